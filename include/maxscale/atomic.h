@@ -36,6 +36,28 @@ int      atomic_add(int *variable, int value);
 int64_t  atomic_add_int64(int64_t *variable, int64_t value);
 uint64_t atomic_add_uint64(uint64_t *variable, int64_t value);
 
+/**
+ * @brief Atomically load a pointer
+ *
+ * The load has acquire semantics: the stores that were done before the pointer
+ * was stored with atomic_store_ptr() are visible after the load.
+ *
+ * @param variable Pointer to the pointer to load
+ * @return The value of the pointer
+ */
+void* atomic_load_ptr(void **variable);
+
+/**
+ * @brief Atomically store a pointer
+ *
+ * The store has release semantics: the stores done before it are visible to
+ * the threads that load the pointer with atomic_load_ptr().
+ *
+ * @param variable Pointer to the pointer to store
+ * @param value    The value to store
+ */
+void atomic_store_ptr(void **variable, void *value);
+
 /**
  * @brief Impose a full memory barrier
  *
@@ -104,6 +104,8 @@ typedef struct mxs_authenticator
 #define MXS_AUTH_LOADUSERS_OK    0 /**< Users loaded successfully */
 #define MXS_AUTH_LOADUSERS_ERROR 1 /**< Temporary error, service is started */
 #define MXS_AUTH_LOADUSERS_FATAL 2 /**< Fatal error, service is not started */
+#define MXS_AUTH_LOADUSERS_CACHED 3 /**< Users were loaded from the snapshot persisted by the
+                                     * previous run and should be refreshed in the background */
 
 /**
  * Authentication states
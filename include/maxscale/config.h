@@ -79,6 +79,7 @@ typedef struct
     time_t        query_retry_timeout;                 /**< Timeout for query retries */
     char*         local_address;                       /**< Local address to use when connecting */
     time_t        users_refresh_time;                  /**< How often the users can be refreshed */
+    time_t        dns_cache_ttl;                       /**< How long resolved addresses are cached */
 } MXS_CONFIG;
 
 /**
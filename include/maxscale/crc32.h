@@ -0,0 +1,55 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file crc32.h CRC-32 of binlog events
+ *
+ * The checksum is the same CRC-32 that zlib's crc32() computes and that the
+ * MySQL and MariaDB servers store in binlog events. On x86-64 processors that
+ * have the carry-less multiplication instruction the data is folded 64 bytes
+ * at a time with PCLMULQDQ, elsewhere a table driven implementation that
+ * processes 8 bytes at a time is used. The implementation is selected when
+ * the function is first called.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+MXS_BEGIN_DECLS
+
+/**
+ * Update a CRC-32
+ *
+ * The function is a replacement for zlib's crc32() and is used the same way:
+ * the CRC-32 of data is mxs_crc32(0, data, len) and the CRC-32 of data that is
+ * in several pieces is computed by passing the previous result as @c crc.
+ *
+ * @param crc  The CRC-32 of the preceding data, 0 for the first piece
+ * @param data The data
+ * @param len  Length of the data
+ *
+ * @return The CRC-32 of the preceding data and @c data
+ */
+uint32_t mxs_crc32(uint32_t crc, const void *data, size_t len);
+
+/**
+ * Check whether the hardware accelerated implementation is used
+ *
+ * @return True if the CRC-32 is computed with PCLMULQDQ
+ */
+bool mxs_crc32_is_accelerated();
+
+MXS_END_DECLS
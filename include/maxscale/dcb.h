@@ -23,6 +23,7 @@
 #include <maxscale/authenticator.h>
 #include <maxscale/ssl.h>
 #include <maxscale/modinfo.h>
+#include <maxscale/timer_wheel.h>
 #include <netinet/in.h>
 
 MXS_BEGIN_DECLS
@@ -221,6 +222,7 @@ typedef struct dcb
     DCBMM           memdata;        /**< The data related to DCB memory management */
     DCB_CALLBACK    *callbacks;     /**< The list of callbacks for the DCB */
     long            last_read;      /*< Last time the DCB received data */
+    MXS_TIMER       idle_timer;     /**< Connection idle timeout, armed in the owner's timer wheel */
     int             high_water;     /**< High water mark */
     int             low_water;      /**< Low water mark */
     struct server   *server;        /**< The associated backend server */
@@ -271,6 +273,12 @@ typedef enum
 
 #define DCB_POLL_BUSY(x)                ((x)->evq.next != NULL)
 
+/**
+ * Number of connections a worker thread accepts from a listener before it
+ * processes its other events
+ */
+#define DCB_ACCEPT_BATCH 64
+
 /**
  * @brief DCB system initialization function
  *
@@ -299,6 +307,24 @@ void dcb_close(DCB *);
  */
 void dcb_process_zombies(int threadid);
 
+/**
+ * @brief Start accepting a batch of connections
+ *
+ * This should only be called from a polling thread in poll.c before the accept
+ * entry point of a listener is called. Until dcb_accept_batch_end() is called,
+ * dcb_accept() returns NULL once DCB_ACCEPT_BATCH connections have been accepted.
+ */
+void dcb_accept_batch_start();
+
+/**
+ * @brief End a batch of accepted connections
+ *
+ * @param listener The listener whose connections were accepted
+ * @return True if the batch was full or accepting failed and more connections
+ *         may be pending
+ */
+bool dcb_accept_batch_end(DCB *listener);
+
 /**
  * Add a DCB to the owner's list
  *
@@ -330,7 +356,10 @@ int dcb_connect_SSL(DCB* dcb);
 int dcb_listen(DCB *listener, const char *config, const char *protocol_name);
 void dcb_append_readqueue(DCB *dcb, GWBUF *buffer);
 void dcb_enable_session_timeouts();
+void dcb_update_idle_timeouts(struct service *service);
 void dcb_process_idle_sessions(int thr);
+bool dcb_pending_idle_timeouts(int thr);
+bool dcb_pending_zombies(int thr);
 
 /**
  * @brief Call a function for each connected DCB
@@ -144,6 +144,10 @@ typedef struct mxs_filter_object
      *
      * TODO: Document how routeQuery should be used
      *
+     * If NULL, the filter does not see the queries and the previous component
+     * of the chain routes them directly to the downstream component of the
+     * filter. The downstream component is still given to @c setDownstream.
+     *
      * @param instance Filter instance
      * @param fsession Filter session
      * @param queue    Request from the client
@@ -158,6 +162,10 @@ typedef struct mxs_filter_object
      *
      * TODO: Document how clientReply should be used
      *
+     * If NULL, the filter does not see the replies and the next component of
+     * the chain returns them directly to the upstream component of the filter.
+     * The upstream component is still given to @c setUpstream.
+     *
      * @param instance Filter instance
      * @param fsession Filter session
      * @param queue    Response from the server
@@ -199,7 +207,7 @@ typedef struct mxs_filter_object
  * is changed these values must be updated in line with the rules in the
  * file modinfo.h.
  */
-#define MXS_FILTER_VERSION  {2, 2, 0}
+#define MXS_FILTER_VERSION  {2, 3, 0}
 
 /**
  * MXS_FILTER_DEF represents a filter definition from the configuration file.
@@ -309,6 +309,21 @@ public:
     }
 
     static MXS_FILTER_OBJECT s_object;
+
+private:
+    typedef char Inherited[1];
+    typedef char Overridden[2];
+
+    /**
+     * Used for finding out at compile time whether the filter session class
+     * overrides @c routeQuery or @c clientReply of FilterSession. If it does
+     * not, the entry point is left out of @c s_object and the filter session
+     * is not called for each packet only for passing it on.
+     */
+    static Inherited& hook(int (FilterSession::*)(GWBUF*));
+
+    template<class T>
+    static Overridden& hook(int (T::*)(GWBUF*));
 };
 
 
@@ -321,8 +336,10 @@ MXS_FILTER_OBJECT Filter<FilterType, FilterSessionType>::s_object =
     &Filter<FilterType, FilterSessionType>::freeSession,
     &Filter<FilterType, FilterSessionType>::setDownstream,
     &Filter<FilterType, FilterSessionType>::setUpstream,
-    &Filter<FilterType, FilterSessionType>::routeQuery,
-    &Filter<FilterType, FilterSessionType>::clientReply,
+    sizeof(hook(&FilterSessionType::routeQuery)) == sizeof(Overridden) ?
+    &Filter<FilterType, FilterSessionType>::routeQuery : NULL,
+    sizeof(hook(&FilterSessionType::clientReply)) == sizeof(Overridden) ?
+    &Filter<FilterType, FilterSessionType>::clientReply : NULL,
     &Filter<FilterType, FilterSessionType>::diagnostics,
     &Filter<FilterType, FilterSessionType>::getCapabilities,
     &Filter<FilterType, FilterSessionType>::destroyInstance,
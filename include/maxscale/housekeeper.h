@@ -20,6 +20,7 @@
 #include <time.h>
 #include <maxscale/dcb.h>
 #include <maxscale/hk_heartbeat.h>
+#include <maxscale/timer_wheel.h>
 
 MXS_BEGIN_DECLS
 
@@ -40,6 +41,12 @@ typedef struct hktask
     int frequency;            /*< How often to call the tasks (seconds) */
     time_t nextdue;           /*< When the task should be next run */
     HKTASK_TYPE type;         /*< The task type */
+    bool parallel;            /*< Whether the task may run in parallel with other tasks */
+    int max_concurrency;      /*< How many runs of the task may execute at the same time */
+    int running;              /*< Number of runs queued or executing */
+    int overruns;             /*< Number of runs skipped due to the concurrency limit */
+    bool removed;             /*< Task removed while running, freed by the last run */
+    MXS_TIMER timer;          /*< Timer in the housekeeper's timer wheel */
     struct hktask *next;      /*< Next task in the list */
 } HKTASK;
 
@@ -63,12 +70,14 @@ extern bool hkinit();
 extern void hkshutdown();
 
 /**
- * Waits for the housekeeper thread to finish. Should be called only after
+ * Waits for the housekeeper threads to finish. Should be called only after
  * hkshutdown() has been called.
  */
 extern void hkfinish();
 
 extern int  hktask_add(const char *name, void (*task)(void *), void *data, int frequency);
+extern int  hktask_add_concurrent(const char *name, void (*task)(void *), void *data,
+                                  int frequency, int max_concurrency);
 extern int  hktask_oneshot(const char *name, void (*task)(void *), void *data, int when);
 extern int  hktask_remove(const char *name);
 extern void hkshow_tasks(DCB *pdcb);
@@ -0,0 +1,137 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file latency.h Per-stage latency of statements
+ *
+ * The time a statement spends in MaxScale is split into stages that are
+ * measured with a monotonic clock. The stages are recorded into histograms
+ * of the service of the session and the stages that involve a backend also
+ * into histograms of the server. The histograms are kept per thread and they
+ * are merged when read.
+ *
+ * The protocol modules mark the points where a statement is read from the
+ * client and where a reply is read from a backend. The rest of the points are
+ * marked by the core.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+MXS_BEGIN_DECLS
+
+struct latency_stats;
+struct server;
+struct session;
+
+typedef enum latency_stage
+{
+    LATENCY_STAGE_PROTOCOL, /**< From reading client data to routing the statement */
+    LATENCY_STAGE_FILTERS,  /**< The filter chain, excluding classification */
+    LATENCY_STAGE_CLASSIFY, /**< Query classification done by filters and the router */
+    LATENCY_STAGE_ROUTER,   /**< The router, excluding classification */
+    LATENCY_STAGE_BACKEND,  /**< From the router returning to the first reply */
+    LATENCY_STAGE_REPLY,    /**< From the first reply to writing it to the client */
+    LATENCY_STAGE_MAX
+} latency_stage_t;
+
+/**
+ * The latency tracking state of a session
+ */
+typedef struct mxs_session_latency
+{
+    uint64_t read;            /**< When client data was read */
+    uint64_t route;           /**< When the statement entered the filter chain */
+    uint64_t router;          /**< When the statement reached the router */
+    uint64_t sent;            /**< When the router returned */
+    uint64_t reply;           /**< When the first reply was read */
+    uint64_t classify_route;  /**< Classification time of the thread at @c route */
+    uint64_t classify_router; /**< Classification time of the thread at @c router */
+    const struct server *server; /**< The server that replied */
+    uint64_t stage[LATENCY_STAGE_MAX]; /**< Stages of the latest statement */
+    bool     traced;          /**< Whether the stages of each statement are logged */
+} MXS_SESSION_LATENCY;
+
+/**
+ * Read the monotonic clock
+ *
+ * @return Current time in nanoseconds
+ */
+static inline uint64_t latency_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Mark that data was read from the client
+ *
+ * @param session The session
+ * @param when    When the read started, as returned by latency_now()
+ */
+void latency_client_read(struct session *session, uint64_t when);
+
+/**
+ * Mark that a statement enters the filter chain
+ *
+ * This is called by MXS_SESSION_ROUTE_QUERY.
+ *
+ * @param session The session
+ */
+void latency_route_begin(struct session *session);
+
+/**
+ * Mark that a reply was read from a backend
+ *
+ * @param session The session
+ * @param server  The server that sent the reply
+ */
+void latency_backend_reply(struct session *session, const struct server *server);
+
+/**
+ * Add time spent in query classification by the current thread
+ *
+ * @param ns Time in nanoseconds
+ */
+void latency_classify_add(uint64_t ns);
+
+/**
+ * Set the percentage of new sessions whose statements are traced
+ *
+ * The stages of each statement of a traced session are logged as notices.
+ *
+ * @param percent Percentage between 0 and 100
+ */
+void latency_set_trace_sampling(int percent);
+
+/**
+ * Get the percentage of new sessions whose statements are traced
+ *
+ * @return Percentage between 0 and 100
+ */
+int latency_get_trace_sampling();
+
+/**
+ * Convert a stage to a string
+ *
+ * @param stage The stage
+ *
+ * @return The name of the stage
+ */
+const char* latency_stage_to_string(latency_stage_t stage);
+
+MXS_END_DECLS
@@ -20,12 +20,23 @@
 #include <maxscale/protocol.h>
 #include <maxscale/ssl.h>
 #include <maxscale/hashtable.h>
+#include <maxscale/metrics.h>
 
 MXS_BEGIN_DECLS
 
 struct dcb;
 struct service;
 
+/**
+ * Statistics of the connections accepted by a listener
+ */
+typedef struct listener_stats
+{
+    MXS_METRIC *n_accepted; /**< Accepted connections */
+    MXS_METRIC *n_errors;   /**< Failed accepts */
+    MXS_METRIC *batches;    /**< Connections accepted per readiness event */
+} LISTENER_STATS;
+
 /**
  * The servlistener structure is used to link a service to the protocols that
  * are used to support that service. It defines the name of the protocol module
@@ -45,6 +56,7 @@ typedef struct servlistener
     struct dcb *listener;       /**< The DCB for the listener */
     struct users *users;        /**< The user data for this listener */
     struct service* service;    /**< The service which used by this listener */
+    LISTENER_STATS stats;       /**< Accept statistics */
     SPINLOCK lock;
     struct  servlistener *next; /**< Next service protocol */
 } SERV_LISTENER;
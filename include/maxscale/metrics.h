@@ -0,0 +1,208 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file metrics.h  - The registry of metrics
+ *
+ * A metric family is defined once, either by the core or by a module in its
+ * MXS_MODULE declaration. Instruments of a family are then created with a set
+ * of labels, e.g. one for each router instance.
+ *
+ * Each worker thread has its own block of values which the instruments of the
+ * thread update without atomic operations. The values of the threads are
+ * combined when an instrument is read. Threads that are not workers share one
+ * block that is updated with atomic operations.
+ *
+ * All registered metrics are added to the Prometheus output of MaxScale.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+MXS_BEGIN_DECLS
+
+/** Maximum number of bucket bounds of a histogram */
+#define MXS_METRIC_BOUNDS_MAX 32
+
+typedef enum mxs_metric_type
+{
+    MXS_METRIC_COUNTER,  /**< A count that only grows, the values of the threads are summed */
+    MXS_METRIC_GAUGE,    /**< A current value, the values of the threads are summed */
+    MXS_METRIC_MAX,      /**< The highest value seen, the highest value of the threads */
+    MXS_METRIC_HISTOGRAM /**< The distribution of observed values */
+} mxs_metric_type_t;
+
+/** The definition of a metric family */
+typedef struct mxs_metric_def
+{
+    const char       *name;     /**< Name of the metric, NULL for the end of a list */
+    mxs_metric_type_t type;     /**< Type of the metric */
+    const char       *help;     /**< Description of the metric */
+    const int64_t    *bounds;   /**< HISTOGRAM: Inclusive upper bounds of the buckets
+                                 *   in increasing order. The last bucket has no bound. */
+    int               n_bounds; /**< HISTOGRAM: Number of bounds */
+} MXS_METRIC_DEF;
+
+/**
+ * This should be the last value of a list of metric definitions
+ */
+#define MXS_END_MODULE_METRICS {NULL}
+
+typedef struct mxs_metric MXS_METRIC;
+
+/**
+ * @brief Define a metric family
+ *
+ * Defining a family that already exists with the same type succeeds.
+ *
+ * @param module Name of the defining module, NULL for the core
+ * @param def    The definition
+ *
+ * @return True if the family was defined
+ */
+bool mxs_metric_define(const char *module, const MXS_METRIC_DEF *def);
+
+/**
+ * @brief Create an instrument of a metric family
+ *
+ * @param name   Name of the family
+ * @param labels Labels of the instrument, built with prometheus_label(), may be NULL
+ *
+ * @return The instrument or NULL if the family does not exist or memory
+ *         allocation failed
+ */
+MXS_METRIC* mxs_metric_create(const char *name, const char *labels);
+
+/**
+ * @brief Free an instrument
+ *
+ * The instrument must not be used by any thread when it is freed.
+ *
+ * @param metric The instrument, may be NULL
+ */
+void mxs_metric_free(MXS_METRIC *metric);
+
+/**
+ * @brief Add to a counter or a gauge
+ *
+ * @param metric The instrument
+ * @param value  Value to add, negative values are allowed only for gauges
+ */
+void mxs_metric_add(MXS_METRIC *metric, int64_t value);
+
+/**
+ * @brief Increment a counter or a gauge by one
+ *
+ * @param metric The instrument
+ */
+static inline void mxs_metric_inc(MXS_METRIC *metric)
+{
+    mxs_metric_add(metric, 1);
+}
+
+/**
+ * @brief Set the value of the calling thread of a gauge
+ *
+ * @param metric The instrument
+ * @param value  The value
+ */
+void mxs_metric_set(MXS_METRIC *metric, int64_t value);
+
+/**
+ * @brief Update the highest value of a maximum
+ *
+ * @param metric The instrument
+ * @param value  The value, stored if it is higher than the current value
+ */
+void mxs_metric_set_max(MXS_METRIC *metric, int64_t value);
+
+/**
+ * @brief Observe a value of a histogram
+ *
+ * @param metric The instrument
+ * @param value  The observed value
+ */
+void mxs_metric_observe(MXS_METRIC *metric, int64_t value);
+
+/**
+ * @brief Read an instrument
+ *
+ * @param metric The instrument
+ *
+ * @return The combined value of all threads. For histograms, this is the
+ *         number of observations.
+ */
+int64_t mxs_metric_get(const MXS_METRIC *metric);
+
+/**
+ * @brief Read the buckets of a histogram
+ *
+ * @param metric  The instrument
+ * @param buckets Array of at least MXS_METRIC_BOUNDS_MAX + 1 values where the
+ *                number of observations in each bucket is stored
+ * @param sum     If not NULL, the sum of the observed values is stored here
+ *
+ * @return Number of buckets, the number of bounds plus one
+ */
+int mxs_metric_get_buckets(const MXS_METRIC *metric, int64_t *buckets, int64_t *sum);
+
+/**
+ * @brief Get the name of the family of an instrument
+ *
+ * @param metric The instrument
+ *
+ * @return The name
+ */
+const char* mxs_metric_name(const MXS_METRIC *metric);
+
+/**
+ * @brief Get the labels of an instrument
+ *
+ * @param metric The instrument
+ *
+ * @return The labels, an empty string if the instrument has none
+ */
+const char* mxs_metric_labels(const MXS_METRIC *metric);
+
+/**
+ * @brief Get the type of an instrument
+ *
+ * @param metric The instrument
+ *
+ * @return The type
+ */
+mxs_metric_type_t mxs_metric_type(const MXS_METRIC *metric);
+
+/**
+ * @brief Call a function for each instrument
+ *
+ * The registry is locked while the function is called. The function must
+ * not create or free instruments.
+ *
+ * @param func Function to call, iteration stops if it returns false
+ * @param data Data given to the function
+ */
+void mxs_metric_foreach(bool (*func)(const MXS_METRIC *metric, void *data), void *data);
+
+/**
+ * @brief Convert a metric type to a string
+ *
+ * @param type The type
+ *
+ * @return The type as a string
+ */
+const char* mxs_metric_type_to_string(mxs_metric_type_t type);
+
+MXS_END_DECLS
@@ -17,6 +17,7 @@
  */
 
 #include <maxscale/cdefs.h>
+#include <maxscale/metrics.h>
 
 MXS_BEGIN_DECLS
 
@@ -166,6 +167,13 @@ typedef struct mxs_module
     void (*thread_finish)();
 
     MXS_MODULE_PARAM parameters[MXS_MODULE_PARAM_MAX + 1];  /**< Declared parameters */
+
+    /**
+     * The metric families of the module, terminated by MXS_END_MODULE_METRICS.
+     * The families are defined when the module is loaded and the module creates
+     * the instruments, e.g. in @c createInstance. NULL if the module has none.
+     */
+    const MXS_METRIC_DEF *metrics;
 } MXS_MODULE;
 
 /**
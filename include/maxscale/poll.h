@@ -91,4 +91,19 @@ int poll_remove_dcb(DCB *);
  */
 void poll_add_epollin_event_to_dcb(DCB* dcb, GWBUF* buf);
 
+/**
+ * Call a function in a worker thread
+ *
+ * The function is called after the worker has processed the events it is
+ * currently handling. This allows a module to defer work that must not be
+ * done from within a callback, to the thread that owns the affected DCBs.
+ *
+ * @param thread_id ID of the worker thread
+ * @param task      Function to call
+ * @param data      Argument given to the function
+ *
+ * @return True if the call was posted, false on memory allocation failure
+ */
+bool poll_post_task(int thread_id, void (*task)(void *data), void *data);
+
 MXS_END_DECLS
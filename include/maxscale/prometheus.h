@@ -0,0 +1,146 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file prometheus.h Metrics in the Prometheus text exposition format
+ *
+ * The metrics are produced by collectors. The core registers collectors for
+ * its own subsystems and modules register collectors for theirs. A collector
+ * must not take locks that the worker threads take when processing events.
+ * Values that the workers update should be instruments of the metrics
+ * registry in metrics.h, which adds all instruments to the output.
+ *
+ * The samples of a metric family may be added in any order and by several
+ * collectors, they are grouped by family when the output is formatted.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <maxscale/buffer.h>
+
+MXS_BEGIN_DECLS
+
+/** Maximum length of the labels of a sample */
+#define PROMETHEUS_LABELS_MAXLEN 512
+
+typedef enum prometheus_type
+{
+    PROMETHEUS_COUNTER,
+    PROMETHEUS_GAUGE,
+    PROMETHEUS_SUMMARY,
+    PROMETHEUS_HISTOGRAM
+} prometheus_type_t;
+
+typedef struct prometheus_output PROMETHEUS_OUTPUT;
+
+/**
+ * A collector adds the samples of its metrics to the output
+ *
+ * @param out  The output
+ * @param data The data given when the collector was added
+ */
+typedef void (*prometheus_collector_t)(PROMETHEUS_OUTPUT *out, void *data);
+
+/**
+ * Add a collector
+ *
+ * The collectors are run while an internal lock is held. A collector must not
+ * add or remove collectors and collectors must not be added or removed while
+ * holding a lock that a collector takes.
+ *
+ * @param collector The collector
+ * @param data      Data given to the collector
+ *
+ * @return True if the collector was added
+ */
+bool prometheus_add_collector(prometheus_collector_t collector, void *data);
+
+/**
+ * Remove a collector
+ *
+ * @param collector The collector
+ * @param data      The data the collector was added with
+ */
+void prometheus_remove_collector(prometheus_collector_t collector, void *data);
+
+/**
+ * Append a label to a label string
+ *
+ * The value is escaped as the text format requires.
+ *
+ * @param labels The labels, of size PROMETHEUS_LABELS_MAXLEN, empty for the first label
+ * @param name   Name of the label
+ * @param value  Value of the label
+ *
+ * @return @c labels
+ */
+char* prometheus_label(char *labels, const char *name, const char *value);
+
+/**
+ * Add a sample of a counter or a gauge
+ *
+ * @param out    The output
+ * @param name   Name of the metric
+ * @param type   PROMETHEUS_COUNTER or PROMETHEUS_GAUGE
+ * @param help   Description of the metric
+ * @param labels Labels of the sample, may be NULL
+ * @param value  The value
+ */
+void prometheus_sample(PROMETHEUS_OUTPUT *out, const char *name, prometheus_type_t type,
+                       const char *help, const char *labels, double value);
+
+/**
+ * Add a sample of a summary
+ *
+ * @param out       The output
+ * @param name      Name of the metric
+ * @param help      Description of the metric
+ * @param labels    Labels of the sample, may be NULL
+ * @param count     Number of observations
+ * @param sum       Sum of the observations
+ * @param n         Number of quantiles
+ * @param quantiles The quantiles, between 0 and 1
+ * @param values    The values of the quantiles
+ */
+void prometheus_summary(PROMETHEUS_OUTPUT *out, const char *name, const char *help,
+                        const char *labels, uint64_t count, double sum,
+                        int n, const double *quantiles, const double *values);
+
+/**
+ * Add a sample of a histogram
+ *
+ * @param out    The output
+ * @param name   Name of the metric
+ * @param help   Description of the metric
+ * @param labels Labels of the sample, may be NULL
+ * @param n      Number of bucket bounds
+ * @param bounds The inclusive upper bounds of the buckets
+ * @param counts The cumulative counts of the buckets, @c n + 1 values where
+ *               the last one is the total count
+ * @param sum    Sum of the observations
+ */
+void prometheus_histogram(PROMETHEUS_OUTPUT *out, const char *name, const char *help,
+                          const char *labels, int n, const double *bounds,
+                          const uint64_t *counts, double sum);
+
+/**
+ * Run all collectors
+ *
+ * @return The metrics in the text exposition format or NULL on memory
+ *         allocation failure
+ */
+GWBUF* prometheus_collect();
+
+MXS_END_DECLS
@@ -69,6 +69,7 @@ typedef struct mxs_protocol
     char   *(*auth_default)();
     int32_t (*connlimit)(struct dcb *, int limit);
     bool    (*established)(struct dcb *);
+    int32_t (*reuse)(struct dcb *);     /**< Prepare a pooled connection for a new session */
 } MXS_PROTOCOL;
 
 /**
@@ -76,6 +77,6 @@ typedef struct mxs_protocol
  * the MXS_PROTOCOL structure is changed. See the rules defined in modinfo.h
  * that define how these numbers should change.
  */
-#define MXS_PROTOCOL_VERSION      {1, 1, 0}
+#define MXS_PROTOCOL_VERSION      {1, 2, 0}
 
 MXS_END_DECLS
@@ -75,6 +75,7 @@ MXS_BEGIN_DECLS
 #define MYSQL_EOF_PACKET_LEN 9
 #define MYSQL_OK_PACKET_MIN_LEN 11
 #define MYSQL_ERR_PACKET_MIN_LEN 9
+#define MYSQL_COMPRESSED_HEADER_LEN 7
 
 /**
  * Offsets and sizes of various parts of the client packet. If the offset is
@@ -308,6 +309,15 @@ typedef struct
     unsigned int           charset;                      /*< MySQL character set at connect time */
     bool                   ignore_reply;                 /*< If the reply should be discarded */
     GWBUF*                 stored_query;                 /*< Temporarily stored queries */
+    bool                   compress;                     /*< Compressed protocol is in use */
+    uint8_t                compress_seq;                 /*< Next compressed packet sequence number */
+    GWBUF*                 compress_readq;               /*< Incomplete compressed packets */
+    uint8_t                compress_header[MYSQL_HEADER_LEN]; /*< Header of the packet being written */
+    uint8_t                compress_header_len;          /*< Bytes of the header written so far */
+    uint32_t               compress_packet_left;         /*< Payload bytes of the packet left to write */
+    bool                   compress_in_command;          /*< The next packet written continues a command */
+    bool                   compress_load_data;           /*< LOAD DATA LOCAL INFILE data is being written */
+    bool                   compress_reply_expected;      /*< The first packet of a reply is not yet read */
 #if defined(SS_DEBUG)
     skygw_chk_t            protocol_chk_tail;
 #endif
@@ -442,4 +452,13 @@ bool mxs_mysql_is_ok_packet(GWBUF *buffer);
 /** Check for result set */
 bool mxs_mysql_is_result_set(GWBUF *buffer);
 
+/** Read data from a DCB, decompressing it if the compressed protocol is in use */
+int mxs_mysql_read(DCB *dcb, GWBUF **head, int maxbytes);
+
+/** Write data to a DCB, compressing it if the compressed protocol is in use */
+int mxs_mysql_write(DCB *dcb, GWBUF *buffer);
+
+/** Check whether the compressed protocol is used with a backend server */
+bool mxs_mysql_backend_compression(MySQLProtocol *proto);
+
 MXS_END_DECLS
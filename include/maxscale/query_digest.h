@@ -0,0 +1,86 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file query_digest.h Server-wide statistics of statements grouped by digest
+ *
+ * Statements are grouped by their canonical form, that is, the statement with
+ * its literal values replaced with question marks. The digest of a statement
+ * is a hash of its canonical form.
+ *
+ * Each thread records into its own shard of the table and the shards are
+ * merged when the statistics are read. The number of digests a shard can hold
+ * is limited, when a shard is full a rarely executed digest is evicted.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <maxscale/dcb.h>
+#include <maxscale/resultset.h>
+
+MXS_BEGIN_DECLS
+
+/** Maximum number of digests in the shard of one thread */
+#define QUERY_DIGEST_MAX_ENTRIES 1024
+
+/** Maximum stored length of a canonical statement */
+#define QUERY_DIGEST_MAX_TEXT    1024
+
+/** Number of latency histogram buckets, bucket N counts latencies between
+ * 2^N and 2^(N+1) microseconds and the last bucket counts all longer ones */
+#define QUERY_DIGEST_HIST_BUCKETS 24
+
+/**
+ * Record one execution of a statement
+ *
+ * @param canonical  The canonical form of the statement
+ * @param latency_us The time from sending the statement to receiving the
+ *                   complete response, in microseconds
+ * @param rows       Number of rows returned
+ * @param bytes      Number of bytes returned
+ * @param error      True if the statement returned an error
+ */
+void query_digest_record(const char *canonical, uint64_t latency_us,
+                         uint64_t rows, uint64_t bytes, bool error);
+
+/**
+ * Calculate the digest of a canonical statement
+ *
+ * @param canonical The canonical form of the statement
+ *
+ * @return The digest
+ */
+uint64_t query_digest_hash(const char *canonical);
+
+/**
+ * Discard all collected statistics
+ */
+void query_digest_reset();
+
+/**
+ * Print the statistics, ordered by the total execution time
+ *
+ * @param dcb The DCB to print to
+ */
+void dShowQueryDigests(DCB *dcb);
+
+/**
+ * Return a result set with the statistics, ordered by the total execution time
+ *
+ * @return A result set or NULL on memory allocation failure
+ */
+RESULTSET* queryDigestGetList();
+
+MXS_END_DECLS
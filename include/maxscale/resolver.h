@@ -0,0 +1,89 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file include/maxscale/resolver.h - The public host name resolver interface
+ *
+ * Host names are resolved by a background thread and the results are cached.
+ * Lookups done by the worker threads never block on name resolution.
+ */
+
+#include <maxscale/cdefs.h>
+#include <sys/socket.h>
+#include <maxscale/dcb.h>
+
+MXS_BEGIN_DECLS
+
+/**
+ * The result of a cached host name lookup
+ */
+typedef enum
+{
+    MXS_RESOLVE_OK,      /**< The address was found */
+    MXS_RESOLVE_PENDING, /**< The host is being resolved in the background */
+    MXS_RESOLVE_FAILED   /**< The last resolution of the host failed */
+} mxs_resolve_result_t;
+
+/**
+ * Resolver cache statistics
+ */
+typedef struct
+{
+    uint64_t hits;        /**< Lookups answered from the cache */
+    uint64_t stale_hits;  /**< Hits on entries older than the TTL */
+    uint64_t misses;      /**< Lookups of hosts not yet resolved */
+    uint64_t failures;    /**< Lookups of hosts that could not be resolved */
+    uint64_t resolutions; /**< Host names resolved by the background thread */
+    uint64_t errors;      /**< Failed resolutions by the background thread */
+    int      entries;     /**< Number of cached host names */
+} RESOLVER_STATS;
+
+/**
+ * @brief Look up the address of a host without blocking
+ *
+ * Numeric addresses are converted directly. Other host names are looked up
+ * from the cache. If the host is not in the cache, it is queued for resolution
+ * by the background thread and MXS_RESOLVE_PENDING is returned. Entries older
+ * than the TTL are still returned while they are refreshed in the background.
+ *
+ * @param host Host name or numeric address
+ * @param addr Where the address is stored, the port is not set
+ * @return MXS_RESOLVE_OK if @c addr was set
+ */
+mxs_resolve_result_t resolver_lookup(const char *host, struct sockaddr_storage *addr);
+
+/**
+ * @brief Queue a host for background resolution
+ *
+ * Used to warm up the cache before the first connection to a host is made.
+ *
+ * @param host Host name or numeric address
+ */
+void resolver_prefetch(const char *host);
+
+/**
+ * @brief Get resolver cache statistics
+ *
+ * @param stats Where the statistics are stored
+ */
+void resolver_get_stats(RESOLVER_STATS *stats);
+
+/**
+ * @brief Print resolver statistics and cached entries to a DCB
+ *
+ * @param dcb DCB to print to
+ */
+void dprintResolverStats(DCB *dcb);
+
+MXS_END_DECLS
@@ -42,6 +42,9 @@ typedef enum routing_capability
     RCAP_TYPE_CONTIGUOUS_OUTPUT     = 0x0030, /* 0b0000000000110000 */
     /** Result sets are delivered in one buffer; implies RCAP_TYPE_STMT_OUTPUT. */
     RCAP_TYPE_RESULTSET_OUTPUT      = 0x0050, /* 0b0000000001110000 */
+    /** Session state changes are reported in OK packets; the client is offered
+        session tracking which is then requested from the backend servers. */
+    RCAP_TYPE_SESSION_TRACKING      = 0x0100, /* 0b0000000100000000 */
 
 } mxs_routing_capability_t;
 
@@ -20,6 +20,7 @@
 
 #include <maxscale/cdefs.h>
 #include <maxscale/dcb.h>
+#include <maxscale/prometheus.h>
 #include <maxscale/resultset.h>
 
 MXS_BEGIN_DECLS
@@ -27,6 +28,7 @@ MXS_BEGIN_DECLS
 #define MAX_SERVER_NAME_LEN 1024
 #define MAX_SERVER_MONUSER_LEN 512
 #define MAX_SERVER_MONPW_LEN 512
+#define MAX_SERVER_GTID_POS_LEN 512
 #define MAX_NUM_SLAVES 128 /**< Maximum number of slaves under a single server*/
 
 /**
@@ -51,6 +53,8 @@ typedef struct
     int n_persistent;     /**< Current persistent pool */
     uint64_t n_new_conn;  /**< Times the current pool was empty */
     uint64_t n_from_pool; /**< Times when a connection was available from the pool */
+    uint64_t n_responses; /**< Number of measured response times */
+    int64_t response_time; /**< Moving average of the response time in microseconds */
 } SERVER_STATS;
 
 /**
@@ -93,6 +97,9 @@ typedef struct server
     long           persistpoolmax; /**< Maximum size of persistent connections pool */
     long           persistmaxtime; /**< Maximum number of seconds connection can live */
     int            persistmax;     /**< Maximum pool size actually achieved since startup */
+    bool           compression;    /**< Use the compressed protocol with this server */
+    char           gtid_pos[MAX_SERVER_GTID_POS_LEN]; /**< Replicated GTID position, updated by the monitor */
+    SPINLOCK       gtid_lock;      /**< Protects gtid_pos, monitors hold lock while they update it */
     uint8_t        charset;        /**< Default server character set */
     bool           is_active;      /**< Server is active and has not been "destroyed" */
     bool           created_online; /**< Whether this server was created after startup */
@@ -100,6 +107,7 @@ typedef struct server
     {
         bool ssl_not_enabled; /**< SSL not used for an SSL enabled server */
     } log_warning; /**< Whether a specific warning was logged */
+    struct latency_stats *latency; /**< Backend and reply latency histograms */
 #if defined(SS_DEBUG)
     skygw_chk_t    server_chk_tail;
 #endif
@@ -129,6 +137,7 @@ enum
 #define SERVER_AUTH_ERROR        0x1000  /**<< Authentication error from monitor */
 #define SERVER_STALE_SLAVE       0x2000  /**<< Slave status is possible even without a master */
 #define SERVER_RELAY_MASTER      0x4000  /**<< Server is a relay master */
+#define SERVER_DNS_ERROR         0x8000  /**<< The address of the server could not be resolved */
 
 /**
  * Is the server valid and active
@@ -139,7 +148,8 @@ enum
  * Is the server running - the macro returns true if the server is marked as running
  * regardless of it's state as a master or slave
  */
-#define SERVER_IS_RUNNING(server) (((server)->status & (SERVER_RUNNING|SERVER_MAINT)) == SERVER_RUNNING)
+#define SERVER_IS_RUNNING(server) (((server)->status & (SERVER_RUNNING|SERVER_MAINT|SERVER_DNS_ERROR)) == \
+                                   SERVER_RUNNING)
 /**
  * Is the server marked as down - the macro returns true if the server is believed
  * to be inoperable.
@@ -152,7 +162,7 @@ enum
 #define SERVER_IS_MASTER(server) SRV_MASTER_STATUS((server)->status)
 
 #define SRV_MASTER_STATUS(status) ((status &                            \
-                                    (SERVER_RUNNING|SERVER_MASTER|SERVER_MAINT)) == \
+                                    (SERVER_RUNNING|SERVER_MASTER|SERVER_MAINT|SERVER_DNS_ERROR)) == \
                                    (SERVER_RUNNING|SERVER_MASTER))
 
 /**
@@ -160,27 +170,30 @@ enum
  * marked as master and not have maintenance bit set.
  */
 #define SERVER_IS_ROOT_MASTER(server)                                   \
-    (((server)->status & (SERVER_RUNNING|SERVER_MASTER|SERVER_MAINT)) == (SERVER_RUNNING|SERVER_MASTER))
+    (((server)->status & (SERVER_RUNNING|SERVER_MASTER|SERVER_MAINT|SERVER_DNS_ERROR)) == \
+     (SERVER_RUNNING|SERVER_MASTER))
 
 /**
  * Is the server a slave? The server must be both running and marked as a slave
  * in order for the macro to return true
  */
 #define SERVER_IS_SLAVE(server)                                         \
-    (((server)->status & (SERVER_RUNNING|SERVER_SLAVE|SERVER_MAINT)) == \
+    (((server)->status & (SERVER_RUNNING|SERVER_SLAVE|SERVER_MAINT|SERVER_DNS_ERROR)) == \
      (SERVER_RUNNING|SERVER_SLAVE))
 
 /**
  * Is the server joined Galera node? The server must be running and joined.
  */
 #define SERVER_IS_JOINED(server)                                        \
-    (((server)->status & (SERVER_RUNNING|SERVER_JOINED|SERVER_MAINT)) == (SERVER_RUNNING|SERVER_JOINED))
+    (((server)->status & (SERVER_RUNNING|SERVER_JOINED|SERVER_MAINT|SERVER_DNS_ERROR)) == \
+     (SERVER_RUNNING|SERVER_JOINED))
 
 /**
  * Is the server a SQL node in MySQL Cluster? The server must be running and with NDB status
  */
 #define SERVER_IS_NDB(server)                                           \
-    (((server)->status & (SERVER_RUNNING|SERVER_NDB|SERVER_MAINT)) == (SERVER_RUNNING|SERVER_NDB))
+    (((server)->status & (SERVER_RUNNING|SERVER_NDB|SERVER_MAINT|SERVER_DNS_ERROR)) == \
+     (SERVER_RUNNING|SERVER_NDB))
 
 /**
  * Is the server in maintenance mode.
@@ -234,6 +247,17 @@ extern SERVER* server_alloc(const char *name, const char *address, unsigned shor
  */
 SERVER* server_find_destroyed(const char *name, const char *protocol,
                               const char *authenticator, const char *auth_options);
+
+/**
+ * @brief Mark a server as active or destroyed
+ *
+ * Only active servers are found with server_find_by_unique_name().
+ *
+ * @param server The server
+ * @param active True to activate a destroyed server, false to destroy it
+ * @see runtime_destroy_server
+ */
+void server_set_active(SERVER *server, bool active);
 /**
  * @brief Serialize a server to a file
  *
@@ -272,6 +296,54 @@ bool server_remove_parameter(SERVER *server, const char *name);
  */
 bool server_is_mxs_service(const SERVER *server);
 
+/**
+ * @brief Update the name resolution state of all servers with an address
+ *
+ * Sets or clears the SERVER_DNS_ERROR bit of every server that uses
+ * @c address in both the current and the pending status, so that monitors
+ * keep the bit. Called by the resolver thread.
+ *
+ * @param address Server address
+ * @param error   True if the address could not be resolved
+ */
+void server_set_dns_error(const char *address, bool error);
+
+/**
+ * @brief Update the GTID position of a server
+ *
+ * The position is protected by its own lock and not by the server lock, so this
+ * can be called by a monitor that holds the server lock.
+ *
+ * @param server   Server to update
+ * @param gtid_pos The GTID position of the server in MariaDB format, e.g. 0-1-15,1-2-4
+ */
+void server_set_gtid_pos(SERVER *server, const char *gtid_pos);
+
+/**
+ * @brief Check whether a server has replicated a GTID
+ *
+ * A server has replicated a GTID if, for each replication domain of @c gtid,
+ * the server's GTID position has a sequence number at least as large.
+ *
+ * @param server Server to check
+ * @param gtid   GTID or a list of GTIDs in MariaDB format
+ * @return True if the server's position includes @c gtid
+ */
+bool server_has_gtid(SERVER *server, const char *gtid);
+
+/**
+ * @brief Add a measured response time of a server
+ *
+ * The response time is added to a moving average in which older values decay
+ * exponentially. The average is updated without locks and it can be updated
+ * by any number of threads at the same time.
+ *
+ * @param server Server that responded
+ * @param us     Time from sending a query to the first part of the reply, in
+ *               microseconds
+ */
+void server_add_response_time(SERVER *server, uint64_t us);
+
 extern int server_free(SERVER *server);
 extern SERVER *server_find_by_unique_name(const char *name);
 extern SERVER *server_find(const char *servname, unsigned short port);
@@ -299,5 +371,8 @@ extern void dprintServer(DCB *, const SERVER *);
 extern void dprintPersistentDCBs(DCB *, const SERVER *);
 extern void dListServers(DCB *);
 extern RESULTSET *serverGetList();
+extern void dprintServerLatency(DCB *);
+extern void serverCollectMetrics(PROMETHEUS_OUTPUT *out, void *data);
+extern RESULTSET *serverGetLatencyList();
 
 MXS_END_DECLS
@@ -19,6 +19,7 @@
  */
 
 #include <maxscale/cdefs.h>
+#include <semaphore.h>
 #include <time.h>
 #include <maxscale/protocol.h>
 #include <maxscale/spinlock.h>
@@ -30,6 +31,7 @@
 #include <maxscale/resultset.h>
 #include <maxscale/config.h>
 #include <maxscale/queuemanager.h>
+#include <maxscale/thread.h>
 #include <openssl/crypto.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
@@ -75,6 +77,20 @@ typedef struct
     bool   warned; /**< Has it been warned that the limit has been exceeded. */
 } SERVICE_REFRESH_RATE;
 
+/**
+ * The thread that reloads the users of a service in the background when
+ * service_refresh_users_async() is called. The thread is started when the
+ * first reload is requested.
+ */
+typedef struct
+{
+    THREAD   thread;  /**< The loader thread */
+    sem_t    sem;     /**< Posted when a reload is requested and at shutdown */
+    SPINLOCK lock;    /**< Protects the starting of the thread */
+    bool     running; /**< Whether the thread has been started */
+    bool     stale;   /**< A listener was started with persisted users */
+} SERVICE_USERS_LOADER;
+
 typedef struct server_ref_t
 {
     struct server_ref_t *next; /**< Next server reference */
@@ -143,14 +159,17 @@ typedef struct service
                                         * when querying them from the server. MySQL Workbench seems
                                         * to escape at least the underscore character. */
     SERVICE_REFRESH_RATE rate_limit;   /**< The refresh rate limit for users table */
+    SERVICE_USERS_LOADER users_loader; /**< Reloads the users in the background */
     MXS_FILTER_DEF **filters;          /**< Ordered list of filters */
     int n_filters;                     /**< Number of filters */
+    struct filter_chain *filter_chain; /**< The filters compiled for creating sessions */
     uint64_t conn_idle_timeout;            /**< Session timeout in seconds */
     char *weightby;                    /**< Service weighting parameter name */
     struct service *next;              /**< The next service in the linked list */
     bool retry_start;                  /**< If starting of the service should be retried later */
     bool log_auth_warnings;            /**< Log authentication failures and warnings */
     uint64_t capabilities;             /**< The capabilities of the service. */
+    struct latency_stats *latency;     /**< Per-stage latency histograms */
 } SERVICE;
 
 typedef enum count_spec_t
@@ -263,6 +282,22 @@ int   serviceStripDbEsc(SERVICE* service, int action);
 int   serviceAuthAllServers(SERVICE *service, int action);
 int   service_refresh_users(SERVICE *service);
 
+/**
+ * @brief Reload the users of a service in the background
+ *
+ * The users are loaded by a thread of the service and the caller does not
+ * wait for them. This should be used instead of service_refresh_users() by
+ * the worker threads, e.g. when authentication fails. Until the new users
+ * have been loaded, clients are authenticated against the current users.
+ * The same refresh rate limit applies to both functions.
+ *
+ * @param service Service to reload
+ * @return 0 if a reload was requested and 1 if the rate limit was exceeded,
+ *         the users are being reloaded with service_refresh_users() or
+ *         the loader thread could not be started
+ */
+int   service_refresh_users_async(SERVICE *service);
+
 /**
  * Diagnostics
  */
@@ -282,6 +317,8 @@ void       dListListeners(DCB *dcb);
 int        serviceSessionCountAll(void);
 RESULTSET* serviceGetList(void);
 RESULTSET* serviceGetListenerList(void);
+void       dprintServiceLatency(DCB *dcb);
+RESULTSET* serviceGetLatencyList(void);
 
 /**
  * Get the capabilities of the servive.
@@ -22,6 +22,7 @@
 
 #include <maxscale/atomic.h>
 #include <maxscale/buffer.h>
+#include <maxscale/latency.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/resultset.h>
 #include <maxscale/spinlock.h>
@@ -146,6 +147,7 @@ typedef struct session
         const struct server *target; /**< Where the statement was sent */
     } stmt;  /**< Current statement being executed */
     bool qualifies_for_pooling; /**< Whether this session qualifies for the connection pool */
+    MXS_SESSION_LATENCY latency; /**< Timestamps of the current statement */
     skygw_chk_t     ses_chk_tail;
 } MXS_SESSION;
 
@@ -155,8 +157,9 @@ typedef struct session
  * routers.
  */
 #define MXS_SESSION_ROUTE_QUERY(sess, buf)                          \
-    ((sess)->head.routeQuery)((sess)->head.instance,            \
-                              (sess)->head.session, (buf))
+    (latency_route_begin(sess),                                 \
+     ((sess)->head.routeQuery)((sess)->head.instance,           \
+                               (sess)->head.session, (buf)))
 /**
  * A convenience macro that can be used by the router modules to route
  * the replies to the first element in the pipeline of filters and
@@ -325,6 +328,20 @@ static inline bool session_set_autocommit(MXS_SESSION* ses, bool autocommit)
  */
 MXS_SESSION* session_get_by_id(int id);
 
+/**
+ * @brief Get a session reference
+ *
+ * This creates an additional reference to a session which allows it to live
+ * as long as it is needed. This function is public only because the
+ * tee-filter uses it.
+ *
+ * @param session Session reference to get
+ * @return Reference to a MXS_SESSION
+ *
+ * @note The caller must free the session reference by calling session_put_ref
+ */
+MXS_SESSION* session_get_ref(MXS_SESSION *session);
+
 /**
  * @brief Release a session reference
  *
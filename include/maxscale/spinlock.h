@@ -25,6 +25,7 @@
 
 #include <maxscale/cdefs.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <maxscale/debug.h>
 
 MXS_BEGIN_DECLS
@@ -36,6 +37,8 @@ MXS_BEGIN_DECLS
  *
  * In normal builds the structure merely contains a lock value which
  * is 0 if the spinlock is not taken and greater than zero if it is held.
+ * A thread that fails to take the lock spins for a short while, backing off
+ * exponentially, and then sleeps until the lock is released.
  *
  * In builds with the SPINLOCK_PROFILE option set this structure also holds
  * a number of profile related fields that count the number of spins, number
@@ -112,4 +115,42 @@ extern void spinlock_release(const SPINLOCK *lock);
  */
 extern void spinlock_stats(const SPINLOCK *lock, void (*reporter)(void *, char *, int), void *hdl);
 
+/**
+ * Enable or disable the runtime profiling of spinlocks. When enabled, a sample
+ * of all acquisitions and every contended acquisition is recorded per lock.
+ * Enabling the profiling discards the results of earlier profiling.
+ *
+ * @param enable True to enable profiling, false to disable it
+ */
+extern void spinlock_profile_enable(bool enable);
+
+/**
+ * Check whether spinlock profiling is enabled.
+ *
+ * @return True if profiling is enabled
+ */
+extern bool spinlock_profile_enabled();
+
+/**
+ * Callback used for reporting the profile of one spinlock.
+ *
+ * @param hdl       The handle given to spinlock_profile_report
+ * @param lock      Address of the lock, it may no longer be valid
+ * @param caller    The function where the lock was first sampled
+ * @param acquired  Estimated number of acquisitions
+ * @param contended Number of acquisitions where the lock was already held
+ */
+typedef void (*spinlock_profile_reporter_t)(void *hdl, const void *lock, const char *caller,
+                                            uint64_t acquired, uint64_t contended);
+
+/**
+ * Report the profiled spinlocks, most contended first.
+ *
+ * @param reporter The callback function called for each lock
+ * @param hdl      A handle that is passed to the reporter function
+ *
+ * @return Number of samples that were dropped because too many locks were seen
+ */
+extern uint64_t spinlock_profile_report(spinlock_profile_reporter_t reporter, void *hdl);
+
 MXS_END_DECLS
@@ -0,0 +1,138 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file timer_wheel.h Hierarchical timer wheel
+ *
+ * A timer wheel holds a set of timers, each of which expires at a given tick.
+ * Adding and removing a timer are constant time operations and advancing the
+ * wheel only touches the timers that expire, which makes the wheel suitable
+ * for tracking large numbers of mostly cancelled timeouts, e.g. one per
+ * connection.
+ *
+ * The wheel does no locking of its own, the owner of a wheel must serialize
+ * all access to it. The unit of a tick is decided by the owner, in MaxScale
+ * it is usually one housekeeper heartbeat, that is, 100 milliseconds.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+
+MXS_BEGIN_DECLS
+
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_SLOTS      (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS     4
+
+/** The longest delay a timer can be added with, longer delays are clamped
+ * internally and the timer is re-queued until its real expiry time */
+#define TIMER_WHEEL_MAX_DELAY  ((1L << (TIMER_WHEEL_LEVEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+struct mxs_timer;
+
+typedef void (*mxs_timer_cb_t)(struct mxs_timer *timer, void *data);
+
+/**
+ * A timer. The structure is meant to be embedded into the object whose
+ * timeout it tracks so that no allocations are needed.
+ */
+typedef struct mxs_timer
+{
+    struct mxs_timer  *next;     /**< Next timer in the same slot */
+    struct mxs_timer **pprev;    /**< The pointer that points to this timer, NULL if not armed */
+    long               expires;  /**< The tick at which the timer expires */
+    mxs_timer_cb_t     callback; /**< Function called when the timer expires */
+    void              *data;     /**< Data passed to the callback */
+} MXS_TIMER;
+
+#define MXS_TIMER_INIT {NULL, NULL, 0, NULL, NULL}
+
+/**
+ * A timer wheel
+ */
+typedef struct mxs_timer_wheel
+{
+    long       now;     /**< The last tick that was processed */
+    int        count;   /**< Number of armed timers */
+    MXS_TIMER *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} MXS_TIMER_WHEEL;
+
+/**
+ * Initialize a timer wheel
+ *
+ * @param wheel Wheel to initialize
+ * @param now   The current tick
+ */
+void timer_wheel_init(MXS_TIMER_WHEEL *wheel, long now);
+
+/**
+ * Initialize a timer
+ *
+ * @param timer    Timer to initialize
+ * @param callback Function to call when the timer expires
+ * @param data     Data passed to @c callback
+ */
+void timer_init(MXS_TIMER *timer, mxs_timer_cb_t callback, void *data);
+
+/**
+ * Check whether a timer is armed
+ *
+ * @param timer Timer to check
+ *
+ * @return True if the timer is in a wheel
+ */
+static inline bool timer_is_armed(const MXS_TIMER *timer)
+{
+    return timer->pprev != NULL;
+}
+
+/**
+ * Arm a timer
+ *
+ * If the timer is already armed, it is first removed from the wheel. A timer
+ * that expires at or before the current tick expires on the next call to
+ * timer_wheel_advance() that moves the wheel forward.
+ *
+ * The callback may add the timer it was called for back into the wheel.
+ *
+ * @param wheel   Wheel to add the timer to
+ * @param timer   An initialized timer
+ * @param expires The tick at which the timer expires
+ */
+void timer_wheel_add(MXS_TIMER_WHEEL *wheel, MXS_TIMER *timer, long expires);
+
+/**
+ * Disarm a timer
+ *
+ * Removing a timer that is not armed is a no-op.
+ *
+ * @param wheel The wheel the timer was added to
+ * @param timer Timer to remove
+ */
+void timer_wheel_remove(MXS_TIMER_WHEEL *wheel, MXS_TIMER *timer);
+
+/**
+ * Advance the wheel
+ *
+ * Moves the wheel forward to @c now and calls the callbacks of the timers
+ * that expired. The timers are disarmed before their callbacks are called.
+ *
+ * @param wheel Wheel to advance
+ * @param now   The current tick
+ *
+ * @return Number of timers that expired
+ */
+int timer_wheel_advance(MXS_TIMER_WHEEL *wheel, long now);
+
+MXS_END_DECLS
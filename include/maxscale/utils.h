@@ -72,6 +72,31 @@ int open_network_socket(enum mxs_socket_type type, struct sockaddr_storage *addr
 int setnonblocking(int fd);
 char  *gw_strend(register const char *s);
 static char gw_randomchar();
+
+/**
+ * Generate cryptographically secure random bytes
+ *
+ * The bytes come from the kernel but are read in blocks into a per-thread
+ * buffer so that most calls do not need a system call.
+ *
+ * @param output Buffer where the bytes are stored
+ * @param len    Number of bytes to generate
+ *
+ * @return True if the bytes were generated, false if the kernel did not
+ *         provide random bytes
+ */
+bool mxs_random_bytes(uint8_t *output, size_t len);
+
+/**
+ * Generate a random string for a scramble
+ *
+ * The characters are taken from mxs_random_bytes().
+ *
+ * @param output Buffer of at least @c len + 1 bytes
+ * @param len    Length of the string
+ *
+ * @return 0
+ */
 int gw_generate_random_str(char *output, int len);
 int gw_hex2bin(uint8_t *out, const char *in, unsigned int len);
 char *gw_bin2hex(char *out, const uint8_t *in, unsigned int len);
@@ -31,3 +31,13 @@ uint64_t atomic_add_uint64(uint64_t *variable, int64_t value)
 {
     return __sync_fetch_and_add(variable, value);
 }
+
+void* atomic_load_ptr(void **variable)
+{
+    return __atomic_load_n(variable, __ATOMIC_ACQUIRE);
+}
+
+void atomic_store_ptr(void **variable, void *value)
+{
+    __atomic_store_n(variable, value, __ATOMIC_RELEASE);
+}
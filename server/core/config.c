@@ -72,6 +72,7 @@
 #include "maxscale/service.h"
 #include "maxscale/monitor.h"
 #include "maxscale/modules.h"
+#include "maxscale/resolver.h"
 
 typedef struct duplicate_context
 {
@@ -194,6 +195,7 @@ static const char *server_params[] =
     "monitorpw",
     "persistpoolmax",
     "persistmaxtime",
+    "compression",
     "ssl_cert",
     "ssl_ca_cert",
     "ssl",
@@ -1405,6 +1407,20 @@ handle_global_item(const char *name, const char *value)
     {
         gateway.local_address = MXS_STRDUP_A(value);
     }
+    else if (strcmp(name, "dns_cache_ttl") == 0)
+    {
+        char* endptr;
+        long intval = strtol(value, &endptr, 0);
+        if (*endptr == '\0' && intval > 0)
+        {
+            gateway.dns_cache_ttl = intval;
+        }
+        else
+        {
+            MXS_ERROR("Invalid value for 'dns_cache_ttl': %s", value);
+            return 0;
+        }
+    }
     else if (strcmp(name, "users_refresh_time") == 0)
     {
         char* endptr;
@@ -1675,6 +1691,7 @@ global_defaults()
     gateway.skip_permission_checks = false;
     gateway.query_retries = DEFAULT_QUERY_RETRIES;
     gateway.query_retry_timeout = DEFAULT_QUERY_RETRY_TIMEOUT;
+    gateway.dns_cache_ttl = DEFAULT_DNS_CACHE_TTL;
 
     if (version_string != NULL)
     {
@@ -2859,6 +2876,12 @@ int create_new_server(CONFIG_CONTEXT *obj)
             }
         }
 
+        const char *compression = config_get_value_string(obj->parameters, "compression");
+        if (*compression)
+        {
+            server->compression = config_truth_value(compression);
+        }
+
         MXS_CONFIG_PARAMETER *params = obj->parameters;
 
         server->server_ssl = make_ssl_structure(obj, false, &error_count);
@@ -128,7 +128,7 @@ bool runtime_create_server(const char *name, const char *address, const char *po
              * reactivate it */
             snprintf(server->name, sizeof(server->name), "%s", address);
             server->port = atoi(port);
-            server->is_active = true;
+            server_set_active(server, true);
             rval = true;
         }
         else
@@ -197,7 +197,7 @@ bool runtime_destroy_server(SERVER *server)
         {
             MXS_NOTICE("Destroyed server '%s' at %s:%u", server->unique_name,
                        server->name, server->port);
-            server->is_active = false;
+            server_set_active(server, false);
         }
     }
 
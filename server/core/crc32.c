@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file crc32.c CRC-32 of binlog events
+ *
+ * The portable implementation is the slicing-by-8 algorithm that looks up
+ * eight bytes at a time from eight tables. The accelerated implementation
+ * folds the data with carry-less multiplications as described in Intel's
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+ * and reduces the result with Barrett reduction. Both work on the inverted
+ * CRC, the inversions are done by mxs_crc32().
+ */
+
+#include <maxscale/crc32.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC32_PCLMUL
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+/** The reflected polynomial of CRC-32 */
+#define CRC32_POLY 0xedb88320
+
+/** The accelerated implementation is used for at least this many bytes */
+#define CRC32_PCLMUL_MIN_LEN 64
+
+static uint32_t crc32_table[8][256];
+static bool crc32_pclmul_enabled = false;
+static pthread_once_t crc32_init_done = PTHREAD_ONCE_INIT;
+
+static void crc32_init()
+{
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t crc = n;
+
+        for (int k = 0; k < 8; k++)
+        {
+            crc = crc & 1 ? CRC32_POLY ^ (crc >> 1) : crc >> 1;
+        }
+
+        crc32_table[0][n] = crc;
+    }
+
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t crc = crc32_table[0][n];
+
+        for (int k = 1; k < 8; k++)
+        {
+            crc = crc32_table[0][crc & 0xff] ^ (crc >> 8);
+            crc32_table[k][n] = crc;
+        }
+    }
+
+#if defined(CRC32_PCLMUL)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        crc32_pclmul_enabled = (ecx & bit_PCLMUL) != 0;
+    }
+#endif
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *buf, size_t len)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8)
+    {
+        uint32_t one;
+        uint32_t two;
+
+        memcpy(&one, buf, sizeof(one));
+        memcpy(&two, buf + 4, sizeof(two));
+        one ^= crc;
+
+        crc = crc32_table[7][one & 0xff] ^
+              crc32_table[6][(one >> 8) & 0xff] ^
+              crc32_table[5][(one >> 16) & 0xff] ^
+              crc32_table[4][one >> 24] ^
+              crc32_table[3][two & 0xff] ^
+              crc32_table[2][(two >> 8) & 0xff] ^
+              crc32_table[1][(two >> 16) & 0xff] ^
+              crc32_table[0][two >> 24];
+
+        buf += 8;
+        len -= 8;
+    }
+#endif
+
+    while (len--)
+    {
+        crc = crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+#if defined(CRC32_PCLMUL)
+
+/**
+ * Fold the data with PCLMULQDQ
+ *
+ * @param crc The inverted CRC
+ * @param buf The data
+ * @param len Length of the data, at least 64 and a multiple of 16
+ *
+ * @return The inverted CRC
+ */
+__attribute__((target("pclmul,sse2")))
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *buf, size_t len)
+{
+    /** The folding constants and the Barrett reduction constants of CRC-32 */
+    static const uint64_t k1k2[] __attribute__((aligned(16))) = {0x0154442bd4, 0x01c6e41596};
+    static const uint64_t k3k4[] __attribute__((aligned(16))) = {0x01751997d0, 0x00ccaa009e};
+    static const uint64_t k5k0[] __attribute__((aligned(16))) = {0x0163cd6124, 0x0000000000};
+    static const uint64_t poly[] __attribute__((aligned(16))) = {0x01db710641, 0x01f7011641};
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /** Fold four blocks of 16 bytes in parallel */
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /** Fold the four blocks into one */
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /** Fold the remaining blocks of 16 bytes */
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /** Fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /** Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+#endif
+
+uint32_t mxs_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *buf = data;
+
+    pthread_once(&crc32_init_done, crc32_init);
+    crc = ~crc;
+
+#if defined(CRC32_PCLMUL)
+    if (crc32_pclmul_enabled && len >= CRC32_PCLMUL_MIN_LEN)
+    {
+        size_t chunk = len & ~(size_t)15;
+        crc = crc32_pclmul(crc, buf, chunk);
+        buf += chunk;
+        len -= chunk;
+    }
+#endif
+
+    return ~crc32_slice8(crc, buf, len);
+}
+
+bool mxs_crc32_is_accelerated()
+{
+    pthread_once(&crc32_init_done, crc32_init);
+    return crc32_pclmul_enabled;
+}
@@ -96,6 +96,7 @@
 
 #include "maxscale/session.h"
 #include "maxscale/modules.h"
+#include "maxscale/poll.h"
 #include "maxscale/queuemanager.h"
 
 /* A DCB with null values, used for initialization */
@@ -108,9 +109,11 @@ static  int            *nzombies;
 static  int             maxzombies = 0;
 static  SPINLOCK        zombiespin = SPINLOCK_INIT;
 
+/** Per-thread timer wheels for the connection idle timeouts, protected by all_dcbs_lock */
+static  MXS_TIMER_WHEEL *idle_wheels;
+
 /** Variables for session timeout checks */
 bool check_timeouts = false;
-thread_local long next_timeout_check = 0;
 
 void dcb_global_init()
 {
@@ -119,7 +122,8 @@ void dcb_global_init()
     if ((zombies = MXS_CALLOC(nthreads, sizeof(DCB*))) == NULL ||
         (all_dcbs = MXS_CALLOC(nthreads, sizeof(DCB*))) == NULL ||
         (all_dcbs_lock = MXS_CALLOC(nthreads, sizeof(SPINLOCK))) == NULL ||
-        (nzombies = MXS_CALLOC(nthreads, sizeof(int))) == NULL)
+        (nzombies = MXS_CALLOC(nthreads, sizeof(int))) == NULL ||
+        (idle_wheels = MXS_CALLOC(nthreads, sizeof(MXS_TIMER_WHEEL))) == NULL)
     {
         MXS_OOM();
         raise(SIGABRT);
@@ -128,6 +132,7 @@ void dcb_global_init()
     for (int i = 0; i < nthreads; i++)
     {
         spinlock_init(&all_dcbs_lock[i]);
+        timer_wheel_init(&idle_wheels[i], hkheartbeat);
     }
 }
 
@@ -138,6 +143,7 @@ static int  dcb_null_write(DCB *dcb, GWBUF *buf);
 static int  dcb_null_auth(DCB *dcb, SERVER *server, MXS_SESSION *session, GWBUF *buf);
 static inline DCB * dcb_find_in_list(DCB *dcb);
 static inline void dcb_process_victim_queue(int threadid);
+static void dcb_idle_timeout(MXS_TIMER *timer, void *data);
 static void dcb_stop_polling_and_shutdown (DCB *dcb);
 static bool dcb_maybe_add_persistent(DCB *);
 static inline bool dcb_write_parameter_check(DCB *dcb, GWBUF *queue);
@@ -637,7 +643,20 @@ dcb_connect(SERVER *server, MXS_SESSION *session, const char *protocol)
             dcb->was_persistent = true;
             dcb->last_read = hkheartbeat;
             atomic_add_uint64(&server->stats.n_from_pool, 1);
-            return dcb;
+
+            /**
+             * Let the protocol start resetting the connection for the new session
+             * before anything is written to it. If it can't, a new connection is
+             * created instead.
+             */
+            if (dcb->func.reuse == NULL || dcb->func.reuse(dcb))
+            {
+                return dcb;
+            }
+
+            MXS_INFO("Persistent connection to server '%s' could not be reused, "
+                     "creating a new connection.", server->unique_name);
+            dcb_close(dcb);
         }
         else
         {
@@ -1577,6 +1596,15 @@ static void log_illegal_dcb(DCB *dcb)
               dcb, STRDCBSTATE(dcb->state), connected_to);
 }
 
+/**
+ * Wake up a worker thread so that it processes its zombie queue and idle timers
+ *
+ * Both are processed after the posted tasks, there's nothing else to do.
+ */
+static void dcb_wakeup(void *data)
+{
+}
+
 /**
  * Removes dcb from poll set, and adds it to zombies list. As a consequence,
  * dcb first moves to DCB_STATE_NOPOLLING, and then to DCB_STATE_ZOMBIE state.
@@ -1640,6 +1668,12 @@ dcb_close(DCB *dcb)
         {
             maxzombies = nzombies[owner];
         }
+
+        if (!poll_is_worker(owner))
+        {
+            /** The owner may be blocked in epoll_wait() without a timeout */
+            poll_post_task(owner, dcb_wakeup, NULL);
+        }
     }
     else
     {
@@ -2815,35 +2849,63 @@ int dcb_connect_SSL(DCB* dcb)
 }
 
 /**
- * @brief Accept a new client connection, given a listener, return new DCB
- *
- * Calls dcb_accept_one_connection to do the basic work of obtaining a new
- * connection from a listener.  If that succeeds, some settings are fixed and
- * a client DCB is created to handle the new connection. Further DCB details
- * are set before returning the new DCB to the caller, or returning NULL if
- * no new connection could be achieved.
+ * The connections accepted by this thread while it processes a readiness
+ * event of a listener
+ */
+static thread_local struct
+{
+    bool active;    /**< Whether a batch has been started */
+    bool exhausted; /**< Whether the batch ended before all connections were accepted */
+    int  accepted;  /**< Number of connections accepted in the batch */
+} accept_batch;
+
+void dcb_accept_batch_start()
+{
+    accept_batch.active = true;
+    accept_batch.exhausted = false;
+    accept_batch.accepted = 0;
+}
+
+bool dcb_accept_batch_end(DCB *listener)
+{
+    accept_batch.active = false;
+
+    if (listener->listener)
+    {
+        mxs_metric_observe(listener->listener->stats.batches, accept_batch.accepted);
+    }
+
+    return accept_batch.exhausted;
+}
+
+/**
+ * @brief Create a client DCB for an accepted connection
  *
- * @param dcb Listener DCB that has detected new connection request
- * @return DCB - The new client DCB for the new connection, or NULL if failed
+ * @param listener    Listener DCB that accepted the connection
+ * @param c_sock      The accepted socket
+ * @param client_conn Address of the client
+ * @return The new client DCB, or NULL if the connection was closed or queued
  */
-DCB *
-dcb_accept(DCB *listener)
+static DCB *
+dcb_create_client(DCB *listener, int c_sock, struct sockaddr_storage *client_conn)
 {
     DCB *client_dcb = NULL;
     MXS_PROTOCOL *protocol_funcs = &listener->func;
-    int c_sock;
     int sendbuf;
-    struct sockaddr_storage client_conn;
     socklen_t optlen = sizeof(sendbuf);
     char errbuf[MXS_STRERROR_BUFLEN];
 
-    if ((c_sock = dcb_accept_one_connection(listener, (struct sockaddr *)&client_conn)) >= 0)
+    MXS_DEBUG("%lu [gw_MySQLAccept] Accepted fd %d.",
+              pthread_self(),
+              c_sock);
+
+    /**
+     * The socket is non-blocking and TCP sockets inherit the buffer sizes
+     * and TCP_NODELAY from the listener socket. Unix domain sockets do not
+     * inherit the buffer sizes.
+     */
+    if (client_conn->ss_family == AF_UNIX)
     {
-        listener->stats.n_accepts++;
-        MXS_DEBUG("%lu [gw_MySQLAccept] Accepted fd %d.",
-                  pthread_self(),
-                  c_sock);
-        /* set nonblocking  */
         sendbuf = MXS_CLIENT_SO_SNDBUF;
 
         if (setsockopt(c_sock, SOL_SOCKET, SO_SNDBUF, &sendbuf, optlen) != 0)
@@ -2859,102 +2921,149 @@ dcb_accept(DCB *listener)
             MXS_ERROR("Failed to set socket options. Error %d: %s",
                       errno, strerror_r(errno, errbuf, sizeof(errbuf)));
         }
-        setnonblocking(c_sock);
+    }
 
-        client_dcb = dcb_alloc(DCB_ROLE_CLIENT_HANDLER, listener->listener);
+    client_dcb = dcb_alloc(DCB_ROLE_CLIENT_HANDLER, listener->listener);
 
-        if (client_dcb == NULL)
+    if (client_dcb == NULL)
+    {
+        MXS_ERROR("Failed to create DCB object for client connection.");
+        close(c_sock);
+    }
+    else
+    {
+        const char *authenticator_name = "NullAuthDeny";
+        MXS_AUTHENTICATOR *authfuncs;
+
+        client_dcb->service = listener->session->service;
+        client_dcb->session = session_set_dummy(client_dcb);
+        client_dcb->fd = c_sock;
+
+        // get client address
+        if (client_conn->ss_family == AF_UNIX)
         {
-            MXS_ERROR("Failed to create DCB object for client connection.");
-            close(c_sock);
+            // client address
+            client_dcb->remote = MXS_STRDUP_A("localhost");
         }
         else
         {
-            const char *authenticator_name = "NullAuthDeny";
-            MXS_AUTHENTICATOR *authfuncs;
-
-            client_dcb->service = listener->session->service;
-            client_dcb->session = session_set_dummy(client_dcb);
-            client_dcb->fd = c_sock;
+            /* client IP in raw data*/
+            memcpy(&client_dcb->ip, client_conn, sizeof(*client_conn));
+            /* client IP in string representation */
+            client_dcb->remote = (char *)MXS_CALLOC(INET6_ADDRSTRLEN + 1, sizeof(char));
 
-            // get client address
-            if (client_conn.ss_family == AF_UNIX)
-            {
-                // client address
-                client_dcb->remote = MXS_STRDUP_A("localhost");
-            }
-            else
+            if (client_dcb->remote)
             {
-                /* client IP in raw data*/
-                memcpy(&client_dcb->ip, &client_conn, sizeof(client_conn));
-                /* client IP in string representation */
-                client_dcb->remote = (char *)MXS_CALLOC(INET6_ADDRSTRLEN + 1, sizeof(char));
-
-                if (client_dcb->remote)
+                void *ptr;
+                if (client_dcb->ip.ss_family == AF_INET)
                 {
-                    void *ptr;
-                    if (client_dcb->ip.ss_family == AF_INET)
-                    {
-                        ptr = &((struct sockaddr_in*)&client_dcb->ip)->sin_addr;
-                    }
-                    else
-                    {
-                        ptr = &((struct sockaddr_in6*)&client_dcb->ip)->sin6_addr;
-                    }
-
-                    inet_ntop(client_dcb->ip.ss_family, ptr,
-                              client_dcb->remote, INET6_ADDRSTRLEN);
+                    ptr = &((struct sockaddr_in*)&client_dcb->ip)->sin_addr;
                 }
-            }
-            memcpy(&client_dcb->func, protocol_funcs, sizeof(MXS_PROTOCOL));
-            if (listener->listener->authenticator)
-            {
-                authenticator_name = listener->listener->authenticator;
-            }
-            else if (client_dcb->func.auth_default != NULL)
-            {
-                authenticator_name = client_dcb->func.auth_default();
-            }
-            if ((authfuncs = (MXS_AUTHENTICATOR *)load_module(authenticator_name,
-                                                            MODULE_AUTHENTICATOR)) == NULL)
-            {
-                if ((authfuncs = (MXS_AUTHENTICATOR *)load_module("NullAuthDeny",
-                                                                MODULE_AUTHENTICATOR)) == NULL)
+                else
                 {
-                    MXS_ERROR("Failed to load authenticator module for %s, free dcb %p\n",
-                              authenticator_name,
-                              client_dcb);
-                    dcb_close(client_dcb);
-                    return NULL;
+                    ptr = &((struct sockaddr_in6*)&client_dcb->ip)->sin6_addr;
                 }
-            }
-            memcpy(&(client_dcb->authfunc), authfuncs, sizeof(MXS_AUTHENTICATOR));
 
-            /** Allocate DCB specific authentication data */
-            if (client_dcb->authfunc.create &&
-                (client_dcb->authenticator_data = client_dcb->authfunc.create(
-                                                      client_dcb->listener->auth_instance)) == NULL)
+                inet_ntop(client_dcb->ip.ss_family, ptr,
+                          client_dcb->remote, INET6_ADDRSTRLEN);
+            }
+        }
+        memcpy(&client_dcb->func, protocol_funcs, sizeof(MXS_PROTOCOL));
+        if (listener->listener->authenticator)
+        {
+            authenticator_name = listener->listener->authenticator;
+        }
+        else if (client_dcb->func.auth_default != NULL)
+        {
+            authenticator_name = client_dcb->func.auth_default();
+        }
+        if ((authfuncs = (MXS_AUTHENTICATOR *)load_module(authenticator_name,
+                                                        MODULE_AUTHENTICATOR)) == NULL)
+        {
+            if ((authfuncs = (MXS_AUTHENTICATOR *)load_module("NullAuthDeny",
+                                                            MODULE_AUTHENTICATOR)) == NULL)
             {
-                MXS_ERROR("Failed to create authenticator for client DCB.");
+                MXS_ERROR("Failed to load authenticator module for %s, free dcb %p\n",
+                          authenticator_name,
+                          client_dcb);
                 dcb_close(client_dcb);
                 return NULL;
             }
+        }
+        memcpy(&(client_dcb->authfunc), authfuncs, sizeof(MXS_AUTHENTICATOR));
 
-            if (client_dcb->service->max_connections &&
-                client_dcb->service->client_count >= client_dcb->service->max_connections)
+        /** Allocate DCB specific authentication data */
+        if (client_dcb->authfunc.create &&
+            (client_dcb->authenticator_data = client_dcb->authfunc.create(
+                                                  client_dcb->listener->auth_instance)) == NULL)
+        {
+            MXS_ERROR("Failed to create authenticator for client DCB.");
+            dcb_close(client_dcb);
+            return NULL;
+        }
+
+        if (client_dcb->service->max_connections &&
+            client_dcb->service->client_count >= client_dcb->service->max_connections)
+        {
+            if (!mxs_enqueue(client_dcb->service->queued_connections, client_dcb))
             {
-                if (!mxs_enqueue(client_dcb->service->queued_connections, client_dcb))
+                if (client_dcb->func.connlimit)
                 {
-                    if (client_dcb->func.connlimit)
-                    {
-                        client_dcb->func.connlimit(client_dcb, client_dcb->service->max_connections);
-                    }
-                    dcb_close(client_dcb);
+                    client_dcb->func.connlimit(client_dcb, client_dcb->service->max_connections);
                 }
-                client_dcb = NULL;
+                dcb_close(client_dcb);
             }
+            client_dcb = NULL;
+        }
+    }
+    return client_dcb;
+}
+
+/**
+ * @brief Accept a new client connection, given a listener, return new DCB
+ *
+ * Calls dcb_accept_one_connection to do the basic work of obtaining a new
+ * connection from a listener.  If that succeeds, some settings are fixed and
+ * a client DCB is created to handle the new connection. Further DCB details
+ * are set before returning the new DCB to the caller, or returning NULL if
+ * no new connection could be achieved.
+ *
+ * A connection that is rejected, queued or fails after it was accepted does not
+ * end the accepting: the next pending connection is accepted instead. If NULL
+ * is returned for any other reason than the listener having no more pending
+ * connections, the current batch is marked as exhausted so that the accepting
+ * continues after the other events are processed.
+ *
+ * @param dcb Listener DCB that has detected new connection request
+ * @return DCB - The new client DCB for the new connection, or NULL if failed
+ */
+DCB *
+dcb_accept(DCB *listener)
+{
+    DCB *client_dcb = NULL;
+    struct sockaddr_storage client_conn;
+    int c_sock;
+
+    while (client_dcb == NULL)
+    {
+        if (accept_batch.active && accept_batch.accepted >= DCB_ACCEPT_BATCH)
+        {
+            /** The rest of the connections are accepted after other events are processed */
+            accept_batch.exhausted = true;
+            break;
         }
+
+        if ((c_sock = dcb_accept_one_connection(listener, (struct sockaddr *)&client_conn)) < 0)
+        {
+            break;
+        }
+
+        listener->stats.n_accepts++;
+        accept_batch.accepted++;
+        mxs_metric_inc(listener->listener->stats.n_accepted);
+        client_dcb = dcb_create_client(listener, c_sock, &client_conn);
     }
+
     return client_dcb;
 }
 
@@ -2962,8 +3071,8 @@ dcb_accept(DCB *listener)
  * @brief Accept a new client connection, given listener, return file descriptor
  *
  * Up to 10 retries will be attempted in case of non-permanent errors.  Calls
- * the accept function and analyses the return, logging any errors and making
- * an appropriate return.
+ * accept4() and analyses the return, logging any errors and making an
+ * appropriate return. The new socket is non-blocking and close-on-exec.
  *
  * @param dcb Listener DCB that has detected new connection request
  * @return -1 for failure, or a file descriptor for the new connection
@@ -2972,6 +3081,7 @@ static int
 dcb_accept_one_connection(DCB *listener, struct sockaddr *client_conn)
 {
     int c_sock;
+    bool drained = false;
 
     /* Try up to 10 times to get a file descriptor by use of accept */
     for (int i = 0; i < 10; i++)
@@ -2980,9 +3090,10 @@ dcb_accept_one_connection(DCB *listener, struct sockaddr *client_conn)
         int eno = 0;
 
         /* new connection from client */
-        c_sock = accept(listener->fd,
-                        client_conn,
-                        &client_len);
+        c_sock = accept4(listener->fd,
+                         client_conn,
+                         &client_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
         eno = errno;
         errno = 0;
 
@@ -2996,6 +3107,7 @@ dcb_accept_one_connection(DCB *listener, struct sockaddr *client_conn)
                  * We have processed all incoming connections, break out
                  * of loop for return of -1.
                  */
+                drained = true;
                 break;
             }
             else if (eno == ENFILE || eno == EMFILE)
@@ -3015,6 +3127,7 @@ dcb_accept_one_connection(DCB *listener, struct sockaddr *client_conn)
                 /* Log an error the first time this happens */
                 if (i == 0)
                 {
+                    mxs_metric_inc(listener->listener->stats.n_errors);
                     MXS_ERROR("Error %d, %s. Failed to accept new client connection.",
                               eno,
                               strerror_r(eno, errbuf, sizeof(errbuf)));
@@ -3031,6 +3144,7 @@ dcb_accept_one_connection(DCB *listener, struct sockaddr *client_conn)
                 /**
                  * Other error, log it then break out of loop for return of -1.
                  */
+                mxs_metric_inc(listener->listener->stats.n_errors);
                 MXS_ERROR("Failed to accept new client connection due to %d, %s.",
                           eno,
                           strerror_r(eno, errbuf, sizeof(errbuf)));
@@ -3042,6 +3156,13 @@ dcb_accept_one_connection(DCB *listener, struct sockaddr *client_conn)
             break;
         }
     }
+
+    if (c_sock == -1 && !drained)
+    {
+        /** The edge-triggered listener does not report the pending connections again */
+        accept_batch.exhausted = true;
+    }
+
     return c_sock;
 }
 
@@ -3332,6 +3453,14 @@ void dcb_add_to_list(DCB *dcb)
             all_dcbs[dcb->thread.id]->thread.tail = dcb;
         }
 
+        if (check_timeouts && dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER &&
+            dcb->listener->service->conn_idle_timeout)
+        {
+            timer_init(&dcb->idle_timer, dcb_idle_timeout, dcb);
+            timer_wheel_add(&idle_wheels[dcb->thread.id], &dcb->idle_timer,
+                            hkheartbeat + dcb->listener->service->conn_idle_timeout * 10);
+        }
+
         spinlock_release(&all_dcbs_lock[dcb->thread.id]);
     }
 }
@@ -3381,6 +3510,8 @@ static void dcb_remove_from_list(DCB *dcb)
     dcb->thread.next = NULL;
     dcb->thread.tail = NULL;
 
+    timer_wheel_remove(&idle_wheels[dcb->thread.id], &dcb->idle_timer);
+
     spinlock_release(&all_dcbs_lock[dcb->thread.id]);
 }
 
@@ -3393,45 +3524,152 @@ void dcb_enable_session_timeouts()
 }
 
 /**
- * Close sessions that have been idle for too long.
+ * Apply a changed idle timeout of a service to its existing client connections
  *
- * If the time since a session last sent data is greater than the set value in the
- * service, it is disconnected. The connection timeout is disabled by default.
+ * The idle timer of a DCB is normally armed only when the DCB is added to the
+ * owner's list, so without this the connections that existed when the timeout
+ * was enabled would never time out. The timers of the service's connections
+ * are (re)armed to expire when the new timeout would be reached and the owning
+ * threads are woken up so that they start processing the timers.
+ *
+ * @param service The service whose conn_idle_timeout was changed
  */
-void dcb_process_idle_sessions(int thr)
+void dcb_update_idle_timeouts(SERVICE *service)
 {
-    if (check_timeouts && hkheartbeat >= next_timeout_check)
+    if (idle_wheels == NULL)
+    {
+        /** The configuration is being loaded, there are no connections yet */
+        return;
+    }
+
+    if (!check_timeouts || service->conn_idle_timeout == 0)
     {
-        /** Because the resolution of the timeout is one second, we only need to
-         * check for it once per second. One heartbeat is 100 milliseconds. */
-        next_timeout_check = hkheartbeat + 10;
+        /** Armed timers find the timeout disabled when they expire */
+        return;
+    }
+
+    int64_t timeout = service->conn_idle_timeout * 10;
+    int nthr = config_threadcount();
 
-        for (DCB *dcb = all_dcbs[thr]; dcb; dcb = dcb->thread.next)
+    for (int i = 0; i < nthr; i++)
+    {
+        bool armed = false;
+        spinlock_acquire(&all_dcbs_lock[i]);
+
+        for (DCB *dcb = all_dcbs[i]; dcb; dcb = dcb->thread.next)
         {
-            if (dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER)
+            if (dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER && dcb->listener &&
+                dcb->listener->service == service)
             {
-                ss_dassert(dcb->listener);
-                SERVICE *service = dcb->listener->service;
-
-                if (service->conn_idle_timeout && dcb->state == DCB_STATE_POLLING)
+                if (!timer_is_armed(&dcb->idle_timer))
                 {
-                    int64_t idle = hkheartbeat - dcb->last_read;
-                    int64_t timeout = service->conn_idle_timeout * 10;
-
-                    if (idle > timeout)
-                    {
-                        MXS_WARNING("Timing out '%s'@%s, idle for %.1f seconds",
-                                    dcb->user ? dcb->user : "<unknown>",
-                                    dcb->remote ? dcb->remote : "<unknown>",
-                                    (float)idle / 10.f);
-                        poll_fake_hangup_event(dcb);
-                    }
+                    timer_init(&dcb->idle_timer, dcb_idle_timeout, dcb);
                 }
+
+                timer_wheel_add(&idle_wheels[i], &dcb->idle_timer, dcb->last_read + timeout + 1);
+                armed = true;
             }
         }
+
+        spinlock_release(&all_dcbs_lock[i]);
+
+        if (armed)
+        {
+            poll_post_task(i, dcb_wakeup, NULL);
+        }
+    }
+}
+
+/**
+ * Called when the idle timer of a client DCB expires.
+ *
+ * The timer is armed only when the DCB is added to the owner's list and it is
+ * not moved on every read. Instead, the time of the last read is checked when
+ * the timer expires and if the DCB has not been idle for long enough, the
+ * timer is re-armed to expire when it would be.
+ *
+ * Called by the owning thread with the owner's all_dcbs_lock held.
+ */
+static void dcb_idle_timeout(MXS_TIMER *timer, void *data)
+{
+    DCB *dcb = (DCB*)data;
+    ss_dassert(dcb->dcb_role == DCB_ROLE_CLIENT_HANDLER && dcb->listener);
+    SERVICE *service = dcb->listener->service;
+
+    if (service->conn_idle_timeout)
+    {
+        int64_t idle = hkheartbeat - dcb->last_read;
+        int64_t timeout = service->conn_idle_timeout * 10;
+
+        if (dcb->state != DCB_STATE_POLLING)
+        {
+            /** Not yet, or no longer, processing events */
+            timer_wheel_add(&idle_wheels[dcb->thread.id], timer, hkheartbeat + timeout);
+        }
+        else if (idle > timeout)
+        {
+            MXS_WARNING("Timing out '%s'@%s, idle for %.1f seconds",
+                        dcb->user ? dcb->user : "<unknown>",
+                        dcb->remote ? dcb->remote : "<unknown>",
+                        (float)idle / 10.f);
+            poll_fake_hangup_event(dcb);
+        }
+        else
+        {
+            timer_wheel_add(&idle_wheels[dcb->thread.id], timer, dcb->last_read + timeout + 1);
+        }
+    }
+}
+
+/**
+ * Close sessions that have been idle for too long.
+ *
+ * If the time since a session last sent data is greater than the set value in the
+ * service, it is disconnected. The connection timeout is disabled by default.
+ *
+ * Only the timers that expire are processed so the cost does not depend on the
+ * number of connections the thread owns.
+ */
+void dcb_process_idle_sessions(int thr)
+{
+    /** The tick is checked without the lock, a stale value only delays the
+     * processing until the next call. */
+    if (check_timeouts && idle_wheels[thr].now < hkheartbeat)
+    {
+        spinlock_acquire(&all_dcbs_lock[thr]);
+        timer_wheel_advance(&idle_wheels[thr], hkheartbeat);
+        spinlock_release(&all_dcbs_lock[thr]);
     }
 }
 
+/**
+ * Check whether a thread has connection idle timeouts to process
+ *
+ * The result is a dirty read, it is used to decide how long the thread may
+ * sleep when it has no events to process.
+ *
+ * @param thr The thread ID
+ * @return True if the thread has idle timers armed
+ */
+bool dcb_pending_idle_timeouts(int thr)
+{
+    return check_timeouts && idle_wheels[thr].count > 0;
+}
+
+/**
+ * Check whether a thread has closed DCBs to process
+ *
+ * The result is a dirty read, it is used to decide how long the thread may
+ * sleep when it has no events to process.
+ *
+ * @param thr The thread ID
+ * @return True if the zombie queue of the thread is not empty
+ */
+bool dcb_pending_zombies(int thr)
+{
+    return zombies[thr] != NULL;
+}
+
 bool dcb_foreach(bool(*func)(DCB *, void *), void *data)
 {
 
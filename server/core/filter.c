@@ -28,6 +28,7 @@
 #include <string.h>
 #include <errno.h>
 #include <maxscale/alloc.h>
+#include <maxscale/debug.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/session.h>
 #include <maxscale/spinlock.h>
@@ -35,9 +36,12 @@
 
 #include "maxscale/config.h"
 #include "maxscale/modules.h"
+#include "maxscale/registry.h"
 
 static SPINLOCK filter_spin = SPINLOCK_INIT;    /**< Protects the list of all filters */
 static MXS_FILTER_DEF *allFilters = NULL;           /**< The list of all filters */
+static void* filter_registry_next(void *object, const char **name);
+static REGISTRY filter_registry = REGISTRY_INIT(filter_registry_next, &filter_spin); /**< Index of all filters */
 
 static void filter_free_parameters(MXS_FILTER_DEF *filter);
 
@@ -77,6 +81,7 @@ filter_alloc(const char *name, const char *module)
     spinlock_acquire(&filter_spin);
     filter->next = allFilters;
     allFilters = filter;
+    registry_update(&filter_registry);
     spinlock_release(&filter_spin);
 
     return filter;
@@ -114,6 +119,7 @@ filter_free(MXS_FILTER_DEF *filter)
                 ptr->next = filter->next;
             }
         }
+        registry_update(&filter_registry);
         spinlock_release(&filter_spin);
 
         /* Clean up session and free the memory */
@@ -135,10 +141,29 @@ filter_free(MXS_FILTER_DEF *filter)
     }
 }
 
+/** Iterate over the filters for the registry, called with the lock held */
+static void* filter_registry_next(void *object, const char **name)
+{
+    MXS_FILTER_DEF *filter = object ? ((MXS_FILTER_DEF*)object)->next : allFilters;
+
+    if (filter)
+    {
+        *name = filter->name;
+    }
+
+    return filter;
+}
+
 MXS_FILTER_DEF *
 filter_def_find(const char *name)
 {
     MXS_FILTER_DEF *filter;
+    void *found;
+
+    if (registry_find(&filter_registry, name, &found))
+    {
+        return found;
+    }
 
     spinlock_acquire(&filter_spin);
     filter = allFilters;
@@ -399,76 +424,67 @@ bool filter_load(MXS_FILTER_DEF* filter)
 }
 
 /**
- * Connect the downstream filter chain for a filter.
+ * Compile the filter chain of a service
  *
- * This will create the filter instance, loading the filter module, and
- * conenct the fitler into the downstream chain.
+ * The entry points of the filters are resolved once so that creating the
+ * filter sessions of a client session does not need to look them up. A filter
+ * that does not implement routeQuery or clientReply is not inserted into that
+ * direction of the chain. The filter is still told its downstream and upstream
+ * components so that it can route data of its own.
  *
- * @param filter        The filter to add into the chain
- * @param session       The client session
- * @param downstream    The filter downstream of this filter
- * @return              The downstream component for the next filter or NULL
- *                      if the filter could not be created
+ * @param filters       The filters of the service, in the order of the chain
+ * @param n_filters     Number of filters
+ * @return              The compiled chain or NULL on error
  */
-MXS_DOWNSTREAM *
-filter_apply(MXS_FILTER_DEF *filter, MXS_SESSION *session, MXS_DOWNSTREAM *downstream)
+FILTER_CHAIN *
+filter_chain_compile(MXS_FILTER_DEF **filters, int n_filters)
 {
-    MXS_DOWNSTREAM *me;
+    FILTER_CHAIN *chain = (FILTER_CHAIN *)MXS_MALLOC(sizeof(FILTER_CHAIN) +
+                                                     n_filters * sizeof(FILTER_CHAIN_ENTRY));
 
-    if ((me = (MXS_DOWNSTREAM *)MXS_CALLOC(1, sizeof(MXS_DOWNSTREAM))) == NULL)
+    if (chain == NULL)
     {
         return NULL;
     }
-    me->instance = filter->filter;
-    me->routeQuery = (void *)(filter->obj->routeQuery);
 
-    if ((me->session = filter->obj->newSession(me->instance, session)) == NULL)
+    chain->n_filters = n_filters;
+    chain->n_downstream = 0;
+    chain->n_upstream = 0;
+    chain->filters = (FILTER_CHAIN_ENTRY *)(chain + 1);
+
+    for (int i = 0; i < n_filters; i++)
     {
-        MXS_FREE(me);
-        return NULL;
+        FILTER_CHAIN_ENTRY *entry = &chain->filters[i];
+        MXS_FILTER_OBJECT *obj = filters[i]->obj;
+
+        ss_dassert(obj && obj->newSession && obj->setDownstream);
+        entry->filter = filters[i];
+        entry->instance = filters[i]->filter;
+        entry->obj = obj;
+        entry->routeQuery = obj->routeQuery;
+        entry->clientReply = obj->setUpstream ? obj->clientReply : NULL;
+
+        if (entry->routeQuery)
+        {
+            chain->n_downstream++;
+        }
+
+        if (entry->clientReply)
+        {
+            chain->n_upstream++;
+        }
     }
-    filter->obj->setDownstream(me->instance, me->session, downstream);
 
-    return me;
+    return chain;
 }
 
 /**
- * Connect a filter in the up stream filter chain for a session
- *
- * Note, the filter will have been created when the downstream chian was
- * previously setup.
- * Note all filters require to be in the upstream chain, so this routine
- * may skip a filter if it does not provide an upstream interface.
+ * Free a compiled filter chain
  *
- * @param filter        The fitler to add to the chain
- * @param fsession      The filter session
- * @param upstream      The filter that should be upstream of this filter
- * @return              The upstream component for the next filter
+ * @param chain         The chain to free, may be NULL
  */
-MXS_UPSTREAM *
-filter_upstream(MXS_FILTER_DEF *filter, void *fsession, MXS_UPSTREAM *upstream)
+void
+filter_chain_free(FILTER_CHAIN *chain)
 {
-    MXS_UPSTREAM *me = NULL;
-
-    /*
-     * The the filter has no setUpstream entry point then is does
-     * not require to see results and can be left out of the chain.
-     */
-    if (filter->obj->setUpstream == NULL)
-    {
-        return upstream;
-    }
-
-    if (filter->obj->clientReply != NULL)
-    {
-        if ((me = (MXS_UPSTREAM *)MXS_CALLOC(1, sizeof(MXS_UPSTREAM))) == NULL)
-        {
-            return NULL;
-        }
-        me->instance = filter->filter;
-        me->session = fsession;
-        me->clientReply = (void *)(filter->obj->clientReply);
-        filter->obj->setUpstream(me->instance, me->session, upstream);
-    }
-    return me;
+    MXS_FREE(chain);
 }
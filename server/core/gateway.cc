@@ -74,8 +74,10 @@
 #include "maxscale/modules.h"
 #include "maxscale/monitor.h"
 #include "maxscale/poll.h"
+#include "maxscale/prometheus.h"
+#include "maxscale/registry.h"
+#include "maxscale/resolver.h"
 #include "maxscale/service.h"
-#include "maxscale/statistics.h"
 
 #define STRING_BUFFER_SIZE 1024
 #define PIDFD_CLOSED -1
@@ -1972,14 +1974,26 @@ int main(int argc, char **argv)
         pid_file_created = true;
     }
 
-    /** Initialize statistics */
-    ts_stats_init();
-
     /* Init MaxScale poll system */
     poll_init();
 
+    /** Add the collectors of the Prometheus metrics */
+    prometheus_init();
+
     dcb_global_init();
 
+    /*
+     * Start the resolver thread. This resolves the addresses of all
+     * configured servers before the monitors and services are started.
+     */
+    if (!resolver_init())
+    {
+        const char* logerr = "Failed to start resolver thread.";
+        print_log_n_stderr(true, true, logerr, logerr, 0);
+        rc = MAXSCALE_INTERNALERROR;
+        goto return_main;
+    }
+
     /* Initialize the internal query classifier. The plugin will be initialized
      * via the module initialization below.
      */
@@ -2043,6 +2057,9 @@ int main(int argc, char **argv)
         goto return_main;
     }
 
+    /** Index the servers, services, filters and monitors of the configuration */
+    registry_start();
+
     /*<
      * Start the polling threads, note this is one less than is
      * configured as the main thread will also poll.
@@ -2084,6 +2101,11 @@ int main(int argc, char **argv)
      */
     hkfinish();
 
+    /*<
+     * Wait for the resolver to finish.
+     */
+    resolver_finish();
+
     /*<
      * Wait server threads' completion.
      */
@@ -2168,6 +2190,7 @@ int maxscale_shutdown()
         service_shutdown();
         poll_shutdown();
         hkshutdown();
+        resolver_shutdown();
         log_flush_shutdown();
     }
 
@@ -29,6 +29,19 @@
  * shot task that will only be run once after a specified number of
  * seconds.
  *
+ * The housekeeper consists of a scheduler thread and a small pool of worker
+ * threads. The scheduler keeps the tasks in a timer wheel and, when a task is
+ * due, queues it for the workers. The tasks added with hktask_add() and
+ * hktask_oneshot() are serial: they are all run by the same worker, one at a
+ * time and in the order they become due, so they need not be thread-safe with
+ * respect to each other. Only the tasks added with hktask_add_concurrent() are
+ * run by the other workers, in parallel with the serial tasks and with each
+ * other. Slow tasks that only use their own data, such as the binlog to Avro
+ * conversion, are added this way so that they do not delay the serial tasks.
+ * Each task has a concurrency limit, one for serial tasks, and a task
+ * that is due while the limit is reached is not run. Such an overrun is
+ * counted and logged.
+ *
  * The housekeeper also maintains a global variable, hkheartbeat, that
  * is incremented every 100ms.
  *
@@ -42,42 +55,143 @@
  * @endverbatim
  */
 
+/** Number of threads that execute the tasks, the first one runs the serial tasks */
+#define HK_WORKERS 4
+
+/** Number of heartbeats in a second */
+#define HK_TICKS_PER_SECOND 10
+
 /**
  * List of all tasks that need to be run
  */
 static HKTASK *tasks = NULL;
 /**
- * Spinlock to protect the tasks list
+ * Spinlock to protect the tasks list and the timer wheel
  */
 static SPINLOCK tasklock = SPINLOCK_INIT;
 
+/**
+ * The task timers, one tick is one heartbeat. A zeroed wheel is a valid empty
+ * wheel which allows tasks to be added before the housekeeper is started.
+ */
+static MXS_TIMER_WHEEL hk_wheel;
+
+/**
+ * A queued run of a task
+ */
+typedef struct hkrun
+{
+    HKTASK *task;
+    struct hkrun *next;
+} HKRUN;
+
+/**
+ * A queue of task runs waiting for a worker
+ */
+typedef struct hkqueue
+{
+    HKRUN   *head;
+    HKRUN   *tail;
+    SPINLOCK lock;
+    sem_t    sem;
+} HKQUEUE;
+
+/** The runs of the serial tasks, executed by the first worker */
+static HKQUEUE serialq = {NULL, NULL, SPINLOCK_INIT};
+
+/** The runs of the tasks that may run in parallel, executed by the other workers */
+static HKQUEUE parallelq = {NULL, NULL, SPINLOCK_INIT};
+
 static bool do_shutdown = 0;
 
 long hkheartbeat = 0; /*< One heartbeat is 100 milliseconds */
 static THREAD hk_thr_handle;
+static THREAD hk_worker_handles[HK_WORKERS];
+static HKQUEUE *hk_worker_queues[HK_WORKERS];
+static int n_workers = 0;
 
 static void hkthread(void *);
+static void hkworker(void *);
+static void hktask_due(MXS_TIMER *timer, void *data);
 
 struct hkinit_result
 {
     sem_t sem;
     bool ok;
+    HKQUEUE *queue; /*< The queue of the worker that is being started */
 };
 
+static void hkqueue_clear(HKQUEUE *queue)
+{
+    HKRUN *run = queue->head;
+
+    while (run)
+    {
+        HKRUN *next = run->next;
+        MXS_FREE(run);
+        run = next;
+    }
+
+    queue->head = queue->tail = NULL;
+}
+
+static void hkstop_workers()
+{
+    for (int i = 0; i < n_workers; i++)
+    {
+        sem_post(&hk_worker_queues[i]->sem);
+    }
+
+    for (int i = 0; i < n_workers; i++)
+    {
+        thread_wait(hk_worker_handles[i]);
+    }
+
+    n_workers = 0;
+    hkqueue_clear(&serialq);
+    hkqueue_clear(&parallelq);
+}
+
 bool
 hkinit()
 {
     struct hkinit_result res;
     sem_init(&res.sem, 0, 0);
-    res.ok = false;
+    sem_init(&serialq.sem, 0, 0);
+    sem_init(&parallelq.sem, 0, 0);
+    res.ok = true;
 
-    if (thread_start(&hk_thr_handle, hkthread, &res) != NULL)
+    /** The workers are started one at a time so that they can all report
+     * their status through the same result structure */
+    while (res.ok && n_workers < HK_WORKERS)
     {
-        sem_wait(&res.sem);
+        res.queue = n_workers == 0 ? &serialq : &parallelq;
+        hk_worker_queues[n_workers] = res.queue;
+
+        if (thread_start(&hk_worker_handles[n_workers], hkworker, &res) != NULL)
+        {
+            n_workers++;
+            sem_wait(&res.sem);
+        }
+        else
+        {
+            MXS_ALERT("Failed to start housekeeper worker thread.");
+            res.ok = false;
+        }
     }
-    else
+
+    if (res.ok && thread_start(&hk_thr_handle, hkthread, NULL) == NULL)
     {
         MXS_ALERT("Failed to start housekeeper thread.");
+        res.ok = false;
+    }
+
+    if (!res.ok)
+    {
+        do_shutdown = true;
+        atomic_synchronize();
+        hkstop_workers();
+        do_shutdown = false;
     }
 
     sem_destroy(&res.sem);
@@ -85,28 +199,68 @@ hkinit()
 }
 
 /**
- * Add a new task to the housekeepers lists of tasks that should be
- * run periodically.
+ * Free a task
  *
- * The task will be first run frequency seconds after this call is
- * made and will the be executed repeatedly every frequency seconds
- * until the task is removed.
+ * @param task Task to free
+ */
+static void
+hktask_free(HKTASK *task)
+{
+    MXS_FREE(task->name);
+    MXS_FREE(task);
+}
+
+/**
+ * Remove a task from the task list and the timer wheel. The caller must
+ * hold the tasklock.
  *
- * Task names must be unique.
+ * @param task Task to remove
+ * @return True if the task can be freed, false if a run of it is queued or
+ * executing in which case the last run frees it
+ */
+static bool
+hktask_unlink(HKTASK *task)
+{
+    HKTASK **pptr = &tasks;
+
+    while (*pptr && *pptr != task)
+    {
+        pptr = &(*pptr)->next;
+    }
+
+    if (*pptr)
+    {
+        *pptr = task->next;
+    }
+
+    task->next = NULL;
+    task->removed = true;
+    timer_wheel_remove(&hk_wheel, &task->timer);
+
+    return task->running == 0;
+}
+
+/**
+ * Add a task to the task list and arm its timer.
  *
- * @param name          The unique name for this housekeeper task
- * @param taskfn        The function to call for the task
- * @param data          Data to pass to the task function
- * @param frequency     How often to run the task, expressed in seconds
- * @return              Return the time in seconds when the task will be first run
- *                      if the task was added, otherwise 0
+ * @param name            The name of the task
+ * @param taskfn          The function to call for the task
+ * @param data            Data to pass to the task function
+ * @param frequency       How often to run a repeated task, in seconds
+ * @param delay           Seconds until the first run of the task
+ * @param type            The task type
+ * @param max_concurrency How many runs of the task may execute at the same time,
+ *                        zero for a serial task
+ * @return                Return the time in seconds when the task will be first run
+ *                        if the task was added, otherwise 0
  */
-int
-hktask_add(const char *name, void (*taskfn)(void *), void *data, int frequency)
+static int
+hktask_add_internal(const char *name, void (*taskfn)(void *), void *data, int frequency,
+                    int delay, HKTASK_TYPE type, int max_concurrency)
 {
     HKTASK *task, *ptr;
 
-    if ((task = (HKTASK *)MXS_MALLOC(sizeof(HKTASK))) == NULL)
+    if ((task = (HKTASK *)MXS_CALLOC(1, sizeof(HKTASK))) == NULL)
     {
         return 0;
     }
@@ -118,29 +272,31 @@ hktask_add(const char *name, void (*taskfn)(void *), void *data, int frequency)
     task->task = taskfn;
     task->data = data;
     task->frequency = frequency;
-    task->type = HK_REPEATED;
-    task->nextdue = time(0) + frequency;
+    task->type = type;
+    task->parallel = max_concurrency > 0;
+    task->max_concurrency = max_concurrency > 0 ? max_concurrency : 1;
+    task->nextdue = time(0) + delay;
     task->next = NULL;
+    timer_init(&task->timer, hktask_due, task);
+
     spinlock_acquire(&tasklock);
     ptr = tasks;
     while (ptr && ptr->next)
     {
-        if (strcmp(ptr->name, name) == 0)
+        if (type == HK_REPEATED && strcmp(ptr->name, name) == 0)
         {
             spinlock_release(&tasklock);
-            MXS_FREE(task->name);
-            MXS_FREE(task);
+            hktask_free(task);
             return 0;
         }
         ptr = ptr->next;
     }
     if (ptr)
     {
-        if (strcmp(ptr->name, name) == 0)
+        if (type == HK_REPEATED && strcmp(ptr->name, name) == 0)
         {
             spinlock_release(&tasklock);
-            MXS_FREE(task->name);
-            MXS_FREE(task);
+            hktask_free(task);
             return 0;
         }
         ptr->next = task;
@@ -149,19 +305,66 @@ hktask_add(const char *name, void (*taskfn)(void *), void *data, int frequency)
     {
         tasks = task;
     }
+    timer_wheel_add(&hk_wheel, &task->timer, hk_wheel.now + delay * HK_TICKS_PER_SECOND);
     spinlock_release(&tasklock);
 
     return task->nextdue;
 }
 
 /**
- * Add a one-shot task to the housekeeper task list
+ * Add a new task to the housekeepers lists of tasks that should be
+ * run periodically.
+ *
+ * The task will be first run frequency seconds after this call is
+ * made and will the be executed repeatedly every frequency seconds
+ * until the task is removed. If the previous run of the task has not
+ * finished when the task is next due, that run is skipped. The task is
+ * serial, it never runs at the same time as another serial task.
  *
  * Task names must be unique.
  *
  * @param name          The unique name for this housekeeper task
  * @param taskfn        The function to call for the task
  * @param data          Data to pass to the task function
+ * @param frequency     How often to run the task, expressed in seconds
+ * @return              Return the time in seconds when the task will be first run
+ *                      if the task was added, otherwise 0
+ */
+int
+hktask_add(const char *name, void (*taskfn)(void *), void *data, int frequency)
+{
+    return hktask_add_internal(name, taskfn, data, frequency, frequency, HK_REPEATED, 0);
+}
+
+/**
+ * Add a new repeated task that may run concurrently with itself.
+ *
+ * Like hktask_add() but the task is run by the parallel workers and up to
+ * max_concurrency runs of the task may execute at the same time. The task
+ * function must be thread-safe, also with respect to the serial tasks.
+ *
+ * @param name            The unique name for this housekeeper task
+ * @param taskfn          The function to call for the task
+ * @param data            Data to pass to the task function
+ * @param frequency       How often to run the task, expressed in seconds
+ * @param max_concurrency How many runs of the task may execute at the same time
+ * @return                Return the time in seconds when the task will be first run
+ *                        if the task was added, otherwise 0
+ */
+int
+hktask_add_concurrent(const char *name, void (*taskfn)(void *), void *data,
+                      int frequency, int max_concurrency)
+{
+    return hktask_add_internal(name, taskfn, data, frequency, frequency, HK_REPEATED,
+                               max_concurrency);
+}
+
+/**
+ * Add a one-shot task to the housekeeper task list
+ *
+ * @param name          The name for this housekeeper task
+ * @param taskfn        The function to call for the task
+ * @param data          Data to pass to the task function
  * @param when          How many second until the task is executed
  * @return              Return the time in seconds when the task will be first run
  *                      if the task was added, otherwise 0
@@ -170,159 +373,218 @@ hktask_add(const char *name, void (*taskfn)(void *), void *data, int frequency)
 int
 hktask_oneshot(const char *name, void (*taskfn)(void *), void *data, int when)
 {
-    HKTASK *task, *ptr;
+    return hktask_add_internal(name, taskfn, data, 0, when, HK_ONESHOT, 0);
+}
+
+
+/**
+ * Remove a named task from the housekeepers task list
+ *
+ * A run of the task that is queued but not yet started is discarded. A run
+ * that is already executing is allowed to finish.
+ *
+ * @param name          The task name to remove
+ * @return              Returns 0 if the task could not be removed
+ */
+int
+hktask_remove(const char *name)
+{
+    HKTASK *ptr;
+    bool do_free = false;
 
-    if ((task = (HKTASK *)MXS_MALLOC(sizeof(HKTASK))) == NULL)
-    {
-        return 0;
-    }
-    if ((task->name = MXS_STRDUP(name)) == NULL)
-    {
-        MXS_FREE(task);
-        return 0;
-    }
-    task->task = taskfn;
-    task->data = data;
-    task->frequency = 0;
-    task->type = HK_ONESHOT;
-    task->nextdue = time(0) + when;
-    task->next = NULL;
     spinlock_acquire(&tasklock);
     ptr = tasks;
-    while (ptr && ptr->next)
+    while (ptr && strcmp(ptr->name, name) != 0)
     {
         ptr = ptr->next;
     }
     if (ptr)
     {
-        ptr->next = task;
+        do_free = hktask_unlink(ptr);
     }
-    else
+    spinlock_release(&tasklock);
+
+    if (do_free)
     {
-        tasks = task;
+        hktask_free(ptr);
     }
-    spinlock_release(&tasklock);
 
-    return task->nextdue;
+    return ptr ? 1 : 0;
 }
 
-
 /**
- * Remove a named task from the housekeepers task list
+ * Called by the scheduler, with the tasklock held, when a task is due.
  *
- * @param name          The task name to remove
- * @return              Returns 0 if the task could not be removed
+ * @param timer The task's timer
+ * @param data  The task
  */
-int
-hktask_remove(const char *name)
+static void
+hktask_due(MXS_TIMER *timer, void *data)
 {
-    HKTASK *ptr, *lptr = NULL;
+    HKTASK *task = (HKTASK*)data;
 
-    spinlock_acquire(&tasklock);
-    ptr = tasks;
-    while (ptr && strcmp(ptr->name, name) != 0)
+    if (task->type == HK_REPEATED)
     {
-        lptr = ptr;
-        ptr = ptr->next;
+        int frequency = task->frequency > 0 ? task->frequency : 1;
+        task->nextdue = time(0) + frequency;
+        timer_wheel_add(&hk_wheel, timer, hk_wheel.now + frequency * HK_TICKS_PER_SECOND);
     }
-    if (ptr && lptr)
+
+    if (task->running >= task->max_concurrency)
     {
-        lptr->next = ptr->next;
+        task->overruns++;
+        MXS_WARNING("Housekeeper task '%s' is due but %d run(s) of it have not "
+                    "completed, skipping this run. The task has been skipped %d times.",
+                    task->name, task->running, task->overruns);
+        return;
     }
-    else if (ptr)
+
+    HKRUN *run = (HKRUN*)MXS_MALLOC(sizeof(HKRUN));
+
+    if (run)
     {
-        tasks = ptr->next;
+        HKQUEUE *queue = task->parallel ? &parallelq : &serialq;
+        run->task = task;
+        run->next = NULL;
+        task->running++;
+
+        spinlock_acquire(&queue->lock);
+        if (queue->tail)
+        {
+            queue->tail->next = run;
+        }
+        else
+        {
+            queue->head = run;
+        }
+        queue->tail = run;
+        spinlock_release(&queue->lock);
+
+        sem_post(&queue->sem);
     }
+}
+
+/**
+ * Execute one queued run of a task.
+ *
+ * The task function is called without any locks being held. This allows
+ * manipulation of the housekeeper task list during execution of the task.
+ *
+ * @param task The task to run
+ */
+static void
+hktask_run(HKTASK *task)
+{
+    spinlock_acquire(&tasklock);
+    bool removed = task->removed;
     spinlock_release(&tasklock);
 
-    if (ptr)
+    if (!removed)
     {
-        MXS_FREE(ptr->name);
-        MXS_FREE(ptr);
-        return 1;
+        task->task(task->data);
     }
-    else
+
+    bool do_free = false;
+
+    spinlock_acquire(&tasklock);
+    task->running--;
+
+    if (!task->removed && task->type == HK_ONESHOT)
     {
-        return 0;
+        hktask_unlink(task);
     }
-}
 
+    if (task->removed && task->running == 0)
+    {
+        do_free = true;
+    }
+    spinlock_release(&tasklock);
+
+    if (do_free)
+    {
+        hktask_free(task);
+    }
+}
 
 /**
- * The housekeeper thread implementation.
- *
- * This function is responsible for executing the housekeeper tasks.
+ * The housekeeper scheduler thread.
  *
- * The implementation of the callng of the task functions is such that
- * the tasks are called without the tasklock spinlock being held. This
- * allows manipulation of the housekeeper task list during execution of
- * one of the tasks. The resutl is that upon completion of a task the
- * search for tasks to run must restart from the start of the queue.
- * It is vital that the task->nextdue tiem is updated before the task
- * is run.
+ * Keeps the heartbeat going and hands the tasks that are due to the
+ * worker threads.
  *
  * @param       data            Unused, here to satisfy the thread system
  */
-void
+static void
 hkthread(void *data)
 {
-    HKTASK *ptr;
-    time_t now;
-    void (*taskfn)(void *);
-    void *taskdata;
-    int i;
+    while (!do_shutdown)
+    {
+        thread_millisleep(100);
+        hkheartbeat++;
 
+        spinlock_acquire(&tasklock);
+        timer_wheel_advance(&hk_wheel, hkheartbeat);
+        spinlock_release(&tasklock);
+    }
+
+    MXS_NOTICE("Housekeeper shutting down.");
+}
+
+/**
+ * A housekeeper worker thread.
+ *
+ * Executes the task runs queued by the scheduler.
+ *
+ * @param       data            The hkinit_result used to report the status
+ */
+static void
+hkworker(void *data)
+{
     struct hkinit_result* res = (struct hkinit_result*)data;
-    res->ok = qc_thread_init(QC_INIT_BOTH);
+    HKQUEUE *queue = res->queue;
+    bool ok = qc_thread_init(QC_INIT_BOTH);
 
-    if (!res->ok)
+    if (!ok)
     {
         MXS_ERROR("Could not initialize housekeeper thread.");
+        res->ok = false;
     }
 
+    /** The result structure may not be accessed after this */
     sem_post(&res->sem);
 
-    while (!do_shutdown)
+    while (ok)
     {
-        for (i = 0; i < 10; i++)
+        sem_wait(&queue->sem);
+
+        if (do_shutdown)
         {
-            thread_millisleep(100);
-            hkheartbeat++;
+            break;
         }
-        now = time(0);
-        spinlock_acquire(&tasklock);
-        ptr = tasks;
-        while (!do_shutdown && ptr)
+
+        spinlock_acquire(&queue->lock);
+        HKRUN *run = queue->head;
+        if (run)
         {
-            if (ptr->nextdue <= now)
-            {
-                ptr->nextdue = now + ptr->frequency;
-                taskfn = ptr->task;
-                taskdata = ptr->data;
-                // We need to copy type and name, in case hktask_remove is called from
-                // the callback. Otherwise we will access freed data.
-                HKTASK_TYPE type = ptr->type;
-                char name[strlen(ptr->name) + 1];
-                strcpy(name, ptr->name);
-                spinlock_release(&tasklock);
-                (*taskfn)(taskdata);
-                if (type == HK_ONESHOT)
-                {
-                    hktask_remove(name);
-                }
-                spinlock_acquire(&tasklock);
-                ptr = tasks;
-            }
-            else
+            queue->head = run->next;
+            if (queue->head == NULL)
             {
-                ptr = ptr->next;
+                queue->tail = NULL;
             }
         }
-        spinlock_release(&tasklock);
+        spinlock_release(&queue->lock);
+
+        if (run)
+        {
+            hktask_run(run->task);
+            MXS_FREE(run);
+        }
     }
 
-    qc_thread_end(QC_INIT_BOTH);
-    MXS_NOTICE("Housekeeper shutting down.");
+    if (ok)
+    {
+        qc_thread_end(QC_INIT_BOTH);
+    }
 }
 
 void
@@ -330,6 +592,11 @@ hkshutdown()
 {
     do_shutdown = true;
     atomic_synchronize();
+
+    for (int i = 0; i < n_workers; i++)
+    {
+        sem_post(&hk_worker_queues[i]->sem);
+    }
 }
 
 void hkfinish()
@@ -338,6 +605,9 @@ void hkfinish()
 
     MXS_NOTICE("Waiting for housekeeper to shut down.");
     thread_wait(hk_thr_handle);
+    hkstop_workers();
+    sem_destroy(&serialq.sem);
+    sem_destroy(&parallelq.sem);
     do_shutdown = false;
     MXS_NOTICE("Housekeeper has shut down.");
 }
@@ -354,18 +624,20 @@ hkshow_tasks(DCB *pdcb)
     struct tm tm;
     char buf[40];
 
-    dcb_printf(pdcb, "%-25s | Type     | Frequency | Next Due\n", "Name");
-    dcb_printf(pdcb, "--------------------------+----------+-----------+-------------------------\n");
+    dcb_printf(pdcb, "%-25s | Type     | Frequency | Running | Overruns | Next Due\n", "Name");
+    dcb_printf(pdcb, "--------------------------+----------+-----------+---------+----------+-------------------------\n");
     spinlock_acquire(&tasklock);
     ptr = tasks;
     while (ptr)
     {
         localtime_r(&ptr->nextdue, &tm);
         asctime_r(&tm, buf);
-        dcb_printf(pdcb, "%-25s | %-8s | %-9d | %s",
+        dcb_printf(pdcb, "%-25s | %-8s | %-9d | %-7d | %-8d | %s",
                    ptr->name,
                    ptr->type == HK_REPEATED ? "Repeated" : "One-Shot",
                    ptr->frequency,
+                   ptr->running,
+                   ptr->overruns,
                    buf);
         ptr = ptr->next;
     }
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file latency.c Per-stage latency of statements
+ *
+ * Each service and server has an array of histograms with one element per
+ * worker thread. A thread only ever writes to its own element so recording
+ * needs no locking. The readers merge the elements without locking, which
+ * may make the merged counts slightly stale but never invalid.
+ *
+ * The histograms are log-linear: each power of two is divided into eight
+ * equally wide buckets.
+ */
+
+#include "maxscale/latency.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+#include <maxscale/config.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/platform.h>
+#include <maxscale/random_jkiss.h>
+#include <maxscale/server.h>
+#include <maxscale/service.h>
+#include "maxscale/poll.h"
+
+typedef struct latency_histogram
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+} LATENCY_HISTOGRAM;
+
+/** The histograms of one thread */
+struct latency_stats
+{
+    LATENCY_HISTOGRAM stage[LATENCY_STAGE_MAX];
+};
+
+static const char *stage_names[LATENCY_STAGE_MAX] =
+{
+    "protocol",
+    "filters",
+    "classify",
+    "router",
+    "backend",
+    "reply"
+};
+
+/** Total time the thread has spent in query classification */
+static thread_local uint64_t classify_total = 0;
+
+/** Percentage of sessions that are traced */
+static int trace_sampling = 0;
+
+int latency_bucket(uint64_t ns)
+{
+    if (ns < LATENCY_SUB_BUCKETS)
+    {
+        return ns;
+    }
+
+    int exp = 63 - __builtin_clzll(ns);
+
+    if (exp > LATENCY_MAX_EXP)
+    {
+        return LATENCY_HIST_BUCKETS - 1;
+    }
+
+    int sub = (ns >> (exp - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return (exp - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint64_t latency_bucket_upper(int bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    int exp = bucket / LATENCY_SUB_BUCKETS + LATENCY_SUB_BITS - 1;
+    uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+    uint64_t width = 1ULL << (exp - LATENCY_SUB_BITS);
+
+    return (LATENCY_SUB_BUCKETS + sub) * width + width - 1;
+}
+
+/**
+ * Get the histograms of the current thread, allocating the histograms of all
+ * threads on first use
+ */
+static struct latency_stats* latency_stats_get(struct latency_stats **stats)
+{
+    int n_threads = config_threadcount();
+
+    if (current_thread_id >= n_threads)
+    {
+        return NULL;
+    }
+
+    struct latency_stats *s = *stats;
+
+    if (s == NULL)
+    {
+        if ((s = MXS_CALLOC(n_threads, sizeof(struct latency_stats))) == NULL)
+        {
+            return NULL;
+        }
+
+        if (!__sync_bool_compare_and_swap(stats, NULL, s))
+        {
+            MXS_FREE(s);
+            s = *stats;
+        }
+    }
+
+    return &s[current_thread_id];
+}
+
+static inline void latency_record(struct latency_stats *stats, latency_stage_t stage, uint64_t ns)
+{
+    LATENCY_HISTOGRAM *hist = &stats->stage[stage];
+    hist->count++;
+    hist->total += ns;
+    hist->buckets[latency_bucket(ns)]++;
+
+    if (ns > hist->max)
+    {
+        hist->max = ns;
+    }
+}
+
+/** Record a stage into the service of the session */
+static void latency_record_service(MXS_SESSION *session, latency_stage_t stage, uint64_t ns)
+{
+    struct latency_stats *stats;
+    session->latency.stage[stage] = ns;
+
+    if (session->service && (stats = latency_stats_get(&session->service->latency)))
+    {
+        latency_record(stats, stage, ns);
+    }
+}
+
+/** Record a stage into the server that replied */
+static void latency_record_server(MXS_SESSION *session, latency_stage_t stage, uint64_t ns)
+{
+    struct latency_stats *stats;
+    SERVER *server = (SERVER*)session->latency.server;
+
+    if (server && (stats = latency_stats_get(&server->latency)))
+    {
+        latency_record(stats, stage, ns);
+    }
+}
+
+void latency_client_read(MXS_SESSION *session, uint64_t when)
+{
+    session->latency.read = when;
+}
+
+void latency_route_begin(MXS_SESSION *session)
+{
+    MXS_SESSION_LATENCY *lat = &session->latency;
+    uint64_t now = latency_now();
+
+    if (lat->read)
+    {
+        latency_record_service(session, LATENCY_STAGE_PROTOCOL, now - lat->read);
+        lat->read = 0;
+    }
+
+    lat->route = now;
+    lat->classify_route = classify_total;
+}
+
+void latency_router_begin(MXS_SESSION *session)
+{
+    MXS_SESSION_LATENCY *lat = &session->latency;
+    uint64_t now = latency_now();
+
+    if (lat->route)
+    {
+        uint64_t classify = classify_total - lat->classify_route;
+        uint64_t elapsed = now - lat->route;
+        latency_record_service(session, LATENCY_STAGE_FILTERS,
+                               elapsed > classify ? elapsed - classify : 0);
+    }
+    else
+    {
+        /** The statement did not come through MXS_SESSION_ROUTE_QUERY */
+        lat->classify_route = classify_total;
+    }
+
+    lat->router = now;
+    lat->classify_router = classify_total;
+}
+
+void latency_router_end(MXS_SESSION *session)
+{
+    MXS_SESSION_LATENCY *lat = &session->latency;
+    uint64_t now = latency_now();
+    uint64_t classify = classify_total - lat->classify_router;
+    uint64_t elapsed = now - lat->router;
+
+    latency_record_service(session, LATENCY_STAGE_ROUTER, elapsed > classify ? elapsed - classify : 0);
+    latency_record_service(session, LATENCY_STAGE_CLASSIFY, classify_total - lat->classify_route);
+
+    lat->route = 0;
+    lat->sent = now;
+
+    /** If the client sent more than one statement, the rest of them are
+     * waiting in the protocol from this point on */
+    lat->read = now;
+}
+
+void latency_backend_reply(MXS_SESSION *session, const SERVER *server)
+{
+    MXS_SESSION_LATENCY *lat = &session->latency;
+
+    if (lat->sent)
+    {
+        uint64_t now = latency_now();
+        lat->server = server;
+        latency_record_service(session, LATENCY_STAGE_BACKEND, now - lat->sent);
+        latency_record_server(session, LATENCY_STAGE_BACKEND, now - lat->sent);
+        lat->sent = 0;
+        lat->reply = now;
+    }
+}
+
+void latency_client_reply(MXS_SESSION *session)
+{
+    MXS_SESSION_LATENCY *lat = &session->latency;
+
+    if (lat->reply)
+    {
+        uint64_t ns = latency_now() - lat->reply;
+        latency_record_service(session, LATENCY_STAGE_REPLY, ns);
+        latency_record_server(session, LATENCY_STAGE_REPLY, ns);
+        lat->reply = 0;
+
+        if (lat->traced)
+        {
+            MXS_NOTICE("Session %lu latency (us): protocol %.1f, filters %.1f, "
+                       "classify %.1f, router %.1f, backend %.1f (%s), reply %.1f",
+                       session->ses_id,
+                       lat->stage[LATENCY_STAGE_PROTOCOL] / 1000.0,
+                       lat->stage[LATENCY_STAGE_FILTERS] / 1000.0,
+                       lat->stage[LATENCY_STAGE_CLASSIFY] / 1000.0,
+                       lat->stage[LATENCY_STAGE_ROUTER] / 1000.0,
+                       lat->stage[LATENCY_STAGE_BACKEND] / 1000.0,
+                       lat->server ? lat->server->unique_name : "none",
+                       lat->stage[LATENCY_STAGE_REPLY] / 1000.0);
+        }
+
+        memset(lat->stage, 0, sizeof(lat->stage));
+    }
+}
+
+void latency_classify_add(uint64_t ns)
+{
+    classify_total += ns;
+}
+
+void latency_set_trace_sampling(int percent)
+{
+    if (percent < 0)
+    {
+        percent = 0;
+    }
+    else if (percent > 100)
+    {
+        percent = 100;
+    }
+
+    trace_sampling = percent;
+    atomic_synchronize();
+}
+
+int latency_get_trace_sampling()
+{
+    return trace_sampling;
+}
+
+bool latency_trace_session()
+{
+    int sampling = trace_sampling;
+    return sampling > 0 && (int)(random_jkiss() % 100) < sampling;
+}
+
+const char* latency_stage_to_string(latency_stage_t stage)
+{
+    return stage >= 0 && stage < LATENCY_STAGE_MAX ? stage_names[stage] : "unknown";
+}
+
+/**
+ * Find the value below which the given fraction of the measurements fall
+ */
+static double latency_percentile(const LATENCY_HISTOGRAM *hist, double fraction)
+{
+    uint64_t target = hist->count * fraction;
+    uint64_t count = 0;
+
+    if (target == 0)
+    {
+        target = 1;
+    }
+
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++)
+    {
+        count += hist->buckets[i];
+
+        if (count >= target)
+        {
+            uint64_t upper = latency_bucket_upper(i);
+            return (upper < hist->max ? upper : hist->max) / 1000.0;
+        }
+    }
+
+    return hist->max / 1000.0;
+}
+
+void latency_stats_summary(struct latency_stats *stats, latency_stage_t stage,
+                           LATENCY_SUMMARY *summary)
+{
+    LATENCY_HISTOGRAM merged;
+    memset(&merged, 0, sizeof(merged));
+    memset(summary, 0, sizeof(*summary));
+
+    if (stats)
+    {
+        int n_threads = config_threadcount();
+
+        for (int i = 0; i < n_threads; i++)
+        {
+            LATENCY_HISTOGRAM *hist = &stats[i].stage[stage];
+            merged.count += hist->count;
+            merged.total += hist->total;
+
+            if (hist->max > merged.max)
+            {
+                merged.max = hist->max;
+            }
+
+            for (int b = 0; b < LATENCY_HIST_BUCKETS; b++)
+            {
+                merged.buckets[b] += hist->buckets[b];
+            }
+        }
+    }
+
+    if (merged.count)
+    {
+        summary->count = merged.count;
+        summary->avg = merged.total / 1000.0 / merged.count;
+        summary->p50 = latency_percentile(&merged, 0.5);
+        summary->p99 = latency_percentile(&merged, 0.99);
+        summary->p999 = latency_percentile(&merged, 0.999);
+        summary->max = merged.max / 1000.0;
+    }
+}
+
+void latency_stats_print(DCB *dcb, const char *name, struct latency_stats *stats,
+                         latency_stage_t first, latency_stage_t last)
+{
+    for (int stage = first; stage <= last; stage++)
+    {
+        LATENCY_SUMMARY s;
+        latency_stats_summary(stats, stage, &s);
+        dcb_printf(dcb, "%-20s | %-8s | %12" PRIu64 " | %10.1f | %10.1f | %10.1f | %10.1f | %10.1f\n",
+                   name, stage_names[stage], s.count, s.avg, s.p50, s.p99, s.p999, s.max);
+    }
+}
+
+void latency_stats_collect(PROMETHEUS_OUTPUT *out, const char *name, const char *labels,
+                           struct latency_stats *stats, latency_stage_t first,
+                           latency_stage_t last)
+{
+    static const double quantiles[] = {0.5, 0.99, 0.999};
+
+    for (int stage = first; stage <= last; stage++)
+    {
+        LATENCY_SUMMARY s;
+        char stage_labels[PROMETHEUS_LABELS_MAXLEN];
+        latency_stats_summary(stats, stage, &s);
+
+        double values[] = {s.p50 / 1000000.0, s.p99 / 1000000.0, s.p999 / 1000000.0};
+        strcpy(stage_labels, labels);
+        prometheus_label(stage_labels, "stage", stage_names[stage]);
+        prometheus_summary(out, name, "Latency of the stages of statements in seconds",
+                           stage_labels, s.count, s.avg * s.count / 1000000.0,
+                           sizeof(quantiles) / sizeof(quantiles[0]), quantiles, values);
+    }
+}
+
+void latency_add_columns(RESULTSET *set)
+{
+    resultset_add_column(set, "Name", 32, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Stage", 10, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Count", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Avg_us", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "P50_us", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "P99_us", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "P999_us", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Max_us", 20, COL_TYPE_VARCHAR);
+}
+
+RESULT_ROW* latency_make_row(RESULTSET *set, const char *name,
+                             struct latency_stats *stats, latency_stage_t stage)
+{
+    RESULT_ROW *row = resultset_make_row(set);
+
+    if (row)
+    {
+        LATENCY_SUMMARY s;
+        char buf[40];
+        latency_stats_summary(stats, stage, &s);
+
+        resultset_row_set(row, 0, name);
+        resultset_row_set(row, 1, stage_names[stage]);
+        snprintf(buf, sizeof(buf), "%" PRIu64, s.count);
+        resultset_row_set(row, 2, buf);
+        snprintf(buf, sizeof(buf), "%.1f", s.avg);
+        resultset_row_set(row, 3, buf);
+        snprintf(buf, sizeof(buf), "%.1f", s.p50);
+        resultset_row_set(row, 4, buf);
+        snprintf(buf, sizeof(buf), "%.1f", s.p99);
+        resultset_row_set(row, 5, buf);
+        snprintf(buf, sizeof(buf), "%.1f", s.p999);
+        resultset_row_set(row, 6, buf);
+        snprintf(buf, sizeof(buf), "%.1f", s.max);
+        resultset_row_set(row, 7, buf);
+    }
+
+    return row;
+}
+
+void latency_stats_free(struct latency_stats *stats)
+{
+    MXS_FREE(stats);
+}
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <maxscale/listener.h>
 #include <maxscale/paths.h>
 #include <maxscale/ssl.h>
@@ -39,12 +40,77 @@
 #include <maxscale/alloc.h>
 #include <maxscale/users.h>
 #include <maxscale/service.h>
+#include <maxscale/prometheus.h>
 
 static RSA *rsa_512 = NULL;
 static RSA *rsa_1024 = NULL;
 
 static RSA *tmp_rsa_callback(SSL *s, int is_export, int keylength);
 
+/** The buckets of the number of connections accepted per event */
+static const int64_t batch_bounds[] = {0, 1, 2, 4, 8, 16, 32, 64};
+
+static const MXS_METRIC_DEF listener_metrics[] =
+{
+    {
+        "maxscale_listener_accepts_total", MXS_METRIC_COUNTER,
+        "Number of client connections accepted by the listener"
+    },
+    {
+        "maxscale_listener_accept_errors_total", MXS_METRIC_COUNTER,
+        "Number of failed accepts of client connections"
+    },
+    {
+        "maxscale_listener_accept_batch", MXS_METRIC_HISTOGRAM,
+        "Number of client connections accepted per readiness event",
+        batch_bounds, sizeof(batch_bounds) / sizeof(batch_bounds[0])
+    },
+    MXS_END_MODULE_METRICS
+};
+
+static pthread_once_t listener_metrics_defined = PTHREAD_ONCE_INIT;
+
+static void listener_define_metrics()
+{
+    for (const MXS_METRIC_DEF *def = listener_metrics; def->name; def++)
+    {
+        if (!mxs_metric_define(NULL, def))
+        {
+            MXS_ERROR("Could not define metric '%s'.", def->name);
+        }
+    }
+}
+
+/**
+ * Create the statistics of a listener
+ *
+ * @param stats   The statistics to create
+ * @param service Name of the service
+ * @param name    Name of the listener
+ * @return True if the statistics were created
+ */
+static bool listener_stats_create(LISTENER_STATS *stats, const char *service, const char *name)
+{
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+
+    pthread_once(&listener_metrics_defined, listener_define_metrics);
+    prometheus_label(labels, "service", service);
+    prometheus_label(labels, "listener", name);
+
+    stats->n_accepted = mxs_metric_create("maxscale_listener_accepts_total", labels);
+    stats->n_errors = mxs_metric_create("maxscale_listener_accept_errors_total", labels);
+    stats->batches = mxs_metric_create("maxscale_listener_accept_batch", labels);
+
+    return stats->n_accepted && stats->n_errors && stats->batches;
+}
+
+static void listener_stats_free(LISTENER_STATS *stats)
+{
+    mxs_metric_free(stats->n_accepted);
+    mxs_metric_free(stats->n_errors);
+    mxs_metric_free(stats->batches);
+}
+
 /**
  * Create a new listener structure
  *
@@ -109,8 +175,18 @@ listener_alloc(struct service* service, const char* name, const char *protocol,
     char *my_name = MXS_STRDUP(name);
     SERV_LISTENER *proto = (SERV_LISTENER*)MXS_MALLOC(sizeof(SERV_LISTENER));
 
-    if (!my_protocol || !proto || !my_name || !my_authenticator)
+    if (proto)
     {
+        memset(&proto->stats, 0, sizeof(proto->stats));
+    }
+
+    if (!my_protocol || !proto || !my_name || !my_authenticator ||
+        !listener_stats_create(&proto->stats, service->name, name))
+    {
+        if (proto)
+        {
+            listener_stats_free(&proto->stats);
+        }
         MXS_FREE(my_authenticator);
         MXS_FREE(my_protocol);
         MXS_FREE(my_address);
@@ -150,6 +226,7 @@ void listener_free(SERV_LISTENER* listener)
             users_free(listener->users);
         }
 
+        listener_stats_free(&listener->stats);
         MXS_FREE(listener->address);
         MXS_FREE(listener->authenticator);
         MXS_FREE(listener->auth_options);
@@ -36,6 +36,7 @@
 #include <dlfcn.h>
 #include <maxscale/modinfo.h>
 #include <maxscale/log_manager.h>
+#include <maxscale/metrics.h>
 #include <maxscale/version.h>
 #include <maxscale/notification.h>
 #include <curl/curl.h>
@@ -211,6 +212,15 @@ void *load_module(const char *module, const char *type)
             return NULL;
         }
 
+        for (const MXS_METRIC_DEF *def = mod_info->metrics; def && def->name; def++)
+        {
+            if (!mxs_metric_define(module, def))
+            {
+                MXS_WARNING("Metric '%s' of module '%s' could not be defined.",
+                            def->name, module);
+            }
+        }
+
         MXS_NOTICE("Loaded module %s: %s from %s", module, mod_info->version, fname);
     }
 
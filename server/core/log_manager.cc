@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <sched.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -30,17 +31,19 @@
 #include <maxscale/atomic.h>
 #include <maxscale/config.h>
 #include <maxscale/debug.h>
-#include <maxscale/hashtable.h>
 #include <maxscale/platform.h>
 #include <maxscale/session.h>
 #include <maxscale/spinlock.h>
 #include <maxscale/utils.h>
-#include "maxscale/mlist.h"
+#include "maxscale/skygw_utils.h"
 
 #define MAX_PREFIXLEN 250
 #define MAX_SUFFIXLEN 250
 #define MAX_PATHLEN   512
-#define MAXNBLOCKBUFS 10
+/** Size of the per-thread log ring, must be a power of two */
+#define LOG_RING_SIZE (64 * 1024)
+/** Size of the buffer the file writer collects records into */
+#define LOG_WRITEBUF_SIZE (64 * 1024)
 
 /** for procname */
 #if !defined(_GNU_SOURCE)
@@ -53,13 +56,6 @@ static const char LOGFILE_NAME_SUFFIX[] = ".log";
 extern char *program_invocation_name;
 extern char *program_invocation_short_name;
 
-typedef enum
-{
-    BB_READY = 0x00,
-    BB_FULL,
-    BB_CLEARED
-} blockbuf_state_t;
-
 typedef enum
 {
     FILEWRITER_INIT,
@@ -94,7 +90,6 @@ enum log_flush
 
 #if defined(SS_DEBUG)
 static int write_index;
-static int block_start_index;
 static int prevval;
 static simple_mutex_t msg_mutex;
 #endif
@@ -158,7 +153,6 @@ static logmanager_t* lm;
 static bool flushall_flag;
 static bool flushall_started_flag;
 static bool flushall_done_flag;
-static HASHTABLE* message_stats;
 
 /** This is used to detect if the initialization of the log manager has failed
  * and that it isn't initialized again after a failure has occurred. */
@@ -179,6 +173,9 @@ struct filewriter
     /** fwr_clientmes is for messages to log clients */
     skygw_message_t*   fwr_clientmes;
     skygw_thread_t*    fwr_thread;
+    /** Records merged from the log rings, waiting to be written */
+    size_t             fwr_buf_used;
+    char               fwr_buf[LOG_WRITEBUF_SIZE];
 #if defined(SS_DEBUG)
     skygw_chk_t        fwr_chk_tail;
 #endif
@@ -193,15 +190,67 @@ typedef struct lm_message_key
 
 typedef struct lm_message_stats
 {
-    SPINLOCK lock;
     uint64_t first_ms; /** The time when the error was logged the first time in this window. */
     uint64_t last_ms;  /** The time when the error was logged the last time. */
     size_t   count;    /** How many times the error has been reported within this window. */
 } LM_MESSAGE_STATS;
 
+typedef struct lm_message_slot
+{
+    LM_MESSAGE_KEY   key;  /** Unused if key.filename is NULL. */
+    LM_MESSAGE_STATS stats;
+} LM_MESSAGE_SLOT;
+
 static const int LM_MESSAGE_HASH_SIZE = 293; /** A prime, and roughly a quarter of current
                                                  number of MXS_{ERROR|WARNING|NOTICE} calls. */
 
+/**
+ * Every thread that logs formats its messages into a ring of its own. A ring
+ * has exactly one producer, the owning thread, and one consumer, the file
+ * writer thread, so records are handed over without locks: only the owner
+ * advances lr_head and only the file writer advances lr_tail.
+ */
+typedef struct log_ring
+{
+    char*             lr_buf;       /**< LOG_RING_SIZE bytes of records */
+    volatile uint64_t lr_head;      /**< Bytes produced, written by the owner */
+    volatile uint64_t lr_tail;      /**< Bytes consumed, written by the file writer */
+    volatile bool     lr_closed;    /**< The owner has exited, free when drained */
+    uint64_t          lr_limit;     /**< File writer: end of the records of this round */
+    uint64_t          lr_next_time; /**< File writer: time of the record at lr_tail */
+    uint32_t          lr_next_len;  /**< File writer: length of the record at lr_tail */
+    struct log_ring*  lr_next;      /**< Next ring in the registry */
+} log_ring_t;
+
+/** Header of a record in a log ring, followed by lh_len bytes of text */
+typedef struct log_record_hdr
+{
+    uint64_t lh_time; /**< Monotonic time in nanoseconds when the record was made */
+    uint32_t lh_len;
+} log_record_hdr_t;
+
+/**
+ * The logging state of a thread. The throttling statistics are per thread
+ * so that deciding whether a message is suppressed needs no locking.
+ */
+typedef struct log_thread
+{
+    log_ring_t*     lt_ring;
+    LM_MESSAGE_SLOT lt_stats[LM_MESSAGE_HASH_SIZE];
+} log_thread_t;
+
+/**
+ * Registry of all log rings. Rings are added at the head by the threads that
+ * own them and removed only by the file writer, so the file writer can walk
+ * the list without holding the lock.
+ */
+static log_ring_t*    log_rings;
+static SPINLOCK       log_rings_lock = SPINLOCK_INIT;
+static pthread_key_t  log_thread_key;
+static pthread_once_t log_thread_once = PTHREAD_ONCE_INIT;
+static thread_local log_thread_t* this_log_thread;
+static thread_local bool this_is_filewriter;
+
 /**
  * Returns the current time.
  *
@@ -215,6 +264,19 @@ static uint64_t time_monotonic_ms()
     return now.tv_sec * 1000 + now.tv_nsec / 1000000;
 }
 
+/**
+ * Returns the current time.
+ *
+ * @return Current monotonic time in nanoseconds.
+ */
+static uint64_t time_monotonic_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
 /**
  * Hash-function for lm_message_key.
  *
@@ -243,7 +305,7 @@ int lm_message_key_hash(const void *v)
 
     for (i = 0; i < sizeof(key2); ++i)
     {
-        hash += (key1 >> i * 8) & 0xff;
+        hash += (key2 >> i * 8) & 0xff;
         hash += (hash << 10);
         hash ^= (hash >> 6);
     }
@@ -254,96 +316,6 @@ int lm_message_key_hash(const void *v)
     return hash;
 }
 
-/**
- * Compares two LM_MESSAGE_KEY structures
- *
- * @param v1 Pointer to a LM_MESSAGE_KEY struct.
- * @param v2 Pointer to a LM_MESSAGE_KEY struct.
- * @return  0 if the structures are equal.
- *         -1 if v1 is less than v2
- *          1 if v1 is greater than v2
- */
-static int lm_message_key_cmp(const void* v1, const void* v2)
-{
-    const LM_MESSAGE_KEY* key1 = (const LM_MESSAGE_KEY*)v1;
-    const LM_MESSAGE_KEY* key2 = (const LM_MESSAGE_KEY*)v2;
-
-    int cmp = (int64_t)key1->filename - (int64_t)key2->filename;
-
-    if (cmp == 0)
-    {
-        cmp = key1->linenumber - key2->linenumber;
-    }
-
-    return cmp == 0 ? 0 : (cmp < 0 ? -1 : 1);
-}
-
-/**
- * Clone a LM_MESSAGE_KEY
- *
- * @param v Pointer to a LM_MESSAGE_KEY structure
- * @return A copy of v or NULL if memory allocation fails.
- */
-static void* lm_message_key_clone(const void* v)
-{
-    const LM_MESSAGE_KEY* src = (const LM_MESSAGE_KEY*)v;
-    LM_MESSAGE_KEY* dst = (LM_MESSAGE_KEY*)MXS_MALLOC(sizeof(LM_MESSAGE_KEY));
-
-    if (dst)
-    {
-        dst->filename = src->filename;
-        dst->linenumber = src->linenumber;
-    }
-
-    return dst;
-}
-
-/**
- * Clone a LM_MESSAGE_STATS
- *
- * @param v Pointer to a LM_MESSAGE_STATS structure
- * @return A copy of v or NULL if memory allocation fails.
- */
-static void* lm_message_stats_clone(const void* v)
-{
-    const LM_MESSAGE_STATS* src = (const LM_MESSAGE_STATS*)v;
-    LM_MESSAGE_STATS* dst = (LM_MESSAGE_STATS*)MXS_MALLOC(sizeof(LM_MESSAGE_STATS));
-
-    if (dst)
-    {
-        // Somewhat questionable to copy a lock, but in this context we
-        // know that src is stack allocated and will not be used after this.
-        dst->lock = src->lock;
-        dst->first_ms = src->first_ms;
-        dst->last_ms = src->last_ms;
-        dst->count = src->count;
-    }
-
-    return dst;
-}
-
-/**
- * Log client's string is copied to block-sized log buffer, which is passed
- * to file writer thread.
- */
-typedef struct blockbuf
-{
-#if defined(SS_DEBUG)
-    skygw_chk_t    bb_chk_top;
-#endif
-    blockbuf_state_t bb_state; /**State of the block buffer*/
-    simple_mutex_t bb_mutex;    /**< bb_buf_used, bb_isfull */
-    int            bb_refcount; /**< protected by list mutex. #of clients */
-//        int            bb_blankcount; /**< # of blanks used btw strings */
-    size_t         bb_buf_size;
-    size_t         bb_buf_left;
-    size_t         bb_buf_used;
-    char           bb_buf[MAX_LOGSTRLEN];
-#if defined(SS_DEBUG)
-    skygw_chk_t    bb_chk_tail;
-#endif
-} blockbuf_t;
-
 /**
  * logfile object corresponds to physical file(s) where
  * certain log is written.
@@ -364,8 +336,6 @@ struct logfile
     const char*      lf_name_suffix;
     char*            lf_full_file_name; /**< complete log file name */
     char*            lf_full_link_name; /**< complete symlink name */
-    /** list of block-sized log buffers */
-    mlist_t          lf_blockbuf_list;
     size_t           lf_buf_size;
     bool             lf_flushflag;
     bool             lf_rotateflag;
@@ -456,14 +426,12 @@ static int logmanager_write_log(int            priority,
                                 size_t         len,
                                 const char*    str);
 
-static blockbuf_t* blockbuf_init();
-static void blockbuf_node_done(void* bb_data);
-static char* blockbuf_get_writepos(blockbuf_t** p_bb,
-                                   size_t       str_len,
-                                   bool         flush);
-
-static void blockbuf_register(blockbuf_t* bb);
-static void blockbuf_unregister(blockbuf_t* bb);
+static log_thread_t* log_thread_get(void);
+static void log_ring_push(log_ring_t*    ring,
+                          logfile_t*     lf,
+                          const char*    str,
+                          size_t         len,
+                          enum log_flush flush);
 static char* add_slash(char* str);
 
 static bool check_file_and_path(const char* filename, bool* writable);
@@ -495,7 +463,6 @@ static bool logmanager_init_nomutex(const char* ident,
     lm->lm_chk_top   = CHK_NUM_LOGMANAGER;
     lm->lm_chk_tail  = CHK_NUM_LOGMANAGER;
     write_index = 0;
-    block_start_index = 0;
     prevval = -1;
     simple_mutex_init(&msg_mutex, "Message mutex");
 #endif
@@ -602,29 +569,7 @@ bool mxs_log_init(const char* ident, const char* logdir, mxs_log_target_t target
 
     if (!lm)
     {
-        ss_dassert(!message_stats);
-
-        message_stats = hashtable_alloc(LM_MESSAGE_HASH_SIZE,
-                                        lm_message_key_hash,
-                                        lm_message_key_cmp);
-        if (message_stats)
-        {
-            // As entries are added to the hashtable they will be cloned,
-            // so stack allocated keys and values are ok.
-            hashtable_memory_fns(message_stats,
-                                 lm_message_key_clone,
-                                 lm_message_stats_clone,
-                                 hashtable_item_free,
-                                 hashtable_item_free);
-
-            succ = logmanager_init_nomutex(ident, logdir, target, log_config.do_maxlog);
-
-            if (!succ)
-            {
-                hashtable_free(message_stats);
-                message_stats = NULL;
-            }
-        }
+        succ = logmanager_init_nomutex(ident, logdir, target, log_config.do_maxlog);
     }
     else
     {
@@ -679,9 +624,6 @@ static void logmanager_done_nomutex(void)
     /** Set global pointer NULL to prevent access to freed data. */
     MXS_FREE(lm);
     lm = NULL;
-
-    hashtable_free(message_stats);
-    message_stats = NULL;
 }
 
 /**
@@ -735,7 +677,8 @@ static logfile_t* logmanager_get_logfile(logmanager_t* lmgr)
 }
 
 /**
- * Finds write position from block buffer for log string and writes there.
+ * Formats a log string and hands it over to the file writer via the ring of
+ * the calling thread.
  *
  * Parameters:
  *
@@ -755,13 +698,11 @@ static int logmanager_write_log(int            priority,
                                 size_t         str_len,
                                 const char*    str)
 {
-    logfile_t*   lf = NULL;
-    char*        wp = NULL;
-    int          err = 0;
-    blockbuf_t*  bb = NULL;
-    blockbuf_t*  bb_c = NULL;
-    size_t       timestamp_len;
-    int          i;
+    logfile_t*    lf = NULL;
+    char*         wp = NULL;
+    int           err = 0;
+    log_thread_t* lt = NULL;
+    size_t        timestamp_len;
 
     // The config parameters are copied to local variables, because the values in
     // log_config may change during the course of the function, with would have
@@ -801,10 +742,6 @@ static int logmanager_write_log(int            priority,
     {
         safe_str_len = timestamp_len - sizeof(char) + str_len;
     }
-    /**
-     * Seek write position and register to block buffer.
-     * Then print formatted string to write position.
-     */
 
 #if defined (SS_LOG_DEBUG)
     {
@@ -830,22 +767,19 @@ static int logmanager_write_log(int            priority,
         simple_mutex_unlock(&msg_mutex);
     }
 #endif
-    /** Book space for log string from buffer */
-    if (do_maxlog)
-    {
-        // All messages are now logged to the error log file.
-        wp = blockbuf_get_writepos(&bb, safe_str_len, flush);
-    }
-    else
-    {
-        wp = (char*)MXS_MALLOC(sizeof(char) * (timestamp_len - sizeof(char) + str_len + 1));
-    }
 
-    if (wp == NULL)
+    if (do_maxlog && (lt = log_thread_get()) == NULL)
     {
         return -1;
     }
 
+    /**
+     * The record is formatted on the stack and then copied to the ring of
+     * this thread, so no shared buffer space needs to be booked.
+     */
+    char record[safe_str_len];
+    wp = record;
+
 #if defined (SS_LOG_DEBUG)
     {
         sprintf(wp, "[msg:%d]", atomic_add(&write_index, 1));
@@ -912,356 +846,166 @@ static int logmanager_write_log(int            priority,
 
     if (do_maxlog)
     {
-        blockbuf_unregister(bb);
-    }
-    else
-    {
-        MXS_FREE(wp);
+        log_ring_push(lt->lt_ring, lf, record, (wp - record) + safe_str_len, flush);
     }
 
     return err;
 }
 
 /**
- * Register writer to a block buffer. When reference counter is non-zero the
- * flusher thread doesn't write the block to disk.
+ * Copy data into a log ring, wrapping around at the end of the ring.
  *
- * @param bb    block buffer
+ * @param ring The ring
+ * @param pos  Absolute position where to write
+ * @param data Data to write
+ * @param len  Length of data
  */
-static void blockbuf_register(blockbuf_t* bb)
+static void log_ring_copy_in(log_ring_t* ring, uint64_t pos, const void* data, size_t len)
 {
-    CHK_BLOCKBUF(bb);
-    ss_dassert(bb->bb_refcount >= 0);
-    atomic_add(&bb->bb_refcount, 1);
+    size_t offset = pos & (LOG_RING_SIZE - 1);
+    size_t first = MXS_MIN(len, LOG_RING_SIZE - offset);
+
+    memcpy(ring->lr_buf + offset, data, first);
+    memcpy(ring->lr_buf, (const char*)data + first, len - first);
 }
 
 /**
- * Unregister writer from block buffer. If the buffer got filled up and there
- * are no other registered writers anymore, notify the flusher thread.
+ * Copy data out of a log ring, wrapping around at the end of the ring.
  *
- * @param bb    block buffer
+ * @param ring The ring
+ * @param pos  Absolute position where to read
+ * @param data Where to copy the data
+ * @param len  Length of data
  */
-static void blockbuf_unregister(blockbuf_t* bb)
+static void log_ring_copy_out(log_ring_t* ring, uint64_t pos, void* data, size_t len)
 {
-    logfile_t* lf;
+    size_t offset = pos & (LOG_RING_SIZE - 1);
+    size_t first = MXS_MIN(len, LOG_RING_SIZE - offset);
 
-    CHK_BLOCKBUF(bb);
-    ss_dassert(bb->bb_refcount >= 1);
-    lf = &lm->lm_logfile;
-    CHK_LOGFILE(lf);
-    /**
-     * if this is the last client in a full buffer, send write request.
-     */
-    if (atomic_add(&bb->bb_refcount, -1) == 1 && bb->bb_state == BB_FULL)
-    {
-        skygw_message_send(lf->lf_logmes);
-    }
-    ss_dassert(bb->bb_refcount >= 0);
+    memcpy(data, ring->lr_buf + offset, first);
+    memcpy((char*)data + first, ring->lr_buf, len - first);
 }
 
-
 /**
- * @node (write brief function description here)
+ * Append a record to the ring of the calling thread.
  *
- * Parameters:
- * @param id - <usage>
- *          <description>
- *
- * @param str_len - <usage>
- *          <description>
- *
- * @return
- *
- *
- * @details List mutex now protects both the list and the contents of it.
- * TODO : It should be so that adding and removing nodes of the list is protected
- * by the list mutex. Buffer modifications should be protected by buffer
- * mutex.
+ * The file writer is woken up if the record should be flushed or if the
+ * ring is getting full. If there is no room for the record, the call waits
+ * until the file writer has drained the ring.
  *
+ * @param ring  The ring of the calling thread
+ * @param lf    The log file
+ * @param str   Formatted record
+ * @param len   Length of the record
+ * @param flush Whether the record should be written out immediately
  */
-static char* blockbuf_get_writepos(blockbuf_t** p_bb,
-                                   size_t       str_len,
-                                   bool         flush)
-{
-    logfile_t*     lf;
-    mlist_t*       bb_list;
-    char*          pos = NULL;
-    mlist_node_t*  node;
-    blockbuf_t*    bb;
-#if defined(SS_DEBUG)
-    bool           succ;
-#endif
-
-    CHK_LOGMANAGER(lm);
-    lf = &lm->lm_logfile;
-    CHK_LOGFILE(lf);
-    bb_list = &lf->lf_blockbuf_list;
-
-    /** Lock list */
-    simple_mutex_lock(&bb_list->mlist_mutex, true);
-    CHK_MLIST(bb_list);
-
-    if (bb_list->mlist_nodecount > 0)
-    {
-        /**
-         * At least block buffer exists on the list.
-         */
-        node = bb_list->mlist_first;
-
-        /** Loop over blockbuf list to find write position */
-        while (true)
-        {
-            CHK_MLIST_NODE(node);
-
-            /** Unlock list */
-            simple_mutex_unlock(&bb_list->mlist_mutex);
-
-            bb = (blockbuf_t *)node->mlnode_data;
-            CHK_BLOCKBUF(bb);
-
-            /** Lock buffer */
-            simple_mutex_lock(&bb->bb_mutex, true);
-
-            if (bb->bb_state == BB_FULL || bb->bb_buf_left < str_len)
-            {
-                /**
-                 * This block buffer is too full.
-                 * Send flush request to file writer thread. This causes
-                 * flushing all buffers, and (eventually) frees buffer space.
-                 */
-                blockbuf_register(bb);
-
-                bb->bb_state = BB_FULL;
-
-                blockbuf_unregister(bb);
-
-                /** Unlock buffer */
-                simple_mutex_unlock(&bb->bb_mutex);
-
-                /** Lock list */
-                simple_mutex_lock(&bb_list->mlist_mutex, true);
-
-
-                /**
-                 * If next node exists move forward. Else check if there is
-                 * space for a new block buffer on the list.
-                 */
-                if (node != bb_list->mlist_last)
-                {
-                    node = node->mlnode_next;
-                    continue;
-                }
-                /**
-                 * All buffers on the list are full.
-                 */
-                if (bb_list->mlist_nodecount < bb_list->mlist_nodecount_max)
-                {
-                    /**
-                     * New node is created
-                     */
-                    if ((bb = blockbuf_init()) == NULL)
-                    {
-                        simple_mutex_unlock(&bb_list->mlist_mutex);
-                        return NULL;
-                    }
-
-                    CHK_BLOCKBUF(bb);
-
-                    /**
-                     * Increase version to odd to mark list update active
-                     * update.
-                     */
-                    bb_list->mlist_versno += 1;
-                    ss_dassert(bb_list->mlist_versno % 2 == 1);
-
-                    ss_debug(succ = ) mlist_add_data_nomutex(bb_list, bb);
-                    ss_dassert(succ);
-
-                    /**
-                     * Increase version to even to mark completion of update.
-                     */
-                    bb_list->mlist_versno += 1;
-                    ss_dassert(bb_list->mlist_versno % 2 == 0);
-                }
-                else
-                {
-                    /**
-                     * List and buffers are full.
-                     * Reset to the beginning of the list, and wait until
-                     * there is a block buffer with enough space.
-                     */
-                    simple_mutex_unlock(&bb_list->mlist_mutex);
-                    simple_mutex_lock(&bb_list->mlist_mutex, true);
-
-                    node = bb_list->mlist_first;
-                    continue;
-                }
-
-            }
-            else if (bb->bb_state == BB_CLEARED)
-            {
-
-                /**
-                 *Move the cleared buffer to the end of the list if it is the first one in the list
-                 */
-
-                simple_mutex_unlock(&bb->bb_mutex);
-                simple_mutex_lock(&bb_list->mlist_mutex, true);
-
-                if (node == bb_list->mlist_first)
-                {
-
-                    if ((bb_list->mlist_nodecount > 1) && (node != bb_list->mlist_last))
-                    {
-                        bb_list->mlist_last->mlnode_next = bb_list->mlist_first;
-                        bb_list->mlist_first = bb_list->mlist_first->mlnode_next;
-                        bb_list->mlist_last->mlnode_next->mlnode_next = NULL;
-                        bb_list->mlist_last = bb_list->mlist_last->mlnode_next;
-                    }
-
-                    ss_dassert(node == bb_list->mlist_last);
-
-                    simple_mutex_unlock(&bb_list->mlist_mutex);
-                    simple_mutex_lock(&bb->bb_mutex, true);
+static void log_ring_push(log_ring_t*    ring,
+                          logfile_t*     lf,
+                          const char*    str,
+                          size_t         len,
+                          enum log_flush flush)
+{
+    size_t total = sizeof(log_record_hdr_t) + len;
+    uint64_t head = ring->lr_head;
 
-                    bb->bb_state = BB_READY;
+    ss_dassert(total <= LOG_RING_SIZE);
 
-                    simple_mutex_unlock(&bb->bb_mutex);
-                    simple_mutex_lock(&bb_list->mlist_mutex, true);
-                    node = bb_list->mlist_first;
-                }
-                else
-                {
-                    if (node->mlnode_next)
-                    {
-                        node = node->mlnode_next;
-                    }
-                    else
-                    {
-                        node = bb_list->mlist_first;
-                    }
-                    continue;
-                }
-
-            }
-            else if (bb->bb_state == BB_READY)
-            {
-                /**
-                 * There is space for new log string.
-                 */
-                break;
-            }
-        } /** while (true) */
-    }
-    else
+    while (head + total - ring->lr_tail > LOG_RING_SIZE)
     {
-
-        /**
-         * Create the first block buffer to logfile's blockbuf list.
-         */
-
-        if ((bb = blockbuf_init()) == NULL)
+        if (this_is_filewriter)
         {
-            return NULL;
+            // The file writer can not wait for itself to drain the ring.
+            return;
         }
 
-        CHK_BLOCKBUF(bb);
-
-        /** Lock buffer */
-        simple_mutex_lock(&bb->bb_mutex, true);
-        /**
-         * Increase version to odd to mark list update active update.
-         */
-        bb_list->mlist_versno += 1;
-        ss_dassert(bb_list->mlist_versno % 2 == 1);
-
-        ss_debug(succ = ) mlist_add_data_nomutex(bb_list, bb);
-        ss_dassert(succ);
-
-        /**
-         * Increase version to even to mark completion of update.
-         */
-        bb_list->mlist_versno += 1;
-        ss_dassert(bb_list->mlist_versno % 2 == 0);
+        skygw_message_send(lf->lf_logmes);
+        pthread_yield();
+    }
 
-        /** Unlock list */
-        simple_mutex_unlock(&bb_list->mlist_mutex);
-    } /* if (bb_list->mlist_nodecount > 0) */
+    /** The space must not be reused before the file writer is done with it. */
+    atomic_synchronize();
 
-    ss_dassert(pos == NULL);
-    ss_dassert(!(bb->bb_state == BB_FULL || bb->bb_buf_left < str_len));
-    ss_dassert(bb_list->mlist_nodecount <= bb_list->mlist_nodecount_max);
+    log_record_hdr_t hdr;
+    hdr.lh_time = time_monotonic_ns();
+    hdr.lh_len = len;
 
-    /**
-     * Registration to blockbuf adds reference for the write operation.
-     * It indicates that client has allocated space from the buffer,
-     * but not written yet. As long as refcount > 0 buffer can't be
-     * written to disk.
-     */
-    blockbuf_register(bb);
-    *p_bb = bb;
-    /**
-     * At this point list mutex is held and bb points to a node with
-     * enough space available. pos is not yet set.
-     */
-    pos = &bb->bb_buf[bb->bb_buf_used];
-    bb->bb_buf_used += str_len;
-    bb->bb_buf_left -= str_len;
+    log_ring_copy_in(ring, head, &hdr, sizeof(hdr));
+    log_ring_copy_in(ring, head + sizeof(hdr), str, len);
 
-    ss_dassert((pos >= &bb->bb_buf[0]) && (pos <= &bb->bb_buf[MAX_LOGSTRLEN - str_len]));
+    /** The record must be complete before it is published. */
+    atomic_synchronize();
+    ring->lr_head = head + total;
 
-    /** read checkmark */
-    /** TODO: add buffer overflow checkmark
-        chk_val = (int)bb->bb_buf[bb->bb_buf_used-count_len];
-        ss_dassert(chk_val == bb->bb_strcount);
-    */
+    if (flush == LOG_FLUSH_YES || ring->lr_head - ring->lr_tail >= LOG_RING_SIZE / 2)
+    {
+        skygw_message_send(lf->lf_logmes);
+    }
+}
 
-    /** TODO : write next checkmark
-        bb->bb_strcount += 1;
-        memcpy(&bb->bb_buf[bb->bb_buf_used], &bb->bb_strcount, count_len);
-        bb->bb_buf_used += count_len;
-        bb->bb_buf_left -= count_len;
-    */
+/**
+ * Called when a thread that has logged exits. The file writer frees the ring
+ * once it has written out the records remaining in it.
+ *
+ * @param data The log_thread_t of the exiting thread
+ */
+static void log_thread_done(void* data)
+{
+    log_thread_t* lt = (log_thread_t*)data;
 
-    /**
-     * If flush flag is set, set buffer full. As a consequence, no-one
-     * can write to it before it is flushed to disk.
-     */
-    bb->bb_state = (flush == true ? BB_FULL : bb->bb_state);
+    atomic_synchronize();
+    lt->lt_ring->lr_closed = true;
 
-    /** Unlock buffer */
-    simple_mutex_unlock(&bb->bb_mutex);
-    return pos;
+    this_log_thread = NULL;
+    free(lt);
 }
 
-static void blockbuf_node_done(void* bb_data)
+static void log_thread_key_init(void)
 {
-    blockbuf_t* bb = (blockbuf_t *)bb_data;
-    simple_mutex_done(&bb->bb_mutex);
+    pthread_key_create(&log_thread_key, log_thread_done);
 }
 
-
-static blockbuf_t* blockbuf_init()
+/**
+ * Get the logging state of the calling thread, creating it and registering
+ * the ring of the thread if this is the first message the thread logs.
+ *
+ * The memory is allocated with the system functions, as the log manager
+ * can not log its own allocation failures.
+ *
+ * @return The logging state of the thread or NULL if memory allocation failed.
+ */
+static log_thread_t* log_thread_get(void)
 {
-    blockbuf_t* bb;
-
-    if ((bb = (blockbuf_t *) MXS_CALLOC(1, sizeof (blockbuf_t))))
+    if (this_log_thread == NULL)
     {
-#if defined(SS_DEBUG)
-        bb->bb_chk_top = CHK_NUM_BLOCKBUF;
-        bb->bb_chk_tail = CHK_NUM_BLOCKBUF;
-#endif
-        simple_mutex_init(&bb->bb_mutex, "Blockbuf mutex");
-        bb->bb_buf_left = MAX_LOGSTRLEN;
-        bb->bb_buf_size = MAX_LOGSTRLEN;
-#if defined(SS_LOG_DEBUG)
-        sprintf(bb->bb_buf, "[block:%d]", atomic_add(&block_start_index, 1));
-        bb->bb_buf_used += strlen(bb->bb_buf);
-        bb->bb_buf_left -= strlen(bb->bb_buf);
-#endif
-        CHK_BLOCKBUF(bb);
+        log_thread_t* lt = (log_thread_t*)calloc(1, sizeof(log_thread_t));
+        log_ring_t* ring = (log_ring_t*)calloc(1, sizeof(log_ring_t));
+        char* buf = (char*)malloc(LOG_RING_SIZE);
+
+        if (lt && ring && buf)
+        {
+            ring->lr_buf = buf;
+            lt->lt_ring = ring;
+
+            pthread_once(&log_thread_once, log_thread_key_init);
+            pthread_setspecific(log_thread_key, lt);
+
+            spinlock_acquire(&log_rings_lock);
+            ring->lr_next = log_rings;
+            log_rings = ring;
+            spinlock_release(&log_rings_lock);
+
+            this_log_thread = lt;
+        }
+        else
+        {
+            LOG_ERROR("MaxScale Log: Error, could not allocate the log buffer of a thread.\n");
+            free(buf);
+            free(ring);
+            free(lt);
+        }
     }
-    return bb;
+
+    return this_log_thread;
 }
 
 /**
@@ -1914,21 +1658,6 @@ static bool logfile_init(logfile_t*    logfile,
     {
         goto return_with_succ;
     }
-    /**
-     * Create a block buffer list for log file. Clients' writes go to buffers
-     * from where separate log flusher thread writes them to disk.
-     */
-    if (mlist_init(&logfile->lf_blockbuf_list,
-                   NULL,
-                   MXS_STRDUP_A("logfile block buffer list"),
-                   blockbuf_node_done,
-                   MAXNBLOCKBUFS) == NULL)
-    {
-        LOG_ERROR("MaxScale Log: Error, Initializing buffers for log files failed.\n");
-        logfile_free_memory(logfile);
-        goto return_with_succ;
-    }
-
     succ = true;
     logfile->lf_state = RUN;
     CHK_LOGFILE(logfile);
@@ -1969,11 +1698,6 @@ static void logfile_done(logfile_t* lf)
         CHK_LOGFILE(lf);
     /** fallthrough */
     case INIT:
-        /** Test if list is initialized before freeing it */
-        if (lf->lf_blockbuf_list.mlist_versno != 0)
-        {
-            mlist_done(&lf->lf_blockbuf_list);
-        }
         logfile_free_memory(lf);
         lf->lf_state = DONE;
     /** fallthrough */
@@ -2119,6 +1843,154 @@ static void filewriter_done(filewriter_t* fw, bool write_footer)
     }
 }
 
+/**
+ * Write the records collected by the file writer to the log file.
+ *
+ * @param fwr   The file writer
+ * @param lf    The log file
+ * @param flush Whether the file should be synced to disk
+ */
+static void filewriter_write_buf(filewriter_t* fwr, logfile_t* lf, bool flush)
+{
+    // fwr->fwr_file may be NULL if an earlier log-rotation failed, and writing
+    // may have been disabled due to an earlier error. The records are discarded.
+    if (fwr->fwr_buf_used != 0 && fwr->fwr_file && log_config.do_maxlog)
+    {
+        int err = skygw_file_write(fwr->fwr_file, fwr->fwr_buf, fwr->fwr_buf_used, flush);
+
+        if (err)
+        {
+            // TODO: Log this to syslog.
+            char errbuf[MXS_STRERROR_BUFLEN];
+            LOG_ERROR("MaxScale Log: Error, writing to the log-file %s failed due to %d, %s. "
+                      "Disabling writing to the log.\n",
+                      lf->lf_full_file_name, err, strerror_r(err, errbuf, sizeof(errbuf)));
+
+            mxs_log_set_maxlog_enabled(false);
+        }
+    }
+
+    fwr->fwr_buf_used = 0;
+}
+
+/**
+ * Read the header of the next record of a ring, if the ring has records
+ * left in the current round.
+ *
+ * @param ring The ring
+ *
+ * @return True if the ring has a record, false otherwise.
+ */
+static bool log_ring_peek(log_ring_t* ring)
+{
+    bool rval = false;
+
+    if (ring->lr_tail < ring->lr_limit)
+    {
+        log_record_hdr_t hdr;
+        log_ring_copy_out(ring, ring->lr_tail, &hdr, sizeof(hdr));
+        ring->lr_next_time = hdr.lh_time;
+        ring->lr_next_len = hdr.lh_len;
+        rval = true;
+    }
+
+    return rval;
+}
+
+/**
+ * Write out the records that are in the log rings when the function is
+ * called. The records of the rings are merged in timestamp order. Records
+ * that are added while the rings are drained are left for the next round,
+ * so a busy logger can not keep the file writer from returning.
+ *
+ * @param fwr   The file writer
+ * @param lf    The log file
+ * @param flush Whether the file should be synced to disk
+ */
+static void thr_drain_rings(filewriter_t* fwr, logfile_t* lf, bool flush)
+{
+    spinlock_acquire(&log_rings_lock);
+    log_ring_t* rings = log_rings;
+    spinlock_release(&log_rings_lock);
+
+    for (log_ring_t* ring = rings; ring; ring = ring->lr_next)
+    {
+        ring->lr_limit = ring->lr_head;
+    }
+
+    /** Read the records only after the heads have been read. */
+    atomic_synchronize();
+
+    for (log_ring_t* ring = rings; ring; ring = ring->lr_next)
+    {
+        log_ring_peek(ring);
+    }
+
+    while (true)
+    {
+        log_ring_t* next = NULL;
+
+        for (log_ring_t* ring = rings; ring; ring = ring->lr_next)
+        {
+            if (ring->lr_tail < ring->lr_limit &&
+                (next == NULL || ring->lr_next_time < next->lr_next_time))
+            {
+                next = ring;
+            }
+        }
+
+        if (next == NULL)
+        {
+            break;
+        }
+
+        if (fwr->fwr_buf_used + next->lr_next_len > sizeof(fwr->fwr_buf))
+        {
+            filewriter_write_buf(fwr, lf, false);
+        }
+
+        log_ring_copy_out(next, next->lr_tail + sizeof(log_record_hdr_t),
+                          fwr->fwr_buf + fwr->fwr_buf_used, next->lr_next_len);
+        fwr->fwr_buf_used += next->lr_next_len;
+
+        /** The record must be copied before its space is handed back. */
+        atomic_synchronize();
+        next->lr_tail += sizeof(log_record_hdr_t) + next->lr_next_len;
+
+        log_ring_peek(next);
+    }
+
+    filewriter_write_buf(fwr, lf, flush);
+}
+
+/**
+ * Free the rings of exited threads that have been drained.
+ */
+static void log_rings_free_closed(void)
+{
+    spinlock_acquire(&log_rings_lock);
+
+    log_ring_t** prev = &log_rings;
+
+    while (*prev)
+    {
+        log_ring_t* ring = *prev;
+
+        if (ring->lr_closed && ring->lr_tail == ring->lr_head)
+        {
+            *prev = ring->lr_next;
+            free(ring->lr_buf);
+            free(ring);
+        }
+        else
+        {
+            prev = &ring->lr_next;
+        }
+    }
+
+    spinlock_release(&log_rings_lock);
+}
+
 static bool thr_flush_file(logmanager_t *lm, filewriter_t *fwr)
 {
     /**
@@ -2159,94 +2031,14 @@ static bool thr_flush_file(logmanager_t *lm, filewriter_t *fwr)
                           lf->lf_full_file_name);
             }
         }
-
-        return true;
     }
 
-    skygw_file_t *file = fwr->fwr_file;
     /**
-     * get logfile's block buffer list
+     * The rings are always drained, as the logging threads wait for the
+     * file writer when their rings are full.
      */
-    mlist_t *bb_list = &lf->lf_blockbuf_list;
-#if defined(SS_DEBUG)
-    simple_mutex_lock(&bb_list->mlist_mutex, true);
-    CHK_MLIST(bb_list);
-    simple_mutex_unlock(&bb_list->mlist_mutex);
-#endif
-    mlist_node_t *node = bb_list->mlist_first;
-
-    while (node != NULL)
-    {
-        int err = 0;
-
-        CHK_MLIST_NODE(node);
-        blockbuf_t *bb = (blockbuf_t *)node->mlnode_data;
-        CHK_BLOCKBUF(bb);
-
-        /** Lock block buffer */
-        simple_mutex_lock(&bb->bb_mutex, true);
-
-        blockbuf_state_t flush_blockbuf = bb->bb_state;
-
-        if (bb->bb_buf_used != 0 &&
-            ((flush_blockbuf == BB_FULL) || flush_logfile || do_flushall))
-        {
-            /**
-             * buffer is at least half-full
-             * -> write to disk
-             */
-            while (bb->bb_refcount > 0)
-            {
-                simple_mutex_unlock(&bb->bb_mutex);
-                simple_mutex_lock(&bb->bb_mutex, true);
-            }
-            err = skygw_file_write(file,
-                                   (void *)bb->bb_buf,
-                                   bb->bb_buf_used,
-                                   (flush_logfile || do_flushall));
-            if (err)
-            {
-                // TODO: Log this to syslog.
-                char errbuf[MXS_STRERROR_BUFLEN];
-                LOG_ERROR("MaxScale Log: Error, writing to the log-file %s failed due to %d, %s. "
-                          "Disabling writing to the log.\n",
-                          lf->lf_full_file_name, err, strerror_r(err, errbuf, sizeof(errbuf)));
-
-                mxs_log_set_maxlog_enabled(false);
-            }
-            /**
-             * Reset buffer's counters and mark
-             * not full.
-             */
-            bb->bb_buf_left = bb->bb_buf_size;
-            bb->bb_buf_used = 0;
-            memset(bb->bb_buf, 0, bb->bb_buf_size);
-            bb->bb_state = BB_CLEARED;
-#if defined(SS_LOG_DEBUG)
-            sprintf(bb->bb_buf, "[block:%d]", atomic_add(&block_start_index, 1));
-            bb->bb_buf_used += strlen(bb->bb_buf);
-            bb->bb_buf_left -= strlen(bb->bb_buf);
-#endif
-
-        }
-        /** Release lock to block buffer */
-        simple_mutex_unlock(&bb->bb_mutex);
-
-        size_t vn1;
-        size_t vn2;
-        /** Consistent lock-free read on the list */
-        do
-        {
-            while ((vn1 = bb_list->mlist_versno) % 2 != 0)
-            {
-                continue;
-            }
-            node = node->mlnode_next;
-            vn2 = bb_list->mlist_versno;
-        }
-        while (vn1 != vn2 && node);
-
-    } /* while (node != NULL) */
+    thr_drain_rings(fwr, lf, flush_logfile || do_flushall);
+    log_rings_free_closed();
 
     /**
      * Writer's exit flag was set after checking it.
@@ -2267,7 +2059,7 @@ static bool thr_flush_file(logmanager_t *lm, filewriter_t *fwr)
 }
 
 /**
- * @node Writes block buffers of logfiles to physical log files on disk.
+ * @node Writes the records of the log rings to the physical log file on disk.
  *
  * Parameters:
  * @param data - thread context, skygw_thread_t
@@ -2276,38 +2068,30 @@ static bool thr_flush_file(logmanager_t *lm, filewriter_t *fwr)
  * @return
  *
  *
- * @details Waits until receives wake-up message. Scans through block buffer
- * lists of each logfile object.
- *
- * Block buffer is written to log file if
- * 1. bb_state == true,
- * 2. logfile object's lf_flushflag == true, or
- * 3. skygw_thread_must_exit returns true.
- *
- * Log file is flushed (fsync'd) in cases #2 and #3.
- *
- * Concurrency control : block buffer is accessed by file writer (this) and
- * log clients. File writer reads and sets each logfile object's flushflag
- * with spinlock. Another protected section is when block buffer's metadata is
- * read, and optionally the write operation.
- *
- * When block buffer is marked full, logfile's flushflag is set, other
- * log clients don't try to access buffer(s). There may, however, be
- * active writes, on the block in parallel with file writer operations.
- * Each active write corresponds to bb_refcounter values.
- * On the other hand, file writer doesn't process the block buffer before
- * its refcount is zero.
- *
- * Every log file obj. has its own block buffer (linked) list.
- * List is accessed by log clients, which add nodes if necessary, and
- * by file writer which traverses the list and accesses block buffers
- * included in list nodes.
- * List modifications are protected with version numbers.
- * Before
- modification, version is increased by one to be odd. After the
- * completion, it is increased again to even. List can be read only when
- * version is even and read is consistent only if version hasn't changed
- * during the read.
+ * @details Waits until receives wake-up message. Merges the records of the
+ * per-thread log rings in timestamp order and writes them to the log file.
+ *
+ * A logging thread wakes the file writer up if
+ * 1. the message must be flushed (errors and worse),
+ * 2. its ring is at least half full, or
+ * 3. its ring is full, in which case it waits until there is room.
+ *
+ * The log file is flushed (fsync'd) if the logfile object's lf_flushflag
+ * is set or if skygw_thread_must_exit returns true.
+ *
+ * Concurrency control : each ring has a single producer, the thread owning
+ * it, and a single consumer, this thread. The producer only moves the head
+ * of the ring and the consumer only moves the tail, with memory barriers
+ * between accessing the records and publishing the new position, so no
+ * locks are needed. The registry of the rings is protected by a spinlock,
+ * but it is only taken when a thread logs for the first time and once per
+ * round by the file writer.
+ *
+ * Records are ordered by the monotonic time at which they were made. Since
+ * a round only sees the records published when it starts, a record made just
+ * before a round starts but published just after it may be written after
+ * younger records of other threads. The records of one thread are always
+ * written in the order they were made.
  */
 static void* thr_filewriter_fun(void* data)
 {
@@ -2318,6 +2102,7 @@ static void* thr_filewriter_fun(void* data)
 
     CHK_FILEWRITER(fwr);
     ss_debug(skygw_thread_set_state(thr, THR_RUNNING));
+    this_is_filewriter = true;
 
     /** Inform log manager about the state. */
     skygw_message_send(fwr->fwr_clientmes);
@@ -2768,6 +2553,52 @@ typedef enum message_suppression
     MESSAGE_STILL_SUPPRESSED  // Message is still suppressed (for this round)
 } message_suppression_t;
 
+/**
+ * Get the throttling statistics of a message for the calling thread.
+ *
+ * @param lt   The logging state of the thread
+ * @param file The file where the message was logged
+ * @param line The line where the message was logged
+ *
+ * @return The statistics or NULL if the table of the thread is full.
+ */
+static LM_MESSAGE_STATS* message_stats_get(log_thread_t* lt, const char* file, int line)
+{
+    LM_MESSAGE_KEY key = { file, line };
+    uint32_t start = (uint32_t)lm_message_key_hash(&key) % LM_MESSAGE_HASH_SIZE;
+
+    for (int i = 0; i < LM_MESSAGE_HASH_SIZE; ++i)
+    {
+        LM_MESSAGE_SLOT* slot = &lt->lt_stats[(start + i) % LM_MESSAGE_HASH_SIZE];
+
+        if (slot->key.filename == NULL)
+        {
+            slot->key = key;
+            slot->stats.first_ms = time_monotonic_ms();
+            slot->stats.last_ms = 0;
+            slot->stats.count = 0;
+            return &slot->stats;
+        }
+        else if (slot->key.filename == file && slot->key.linenumber == line)
+        {
+            return &slot->stats;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Check whether a message should be suppressed.
+ *
+ * The statistics are kept per thread, so a message is throttled when one
+ * thread logs it too often.
+ *
+ * @param file The file where the message was logged
+ * @param line The line where the message was logged
+ *
+ * @return Whether the message should be suppressed
+ */
 static message_suppression_t message_status(const char* file, int line)
 {
     message_suppression_t rv = MESSAGE_NOT_SUPPRESSED;
@@ -2776,43 +2607,18 @@ static message_suppression_t message_status(const char* file, int line)
     // them. It does not matter if they are changed just when we are copying
     // them, but we want to use one set of values throughout the function.
     MXS_LOG_THROTTLING t = log_config.throttling;
+    log_thread_t* lt;
 
-    if ((t.count != 0) && (t.window_ms != 0) && (t.suppress_ms != 0))
+    if ((t.count != 0) && (t.window_ms != 0) && (t.suppress_ms != 0) &&
+        (lt = log_thread_get()) != NULL)
     {
-        LM_MESSAGE_KEY key = { file, line };
-        LM_MESSAGE_STATS *value;
-
-        errno = 0;
-
-        // Since the hashtable can not be externally locked, the lookup/creation
-        // must be done in a loop to ensure that everything works even if two
-        // threads logs the same message at the very same time.
-        do
-        {
-            value = (LM_MESSAGE_STATS*) hashtable_fetch(message_stats, &key);
-
-            if (!value)
-            {
-                LM_MESSAGE_STATS stats;
-                spinlock_init(&stats.lock);
-                stats.first_ms = time_monotonic_ms();
-                stats.last_ms = 0;
-                stats.count = 0;
-
-                // hashtable_add may fail for two reasons; the key exists
-                // already or it runs out of memory. In the latter case
-                // errno is set.
-                hashtable_add(message_stats, &key, &stats);
-            }
-        }
-        while (!value && (errno == 0));
+        // If the table is full, the message is not throttled.
+        LM_MESSAGE_STATS *value = message_stats_get(lt, file, line);
 
         if (value)
         {
             uint64_t now_ms = time_monotonic_ms();
 
-            spinlock_acquire(&value->lock);
-
             ++value->count;
 
             // Less that t.window_ms milliseconds since the message was logged
@@ -2864,8 +2670,6 @@ static message_suppression_t message_status(const char* file, int line)
             }
 
             value->last_ms = now_ms;
-
-            spinlock_release(&value->lock);
         }
     }
 
@@ -37,13 +37,39 @@ struct mxs_filter_def
     struct mxs_filter_def *next;  /**< Next filter in the chain of all filters */
 };
 
+/**
+ * A filter of a compiled filter chain
+ */
+typedef struct filter_chain_entry
+{
+    MXS_FILTER_DEF    *filter;   /**< The filter definition */
+    MXS_FILTER        *instance; /**< The filter instance */
+    MXS_FILTER_OBJECT *obj;      /**< The entry points of the filter */
+    /** The entry point for queries, NULL if the filter does not see them */
+    int32_t (*routeQuery)(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue);
+    /** The entry point for replies, NULL if the filter does not see them */
+    int32_t (*clientReply)(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue);
+} FILTER_CHAIN_ENTRY;
+
+/**
+ * The filter chain of a service, compiled when the filters of the service
+ * are set. The sessions of the service create their filter sessions from it.
+ */
+typedef struct filter_chain
+{
+    int                 n_filters;    /**< Number of filters */
+    int                 n_downstream; /**< Number of filters that see the queries */
+    int                 n_upstream;   /**< Number of filters that see the replies */
+    FILTER_CHAIN_ENTRY *filters;      /**< The filters, allocated with the chain */
+} FILTER_CHAIN;
+
 void filter_add_option(MXS_FILTER_DEF *filter_def, const char *option);
 void filter_add_parameter(MXS_FILTER_DEF *filter_def, const char *name, const char *value);
 MXS_FILTER_DEF *filter_alloc(const char *name, const char *module_name);
-MXS_DOWNSTREAM *filter_apply(MXS_FILTER_DEF *filter_def, MXS_SESSION *session, MXS_DOWNSTREAM *downstream);
+FILTER_CHAIN *filter_chain_compile(MXS_FILTER_DEF **filters, int n_filters);
+void filter_chain_free(FILTER_CHAIN *chain);
 void filter_free(MXS_FILTER_DEF *filter_def);
 bool filter_load(MXS_FILTER_DEF *filter_def);
 int filter_standard_parameter(const char *name);
-MXS_UPSTREAM *filter_upstream(MXS_FILTER_DEF *filter_def, void *fsession, MXS_UPSTREAM *upstream);
 
 MXS_END_DECLS
@@ -0,0 +1,163 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file core/maxscale/latency.h - The private latency interface
+ */
+
+#include <maxscale/latency.h>
+#include <maxscale/dcb.h>
+#include <maxscale/prometheus.h>
+#include <maxscale/resultset.h>
+#include <maxscale/session.h>
+
+MXS_BEGIN_DECLS
+
+/**
+ * Number of sub-buckets per power of two in the histograms. The value of a
+ * measurement is known to within 1/8th of its magnitude.
+ */
+#define LATENCY_SUB_BITS     3
+#define LATENCY_SUB_BUCKETS  (1 << LATENCY_SUB_BITS)
+
+/** Highest power of two, in nanoseconds, with buckets of its own */
+#define LATENCY_MAX_EXP      42
+
+#define LATENCY_HIST_BUCKETS ((LATENCY_MAX_EXP - LATENCY_SUB_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+/**
+ * A merged view of the histograms of one stage, the times are in microseconds
+ */
+typedef struct latency_summary
+{
+    uint64_t count;
+    double   avg;
+    double   p50;
+    double   p99;
+    double   p999;
+    double   max;
+} LATENCY_SUMMARY;
+
+/**
+ * Mark that a statement reaches the router
+ *
+ * @param session The session
+ */
+void latency_router_begin(MXS_SESSION *session);
+
+/**
+ * Mark that the router has returned
+ *
+ * @param session The session
+ */
+void latency_router_end(MXS_SESSION *session);
+
+/**
+ * Mark that a reply is written to the client
+ *
+ * @param session The session
+ */
+void latency_client_reply(MXS_SESSION *session);
+
+/**
+ * Decide whether the statements of a new session are traced
+ *
+ * @return True if the session should be traced
+ */
+bool latency_trace_session();
+
+/**
+ * Get the histogram bucket of a value
+ *
+ * @param ns Value in nanoseconds
+ *
+ * @return The bucket index
+ */
+int latency_bucket(uint64_t ns);
+
+/**
+ * Get the highest value of a histogram bucket
+ *
+ * @param bucket The bucket index
+ *
+ * @return Highest value of the bucket in nanoseconds
+ */
+uint64_t latency_bucket_upper(int bucket);
+
+/**
+ * Merge the histograms of all threads
+ *
+ * @param stats   The histograms of a service or a server, may be NULL
+ * @param stage   The stage to merge
+ * @param summary The summary is stored here
+ */
+void latency_stats_summary(struct latency_stats *stats, latency_stage_t stage,
+                           LATENCY_SUMMARY *summary);
+
+/**
+ * Print the summaries of a range of stages
+ *
+ * @param dcb   The DCB to print to
+ * @param name  Name of the service or server
+ * @param stats The histograms of the service or the server
+ * @param first The first stage to print
+ * @param last  The last stage to print
+ */
+void latency_stats_print(DCB *dcb, const char *name, struct latency_stats *stats,
+                         latency_stage_t first, latency_stage_t last);
+
+/**
+ * Add the summaries of a range of stages to Prometheus metrics
+ *
+ * The times are converted into seconds and each stage gets the label @c stage.
+ *
+ * @param out    The output
+ * @param name   Name of the metric
+ * @param labels Labels identifying the service or the server
+ * @param stats  The histograms of the service or the server
+ * @param first  The first stage to add
+ * @param last   The last stage to add
+ */
+void latency_stats_collect(PROMETHEUS_OUTPUT *out, const char *name, const char *labels,
+                           struct latency_stats *stats, latency_stage_t first,
+                           latency_stage_t last);
+
+/**
+ * Add the columns of a latency result set
+ *
+ * @param set The result set
+ */
+void latency_add_columns(RESULTSET *set);
+
+/**
+ * Create a result set row of the summary of one stage
+ *
+ * @param set   The result set
+ * @param name  Name of the service or server
+ * @param stats The histograms of the service or the server
+ * @param stage The stage
+ *
+ * @return The row or NULL on memory allocation failure
+ */
+RESULT_ROW* latency_make_row(RESULTSET *set, const char *name,
+                             struct latency_stats *stats, latency_stage_t stage);
+
+/**
+ * Free the histograms of a service or a server
+ *
+ * @param stats The histograms, may be NULL
+ */
+void latency_stats_free(struct latency_stats *stats);
+
+MXS_END_DECLS
@@ -0,0 +1,50 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file
+ *
+ * Internal code for the registry of metrics.
+ */
+
+#include <maxscale/metrics.h>
+#include <maxscale/prometheus.h>
+
+MXS_BEGIN_DECLS
+
+/**
+ * @brief Make the calling thread update the values of a worker thread
+ *
+ * This is called by each worker thread when it starts.
+ *
+ * @param thread_id ID of the worker thread
+ */
+void metrics_thread_init(int thread_id);
+
+/**
+ * @brief Add all instruments to Prometheus output
+ *
+ * @param out  The output
+ * @param data Not used
+ */
+void metrics_collect(PROMETHEUS_OUTPUT *out, void *data);
+
+/**
+ * @brief Free the registry
+ *
+ * This should be called after all threads have stopped.
+ */
+void metrics_end();
+
+MXS_END_DECLS
@@ -17,6 +17,7 @@
  */
 
 #include <maxscale/monitor.h>
+#include <maxscale/prometheus.h>
 
 MXS_BEGIN_DECLS
 
@@ -52,6 +53,7 @@ void monitorShow(DCB *, MXS_MONITOR *);
 void monitorShowAll(DCB *);
 
 void monitorList(DCB *);
+void monitorCollectMetrics(PROMETHEUS_OUTPUT *out, void *data);
 RESULTSET *monitorGetList();
 
 bool monitorAddServer(MXS_MONITOR *mon, SERVER *server);
@@ -17,6 +17,7 @@
  */
 
 #include <maxscale/poll.h>
+#include <maxscale/platform.h>
 
 #include <maxscale/resultset.h>
 
@@ -45,6 +46,17 @@ enum poll_message
     POLL_MSG_CLEAN_PERSISTENT = 0x01
 };
 
+/** The ID of the current worker thread */
+extern thread_local int current_thread_id;
+
+/**
+ * Check whether the calling thread is a worker thread
+ *
+ * @param thread_id The ID of the worker thread
+ * @return True if called from the worker thread with the given ID
+ */
+bool poll_is_worker(int thread_id);
+
 void            poll_init();
 void            poll_shutdown();
 
@@ -15,23 +15,18 @@
 /**
  * @file
  *
- * Internal code for the statistics system.
+ * Internal code for the Prometheus metrics.
  */
 
-#include <maxscale/statistics.h>
+#include <maxscale/prometheus.h>
 
 MXS_BEGIN_DECLS
 
 /**
- * @brief Initialize statistics system
+ * @brief Add the collectors of the MaxScale core
  *
- * This function should only be called once by the MaxScale core.
+ * This should be called once by the main initialization code.
  */
-void ts_stats_init();
-
-/**
- * @brief Terminate statistics system
- */
-void ts_stats_end();
+void prometheus_init();
 
 MXS_END_DECLS
@@ -0,0 +1,141 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file core/maxscale/registry.h - Lock-free name indexes of the global objects
+ *
+ * The servers, services, filters and monitors are kept in global lists that are
+ * protected by spinlocks. Each list also has a registry that maps the names of
+ * the objects to the objects. The index of a registry is never modified: when
+ * the list changes, the writer builds a new index while holding the lock of the
+ * list and publishes it with an atomic store. Readers look up names from the
+ * published index without taking any locks.
+ *
+ * The indexes are built once all objects of the configuration have been
+ * created, when registry_start() is called before the worker threads start.
+ * Until then the lookups search the lists. An index that is replaced after
+ * that is freed once every worker thread has processed a message posted after
+ * the replacement, as a worker does not look up names between processing
+ * events and messages. Once registry_start() has been called, the names
+ * must therefore only be looked up from the worker threads.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <maxscale/spinlock.h>
+
+MXS_BEGIN_DECLS
+
+typedef struct registry_index REGISTRY_INDEX;
+
+/**
+ * Iterate over the objects of a list
+ *
+ * @param object The previous object or NULL for the first object
+ * @param name   Set to the name of the returned object
+ * @return The next object or NULL at the end of the list
+ */
+typedef void* (*registry_iterator_t)(void *object, const char **name);
+
+typedef struct registry
+{
+    REGISTRY_INDEX     *current; /**< The published index */
+    registry_iterator_t iterate; /**< Iterates over the list the index is built from */
+    SPINLOCK           *lock;    /**< Lock of the list */
+    struct registry    *next;    /**< Next registry that is built by registry_start() */
+    bool                listed;  /**< Whether registry_start() builds the registry */
+} REGISTRY;
+
+#define REGISTRY_INIT(iterate, lock) {NULL, iterate, lock, NULL, false}
+
+/**
+ * @brief Allocate an index
+ *
+ * @param count Number of objects that will be added to the index
+ * @return New index or NULL on memory allocation failure
+ */
+REGISTRY_INDEX* registry_index_alloc(size_t count);
+
+/**
+ * @brief Add an object to an index that has not been published
+ *
+ * @param index  The index
+ * @param name   Name of the object, the name is copied
+ * @param object The object
+ * @return True if the object was added
+ */
+bool registry_index_add(REGISTRY_INDEX *index, const char *name, void *object);
+
+/**
+ * @brief Free an index that has not been published
+ *
+ * @param index The index to free
+ */
+void registry_index_free(REGISTRY_INDEX *index);
+
+/**
+ * @brief Publish a new index
+ *
+ * The calls to this function must be serialized, normally by holding the lock
+ * of the list from which the index was built. If @c index is NULL, no index is
+ * published and the lookups fall back to the list.
+ *
+ * @param registry The registry
+ * @param index    The new index or NULL
+ * @return The replaced index, the caller must free it once no reader uses it
+ */
+REGISTRY_INDEX* registry_publish(REGISTRY *registry, REGISTRY_INDEX *index);
+
+/**
+ * @brief Rebuild the index after the list has changed
+ *
+ * Must be called with the lock of the list held. Before registry_start() is
+ * called, this only marks the registry to be built by it. After that, a new
+ * index is built from the list and published and the replaced index is freed
+ * once the worker threads no longer use it.
+ *
+ * @param registry The registry
+ */
+void registry_update(REGISTRY *registry);
+
+/**
+ * @brief Build the indexes of all registries
+ *
+ * Called once after the configuration has been loaded and before the worker
+ * threads are started.
+ */
+void registry_start();
+
+/**
+ * @brief Look up an object by name
+ *
+ * @param registry The registry
+ * @param name     Name of the object
+ * @param object   The object or NULL if the name was not found
+ * @return True if an index was published and the lookup was done, false
+ *         if the caller must search the list instead
+ */
+bool registry_find(REGISTRY *registry, const char *name, void **object);
+
+/**
+ * @brief Free the published index
+ *
+ * Must only be called when no other thread uses the registry.
+ *
+ * @param registry The registry
+ */
+void registry_clear(REGISTRY *registry);
+
+MXS_END_DECLS
@@ -0,0 +1,46 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file core/maxscale/resolver.h - The private host name resolver interface
+ */
+
+#include <maxscale/resolver.h>
+
+MXS_BEGIN_DECLS
+
+#define DEFAULT_DNS_CACHE_TTL 60 /**< Default lifetime of cached addresses in seconds */
+
+/**
+ * @brief Start the resolver thread
+ *
+ * Returns once the hosts queued with resolver_prefetch() have been resolved.
+ *
+ * @return True if the resolver thread was started
+ */
+bool resolver_init();
+
+/**
+ * @brief Signal the resolver thread to stop
+ */
+void resolver_shutdown();
+
+/**
+ * @brief Wait for the resolver thread to stop
+ *
+ * Should only be called after resolver_shutdown() has been called.
+ */
+void resolver_finish();
+
+MXS_END_DECLS
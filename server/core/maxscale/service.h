@@ -12,6 +12,7 @@
  * Public License.
  */
 
+#include <maxscale/prometheus.h>
 #include <maxscale/service.h>
 
 MXS_BEGIN_DECLS
@@ -135,4 +136,9 @@ void service_add_parameters(SERVICE *service, const MXS_CONFIG_PARAMETER *param)
 void       printService(SERVICE *service);
 void       printAllServices(void);
 
+/**
+ * Metrics of the services, a Prometheus collector
+ */
+void       serviceCollectMetrics(PROMETHEUS_OUTPUT *out, void *data);
+
 MXS_END_DECLS
@@ -0,0 +1,118 @@
+#pragma once
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file core/maxscale/worker_queue.h - Cross-thread message queue of a worker
+ *
+ * A worker queue is a lock-free multi-producer, single-consumer queue. Any
+ * thread may post messages to it but only the owning worker takes them out.
+ * The consumer is woken up through an eventfd which the owner adds to its
+ * epoll instance.
+ */
+
+#include <maxscale/cdefs.h>
+#include <stdbool.h>
+
+MXS_BEGIN_DECLS
+
+struct worker_msg;
+
+/**
+ * Message handler. Called by the consumer, the handler owns the message.
+ */
+typedef void (*worker_msg_handler_t)(int thread_id, struct worker_msg *msg);
+
+/**
+ * A message header. Messages embed this as their first member.
+ */
+typedef struct worker_msg
+{
+    struct worker_msg   *next;    /**< Next message in the queue */
+    worker_msg_handler_t handler; /**< Function that processes the message */
+} WORKER_MSG;
+
+typedef struct worker_queue
+{
+    WORKER_MSG *volatile head; /**< Posted messages, the newest first */
+    int                  fd;   /**< The eventfd used to wake up the consumer */
+} WORKER_QUEUE;
+
+/**
+ * Initialize a worker queue
+ *
+ * @param queue Queue to initialize
+ *
+ * @return True if the eventfd of the queue was created
+ */
+bool worker_queue_init(WORKER_QUEUE *queue);
+
+/**
+ * Close the eventfd of a queue. The queue must be empty.
+ *
+ * @param queue Queue to destroy
+ */
+void worker_queue_destroy(WORKER_QUEUE *queue);
+
+/**
+ * Post a message to a queue
+ *
+ * The eventfd of the queue is signaled if the queue was empty.
+ *
+ * @param queue   Queue to post to
+ * @param msg     Message to post
+ * @param handler The function the consumer calls for the message
+ */
+void worker_queue_post(WORKER_QUEUE *queue, WORKER_MSG *msg, worker_msg_handler_t handler);
+
+/**
+ * Wake up the consumer without posting a message
+ *
+ * @param queue Queue whose consumer to wake
+ */
+void worker_queue_wake(WORKER_QUEUE *queue);
+
+/**
+ * Take all messages out of a queue
+ *
+ * Also clears the eventfd of the queue. Only the consumer may call this.
+ *
+ * @param queue Queue to take the messages from
+ *
+ * @return The messages in the order they were posted, NULL if the queue was empty
+ */
+WORKER_MSG* worker_queue_take(WORKER_QUEUE *queue);
+
+/**
+ * Take all messages out of a queue and call their handlers
+ *
+ * @param queue     Queue to process
+ * @param thread_id The ID of the calling thread, passed to the handlers
+ *
+ * @return Number of messages processed
+ */
+int worker_queue_process(WORKER_QUEUE *queue, int thread_id);
+
+/**
+ * Check whether a queue has messages. The result is a dirty read.
+ *
+ * @param queue Queue to check
+ *
+ * @return True if messages are waiting
+ */
+static inline bool worker_queue_pending(const WORKER_QUEUE *queue)
+{
+    return queue->head != NULL;
+}
+
+MXS_END_DECLS
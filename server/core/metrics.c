@@ -0,0 +1,776 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file metrics.c  - The registry of metrics
+ *
+ * The values of the instruments are stored in blocks, one for each worker
+ * thread and one shared by the other threads. A block consists of chunks of
+ * values that are allocated as instruments are created. An instrument has the
+ * same location in every block, which allows the values of one thread to be
+ * packed together without sharing cache lines with other threads.
+ *
+ * The chunks are never freed or moved, the values of freed instruments are
+ * reused by new instruments that need the same number of values.
+ */
+
+#include "maxscale/metrics.h"
+#include <string.h>
+#include <unistd.h>
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+#include <maxscale/config.h>
+#include <maxscale/debug.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/platform.h>
+#include <maxscale/spinlock.h>
+
+/** Number of values in a chunk */
+#define METRICS_CHUNK_VALUES 512
+
+/** Maximum number of chunks in a block */
+#define METRICS_CHUNKS_MAX 256
+
+typedef struct metrics_block
+{
+    int64_t *chunks[METRICS_CHUNKS_MAX]; /**< The chunks, aligned to the cache line */
+    void    *memory[METRICS_CHUNKS_MAX]; /**< The allocated memory of the chunks */
+} METRICS_BLOCK;
+
+typedef struct metric_family
+{
+    char                 *name;     /**< Name of the family */
+    char                 *help;     /**< Description of the family */
+    char                 *module;   /**< The defining module, NULL for the core */
+    mxs_metric_type_t     type;     /**< Type of the family */
+    int64_t               bounds[MXS_METRIC_BOUNDS_MAX]; /**< Bucket bounds of a histogram */
+    int                   n_bounds; /**< Number of bucket bounds */
+    MXS_METRIC           *head;     /**< The instruments in the order of creation */
+    MXS_METRIC           *tail;
+    struct metric_family *next;
+} METRIC_FAMILY;
+
+struct mxs_metric
+{
+    METRIC_FAMILY     *family;   /**< The family of the instrument */
+    char              *labels;   /**< Labels of the instrument */
+    int                chunk;    /**< The chunk where the values are */
+    int                offset;   /**< Offset of the first value in the chunk */
+    int                n_values; /**< Number of values */
+    struct mxs_metric *next;
+};
+
+/** A range of values of a freed instrument */
+typedef struct metrics_range
+{
+    int                   chunk;
+    int                   offset;
+    int                   n_values;
+    struct metrics_range *next;
+} METRICS_RANGE;
+
+static SPINLOCK        metrics_lock = SPINLOCK_INIT;
+static bool            metrics_initialized = false;
+static int             n_blocks = 0;      /**< Number of worker threads plus one */
+static METRICS_BLOCK  *blocks = NULL;
+static int             n_chunks = 0;      /**< Number of allocated chunks in each block */
+static int             next_offset = METRICS_CHUNK_VALUES; /**< Next free value of the last chunk */
+static METRICS_RANGE  *free_ranges = NULL;
+static METRIC_FAMILY  *families = NULL;
+
+/** Lock of the set and set_max operations of the shared block */
+static SPINLOCK        shared_lock = SPINLOCK_INIT;
+
+/** The block of the calling thread, the shared block for threads that are not workers */
+static thread_local int metrics_thread_id = -1;
+
+static const char* type_names[] =
+{
+    "counter",
+    "gauge",
+    "max",
+    "histogram"
+};
+
+/**
+ * Initialize the registry, the caller must hold metrics_lock
+ *
+ * The objects created from the configuration file create their instruments
+ * before the worker threads are started, which is why this is done on the
+ * first use. The number of threads is known at that point.
+ *
+ * @return True if the registry is initialized
+ */
+static bool metrics_init()
+{
+    if (!metrics_initialized)
+    {
+        int n = config_threadcount() + 1;
+
+        if ((blocks = MXS_CALLOC(n, sizeof(METRICS_BLOCK))) == NULL)
+        {
+            return false;
+        }
+
+        n_blocks = n;
+        metrics_initialized = true;
+    }
+
+    return true;
+}
+
+void metrics_thread_init(int thread_id)
+{
+    ss_dassert(thread_id >= 0 && thread_id < config_threadcount());
+    metrics_thread_id = thread_id;
+}
+
+static size_t get_cache_line_size()
+{
+    long rval = 64;
+
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+    long size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+
+    if (size > 0)
+    {
+        rval = size;
+    }
+#endif
+
+    return rval;
+}
+
+/**
+ * Allocate a new chunk into every block, the caller must hold metrics_lock
+ *
+ * @return True if the chunk was allocated
+ */
+static bool add_chunk()
+{
+    if (n_chunks == METRICS_CHUNKS_MAX)
+    {
+        MXS_ERROR("The maximum number of metrics has been reached.");
+        return false;
+    }
+
+    size_t line = get_cache_line_size();
+    size_t size = METRICS_CHUNK_VALUES * sizeof(int64_t) + line;
+    int i;
+
+    for (i = 0; i < n_blocks; i++)
+    {
+        void *memory = MXS_CALLOC(1, size);
+
+        if (memory == NULL)
+        {
+            break;
+        }
+
+        /** Align the start of the chunk so that the chunks of different
+         * threads never share a cache line */
+        uintptr_t start = ((uintptr_t)memory + line - 1) / line * line;
+        blocks[i].memory[n_chunks] = memory;
+        blocks[i].chunks[n_chunks] = (int64_t*)start;
+    }
+
+    if (i < n_blocks)
+    {
+        while (--i >= 0)
+        {
+            MXS_FREE(blocks[i].memory[n_chunks]);
+            blocks[i].memory[n_chunks] = NULL;
+            blocks[i].chunks[n_chunks] = NULL;
+        }
+
+        return false;
+    }
+
+    n_chunks++;
+    next_offset = 0;
+    return true;
+}
+
+/**
+ * Allocate values for an instrument, the caller must hold metrics_lock
+ *
+ * @param metric The instrument, @c n_values must be set
+ *
+ * @return True if the values were allocated
+ */
+static bool alloc_values(MXS_METRIC *metric)
+{
+    for (METRICS_RANGE **ptr = &free_ranges; *ptr; ptr = &(*ptr)->next)
+    {
+        METRICS_RANGE *range = *ptr;
+
+        if (range->n_values == metric->n_values)
+        {
+            metric->chunk = range->chunk;
+            metric->offset = range->offset;
+            *ptr = range->next;
+            MXS_FREE(range);
+
+            for (int i = 0; i < n_blocks; i++)
+            {
+                memset(blocks[i].chunks[metric->chunk] + metric->offset, 0,
+                       metric->n_values * sizeof(int64_t));
+            }
+
+            return true;
+        }
+    }
+
+    /** The values of an instrument are always in the same chunk */
+    if (next_offset + metric->n_values > METRICS_CHUNK_VALUES && !add_chunk())
+    {
+        return false;
+    }
+
+    metric->chunk = n_chunks - 1;
+    metric->offset = next_offset;
+    next_offset += metric->n_values;
+    return true;
+}
+
+/**
+ * Find a family, the caller must hold metrics_lock
+ *
+ * @param name Name of the family
+ *
+ * @return The family or NULL if it does not exist
+ */
+static METRIC_FAMILY* find_family(const char *name)
+{
+    METRIC_FAMILY *family = families;
+
+    while (family && strcmp(family->name, name) != 0)
+    {
+        family = family->next;
+    }
+
+    return family;
+}
+
+static void free_family(METRIC_FAMILY *family)
+{
+    if (family)
+    {
+        MXS_FREE(family->name);
+        MXS_FREE(family->help);
+        MXS_FREE(family->module);
+        MXS_FREE(family);
+    }
+}
+
+bool mxs_metric_define(const char *module, const MXS_METRIC_DEF *def)
+{
+    ss_dassert(def->name && def->help);
+
+    if (def->type == MXS_METRIC_HISTOGRAM &&
+        (def->n_bounds < 1 || def->n_bounds > MXS_METRIC_BOUNDS_MAX))
+    {
+        MXS_ERROR("Histogram '%s' must have between 1 and %d buckets bounds.",
+                  def->name, MXS_METRIC_BOUNDS_MAX);
+        return false;
+    }
+
+    for (int i = 1; def->type == MXS_METRIC_HISTOGRAM && i < def->n_bounds; i++)
+    {
+        if (def->bounds[i] <= def->bounds[i - 1])
+        {
+            MXS_ERROR("The bucket bounds of histogram '%s' are not in increasing order.",
+                      def->name);
+            return false;
+        }
+    }
+
+    bool rval = false;
+    spinlock_acquire(&metrics_lock);
+
+    METRIC_FAMILY *family = metrics_init() ? find_family(def->name) : NULL;
+
+    if (family)
+    {
+        if (family->type == def->type)
+        {
+            rval = true;
+        }
+        else
+        {
+            MXS_ERROR("Metric '%s' is already defined as a %s.", def->name,
+                      type_names[family->type]);
+        }
+    }
+    else if (metrics_initialized)
+    {
+        if ((family = MXS_CALLOC(1, sizeof(METRIC_FAMILY))) &&
+            (family->name = MXS_STRDUP(def->name)) &&
+            (family->help = MXS_STRDUP(def->help)) &&
+            (module == NULL || (family->module = MXS_STRDUP(module))))
+        {
+            family->type = def->type;
+
+            if (def->type == MXS_METRIC_HISTOGRAM)
+            {
+                memcpy(family->bounds, def->bounds, def->n_bounds * sizeof(int64_t));
+                family->n_bounds = def->n_bounds;
+            }
+
+            /** Keep the families in the order of definition */
+            METRIC_FAMILY **ptr = &families;
+
+            while (*ptr)
+            {
+                ptr = &(*ptr)->next;
+            }
+
+            *ptr = family;
+            rval = true;
+        }
+        else
+        {
+            free_family(family);
+        }
+    }
+
+    spinlock_release(&metrics_lock);
+    return rval;
+}
+
+MXS_METRIC* mxs_metric_create(const char *name, const char *labels)
+{
+    MXS_METRIC *metric = MXS_CALLOC(1, sizeof(MXS_METRIC));
+
+    if (metric == NULL || (metric->labels = MXS_STRDUP(labels ? labels : "")) == NULL)
+    {
+        MXS_FREE(metric);
+        return NULL;
+    }
+
+    spinlock_acquire(&metrics_lock);
+    METRIC_FAMILY *family = metrics_initialized ? find_family(name) : NULL;
+
+    if (family)
+    {
+        metric->family = family;
+        /** A histogram has the buckets and the sum of the observed values */
+        metric->n_values = family->type == MXS_METRIC_HISTOGRAM ? family->n_bounds + 2 : 1;
+
+        if (alloc_values(metric))
+        {
+            if (family->tail)
+            {
+                family->tail->next = metric;
+            }
+            else
+            {
+                family->head = metric;
+            }
+
+            family->tail = metric;
+        }
+        else
+        {
+            family = NULL;
+        }
+    }
+    else
+    {
+        MXS_ERROR("Metric '%s' has not been defined.", name);
+    }
+
+    spinlock_release(&metrics_lock);
+
+    if (family == NULL)
+    {
+        MXS_FREE(metric->labels);
+        MXS_FREE(metric);
+        metric = NULL;
+    }
+
+    return metric;
+}
+
+void mxs_metric_free(MXS_METRIC *metric)
+{
+    if (metric)
+    {
+        METRICS_RANGE *range = MXS_MALLOC(sizeof(METRICS_RANGE));
+
+        spinlock_acquire(&metrics_lock);
+        METRIC_FAMILY *family = metric->family;
+        MXS_METRIC *prev = NULL;
+
+        for (MXS_METRIC *m = family->head; m; prev = m, m = m->next)
+        {
+            if (m == metric)
+            {
+                if (prev)
+                {
+                    prev->next = m->next;
+                }
+                else
+                {
+                    family->head = m->next;
+                }
+
+                if (family->tail == m)
+                {
+                    family->tail = prev;
+                }
+                break;
+            }
+        }
+
+        /** If the range cannot be stored, the values are not reused */
+        if (range)
+        {
+            range->chunk = metric->chunk;
+            range->offset = metric->offset;
+            range->n_values = metric->n_values;
+            range->next = free_ranges;
+            free_ranges = range;
+        }
+
+        spinlock_release(&metrics_lock);
+
+        MXS_FREE(metric->labels);
+        MXS_FREE(metric);
+    }
+}
+
+/**
+ * Get the values of an instrument in a block
+ *
+ * @param metric The instrument
+ * @param block  Index of the block
+ *
+ * @return The values
+ */
+static inline int64_t* get_values(const MXS_METRIC *metric, int block)
+{
+    return blocks[block].chunks[metric->chunk] + metric->offset;
+}
+
+/**
+ * Get the index of the block of the calling thread
+ *
+ * @return Index of the block
+ */
+static inline int get_block()
+{
+    int id = metrics_thread_id;
+    return id >= 0 ? id : n_blocks - 1;
+}
+
+void mxs_metric_add(MXS_METRIC *metric, int64_t value)
+{
+    ss_dassert(metric->family->type == MXS_METRIC_COUNTER ||
+               metric->family->type == MXS_METRIC_GAUGE);
+    ss_dassert(value >= 0 || metric->family->type == MXS_METRIC_GAUGE);
+    int block = get_block();
+    int64_t *values = get_values(metric, block);
+
+    if (block == n_blocks - 1)
+    {
+        atomic_add_int64(values, value);
+    }
+    else
+    {
+        *values += value;
+    }
+}
+
+void mxs_metric_set(MXS_METRIC *metric, int64_t value)
+{
+    ss_dassert(metric->family->type == MXS_METRIC_GAUGE);
+    int block = get_block();
+    int64_t *values = get_values(metric, block);
+
+    if (block == n_blocks - 1)
+    {
+        spinlock_acquire(&shared_lock);
+        *values = value;
+        spinlock_release(&shared_lock);
+    }
+    else
+    {
+        *values = value;
+    }
+}
+
+void mxs_metric_set_max(MXS_METRIC *metric, int64_t value)
+{
+    ss_dassert(metric->family->type == MXS_METRIC_MAX);
+    int block = get_block();
+    int64_t *values = get_values(metric, block);
+
+    if (value > *values)
+    {
+        if (block == n_blocks - 1)
+        {
+            spinlock_acquire(&shared_lock);
+
+            if (value > *values)
+            {
+                *values = value;
+            }
+
+            spinlock_release(&shared_lock);
+        }
+        else
+        {
+            *values = value;
+        }
+    }
+}
+
+void mxs_metric_observe(MXS_METRIC *metric, int64_t value)
+{
+    METRIC_FAMILY *family = metric->family;
+    ss_dassert(family->type == MXS_METRIC_HISTOGRAM);
+    int block = get_block();
+    int64_t *values = get_values(metric, block);
+    int bucket = 0;
+
+    while (bucket < family->n_bounds && value > family->bounds[bucket])
+    {
+        bucket++;
+    }
+
+    if (block == n_blocks - 1)
+    {
+        atomic_add_int64(&values[bucket], 1);
+        atomic_add_int64(&values[family->n_bounds + 1], value);
+    }
+    else
+    {
+        values[bucket]++;
+        values[family->n_bounds + 1] += value;
+    }
+}
+
+int mxs_metric_get_buckets(const MXS_METRIC *metric, int64_t *buckets, int64_t *sum)
+{
+    METRIC_FAMILY *family = metric->family;
+    ss_dassert(family->type == MXS_METRIC_HISTOGRAM);
+    int n = family->n_bounds + 1;
+    int64_t total = 0;
+
+    memset(buckets, 0, n * sizeof(int64_t));
+
+    for (int i = 0; i < n_blocks; i++)
+    {
+        int64_t *values = get_values(metric, i);
+
+        for (int b = 0; b < n; b++)
+        {
+            buckets[b] += values[b];
+        }
+
+        total += values[n];
+    }
+
+    if (sum)
+    {
+        *sum = total;
+    }
+
+    return n;
+}
+
+int64_t mxs_metric_get(const MXS_METRIC *metric)
+{
+    int64_t rval = 0;
+
+    switch (metric->family->type)
+    {
+    case MXS_METRIC_COUNTER:
+    case MXS_METRIC_GAUGE:
+        for (int i = 0; i < n_blocks; i++)
+        {
+            rval += *get_values(metric, i);
+        }
+        break;
+
+    case MXS_METRIC_MAX:
+        for (int i = 0; i < n_blocks; i++)
+        {
+            int64_t value = *get_values(metric, i);
+
+            if (value > rval)
+            {
+                rval = value;
+            }
+        }
+        break;
+
+    case MXS_METRIC_HISTOGRAM:
+        {
+            int64_t buckets[MXS_METRIC_BOUNDS_MAX + 1];
+            int n = mxs_metric_get_buckets(metric, buckets, NULL);
+
+            for (int b = 0; b < n; b++)
+            {
+                rval += buckets[b];
+            }
+        }
+        break;
+
+    default:
+        ss_dassert(false);
+        break;
+    }
+
+    return rval;
+}
+
+const char* mxs_metric_name(const MXS_METRIC *metric)
+{
+    return metric->family->name;
+}
+
+const char* mxs_metric_labels(const MXS_METRIC *metric)
+{
+    return metric->labels;
+}
+
+mxs_metric_type_t mxs_metric_type(const MXS_METRIC *metric)
+{
+    return metric->family->type;
+}
+
+const char* mxs_metric_type_to_string(mxs_metric_type_t type)
+{
+    ss_dassert(type >= MXS_METRIC_COUNTER && type <= MXS_METRIC_HISTOGRAM);
+    return type_names[type];
+}
+
+void mxs_metric_foreach(bool (*func)(const MXS_METRIC *metric, void *data), void *data)
+{
+    spinlock_acquire(&metrics_lock);
+    bool more = true;
+
+    for (METRIC_FAMILY *family = families; family && more; family = family->next)
+    {
+        for (MXS_METRIC *metric = family->head; metric && more; metric = metric->next)
+        {
+            more = func(metric, data);
+        }
+    }
+
+    spinlock_release(&metrics_lock);
+}
+
+void metrics_collect(PROMETHEUS_OUTPUT *out, void *data)
+{
+    spinlock_acquire(&metrics_lock);
+
+    for (METRIC_FAMILY *family = families; family; family = family->next)
+    {
+        for (MXS_METRIC *metric = family->head; metric; metric = metric->next)
+        {
+            switch (family->type)
+            {
+            case MXS_METRIC_COUNTER:
+                prometheus_sample(out, family->name, PROMETHEUS_COUNTER, family->help,
+                                  metric->labels, mxs_metric_get(metric));
+                break;
+
+            case MXS_METRIC_GAUGE:
+            case MXS_METRIC_MAX:
+                prometheus_sample(out, family->name, PROMETHEUS_GAUGE, family->help,
+                                  metric->labels, mxs_metric_get(metric));
+                break;
+
+            case MXS_METRIC_HISTOGRAM:
+                {
+                    int64_t buckets[MXS_METRIC_BOUNDS_MAX + 1];
+                    uint64_t counts[MXS_METRIC_BOUNDS_MAX + 1];
+                    double bounds[MXS_METRIC_BOUNDS_MAX];
+                    int64_t sum;
+                    int n = mxs_metric_get_buckets(metric, buckets, &sum);
+                    uint64_t count = 0;
+
+                    /** Prometheus buckets are cumulative */
+                    for (int b = 0; b < n; b++)
+                    {
+                        count += buckets[b];
+                        counts[b] = count;
+                    }
+
+                    for (int b = 0; b < family->n_bounds; b++)
+                    {
+                        bounds[b] = family->bounds[b];
+                    }
+
+                    prometheus_histogram(out, family->name, family->help, metric->labels,
+                                         family->n_bounds, bounds, counts, sum);
+                }
+                break;
+
+            default:
+                ss_dassert(false);
+                break;
+            }
+        }
+    }
+
+    spinlock_release(&metrics_lock);
+}
+
+void metrics_end()
+{
+    spinlock_acquire(&metrics_lock);
+
+    while (families)
+    {
+        METRIC_FAMILY *family = families;
+        families = family->next;
+
+        while (family->head)
+        {
+            MXS_METRIC *metric = family->head;
+            family->head = metric->next;
+            MXS_FREE(metric->labels);
+            MXS_FREE(metric);
+        }
+
+        free_family(family);
+    }
+
+    while (free_ranges)
+    {
+        METRICS_RANGE *range = free_ranges;
+        free_ranges = range->next;
+        MXS_FREE(range);
+    }
+
+    for (int i = 0; i < n_blocks; i++)
+    {
+        for (int c = 0; c < n_chunks; c++)
+        {
+            MXS_FREE(blocks[i].memory[c]);
+        }
+    }
+
+    MXS_FREE(blocks);
+    blocks = NULL;
+    n_blocks = 0;
+    n_chunks = 0;
+    next_offset = METRICS_CHUNK_VALUES;
+    metrics_initialized = false;
+
+    spinlock_release(&metrics_lock);
+}
@@ -42,14 +42,18 @@
 #include <maxscale/pcre2.h>
 #include <maxscale/secrets.h>
 #include <maxscale/spinlock.h>
+#include <maxscale/utils.h>
 
 #include "maxscale/config.h"
 #include "maxscale/externcmd.h"
 #include "maxscale/monitor.h"
 #include "maxscale/modules.h"
+#include "maxscale/registry.h"
 
 static MXS_MONITOR  *allMonitors = NULL;
 static SPINLOCK monLock = SPINLOCK_INIT;
+static void* monitor_registry_next(void *object, const char **name);
+static REGISTRY monitor_registry = REGISTRY_INIT(monitor_registry_next, &monLock); /**< Index of the monitors */
 
 static void monitor_server_free_all(MXS_MONITOR_SERVERS *servers);
 
@@ -62,6 +66,18 @@ static unsigned int all_server_bits = SERVER_RUNNING |  SERVER_MAINT |
                                       SERVER_MASTER | SERVER_SLAVE |
                                       SERVER_JOINED | SERVER_NDB;
 
+/** Server bits that are persisted so that the next run can start routing with them */
+static unsigned int persisted_server_bits = SERVER_RUNNING | SERVER_MASTER |
+                                            SERVER_SLAVE | SERVER_JOINED | SERVER_NDB |
+                                            SERVER_SLAVE_OF_EXTERNAL_MASTER |
+                                            SERVER_RELAY_MASTER;
+
+/** Name of the file where the state of the servers of a monitor is persisted */
+static const char SERVER_STATE_FILE[] = "server_state";
+
+static void monitor_load_server_state(MXS_MONITOR *monitor);
+static void monitor_store_server_state(MXS_MONITOR *monitor);
+
 /**
  * Allocate a new monitor, load the associated module for the monitor
  * and start execution on the monitor.
@@ -111,6 +127,7 @@ monitor_alloc(char *name, char *module)
     spinlock_acquire(&monLock);
     mon->next = allMonitors;
     allMonitors = mon;
+    registry_update(&monitor_registry);
     spinlock_release(&monLock);
 
     return mon;
@@ -146,6 +163,7 @@ monitor_free(MXS_MONITOR *mon)
             ptr->next = mon->next;
         }
     }
+    registry_update(&monitor_registry);
     spinlock_release(&monLock);
     config_parameter_free(mon->parameters);
     monitor_server_free_all(mon->databases);
@@ -188,6 +206,7 @@ void monitorStartAll()
     ptr = allMonitors;
     while (ptr)
     {
+        monitor_load_server_state(ptr);
         monitorStart(ptr, ptr->parameters);
         ptr = ptr->next;
     }
@@ -517,6 +536,55 @@ monitorList(DCB *dcb)
     spinlock_release(&monLock);
 }
 
+/**
+ * Add the metrics of all monitors to Prometheus output
+ *
+ * @param out   The output
+ * @param data  Not used
+ */
+void
+monitorCollectMetrics(PROMETHEUS_OUTPUT *out, void *data)
+{
+    spinlock_acquire(&monLock);
+
+    for (MXS_MONITOR *ptr = allMonitors; ptr; ptr = ptr->next)
+    {
+        char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+        prometheus_label(labels, "monitor", ptr->name);
+        prometheus_label(labels, "module", ptr->module_name);
+
+        int servers = 0;
+
+        for (MXS_MONITOR_SERVERS *db = ptr->databases; db; db = db->next)
+        {
+            servers++;
+        }
+
+        prometheus_sample(out, "maxscale_monitor_running", PROMETHEUS_GAUGE,
+                          "Whether the monitor is running", labels,
+                          ptr->state & MONITOR_STATE_RUNNING ? 1 : 0);
+        prometheus_sample(out, "maxscale_monitor_servers", PROMETHEUS_GAUGE,
+                          "Number of servers the monitor monitors", labels, servers);
+        prometheus_sample(out, "maxscale_monitor_interval_seconds", PROMETHEUS_GAUGE,
+                          "The monitor interval in seconds", labels, ptr->interval / 1000.0);
+    }
+
+    spinlock_release(&monLock);
+}
+
+/** Iterate over the monitors for the registry, called with the lock held */
+static void* monitor_registry_next(void *object, const char **name)
+{
+    MXS_MONITOR *monitor = object ? ((MXS_MONITOR*)object)->next : allMonitors;
+
+    if (monitor)
+    {
+        *name = monitor->name;
+    }
+
+    return monitor;
+}
+
 /**
  * Find a monitor by name
  *
@@ -527,6 +595,12 @@ MXS_MONITOR *
 monitor_find(const char *name)
 {
     MXS_MONITOR *ptr;
+    void *found;
+
+    if (registry_find(&monitor_registry, name, &found))
+    {
+        return found;
+    }
 
     spinlock_acquire(&monLock);
     ptr = allMonitors;
@@ -1436,10 +1510,13 @@ void servers_status_current_to_pending(MXS_MONITOR *monitor)
 
 void mon_process_state_changes(MXS_MONITOR *monitor, const char *script, uint64_t events)
 {
+    bool changed = false;
+
     for (MXS_MONITOR_SERVERS *ptr = monitor->databases; ptr; ptr = ptr->next)
     {
         if (mon_status_changed(ptr))
         {
+            changed = true;
             mon_log_state_change(ptr);
 
             if (script && (events & mon_get_event_type(ptr)))
@@ -1448,4 +1525,146 @@ void mon_process_state_changes(MXS_MONITOR *monitor, const char *script, uint64_
             }
         }
     }
+
+    if (changed)
+    {
+        monitor_store_server_state(monitor);
+    }
+}
+
+/**
+ * Get the path to the file where the server state of a monitor is persisted
+ *
+ * @param monitor Monitor
+ * @param dest    Destination buffer of PATH_MAX bytes
+ * @param tmp     Whether the temporary file is wanted
+ */
+static void get_server_state_path(const MXS_MONITOR *monitor, char *dest, bool tmp)
+{
+    snprintf(dest, PATH_MAX, "%s/%s/%s%s", get_datadir(), monitor->name,
+             SERVER_STATE_FILE, tmp ? ".tmp" : "");
+}
+
+/**
+ * Persist the state of the servers of a monitor
+ *
+ * The state is written to a temporary file which is then renamed over the
+ * previous state. The file contains a line with the unique name of the server
+ * and its status bits for each monitored server.
+ *
+ * @param monitor Monitor whose servers are stored
+ */
+static void monitor_store_server_state(MXS_MONITOR *monitor)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s/", get_datadir(), monitor->name);
+
+    if (!mxs_mkdir_all(path, S_IRWXU))
+    {
+        return;
+    }
+
+    char tmp[PATH_MAX];
+    get_server_state_path(monitor, tmp, true);
+    FILE *file = fopen(tmp, "w");
+
+    if (file == NULL)
+    {
+        char err[MXS_STRERROR_BUFLEN];
+        MXS_ERROR("Failed to open file '%s' when storing the server state of monitor '%s': %d, %s",
+                  tmp, monitor->name, errno, strerror_r(errno, err, sizeof(err)));
+        return;
+    }
+
+    for (MXS_MONITOR_SERVERS *ptr = monitor->databases; ptr; ptr = ptr->next)
+    {
+        fprintf(file, "%s %x\n", ptr->server->unique_name,
+                ptr->server->status & persisted_server_bits);
+    }
+
+    bool ok = !ferror(file);
+
+    if (fclose(file) != 0)
+    {
+        ok = false;
+    }
+
+    get_server_state_path(monitor, path, false);
+
+    if (!ok || rename(tmp, path) != 0)
+    {
+        char err[MXS_STRERROR_BUFLEN];
+        MXS_ERROR("Failed to store the server state of monitor '%s' at '%s': %d, %s",
+                  monitor->name, path, errno, strerror_r(errno, err, sizeof(err)));
+        unlink(tmp);
+    }
+}
+
+/**
+ * Load the server state persisted by the previous run
+ *
+ * This allows the routers to use the servers according to their last known
+ * state before the first monitor interval has completed. The monitor then
+ * detects and processes the changes that happened while MaxScale was down.
+ * The maintenance mode and the other bits that are not persisted are kept.
+ *
+ * @param monitor Monitor whose servers are loaded
+ */
+static void monitor_load_server_state(MXS_MONITOR *monitor)
+{
+    char path[PATH_MAX];
+    get_server_state_path(monitor, path, false);
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        if (errno != ENOENT)
+        {
+            char err[MXS_STRERROR_BUFLEN];
+            MXS_ERROR("Failed to open file '%s' when loading the server state of monitor '%s': %d, %s",
+                      path, monitor->name, errno, strerror_r(errno, err, sizeof(err)));
+        }
+        return;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    int loaded = 0;
+
+    while (getline(&line, &size, file) != -1)
+    {
+        char *saveptr;
+        char *name = strtok_r(line, " \n", &saveptr);
+        char *bits = strtok_r(NULL, " \n", &saveptr);
+
+        if (name == NULL || bits == NULL)
+        {
+            continue;
+        }
+
+        unsigned int status = strtoul(bits, NULL, 16) & persisted_server_bits;
+
+        for (MXS_MONITOR_SERVERS *ptr = monitor->databases; ptr; ptr = ptr->next)
+        {
+            if (strcmp(ptr->server->unique_name, name) == 0)
+            {
+                SERVER *server = ptr->server;
+                spinlock_acquire(&server->lock);
+                server->status = (server->status & ~persisted_server_bits) | status;
+                server->status_pending = server->status;
+                spinlock_release(&server->lock);
+                loaded++;
+                break;
+            }
+        }
+    }
+
+    free(line);
+    fclose(file);
+
+    if (loaded > 0)
+    {
+        MXS_NOTICE("Loaded the state of %d servers of monitor '%s' stored by the previous run.",
+                   loaded, monitor->name);
+    }
 }
@@ -30,16 +30,19 @@
 #include <maxscale/dcb.h>
 #include <maxscale/housekeeper.h>
 #include <maxscale/log_manager.h>
+#include <maxscale/metrics.h>
 #include <maxscale/platform.h>
 #include <maxscale/query_classifier.h>
 #include <maxscale/resultset.h>
+#include <maxscale/semaphore.h>
 #include <maxscale/server.h>
 #include <maxscale/session.h>
-#include <maxscale/statistics.h>
 #include <maxscale/thread.h>
 #include <maxscale/utils.h>
 
+#include "maxscale/metrics.h"
 #include "maxscale/poll.h"
+#include "maxscale/worker_queue.h"
 
 #define         PROFILE_POLL    0
 
@@ -88,23 +91,38 @@ static thread_local DCB* current_dcb;
 /** Fake epoll event struct */
 typedef struct fake_event
 {
+    WORKER_MSG         msg;   /*< The message header */
     DCB               *dcb;   /*< The DCB where this event was generated */
     GWBUF             *data;  /*< Fake data, placed in the DCB's read queue */
     uint32_t           event; /*< The EPOLL event type */
-    struct fake_event *tail;  /*< The last event */
-    struct fake_event *next;  /*< The next event */
 } fake_event_t;
 
+/** A function call posted with poll_post_task */
+typedef struct poll_task
+{
+    WORKER_MSG         msg;   /*< The message header */
+    void             (*task)(void *data); /*< The function to call */
+    void              *data;  /*< Argument of the function */
+} poll_task_t;
+
+/** A message sent to all threads with poll_send_message */
+typedef struct poll_broadcast
+{
+    WORKER_MSG         msg;     /*< The message header */
+    enum poll_message  type;    /*< The message type */
+    void              *data;    /*< The message data */
+    int               *pending; /*< Number of threads that have not yet processed the message */
+    sem_t             *done;    /*< Posted when the last thread has processed the message */
+} poll_broadcast_t;
+
 thread_local int current_thread_id; /**< This thread's ID */
+static thread_local bool is_worker; /**< Whether this thread is a worker thread */
 static int *epoll_fd;    /*< The epoll file descriptor */
 static int next_epoll_fd = 0; /*< Which thread handles the next DCB */
-static fake_event_t **fake_events; /*< Thread-specific fake event queue */
-static SPINLOCK      *fake_event_lock;
+static WORKER_QUEUE *msg_queues; /*< Thread-specific cross-thread message queues */
 static int do_shutdown = 0;  /*< Flag the shutdown of the poll subsystem */
 
-/** Poll cross-thread messaging variables */
-static volatile int     *poll_msg;
-static void    *poll_msg_data = NULL;
+/** Serializes the senders of poll_send_message */
 static SPINLOCK poll_msg_lock = SPINLOCK_INIT;
 
 #if MUTEX_EPOLL
@@ -114,8 +132,9 @@ static int n_waiting = 0;    /*< No. of threads in epoll_wait */
 
 static int process_pollq(int thread_id, struct epoll_event *event);
 static void poll_add_event_to_dcb(DCB* dcb, GWBUF* buf, uint32_t ev);
+static void poll_continue_accept(int thread_id, DCB *listener);
 static bool poll_dcb_session_check(DCB *dcb, const char *);
-static void poll_check_message(void);
+static void poll_handle_message(int thread_id, enum poll_message msg, void *data);
 
 DCB *eventq = NULL;
 SPINLOCK pollqlock = SPINLOCK_INIT;
@@ -179,33 +198,137 @@ static THREAD_DATA *thread_data = NULL;    /*< Status of each thread */
  */
 static struct
 {
-    ts_stats_t *n_read;         /*< Number of read events   */
-    ts_stats_t *n_write;        /*< Number of write events  */
-    ts_stats_t *n_error;        /*< Number of error events  */
-    ts_stats_t *n_hup;          /*< Number of hangup events */
-    ts_stats_t *n_accept;       /*< Number of accept events */
-    ts_stats_t *n_polls;        /*< Number of poll cycles   */
-    ts_stats_t *n_pollev;       /*< Number of polls returning events */
-    ts_stats_t *n_nbpollev;     /*< Number of polls returning events */
-    ts_stats_t *n_nothreads;    /*< Number of times no threads are polling */
-    int32_t n_fds[MAXNFDS];     /*< Number of wakeups with particular n_fds value */
-    ts_stats_t *evq_length;     /*< Event queue length */
-    ts_stats_t *evq_max;        /*< Maximum event queue length */
-    ts_stats_t *blockingpolls;  /*< Number of epoll_waits with a timeout specified */
+    MXS_METRIC *n_read;         /*< Number of read events   */
+    MXS_METRIC *n_write;        /*< Number of write events  */
+    MXS_METRIC *n_error;        /*< Number of error events  */
+    MXS_METRIC *n_hup;          /*< Number of hangup events */
+    MXS_METRIC *n_accept;       /*< Number of accept events */
+    MXS_METRIC *n_polls;        /*< Number of poll cycles   */
+    MXS_METRIC *n_pollev;       /*< Number of polls returning events */
+    MXS_METRIC *n_nbpollev;     /*< Number of polls returning events */
+    MXS_METRIC *n_nothreads;    /*< Number of times no threads are polling */
+    MXS_METRIC *n_fds;          /*< Number of wakeups with particular n_fds value */
+    MXS_METRIC *evq_length;     /*< Event queue length */
+    MXS_METRIC *evq_max;        /*< Maximum event queue length */
+    MXS_METRIC *blockingpolls;  /*< Number of epoll_waits with a timeout specified */
+    MXS_METRIC *n_threads;      /*< Number of worker threads */
 } pollStats;
 
 #define N_QUEUE_TIMES   30
 /**
- * The event queue statistics
+ * The event queue statistics, the times are in milliseconds
  */
 static struct
 {
-    uint32_t qtimes[N_QUEUE_TIMES + 1];
-    uint32_t exectimes[N_QUEUE_TIMES + 1];
-    ts_stats_t *maxqtime;
-    ts_stats_t *maxexectime;
+    MXS_METRIC *qtimes;
+    MXS_METRIC *exectimes;
+    MXS_METRIC *maxqtime;
+    MXS_METRIC *maxexectime;
 } queueStats;
 
+/** The buckets of the number of descriptors returned by epoll_wait */
+static const int64_t n_fds_bounds[MAXNFDS - 1] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+/** The buckets of the event queue times, one for each housekeeper heartbeat */
+static const int64_t queue_time_bounds[N_QUEUE_TIMES] =
+{
+    0, 100, 200, 300, 400, 500, 600, 700, 800, 900,
+    1000, 1100, 1200, 1300, 1400, 1500, 1600, 1700, 1800, 1900,
+    2000, 2100, 2200, 2300, 2400, 2500, 2600, 2700, 2800, 2900
+};
+
+static const MXS_METRIC_DEF poll_metrics[] =
+{
+    {
+        "maxscale_poll_events_total", MXS_METRIC_COUNTER,
+        "Number of events handled by the worker threads"
+    },
+    {
+        "maxscale_poll_cycles_total", MXS_METRIC_COUNTER,
+        "Number of epoll cycles"
+    },
+    {
+        "maxscale_poll_event_cycles_total", MXS_METRIC_COUNTER,
+        "Number of epoll calls returning events"
+    },
+    {
+        "maxscale_poll_nonblocking_event_cycles_total", MXS_METRIC_COUNTER,
+        "Number of non-blocking epoll calls returning events"
+    },
+    {
+        "maxscale_poll_blocking_cycles_total", MXS_METRIC_COUNTER,
+        "Number of epoll calls with a timeout"
+    },
+    {
+        "maxscale_poll_no_threads_total", MXS_METRIC_COUNTER,
+        "Number of times no threads were polling"
+    },
+    {
+        "maxscale_poll_descriptors", MXS_METRIC_HISTOGRAM,
+        "Number of descriptors returned by epoll calls",
+        n_fds_bounds, MAXNFDS - 1
+    },
+    {
+        "maxscale_poll_event_queue_length", MXS_METRIC_GAUGE,
+        "Length of the latest event queue of the worker threads"
+    },
+    {
+        "maxscale_poll_event_queue_max", MXS_METRIC_MAX,
+        "Maximum event queue length"
+    },
+    {
+        "maxscale_event_queue_time_milliseconds", MXS_METRIC_HISTOGRAM,
+        "Time events were queued before being processed",
+        queue_time_bounds, N_QUEUE_TIMES
+    },
+    {
+        "maxscale_event_execution_time_milliseconds", MXS_METRIC_HISTOGRAM,
+        "Time spent processing events",
+        queue_time_bounds, N_QUEUE_TIMES
+    },
+    {
+        "maxscale_event_queue_time_max_milliseconds", MXS_METRIC_MAX,
+        "Maximum time an event was queued"
+    },
+    {
+        "maxscale_event_execution_time_max_milliseconds", MXS_METRIC_MAX,
+        "Maximum time spent processing an event"
+    },
+    {
+        "maxscale_worker_threads", MXS_METRIC_GAUGE,
+        "Number of worker threads"
+    },
+    MXS_END_MODULE_METRICS
+};
+
+/**
+ * Create a poll statistic
+ *
+ * @param name  Name of the metric
+ * @param type  Value of the label @c type, NULL for no labels
+ *
+ * @return The instrument
+ */
+static MXS_METRIC* poll_metric_create(const char *name, const char *type)
+{
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+
+    if (type)
+    {
+        prometheus_label(labels, "type", type);
+    }
+
+    MXS_METRIC *metric = mxs_metric_create(name, labels);
+
+    if (metric == NULL)
+    {
+        MXS_OOM_MESSAGE("FATAL: Could not allocate statistics data.");
+        exit(-1);
+    }
+
+    return metric;
+}
+
 /**
  * How frequently to call the poll_loadav function used to monitor the load
  * average of the poll subsystem.
@@ -246,28 +369,29 @@ poll_init()
         }
     }
 
-    if ((fake_events = MXS_CALLOC(n_threads, sizeof(fake_event_t*))) == NULL)
-    {
-        exit(-1);
-    }
-
-    if ((fake_event_lock = MXS_CALLOC(n_threads, sizeof(SPINLOCK))) == NULL)
-    {
-        exit(-1);
-    }
-
-    if ((poll_msg = MXS_CALLOC(n_threads, sizeof(int))) == NULL)
+    if ((msg_queues = MXS_CALLOC(n_threads, sizeof(WORKER_QUEUE))) == NULL)
     {
         exit(-1);
     }
 
     for (int i = 0; i < n_threads; i++)
     {
-        spinlock_init(&fake_event_lock[i]);
+        /** The queue's eventfd is level-triggered, it stays readable
+         * until the thread takes the messages out of the queue */
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &msg_queues[i];
+
+        if (!worker_queue_init(&msg_queues[i]) ||
+            epoll_ctl(epoll_fd[i], EPOLL_CTL_ADD, msg_queues[i].fd, &ev) == -1)
+        {
+            char errbuf[MXS_STRERROR_BUFLEN];
+            MXS_ERROR("FATAL: Could not create the message queue of thread %d: %s", i,
+                      strerror_r(errno, errbuf, sizeof(errbuf)));
+            exit(-1);
+        }
     }
 
-    memset(&pollStats, 0, sizeof(pollStats));
-    memset(&queueStats, 0, sizeof(queueStats));
     thread_data = (THREAD_DATA *)MXS_MALLOC(n_threads * sizeof(THREAD_DATA));
     if (thread_data)
     {
@@ -277,25 +401,36 @@ poll_init()
         }
     }
 
-    if ((pollStats.n_read = ts_stats_alloc()) == NULL ||
-        (pollStats.n_write = ts_stats_alloc()) == NULL ||
-        (pollStats.n_error = ts_stats_alloc()) == NULL ||
-        (pollStats.n_hup = ts_stats_alloc()) == NULL ||
-        (pollStats.n_accept = ts_stats_alloc()) == NULL ||
-        (pollStats.n_polls = ts_stats_alloc()) == NULL ||
-        (pollStats.n_pollev = ts_stats_alloc()) == NULL ||
-        (pollStats.n_nbpollev = ts_stats_alloc()) == NULL ||
-        (pollStats.n_nothreads = ts_stats_alloc()) == NULL ||
-        (pollStats.evq_length = ts_stats_alloc()) == NULL ||
-        (pollStats.evq_max = ts_stats_alloc()) == NULL ||
-        (queueStats.maxqtime = ts_stats_alloc()) == NULL ||
-        (queueStats.maxexectime = ts_stats_alloc()) == NULL ||
-        (pollStats.blockingpolls = ts_stats_alloc()) == NULL)
+    for (const MXS_METRIC_DEF *def = poll_metrics; def->name; def++)
     {
-        MXS_OOM_MESSAGE("FATAL: Could not allocate statistics data.");
-        exit(-1);
+        if (!mxs_metric_define(NULL, def))
+        {
+            MXS_ERROR("FATAL: Could not define metric '%s'.", def->name);
+            exit(-1);
+        }
     }
 
+    pollStats.n_read = poll_metric_create("maxscale_poll_events_total", "read");
+    pollStats.n_write = poll_metric_create("maxscale_poll_events_total", "write");
+    pollStats.n_error = poll_metric_create("maxscale_poll_events_total", "error");
+    pollStats.n_hup = poll_metric_create("maxscale_poll_events_total", "hangup");
+    pollStats.n_accept = poll_metric_create("maxscale_poll_events_total", "accept");
+    pollStats.n_polls = poll_metric_create("maxscale_poll_cycles_total", NULL);
+    pollStats.n_pollev = poll_metric_create("maxscale_poll_event_cycles_total", NULL);
+    pollStats.n_nbpollev = poll_metric_create("maxscale_poll_nonblocking_event_cycles_total", NULL);
+    pollStats.blockingpolls = poll_metric_create("maxscale_poll_blocking_cycles_total", NULL);
+    pollStats.n_nothreads = poll_metric_create("maxscale_poll_no_threads_total", NULL);
+    pollStats.n_fds = poll_metric_create("maxscale_poll_descriptors", NULL);
+    pollStats.evq_length = poll_metric_create("maxscale_poll_event_queue_length", NULL);
+    pollStats.evq_max = poll_metric_create("maxscale_poll_event_queue_max", NULL);
+    pollStats.n_threads = poll_metric_create("maxscale_worker_threads", NULL);
+    queueStats.qtimes = poll_metric_create("maxscale_event_queue_time_milliseconds", NULL);
+    queueStats.exectimes = poll_metric_create("maxscale_event_execution_time_milliseconds", NULL);
+    queueStats.maxqtime = poll_metric_create("maxscale_event_queue_time_max_milliseconds", NULL);
+    queueStats.maxexectime = poll_metric_create("maxscale_event_execution_time_max_milliseconds", NULL);
+
+    mxs_metric_set(pollStats.n_threads, n_threads);
+
 #if MUTEX_EPOLL
     simple_mutex_init(&epoll_wait_mutex, "epoll_wait_mutex");
 #endif
@@ -395,7 +530,14 @@ int poll_add_dcb(DCB *dcb)
 
     if (dcb->dcb_role == DCB_ROLE_SERVICE_LISTENER)
     {
-        /** Listeners are added to all epoll instances */
+        /**
+         * Listeners are added to all epoll instances. Only one of the threads
+         * waiting for events is woken up for a new connection.
+         */
+        ev.events = EPOLLIN | EPOLLET;
+#ifdef EPOLLEXCLUSIVE
+        ev.events |= EPOLLEXCLUSIVE;
+#endif
         int nthr = config_threadcount();
 
         for (int i = 0; i < nthr; i++)
@@ -640,12 +782,12 @@ poll_resolve_error(DCB *dcb, int errornum, bool adding)
  * collect events is only made if there are no pending events to be processed on the
  * event queue.
  *
- * Also introduced a "timeout bias" mechanism. This mechansim control the length of
- * of timeout passed to epoll_wait in blocking calls based on previous behaviour.
- * The initial call will block for 10% of the define timeout peroid, this will be
- * increased in increments of 10% until the full timeout value is used. If at any
- * point there is an event to be processed then the value will be reduced to 10% again
- * for the next blocking call.
+ * Fake events and other messages from other threads are posted to the thread's
+ * message queue. The queue has an eventfd in the thread's epoll instance which
+ * wakes the thread up as soon as a message is posted. Because of this, a thread
+ * that has no connection timeouts pending blocks in epoll_wait until an event
+ * arrives. A thread with pending timeouts blocks for at most the configured
+ * maximum poll sleep.
  *
  * @param arg   The thread ID passed as a void * to satisfy the threading package
  */
@@ -653,11 +795,13 @@ void
 poll_waitevents(void *arg)
 {
     struct epoll_event events[MAX_EVENTS];
-    int i, nfds, timeout_bias = 1;
+    int i, nfds;
     current_thread_id = (intptr_t)arg;
+    is_worker = true;
     int poll_spins = 0;
 
     int thread_id = current_thread_id;
+    metrics_thread_init(thread_id);
 
     if (thread_data)
     {
@@ -679,7 +823,7 @@ poll_waitevents(void *arg)
             thread_data[thread_id].state = THREAD_POLLING;
         }
 
-        ts_stats_increment(pollStats.n_polls, thread_id);
+        mxs_metric_inc(pollStats.n_polls);
         if ((nfds = epoll_wait(epoll_fd[thread_id], events, MAX_EVENTS, 0)) == -1)
         {
             atomic_add(&n_waiting, -1);
@@ -697,20 +841,18 @@ poll_waitevents(void *arg)
          * and nothing to process on the event queue then for do a
          * blocking call to epoll_wait.
          *
-         * We calculate a timeout bias to alter the length of the blocking
-         * call based on the time since we last received an event to process
+         * Messages from other threads wake the thread up so the only reasons
+         * to limit the wait are to process the connection timeouts and the
+         * DCBs that are left in the zombie queue to be closed later.
          */
         else if (nfds == 0 && poll_spins++ > number_poll_spins)
         {
-            if (timeout_bias < 10)
-            {
-                timeout_bias++;
-            }
-            ts_stats_increment(pollStats.blockingpolls, thread_id);
+            mxs_metric_inc(pollStats.blockingpolls);
             nfds = epoll_wait(epoll_fd[thread_id],
                               events,
                               MAX_EVENTS,
-                              (max_poll_sleep * timeout_bias) / 10);
+                              dcb_pending_idle_timeouts(thread_id) ||
+                              dcb_pending_zombies(thread_id) ? max_poll_sleep : -1);
             if (nfds == 0)
             {
                 poll_spins = 0;
@@ -723,7 +865,7 @@ poll_waitevents(void *arg)
 
         if (n_waiting == 0)
         {
-            ts_stats_increment(pollStats.n_nothreads, thread_id);
+            mxs_metric_inc(pollStats.n_nothreads);
         }
 #if MUTEX_EPOLL
         simple_mutex_unlock(&epoll_wait_mutex);
@@ -731,19 +873,18 @@ poll_waitevents(void *arg)
 #endif /* BLOCKINGPOLL */
         if (nfds > 0)
         {
-            ts_stats_set(pollStats.evq_length, nfds, thread_id);
-            ts_stats_set_max(pollStats.evq_max, nfds, thread_id);
+            mxs_metric_set(pollStats.evq_length, nfds);
+            mxs_metric_set_max(pollStats.evq_max, nfds);
 
-            timeout_bias = 1;
             if (poll_spins <= number_poll_spins + 1)
             {
-                ts_stats_increment(pollStats.n_nbpollev, thread_id);
+                mxs_metric_inc(pollStats.n_nbpollev);
             }
             poll_spins = 0;
             MXS_DEBUG("%lu [poll_waitevents] epoll_wait found %d fds",
                       pthread_self(),
                       nfds);
-            ts_stats_increment(pollStats.n_pollev, thread_id);
+            mxs_metric_inc(pollStats.n_pollev);
             if (thread_data)
             {
                 thread_data[thread_id].n_fds = nfds;
@@ -752,7 +893,7 @@ poll_waitevents(void *arg)
                 thread_data[thread_id].state = THREAD_PROCESSING;
             }
 
-            pollStats.n_fds[(nfds < MAXNFDS ? (nfds - 1) : MAXNFDS - 1)]++;
+            mxs_metric_observe(pollStats.n_fds, nfds);
 
             load_average = (load_average * load_samples + nfds) / (load_samples + 1);
             atomic_add_uint64(&load_samples, 1);
@@ -772,35 +913,26 @@ poll_waitevents(void *arg)
 
         thread_data[thread_id].cycle_start = hkheartbeat;
 
+        bool have_messages = false;
+
         /* Process of the queue of waiting requests */
         for (int i = 0; i < nfds; i++)
         {
-            process_pollq(thread_id, &events[i]);
-        }
-
-        fake_event_t *event = NULL;
-
-        /** It is very likely that the queue is empty so to avoid hitting the
-         * spinlock every time we receive events, we only do a dirty read. Currently,
-         * only the monitors inject fake events from external threads. */
-        if (fake_events[thread_id])
-        {
-            spinlock_acquire(&fake_event_lock[thread_id]);
-            event = fake_events[thread_id];
-            fake_events[thread_id] = NULL;
-            spinlock_release(&fake_event_lock[thread_id]);
+            if (events[i].data.ptr == &msg_queues[thread_id])
+            {
+                have_messages = true;
+            }
+            else
+            {
+                process_pollq(thread_id, &events[i]);
+            }
         }
 
-        while (event)
+        /** The messages are processed after the real events, as the fake
+         * events were before they were moved to the message queue */
+        if (have_messages)
         {
-            struct epoll_event ev;
-            event->dcb->dcb_fakequeue = event->data;
-            ev.data.ptr = event->dcb;
-            ev.events = event->event;
-            process_pollq(thread_id, &ev);
-            fake_event_t *tmp = event;
-            event = event->next;
-            MXS_FREE(tmp);
+            worker_queue_process(&msg_queues[thread_id], thread_id);
         }
 
         dcb_process_idle_sessions(thread_id);
@@ -813,8 +945,6 @@ poll_waitevents(void *arg)
         /** Process closed DCBs */
         dcb_process_zombies(thread_id);
 
-        poll_check_message();
-
         if (thread_data)
         {
             thread_data[thread_id].state = THREAD_IDLE;
@@ -901,16 +1031,8 @@ process_pollq(int thread_id, struct epoll_event *event)
     uint64_t started = hkheartbeat;
     uint64_t qtime = started - thread_data[thread_id].cycle_start;
 
-    if (qtime > N_QUEUE_TIMES)
-    {
-        queueStats.qtimes[N_QUEUE_TIMES]++;
-    }
-    else
-    {
-        queueStats.qtimes[qtime]++;
-    }
-
-    ts_stats_set_max(queueStats.maxqtime, qtime, thread_id);
+    mxs_metric_observe(queueStats.qtimes, qtime * 100);
+    mxs_metric_set_max(queueStats.maxqtime, qtime * 100);
 
     CHK_DCB(dcb);
     if (thread_data)
@@ -941,7 +1063,7 @@ process_pollq(int thread_id, struct epoll_event *event)
 
         if (eno == 0)
         {
-            ts_stats_increment(pollStats.n_write, thread_id);
+            mxs_metric_inc(pollStats.n_write);
 
             if (poll_dcb_session_check(dcb, "write_ready"))
             {
@@ -969,11 +1091,17 @@ process_pollq(int thread_id, struct epoll_event *event)
                       "Accept in fd %d",
                       pthread_self(),
                       dcb->fd);
-            ts_stats_increment(pollStats.n_accept, thread_id);
+            mxs_metric_inc(pollStats.n_accept);
 
             if (poll_dcb_session_check(dcb, "accept"))
             {
+                dcb_accept_batch_start();
                 dcb->func.accept(dcb);
+
+                if (dcb_accept_batch_end(dcb))
+                {
+                    poll_continue_accept(thread_id, dcb);
+                }
             }
         }
         else
@@ -983,7 +1111,7 @@ process_pollq(int thread_id, struct epoll_event *event)
                       pthread_self(),
                       dcb,
                       dcb->fd);
-            ts_stats_increment(pollStats.n_read, thread_id);
+            mxs_metric_inc(pollStats.n_read);
 
             if (poll_dcb_session_check(dcb, "read"))
             {
@@ -1015,7 +1143,7 @@ process_pollq(int thread_id, struct epoll_event *event)
                       eno,
                       strerror_r(eno, errbuf, sizeof(errbuf)));
         }
-        ts_stats_increment(pollStats.n_error, thread_id);
+        mxs_metric_inc(pollStats.n_error);
 
         if (poll_dcb_session_check(dcb, "error"))
         {
@@ -1035,7 +1163,7 @@ process_pollq(int thread_id, struct epoll_event *event)
                   dcb->fd,
                   eno,
                   strerror_r(eno, errbuf, sizeof(errbuf)));
-        ts_stats_increment(pollStats.n_hup, thread_id);
+        mxs_metric_inc(pollStats.n_hup);
         if ((dcb->flags & DCBF_HUNG) == 0)
         {
             dcb->flags |= DCBF_HUNG;
@@ -1060,7 +1188,7 @@ process_pollq(int thread_id, struct epoll_event *event)
                   dcb->fd,
                   eno,
                   strerror_r(eno, errbuf, sizeof(errbuf)));
-        ts_stats_increment(pollStats.n_hup, thread_id);
+        mxs_metric_inc(pollStats.n_hup);
 
         if ((dcb->flags & DCBF_HUNG) == 0)
         {
@@ -1077,16 +1205,8 @@ process_pollq(int thread_id, struct epoll_event *event)
     /** Calculate event execution statistics */
     qtime = hkheartbeat - started;
 
-    if (qtime > N_QUEUE_TIMES)
-    {
-        queueStats.exectimes[N_QUEUE_TIMES]++;
-    }
-    else
-    {
-        queueStats.exectimes[qtime % N_QUEUE_TIMES]++;
-    }
-
-    ts_stats_set_max(queueStats.maxexectime, qtime, thread_id);
+    mxs_metric_observe(queueStats.exectimes, qtime * 100);
+    mxs_metric_set_max(queueStats.maxexectime, qtime * 100);
 
     current_dcb = NULL; // thread local
 
@@ -1128,6 +1248,13 @@ void
 poll_shutdown()
 {
     do_shutdown = 1;
+    atomic_synchronize();
+
+    /** Wake up the threads that are blocked in epoll_wait */
+    for (int i = 0; i < n_threads; i++)
+    {
+        worker_queue_wake(&msg_queues[i]);
+    }
 }
 
 /**
@@ -1151,44 +1278,46 @@ spin_reporter(void *dcb, char *desc, int value)
 void
 dprintPollStats(DCB *dcb)
 {
+    int64_t n_fds[MAXNFDS];
     int i;
 
+    mxs_metric_get_buckets(pollStats.n_fds, n_fds, NULL);
+
     dcb_printf(dcb, "\nPoll Statistics.\n\n");
     dcb_printf(dcb, "No. of epoll cycles:                           %" PRId64 "\n",
-               ts_stats_get(pollStats.n_polls, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_polls));
     dcb_printf(dcb, "No. of epoll cycles with wait:                 %" PRId64 "\n",
-               ts_stats_get(pollStats.blockingpolls, TS_STATS_SUM));
+               mxs_metric_get(pollStats.blockingpolls));
     dcb_printf(dcb, "No. of epoll calls returning events:           %" PRId64 "\n",
-               ts_stats_get(pollStats.n_pollev, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_pollev));
     dcb_printf(dcb, "No. of non-blocking calls returning events:    %" PRId64 "\n",
-               ts_stats_get(pollStats.n_nbpollev, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_nbpollev));
     dcb_printf(dcb, "No. of read events:                            %" PRId64 "\n",
-               ts_stats_get(pollStats.n_read, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_read));
     dcb_printf(dcb, "No. of write events:                           %" PRId64 "\n",
-               ts_stats_get(pollStats.n_write, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_write));
     dcb_printf(dcb, "No. of error events:                           %" PRId64 "\n",
-               ts_stats_get(pollStats.n_error, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_error));
     dcb_printf(dcb, "No. of hangup events:                          %" PRId64 "\n",
-               ts_stats_get(pollStats.n_hup, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_hup));
     dcb_printf(dcb, "No. of accept events:                          %" PRId64 "\n",
-               ts_stats_get(pollStats.n_accept, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_accept));
     dcb_printf(dcb, "No. of times no threads polling:               %" PRId64 "\n",
-               ts_stats_get(pollStats.n_nothreads, TS_STATS_SUM));
+               mxs_metric_get(pollStats.n_nothreads));
     dcb_printf(dcb, "Total event queue length:                      %" PRId64 "\n",
-               ts_stats_get(pollStats.evq_length, TS_STATS_AVG));
+               mxs_metric_get(pollStats.evq_length));
     dcb_printf(dcb, "Average event queue length:                    %" PRId64 "\n",
-               ts_stats_get(pollStats.evq_length, TS_STATS_AVG));
+               mxs_metric_get(pollStats.evq_length) / n_threads);
     dcb_printf(dcb, "Maximum event queue length:                    %" PRId64 "\n",
-               ts_stats_get(pollStats.evq_max, TS_STATS_MAX));
+               mxs_metric_get(pollStats.evq_max));
 
     dcb_printf(dcb, "No of poll completions with descriptors\n");
     dcb_printf(dcb, "\tNo. of descriptors\tNo. of poll completions.\n");
     for (i = 0; i < MAXNFDS - 1; i++)
     {
-        dcb_printf(dcb, "\t%2d\t\t\t%" PRId32 "\n", i + 1, pollStats.n_fds[i]);
+        dcb_printf(dcb, "\t%2d\t\t\t%" PRId64 "\n", i + 1, n_fds[i]);
     }
-    dcb_printf(dcb, "\t>= %d\t\t\t%" PRId32 "\n", MAXNFDS,
-               pollStats.n_fds[MAXNFDS - 1]);
+    dcb_printf(dcb, "\t>= %d\t\t\t%" PRId64 "\n", MAXNFDS, n_fds[MAXNFDS - 1]);
 
 }
 
@@ -1424,9 +1553,72 @@ void poll_add_epollin_event_to_dcb(DCB*   dcb,
 }
 
 
+/**
+ * Process a fake event in the thread that owns the DCB
+ *
+ * @param thread_id The ID of the calling thread
+ * @param msg       The fake event
+ */
+static void poll_fake_event_handler(int thread_id, WORKER_MSG *msg)
+{
+    fake_event_t *event = (fake_event_t*)msg;
+    struct epoll_event ev;
+
+    event->dcb->dcb_fakequeue = event->data;
+    ev.data.ptr = event->dcb;
+    ev.events = event->event;
+    process_pollq(thread_id, &ev);
+    MXS_FREE(event);
+}
+
+/**
+ * Continue accepting the connections of a listener
+ *
+ * @param thread_id The ID of the calling thread
+ * @param msg       The accept event
+ */
+static void poll_accept_handler(int thread_id, WORKER_MSG *msg)
+{
+    fake_event_t *event = (fake_event_t*)msg;
+
+    /** The listener may have been stopped while the event was queued */
+    if (event->dcb->state == DCB_STATE_LISTENING)
+    {
+        struct epoll_event ev;
+        ev.data.ptr = event->dcb;
+        ev.events = EPOLLIN;
+        process_pollq(thread_id, &ev);
+    }
+
+    MXS_FREE(event);
+}
+
+/**
+ * Queue the accepting of the rest of the connections of a listener
+ *
+ * The listener is edge-triggered so no new event is generated for the
+ * connections that were left in the backlog when a batch was full. The event
+ * is queued to the calling thread after the events it already has.
+ *
+ * @param thread_id The ID of the calling thread
+ * @param listener  The listener
+ */
+static void poll_continue_accept(int thread_id, DCB *listener)
+{
+    fake_event_t *event = MXS_MALLOC(sizeof(*event));
+
+    if (event)
+    {
+        event->data = NULL;
+        event->dcb = listener;
+        event->event = EPOLLIN;
+        worker_queue_post(&msg_queues[thread_id], &event->msg, poll_accept_handler);
+    }
+}
+
 static void poll_add_event_to_dcb(DCB*       dcb,
                                   GWBUF*     buf,
-                                  uint32_t ev)
+                                  uint32_t   ev)
 {
     fake_event_t *event = MXS_MALLOC(sizeof(*event));
 
@@ -1435,28 +1627,45 @@ static void poll_add_event_to_dcb(DCB*       dcb,
         event->data = buf;
         event->dcb = dcb;
         event->event = ev;
-        event->next = NULL;
-        event->tail = event;
-
-        int thr = dcb->thread.id;
 
         /** It is possible that a housekeeper or a monitor thread inserts a fake
-         * event into the thread's event queue which is why the operation needs
-         * to be protected by a spinlock */
-        spinlock_acquire(&fake_event_lock[thr]);
+         * event which is why the event is posted to the owning thread's message
+         * queue instead of being processed directly */
+        worker_queue_post(&msg_queues[dcb->thread.id], &event->msg, poll_fake_event_handler);
+    }
+}
 
-        if (fake_events[thr])
-        {
-            fake_events[thr]->tail->next = event;
-            fake_events[thr]->tail = event;
-        }
-        else
-        {
-            fake_events[thr] = event;
-        }
+/**
+ * Call a posted function in the thread it was posted to
+ *
+ * @param thread_id The ID of the calling thread
+ * @param msg       The posted call
+ */
+static void poll_task_handler(int thread_id, WORKER_MSG *msg)
+{
+    poll_task_t *task = (poll_task_t*)msg;
+
+    task->task(task->data);
+    MXS_FREE(task);
+}
 
-        spinlock_release(&fake_event_lock[thr]);
+bool poll_is_worker(int thread_id)
+{
+    return is_worker && current_thread_id == thread_id;
+}
+
+bool poll_post_task(int thread_id, void (*task)(void *data), void *data)
+{
+    poll_task_t *msg = MXS_MALLOC(sizeof(*msg));
+
+    if (msg)
+    {
+        msg->task = task;
+        msg->data = data;
+        worker_queue_post(&msg_queues[thread_id], &msg->msg, poll_task_handler);
     }
+
+    return msg != NULL;
 }
 
 void poll_fake_write_event(DCB *dcb)
@@ -1487,32 +1696,34 @@ void poll_fake_hangup_event(DCB *dcb)
 void
 dShowEventStats(DCB *pdcb)
 {
+    int64_t qtimes[N_QUEUE_TIMES + 1];
+    int64_t exectimes[N_QUEUE_TIMES + 1];
     int i;
 
+    mxs_metric_get_buckets(queueStats.qtimes, qtimes, NULL);
+    mxs_metric_get_buckets(queueStats.exectimes, exectimes, NULL);
+
     dcb_printf(pdcb, "\nEvent statistics.\n");
-    dcb_printf(pdcb, "Maximum queue time:           %3" PRId64 "00ms\n", ts_stats_get(queueStats.maxqtime,
-                                                                                      TS_STATS_MAX));
-    dcb_printf(pdcb, "Maximum execution time:       %3" PRId64 "00ms\n", ts_stats_get(queueStats.maxexectime,
-                                                                                      TS_STATS_MAX));
-    dcb_printf(pdcb, "Maximum event queue length:   %3" PRId64 "\n", ts_stats_get(pollStats.evq_max,
-                                                                                  TS_STATS_MAX));
-    dcb_printf(pdcb, "Total event queue length:     %3" PRId64 "\n", ts_stats_get(pollStats.evq_length,
-                                                                                  TS_STATS_SUM));
-    dcb_printf(pdcb, "Average event queue length:   %3" PRId64 "\n", ts_stats_get(pollStats.evq_length,
-                                                                                  TS_STATS_AVG));
+    dcb_printf(pdcb, "Maximum queue time:           %3" PRId64 "00ms\n",
+               mxs_metric_get(queueStats.maxqtime) / 100);
+    dcb_printf(pdcb, "Maximum execution time:       %3" PRId64 "00ms\n",
+               mxs_metric_get(queueStats.maxexectime) / 100);
+    dcb_printf(pdcb, "Maximum event queue length:   %3" PRId64 "\n", mxs_metric_get(pollStats.evq_max));
+    dcb_printf(pdcb, "Total event queue length:     %3" PRId64 "\n", mxs_metric_get(pollStats.evq_length));
+    dcb_printf(pdcb, "Average event queue length:   %3" PRId64 "\n", mxs_metric_get(pollStats.evq_length) / n_threads);
     dcb_printf(pdcb, "\n");
     dcb_printf(pdcb, "               |    Number of events\n");
     dcb_printf(pdcb, "Duration       | Queued     | Executed\n");
     dcb_printf(pdcb, "---------------+------------+-----------\n");
-    dcb_printf(pdcb, " < 100ms       | %-10d | %-10d\n",
-               queueStats.qtimes[0], queueStats.exectimes[0]);
+    dcb_printf(pdcb, " < 100ms       | %-10" PRId64 " | %-10" PRId64 "\n",
+               qtimes[0], exectimes[0]);
     for (i = 1; i < N_QUEUE_TIMES; i++)
     {
-        dcb_printf(pdcb, " %2d00 - %2d00ms | %-10d | %-10d\n", i, i + 1,
-                   queueStats.qtimes[i], queueStats.exectimes[i]);
+        dcb_printf(pdcb, " %2d00 - %2d00ms | %-10" PRId64 " | %-10" PRId64 "\n", i, i + 1,
+                   qtimes[i], exectimes[i]);
     }
-    dcb_printf(pdcb, " > %2d00ms      | %-10d | %-10d\n", N_QUEUE_TIMES,
-               queueStats.qtimes[N_QUEUE_TIMES], queueStats.exectimes[N_QUEUE_TIMES]);
+    dcb_printf(pdcb, " > %2d00ms      | %-10" PRId64 " | %-10" PRId64 "\n", N_QUEUE_TIMES,
+               qtimes[N_QUEUE_TIMES], exectimes[N_QUEUE_TIMES]);
 }
 
 /**
@@ -1526,23 +1737,23 @@ int64_t poll_get_stat(POLL_STAT stat)
     switch (stat)
     {
     case POLL_STAT_READ:
-        return ts_stats_get(pollStats.n_read, TS_STATS_SUM);
+        return mxs_metric_get(pollStats.n_read);
     case POLL_STAT_WRITE:
-        return ts_stats_get(pollStats.n_write, TS_STATS_SUM);
+        return mxs_metric_get(pollStats.n_write);
     case POLL_STAT_ERROR:
-        return ts_stats_get(pollStats.n_error, TS_STATS_SUM);
+        return mxs_metric_get(pollStats.n_error);
     case POLL_STAT_HANGUP:
-        return ts_stats_get(pollStats.n_hup, TS_STATS_SUM);
+        return mxs_metric_get(pollStats.n_hup);
     case POLL_STAT_ACCEPT:
-        return ts_stats_get(pollStats.n_accept, TS_STATS_SUM);
+        return mxs_metric_get(pollStats.n_accept);
     case POLL_STAT_EVQ_LEN:
-        return ts_stats_get(pollStats.evq_length, TS_STATS_AVG);
+        return mxs_metric_get(pollStats.evq_length) / n_threads;
     case POLL_STAT_EVQ_MAX:
-        return ts_stats_get(pollStats.evq_max, TS_STATS_MAX);
+        return mxs_metric_get(pollStats.evq_max);
     case POLL_STAT_MAX_QTIME:
-        return ts_stats_get(queueStats.maxqtime, TS_STATS_MAX);
+        return mxs_metric_get(queueStats.maxqtime) / 100;
     case POLL_STAT_MAX_EXECTIME:
-        return ts_stats_get(queueStats.maxexectime, TS_STATS_MAX);
+        return mxs_metric_get(queueStats.maxexectime) / 100;
     default:
         ss_dassert(false);
         break;
@@ -1561,6 +1772,8 @@ static RESULT_ROW *
 eventTimesRowCallback(RESULTSET *set, void *data)
 {
     int *rowno = (int *)data;
+    int64_t qtimes[N_QUEUE_TIMES + 1];
+    int64_t exectimes[N_QUEUE_TIMES + 1];
     char buf[40];
     RESULT_ROW *row;
 
@@ -1586,10 +1799,12 @@ eventTimesRowCallback(RESULTSET *set, void *data)
         buf[39] = '\0';
         resultset_row_set(row, 0, buf);
     }
-    snprintf(buf, 39, "%u", queueStats.qtimes[*rowno]);
+    mxs_metric_get_buckets(queueStats.qtimes, qtimes, NULL);
+    mxs_metric_get_buckets(queueStats.exectimes, exectimes, NULL);
+    snprintf(buf, 39, "%" PRId64, qtimes[*rowno]);
     buf[39] = '\0';
     resultset_row_set(row, 1, buf);
-    snprintf(buf, 39, "%u", queueStats.exectimes[*rowno]);
+    snprintf(buf, 39, "%" PRId64, exectimes[*rowno]);
     buf[39] = '\0';
     resultset_row_set(row, 2, buf);
     (*rowno)++;
@@ -1624,45 +1839,76 @@ eventTimesGetList()
     return set;
 }
 
+/**
+ * Process a message sent with poll_send_message
+ *
+ * @param thread_id The ID of the calling thread
+ * @param msg       The message
+ */
+static void poll_broadcast_handler(int thread_id, WORKER_MSG *msg)
+{
+    poll_broadcast_t *bc = (poll_broadcast_t*)msg;
+    poll_handle_message(thread_id, bc->type, bc->data);
+
+    /** The message lives on the sender's stack, it must not be accessed after
+     * the sender has been released */
+    sem_t *done = bc->done;
+
+    if (atomic_add(bc->pending, -1) == 1)
+    {
+        sem_post(done);
+    }
+}
+
 void poll_send_message(enum poll_message msg, void *data)
 {
     spinlock_acquire(&poll_msg_lock);
     int nthr = config_threadcount();
-    poll_msg_data = data;
+    poll_broadcast_t messages[nthr];
+    int pending = 0;
+    sem_t done;
+    sem_init(&done, 0, 0);
 
     for (int i = 0; i < nthr; i++)
     {
-        poll_msg[i] |= msg;
+        if (i != current_thread_id)
+        {
+            messages[i].type = msg;
+            messages[i].data = data;
+            messages[i].pending = &pending;
+            messages[i].done = &done;
+            pending++;
+        }
     }
 
-    /** Handle this thread's message */
-    poll_check_message();
+    int n_posted = pending;
 
     for (int i = 0; i < nthr; i++)
     {
         if (i != current_thread_id)
         {
-            while (poll_msg[i] & msg)
-            {
-                thread_millisleep(1);
-            }
+            worker_queue_post(&msg_queues[i], &messages[i].msg, poll_broadcast_handler);
         }
     }
 
-    poll_msg_data = NULL;
+    /** Handle this thread's message */
+    poll_handle_message(current_thread_id, msg, data);
+
+    if (n_posted > 0)
+    {
+        sem_wait(&done);
+    }
+
+    sem_destroy(&done);
     spinlock_release(&poll_msg_lock);
 }
 
-static void poll_check_message()
+static void poll_handle_message(int thread_id, enum poll_message msg, void *data)
 {
-    int thread_id = current_thread_id;
-
-    if (poll_msg[thread_id] & POLL_MSG_CLEAN_PERSISTENT)
+    if (msg & POLL_MSG_CLEAN_PERSISTENT)
     {
-        SERVER *server = (SERVER*)poll_msg_data;
+        SERVER *server = (SERVER*)data;
         dcb_persistent_clean_count(server->persistent[thread_id], thread_id, false);
-        atomic_synchronize();
-        poll_msg[thread_id] &= ~POLL_MSG_CLEAN_PERSISTENT;
     }
 }
 
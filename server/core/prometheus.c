@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file prometheus.c  - Metrics in the Prometheus text exposition format
+ *
+ * The output of a scrape is built in memory. Each metric family has its own
+ * text buffer for its samples and the families are written out one after
+ * another once all collectors have run.
+ */
+
+#include "maxscale/prometheus.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <maxscale/alloc.h>
+#include <maxscale/spinlock.h>
+#include <maxscale/server.h>
+#include "maxscale/metrics.h"
+#include "maxscale/monitor.h"
+#include "maxscale/service.h"
+
+/** Initial size of the sample buffer of a family */
+#define PROMETHEUS_SAMPLES_INITIAL 256
+
+typedef struct prometheus_family
+{
+    char                     *name;    /**< Name of the family */
+    prometheus_type_t         type;    /**< Type of the family */
+    char                     *help;    /**< Description of the family */
+    char                     *samples; /**< The samples in text format */
+    size_t                    len;     /**< Length of the samples */
+    size_t                    size;    /**< Size of the sample buffer */
+    struct prometheus_family *next;
+} PROMETHEUS_FAMILY;
+
+struct prometheus_output
+{
+    PROMETHEUS_FAMILY *head;  /**< Families in the order they were added */
+    PROMETHEUS_FAMILY *tail;
+    PROMETHEUS_FAMILY *last;  /**< The family of the previous sample */
+    bool               error; /**< A memory allocation failed */
+};
+
+typedef struct prometheus_collector_entry
+{
+    prometheus_collector_t             collector;
+    void                              *data;
+    struct prometheus_collector_entry *next;
+} PROMETHEUS_COLLECTOR;
+
+static PROMETHEUS_COLLECTOR *collectors = NULL;
+static SPINLOCK collector_lock = SPINLOCK_INIT;
+
+static const char* type_names[] =
+{
+    "counter",
+    "gauge",
+    "summary",
+    "histogram"
+};
+
+bool prometheus_add_collector(prometheus_collector_t collector, void *data)
+{
+    PROMETHEUS_COLLECTOR *entry = MXS_MALLOC(sizeof(*entry));
+
+    if (entry)
+    {
+        entry->collector = collector;
+        entry->data = data;
+        entry->next = NULL;
+
+        /** The collectors run in the order they were added */
+        spinlock_acquire(&collector_lock);
+        PROMETHEUS_COLLECTOR **ptr = &collectors;
+
+        while (*ptr)
+        {
+            ptr = &(*ptr)->next;
+        }
+
+        *ptr = entry;
+        spinlock_release(&collector_lock);
+    }
+
+    return entry != NULL;
+}
+
+void prometheus_remove_collector(prometheus_collector_t collector, void *data)
+{
+    spinlock_acquire(&collector_lock);
+
+    for (PROMETHEUS_COLLECTOR **ptr = &collectors; *ptr; ptr = &(*ptr)->next)
+    {
+        if ((*ptr)->collector == collector && (*ptr)->data == data)
+        {
+            PROMETHEUS_COLLECTOR *entry = *ptr;
+            *ptr = entry->next;
+            MXS_FREE(entry);
+            break;
+        }
+    }
+
+    spinlock_release(&collector_lock);
+}
+
+char* prometheus_label(char *labels, const char *name, const char *value)
+{
+    size_t len = strlen(labels);
+    size_t end = PROMETHEUS_LABELS_MAXLEN - 2; /**< Room for the closing quote */
+
+    len += snprintf(labels + len, PROMETHEUS_LABELS_MAXLEN - len, "%s%s=\"",
+                    len ? "," : "", name);
+
+    for (const char *ptr = value; *ptr && len < end; ptr++)
+    {
+        const char *escape = NULL;
+
+        switch (*ptr)
+        {
+        case '\\':
+            escape = "\\\\";
+            break;
+
+        case '"':
+            escape = "\\\"";
+            break;
+
+        case '\n':
+            escape = "\\n";
+            break;
+
+        default:
+            labels[len++] = *ptr;
+            break;
+        }
+
+        if (escape)
+        {
+            if (len + 2 > end)
+            {
+                break;
+            }
+
+            labels[len++] = escape[0];
+            labels[len++] = escape[1];
+        }
+    }
+
+    if (len < PROMETHEUS_LABELS_MAXLEN - 1)
+    {
+        labels[len++] = '"';
+    }
+
+    labels[len] = '\0';
+    return labels;
+}
+
+/**
+ * Find or create a metric family
+ *
+ * @param out  The output
+ * @param name Name of the family
+ * @param type Type of the family
+ * @param help Description of the family
+ *
+ * @return The family or NULL on memory allocation failure
+ */
+static PROMETHEUS_FAMILY* get_family(PROMETHEUS_OUTPUT *out, const char *name,
+                                     prometheus_type_t type, const char *help)
+{
+    PROMETHEUS_FAMILY *family = out->last;
+
+    if (family == NULL || strcmp(family->name, name) != 0)
+    {
+        for (family = out->head; family; family = family->next)
+        {
+            if (strcmp(family->name, name) == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    if (family == NULL)
+    {
+        if ((family = MXS_CALLOC(1, sizeof(*family))) == NULL ||
+            (family->name = MXS_STRDUP(name)) == NULL ||
+            (family->help = MXS_STRDUP(help)) == NULL)
+        {
+            if (family)
+            {
+                MXS_FREE(family->name);
+                MXS_FREE(family);
+            }
+            out->error = true;
+            return NULL;
+        }
+
+        family->type = type;
+
+        if (out->tail)
+        {
+            out->tail->next = family;
+        }
+        else
+        {
+            out->head = family;
+        }
+
+        out->tail = family;
+    }
+
+    ss_dassert(family->type == type);
+    out->last = family;
+    return family;
+}
+
+/**
+ * Append formatted text to the samples of a family
+ *
+ * @param out    The output
+ * @param family The family
+ * @param format Format string
+ */
+static void append(PROMETHEUS_OUTPUT *out, PROMETHEUS_FAMILY *family, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (family->len + len + 1 > family->size)
+    {
+        size_t size = family->size ? family->size : PROMETHEUS_SAMPLES_INITIAL;
+
+        while (family->len + len + 1 > size)
+        {
+            size *= 2;
+        }
+
+        char *samples = MXS_REALLOC(family->samples, size);
+
+        if (samples == NULL)
+        {
+            out->error = true;
+            return;
+        }
+
+        family->samples = samples;
+        family->size = size;
+    }
+
+    va_start(args, format);
+    vsnprintf(family->samples + family->len, len + 1, format, args);
+    va_end(args);
+
+    family->len += len;
+}
+
+/**
+ * Append one sample line to a family
+ *
+ * @param out    The output
+ * @param family The family
+ * @param name   Name of the sample
+ * @param labels Labels of the sample, may be NULL or empty
+ * @param value  Value of the sample
+ */
+static void append_sample(PROMETHEUS_OUTPUT *out, PROMETHEUS_FAMILY *family, const char *name,
+                          const char *labels, double value)
+{
+    char number[32];
+
+    if (isnan(value))
+    {
+        strcpy(number, "NaN");
+    }
+    else if (isinf(value))
+    {
+        strcpy(number, value > 0 ? "+Inf" : "-Inf");
+    }
+    else
+    {
+        snprintf(number, sizeof(number), "%.15g", value);
+    }
+
+    if (labels && *labels)
+    {
+        append(out, family, "%s{%s} %s\n", name, labels, number);
+    }
+    else
+    {
+        append(out, family, "%s %s\n", name, number);
+    }
+}
+
+void prometheus_sample(PROMETHEUS_OUTPUT *out, const char *name, prometheus_type_t type,
+                       const char *help, const char *labels, double value)
+{
+    ss_dassert(type == PROMETHEUS_COUNTER || type == PROMETHEUS_GAUGE);
+    PROMETHEUS_FAMILY *family = get_family(out, name, type, help);
+
+    if (family)
+    {
+        append_sample(out, family, name, labels, value);
+    }
+}
+
+void prometheus_summary(PROMETHEUS_OUTPUT *out, const char *name, const char *help,
+                        const char *labels, uint64_t count, double sum,
+                        int n, const double *quantiles, const double *values)
+{
+    PROMETHEUS_FAMILY *family = get_family(out, name, PROMETHEUS_SUMMARY, help);
+
+    if (family)
+    {
+        char sample_labels[PROMETHEUS_LABELS_MAXLEN];
+        char sample_name[strlen(name) + sizeof("_count")];
+        char quantile[32];
+
+        for (int i = 0; i < n; i++)
+        {
+            strcpy(sample_labels, labels ? labels : "");
+            snprintf(quantile, sizeof(quantile), "%g", quantiles[i]);
+            prometheus_label(sample_labels, "quantile", quantile);
+            append_sample(out, family, name, sample_labels, values[i]);
+        }
+
+        sprintf(sample_name, "%s_sum", name);
+        append_sample(out, family, sample_name, labels, sum);
+        sprintf(sample_name, "%s_count", name);
+        append_sample(out, family, sample_name, labels, count);
+    }
+}
+
+void prometheus_histogram(PROMETHEUS_OUTPUT *out, const char *name, const char *help,
+                          const char *labels, int n, const double *bounds,
+                          const uint64_t *counts, double sum)
+{
+    PROMETHEUS_FAMILY *family = get_family(out, name, PROMETHEUS_HISTOGRAM, help);
+
+    if (family)
+    {
+        char sample_labels[PROMETHEUS_LABELS_MAXLEN];
+        char sample_name[strlen(name) + sizeof("_bucket")];
+        char bound[32];
+
+        sprintf(sample_name, "%s_bucket", name);
+
+        for (int i = 0; i <= n; i++)
+        {
+            strcpy(sample_labels, labels ? labels : "");
+
+            if (i < n)
+            {
+                snprintf(bound, sizeof(bound), "%.15g", bounds[i]);
+            }
+            else
+            {
+                strcpy(bound, "+Inf");
+            }
+
+            prometheus_label(sample_labels, "le", bound);
+            append_sample(out, family, sample_name, sample_labels, counts[i]);
+        }
+
+        sprintf(sample_name, "%s_sum", name);
+        append_sample(out, family, sample_name, labels, sum);
+        sprintf(sample_name, "%s_count", name);
+        append_sample(out, family, sample_name, labels, counts[n]);
+    }
+}
+
+/**
+ * Copy a string without the terminating null character
+ *
+ * @param ptr Where to copy
+ * @param str The string
+ *
+ * @return Pointer past the copied string
+ */
+static char* copy_string(char *ptr, const char *str)
+{
+    size_t len = strlen(str);
+    memcpy(ptr, str, len);
+    return ptr + len;
+}
+
+GWBUF* prometheus_collect()
+{
+    PROMETHEUS_OUTPUT out = {NULL, NULL, NULL, false};
+
+    spinlock_acquire(&collector_lock);
+
+    for (PROMETHEUS_COLLECTOR *entry = collectors; entry; entry = entry->next)
+    {
+        entry->collector(&out, entry->data);
+    }
+
+    spinlock_release(&collector_lock);
+
+    size_t size = 0;
+
+    for (PROMETHEUS_FAMILY *family = out.head; family; family = family->next)
+    {
+        size += strlen("# HELP  \n# TYPE  \n") + 2 * strlen(family->name) +
+                strlen(family->help) + strlen(type_names[family->type]) + family->len;
+    }
+
+    GWBUF *buffer = out.error ? NULL : gwbuf_alloc(size);
+
+    if (buffer)
+    {
+        char *ptr = (char*)GWBUF_DATA(buffer);
+
+        for (PROMETHEUS_FAMILY *family = out.head; family; family = family->next)
+        {
+            ptr = copy_string(ptr, "# HELP ");
+            ptr = copy_string(ptr, family->name);
+            ptr = copy_string(ptr, " ");
+            ptr = copy_string(ptr, family->help);
+            ptr = copy_string(ptr, "\n# TYPE ");
+            ptr = copy_string(ptr, family->name);
+            ptr = copy_string(ptr, " ");
+            ptr = copy_string(ptr, type_names[family->type]);
+            ptr = copy_string(ptr, "\n");
+
+            if (family->len)
+            {
+                memcpy(ptr, family->samples, family->len);
+                ptr += family->len;
+            }
+        }
+
+        ss_dassert(ptr == (char*)GWBUF_DATA(buffer) + size);
+    }
+
+    while (out.head)
+    {
+        PROMETHEUS_FAMILY *family = out.head;
+        out.head = family->next;
+        MXS_FREE(family->name);
+        MXS_FREE(family->help);
+        MXS_FREE(family->samples);
+        MXS_FREE(family);
+    }
+
+    return buffer;
+}
+
+void prometheus_init()
+{
+    prometheus_add_collector(metrics_collect, NULL);
+    prometheus_add_collector(serviceCollectMetrics, NULL);
+    prometheus_add_collector(serverCollectMetrics, NULL);
+    prometheus_add_collector(monitorCollectMetrics, NULL);
+}
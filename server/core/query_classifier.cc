@@ -15,6 +15,7 @@
 #include <maxscale/log_manager.h>
 #include <maxscale/modutil.h>
 #include <maxscale/alloc.h>
+#include <maxscale/latency.h>
 #include <maxscale/platform.h>
 #include <maxscale/pcre2.h>
 #include <maxscale/utils.h>
@@ -31,6 +32,33 @@
 #define QC_TRACE()
 #endif
 
+namespace
+{
+
+/**
+ * Adds the lifetime of the object to the classification time of the thread
+ */
+class QcMeasure
+{
+public:
+    QcMeasure()
+        : m_start(latency_now())
+    {
+    }
+
+    ~QcMeasure()
+    {
+        latency_classify_add(latency_now() - m_start);
+    }
+
+private:
+    uint64_t m_start;
+};
+
+}
+
+#define QC_MEASURE() QcMeasure qc_measure
+
 struct type_name_info
 {
     const char* name;
@@ -181,6 +209,7 @@ void qc_thread_end(uint32_t kind)
 qc_parse_result_t qc_parse(GWBUF* query, uint32_t collect)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     int32_t result = QC_QUERY_INVALID;
@@ -193,6 +222,7 @@ qc_parse_result_t qc_parse(GWBUF* query, uint32_t collect)
 uint32_t qc_get_type_mask(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     uint32_t type_mask = QUERY_TYPE_UNKNOWN;
@@ -205,6 +235,7 @@ uint32_t qc_get_type_mask(GWBUF* query)
 qc_query_op_t qc_get_operation(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     int32_t op = QUERY_OP_UNDEFINED;
@@ -217,6 +248,7 @@ qc_query_op_t qc_get_operation(GWBUF* query)
 char* qc_get_created_table_name(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     char* name = NULL;
@@ -229,6 +261,7 @@ char* qc_get_created_table_name(GWBUF* query)
 bool qc_is_drop_table_query(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     int32_t is_drop_table = 0;
@@ -241,6 +274,7 @@ bool qc_is_drop_table_query(GWBUF* query)
 char** qc_get_table_names(GWBUF* query, int* tblsize, bool fullnames)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     char** names = NULL;
@@ -254,6 +288,7 @@ char** qc_get_table_names(GWBUF* query, int* tblsize, bool fullnames)
 char* qc_get_canonical(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     char *rval;
@@ -278,6 +313,7 @@ char* qc_get_canonical(GWBUF* query)
 bool qc_query_has_clause(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     int32_t has_clause = 0;
@@ -290,6 +326,7 @@ bool qc_query_has_clause(GWBUF* query)
 void qc_get_field_info(GWBUF* query, const QC_FIELD_INFO** infos, size_t* n_infos)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     *infos = NULL;
@@ -304,6 +341,7 @@ void qc_get_field_info(GWBUF* query, const QC_FIELD_INFO** infos, size_t* n_info
 void qc_get_function_info(GWBUF* query, const QC_FUNCTION_INFO** infos, size_t* n_infos)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     *infos = NULL;
@@ -318,6 +356,7 @@ void qc_get_function_info(GWBUF* query, const QC_FUNCTION_INFO** infos, size_t*
 char** qc_get_database_names(GWBUF* query, int* sizep)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     char** names = NULL;
@@ -331,6 +370,7 @@ char** qc_get_database_names(GWBUF* query, int* sizep)
 char* qc_get_prepare_name(GWBUF* query)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     char* name = NULL;
@@ -343,6 +383,7 @@ char* qc_get_prepare_name(GWBUF* query)
 GWBUF* qc_get_preparable_stmt(GWBUF* stmt)
 {
     QC_TRACE();
+    QC_MEASURE();
     ss_dassert(classifier);
 
     GWBUF* preparable_stmt = NULL;
@@ -0,0 +1,575 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file query_digest.c Server-wide statistics of statements grouped by digest
+ *
+ * Every thread that records statistics gets its own shard, a fixed size table
+ * of digests. A shard is only written by its own thread and its lock is only
+ * contended when the statistics are read. When a shard is full, a few of its
+ * entries are sampled and the one executed the least times is evicted.
+ */
+
+#include <maxscale/query_digest.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <maxscale/alloc.h>
+#include <maxscale/hk_heartbeat.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/platform.h>
+#include <maxscale/spinlock.h>
+
+/** Number of hash chains in a shard */
+#define QD_CHAINS           (QUERY_DIGEST_MAX_ENTRIES * 2)
+
+/** How many entries are sampled when looking for one to evict */
+#define QD_EVICTION_SAMPLES 8
+
+#define QD_NONE (-1)
+
+typedef struct qd_entry
+{
+    uint64_t digest;      /**< Hash of the canonical statement */
+    char    *text;        /**< The canonical statement, possibly truncated */
+    int      next;        /**< Next entry in the hash chain */
+    uint64_t calls;       /**< Number of executions */
+    uint64_t errors;      /**< Number of executions that returned an error */
+    uint64_t rows;        /**< Total rows returned */
+    uint64_t bytes;       /**< Total bytes returned */
+    uint64_t total_us;    /**< Total latency */
+    uint64_t min_us;      /**< Lowest latency */
+    uint64_t max_us;      /**< Highest latency */
+    long     last_seen;   /**< Heartbeat of the latest execution */
+    uint32_t histogram[QUERY_DIGEST_HIST_BUCKETS]; /**< Latency histogram */
+} QD_ENTRY;
+
+typedef struct qd_shard
+{
+    SPINLOCK         lock;
+    int              n_entries;
+    uint64_t         evictions;
+    uint64_t         rand;
+    int              chains[QD_CHAINS];
+    QD_ENTRY         entries[QUERY_DIGEST_MAX_ENTRIES];
+    struct qd_shard *next;
+} QD_SHARD;
+
+/** All shards, shards are never freed */
+static QD_SHARD *shards = NULL;
+static SPINLOCK shards_lock = SPINLOCK_INIT;
+
+static thread_local QD_SHARD *this_shard = NULL;
+
+uint64_t query_digest_hash(const char *canonical)
+{
+    /** 64-bit FNV-1a */
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned char *p = (const unsigned char*)canonical; *p; p++)
+    {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void qd_shard_clear(QD_SHARD *shard)
+{
+    for (int i = 0; i < shard->n_entries; i++)
+    {
+        MXS_FREE(shard->entries[i].text);
+    }
+
+    shard->n_entries = 0;
+    shard->evictions = 0;
+
+    for (int i = 0; i < QD_CHAINS; i++)
+    {
+        shard->chains[i] = QD_NONE;
+    }
+}
+
+static QD_SHARD* qd_get_shard()
+{
+    if (this_shard == NULL)
+    {
+        QD_SHARD *shard = MXS_CALLOC(1, sizeof(QD_SHARD));
+
+        if (shard)
+        {
+            spinlock_init(&shard->lock);
+            shard->rand = (uintptr_t)shard;
+            qd_shard_clear(shard);
+
+            spinlock_acquire(&shards_lock);
+            shard->next = shards;
+            shards = shard;
+            spinlock_release(&shards_lock);
+
+            this_shard = shard;
+        }
+    }
+
+    return this_shard;
+}
+
+static inline int qd_chain(uint64_t digest)
+{
+    return digest % QD_CHAINS;
+}
+
+/**
+ * Remove an entry from its hash chain and free its text. The caller must
+ * reuse the slot.
+ */
+static void qd_unlink(QD_SHARD *shard, int idx)
+{
+    int *link = &shard->chains[qd_chain(shard->entries[idx].digest)];
+
+    while (*link != idx)
+    {
+        ss_dassert(*link != QD_NONE);
+        link = &shard->entries[*link].next;
+    }
+
+    *link = shard->entries[idx].next;
+    MXS_FREE(shard->entries[idx].text);
+    shard->entries[idx].text = NULL;
+}
+
+/**
+ * Find a slot for a new entry, evicting an old entry if the shard is full
+ */
+static int qd_alloc_entry(QD_SHARD *shard)
+{
+    if (shard->n_entries < QUERY_DIGEST_MAX_ENTRIES)
+    {
+        return shard->n_entries++;
+    }
+
+    int victim = QD_NONE;
+
+    for (int i = 0; i < QD_EVICTION_SAMPLES; i++)
+    {
+        shard->rand = shard->rand * 6364136223846793005ULL + 1442695040888963407ULL;
+        int idx = (shard->rand >> 33) % QUERY_DIGEST_MAX_ENTRIES;
+        QD_ENTRY *e = &shard->entries[idx];
+
+        if (victim == QD_NONE ||
+            e->calls < shard->entries[victim].calls ||
+            (e->calls == shard->entries[victim].calls &&
+             e->last_seen < shard->entries[victim].last_seen))
+        {
+            victim = idx;
+        }
+    }
+
+    qd_unlink(shard, victim);
+    shard->evictions++;
+    return victim;
+}
+
+static inline int qd_histogram_bucket(uint64_t latency_us)
+{
+    int bucket = 0;
+
+    while (latency_us > 1 && bucket < QUERY_DIGEST_HIST_BUCKETS - 1)
+    {
+        latency_us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void query_digest_record(const char *canonical, uint64_t latency_us,
+                         uint64_t rows, uint64_t bytes, bool error)
+{
+    QD_SHARD *shard = qd_get_shard();
+
+    if (shard == NULL)
+    {
+        return;
+    }
+
+    uint64_t digest = query_digest_hash(canonical);
+
+    spinlock_acquire(&shard->lock);
+
+    int idx = shard->chains[qd_chain(digest)];
+
+    while (idx != QD_NONE && shard->entries[idx].digest != digest)
+    {
+        idx = shard->entries[idx].next;
+    }
+
+    if (idx == QD_NONE)
+    {
+        char *text = MXS_STRNDUP(canonical, QUERY_DIGEST_MAX_TEXT);
+
+        if (text == NULL)
+        {
+            spinlock_release(&shard->lock);
+            return;
+        }
+
+        idx = qd_alloc_entry(shard);
+        QD_ENTRY *e = &shard->entries[idx];
+        memset(e, 0, sizeof(*e));
+        e->digest = digest;
+        e->text = text;
+        e->min_us = UINT64_MAX;
+        e->next = shard->chains[qd_chain(digest)];
+        shard->chains[qd_chain(digest)] = idx;
+    }
+
+    QD_ENTRY *e = &shard->entries[idx];
+    e->calls++;
+    e->errors += error ? 1 : 0;
+    e->rows += rows;
+    e->bytes += bytes;
+    e->total_us += latency_us;
+    e->last_seen = hkheartbeat;
+
+    if (latency_us < e->min_us)
+    {
+        e->min_us = latency_us;
+    }
+
+    if (latency_us > e->max_us)
+    {
+        e->max_us = latency_us;
+    }
+
+    e->histogram[qd_histogram_bucket(latency_us)]++;
+
+    spinlock_release(&shard->lock);
+}
+
+void query_digest_reset()
+{
+    spinlock_acquire(&shards_lock);
+
+    for (QD_SHARD *shard = shards; shard; shard = shard->next)
+    {
+        spinlock_acquire(&shard->lock);
+        qd_shard_clear(shard);
+        spinlock_release(&shard->lock);
+    }
+
+    spinlock_release(&shards_lock);
+}
+
+static int qd_cmp_digest(const void *a, const void *b)
+{
+    const QD_ENTRY *ea = (const QD_ENTRY*)a;
+    const QD_ENTRY *eb = (const QD_ENTRY*)b;
+    return ea->digest < eb->digest ? -1 : ea->digest > eb->digest ? 1 : 0;
+}
+
+static int qd_cmp_total(const void *a, const void *b)
+{
+    const QD_ENTRY *ea = (const QD_ENTRY*)a;
+    const QD_ENTRY *eb = (const QD_ENTRY*)b;
+    return ea->total_us > eb->total_us ? -1 : ea->total_us < eb->total_us ? 1 : 0;
+}
+
+/**
+ * A merged copy of all shards
+ */
+typedef struct qd_snapshot
+{
+    QD_ENTRY *entries;
+    int       n_entries;
+    uint64_t  evictions;
+    int       row; /**< Next row of a result set */
+} QD_SNAPSHOT;
+
+static void qd_snapshot_free(QD_SNAPSHOT *snapshot)
+{
+    for (int i = 0; i < snapshot->n_entries; i++)
+    {
+        MXS_FREE(snapshot->entries[i].text);
+    }
+
+    MXS_FREE(snapshot->entries);
+    MXS_FREE(snapshot);
+}
+
+/**
+ * Copy all shards and merge the entries of the same digest
+ *
+ * @return The merged entries, ordered by the total execution time
+ */
+static QD_SNAPSHOT* qd_snapshot_create()
+{
+    QD_SNAPSHOT *snapshot = MXS_CALLOC(1, sizeof(QD_SNAPSHOT));
+
+    if (snapshot == NULL)
+    {
+        return NULL;
+    }
+
+    spinlock_acquire(&shards_lock);
+
+    int n_shards = 0;
+
+    for (QD_SHARD *shard = shards; shard; shard = shard->next)
+    {
+        n_shards++;
+    }
+
+    QD_ENTRY *entries = NULL;
+    int n = 0;
+
+    if (n_shards && (entries = MXS_MALLOC(n_shards * QUERY_DIGEST_MAX_ENTRIES * sizeof(QD_ENTRY))))
+    {
+        for (QD_SHARD *shard = shards; shard; shard = shard->next)
+        {
+            spinlock_acquire(&shard->lock);
+            memcpy(entries + n, shard->entries, shard->n_entries * sizeof(QD_ENTRY));
+
+            for (int i = 0; i < shard->n_entries; i++)
+            {
+                /** A NULL text is handled when the entries are printed */
+                entries[n + i].text = MXS_STRDUP(shard->entries[i].text);
+            }
+
+            n += shard->n_entries;
+            snapshot->evictions += shard->evictions;
+            spinlock_release(&shard->lock);
+        }
+    }
+
+    spinlock_release(&shards_lock);
+
+    if (n > 0)
+    {
+        qsort(entries, n, sizeof(QD_ENTRY), qd_cmp_digest);
+
+        int out = 0;
+
+        for (int i = 1; i < n; i++)
+        {
+            QD_ENTRY *dest = &entries[out];
+            QD_ENTRY *src = &entries[i];
+
+            if (src->digest == dest->digest)
+            {
+                dest->calls += src->calls;
+                dest->errors += src->errors;
+                dest->rows += src->rows;
+                dest->bytes += src->bytes;
+                dest->total_us += src->total_us;
+                dest->min_us = src->min_us < dest->min_us ? src->min_us : dest->min_us;
+                dest->max_us = src->max_us > dest->max_us ? src->max_us : dest->max_us;
+                dest->last_seen = src->last_seen > dest->last_seen ? src->last_seen : dest->last_seen;
+
+                for (int b = 0; b < QUERY_DIGEST_HIST_BUCKETS; b++)
+                {
+                    dest->histogram[b] += src->histogram[b];
+                }
+
+                if (dest->text == NULL)
+                {
+                    dest->text = src->text;
+                }
+                else
+                {
+                    MXS_FREE(src->text);
+                }
+            }
+            else
+            {
+                entries[++out] = *src;
+            }
+        }
+
+        n = out + 1;
+        qsort(entries, n, sizeof(QD_ENTRY), qd_cmp_total);
+    }
+
+    snapshot->entries = entries;
+    snapshot->n_entries = n;
+    return snapshot;
+}
+
+/**
+ * Estimate a percentile from the histogram
+ *
+ * @return The upper bound of the bucket the percentile falls into, in microseconds
+ */
+static uint64_t qd_percentile(const QD_ENTRY *e, int percentile)
+{
+    uint64_t target = (e->calls * percentile + 99) / 100;
+    uint64_t count = 0;
+
+    for (int b = 0; b < QUERY_DIGEST_HIST_BUCKETS - 1; b++)
+    {
+        count += e->histogram[b];
+
+        if (count >= target)
+        {
+            uint64_t bound = 2ULL << b;
+            return bound < e->max_us ? bound : e->max_us;
+        }
+    }
+
+    return e->max_us;
+}
+
+void dShowQueryDigests(DCB *dcb)
+{
+    QD_SNAPSHOT *snapshot = qd_snapshot_create();
+
+    if (snapshot == NULL)
+    {
+        return;
+    }
+
+    dcb_printf(dcb, "Digests: %d (%" PRIu64 " evicted)\n\n",
+               snapshot->n_entries, snapshot->evictions);
+    dcb_printf(dcb, "%-16s | %10s | %8s | %12s | %10s | %10s | %10s | %10s | %12s | %s\n",
+               "Digest", "Calls", "Errors", "Total (ms)", "Avg (ms)", "Max (ms)",
+               "P99 (ms)", "Rows", "Bytes", "Statement");
+    dcb_printf(dcb, "-----------------+------------+----------+--------------+------------+"
+               "------------+------------+------------+--------------+----------\n");
+
+    for (int i = 0; i < snapshot->n_entries; i++)
+    {
+        QD_ENTRY *e = &snapshot->entries[i];
+        dcb_printf(dcb, "%016" PRIx64 " | %10" PRIu64 " | %8" PRIu64 " | %12.3f | %10.3f | "
+                   "%10.3f | %10.3f | %10" PRIu64 " | %12" PRIu64 " | %s\n",
+                   e->digest, e->calls, e->errors,
+                   e->total_us / 1000.0,
+                   e->total_us / 1000.0 / e->calls,
+                   e->max_us / 1000.0,
+                   qd_percentile(e, 99) / 1000.0,
+                   e->rows, e->bytes,
+                   e->text ? e->text : "");
+    }
+
+    qd_snapshot_free(snapshot);
+}
+
+/**
+ * Provide a row to the result set that lists the digests
+ *
+ * @param set   The result set
+ * @param data  The snapshot of the statistics
+ * @return The next row or NULL
+ */
+static RESULT_ROW* queryDigestRowCallback(RESULTSET *set, void *data)
+{
+    QD_SNAPSHOT *snapshot = (QD_SNAPSHOT*)data;
+
+    if (snapshot->row >= snapshot->n_entries)
+    {
+        qd_snapshot_free(snapshot);
+        return NULL;
+    }
+
+    QD_ENTRY *e = &snapshot->entries[snapshot->row++];
+    RESULT_ROW *row = resultset_make_row(set);
+    char buf[80];
+    int col = 0;
+
+    snprintf(buf, sizeof(buf), "%016" PRIx64, e->digest);
+    resultset_row_set(row, col++, buf);
+    resultset_row_set(row, col++, e->text ? e->text : "");
+    snprintf(buf, sizeof(buf), "%" PRIu64, e->calls);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%" PRIu64, e->errors);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", e->total_us / 1000.0);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", e->min_us / 1000.0);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", e->total_us / 1000.0 / e->calls);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", e->max_us / 1000.0);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", qd_percentile(e, 50) / 1000.0);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", qd_percentile(e, 95) / 1000.0);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%.3f", qd_percentile(e, 99) / 1000.0);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%" PRIu64, e->rows);
+    resultset_row_set(row, col++, buf);
+    snprintf(buf, sizeof(buf), "%" PRIu64, e->bytes);
+    resultset_row_set(row, col++, buf);
+
+    /** The histogram as a list of non-empty buckets, each bucket is given as
+     * its upper bound in microseconds and the number of statements in it */
+    char hist[QUERY_DIGEST_HIST_BUCKETS * 24] = "";
+    size_t len = 0;
+
+    for (int b = 0; b < QUERY_DIGEST_HIST_BUCKETS; b++)
+    {
+        if (e->histogram[b])
+        {
+            if (b < QUERY_DIGEST_HIST_BUCKETS - 1)
+            {
+                len += snprintf(hist + len, sizeof(hist) - len, "%s%llu:%u", len ? "," : "",
+                                2ULL << b, e->histogram[b]);
+            }
+            else
+            {
+                len += snprintf(hist + len, sizeof(hist) - len, "%sinf:%u", len ? "," : "",
+                                e->histogram[b]);
+            }
+        }
+    }
+
+    resultset_row_set(row, col++, hist);
+
+    return row;
+}
+
+RESULTSET* queryDigestGetList()
+{
+    QD_SNAPSHOT *snapshot = qd_snapshot_create();
+    RESULTSET *set;
+
+    if (snapshot == NULL)
+    {
+        return NULL;
+    }
+
+    if ((set = resultset_create(queryDigestRowCallback, snapshot)) == NULL)
+    {
+        qd_snapshot_free(snapshot);
+        return NULL;
+    }
+
+    resultset_add_column(set, "Digest", 16, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Statement", QUERY_DIGEST_MAX_TEXT, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Calls", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Errors", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Total_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Min_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Avg_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Max_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "P50_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "P95_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "P99_ms", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Rows", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Bytes", 20, COL_TYPE_VARCHAR);
+    resultset_add_column(set, "Histogram", 512, COL_TYPE_VARCHAR);
+
+    return set;
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file registry.c - Lock-free name indexes of the global objects
+ *
+ * An index is an open addressing hash table with linear probing. The table has
+ * at least twice as many slots as there are objects so the probe sequences are
+ * short and the table always has empty slots.
+ */
+
+#include "maxscale/registry.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+#include <maxscale/poll.h>
+
+#include "maxscale/config.h"
+
+#define REGISTRY_MIN_SLOTS 8
+
+typedef struct registry_entry
+{
+    uint32_t hash;   /**< Hash of the name */
+    char    *name;   /**< Copy of the name, NULL for an empty slot */
+    void    *object; /**< The object */
+} REGISTRY_ENTRY;
+
+struct registry_index
+{
+    size_t          mask;    /**< Number of slots minus one */
+    size_t          count;   /**< Number of objects in the index */
+    size_t          max;     /**< Number of objects the index was allocated for */
+    REGISTRY_ENTRY *entries; /**< The slots */
+};
+
+/** A replaced index that is freed once all workers have processed a message */
+typedef struct registry_release
+{
+    REGISTRY_INDEX *index;   /**< The replaced index */
+    int             pending; /**< Number of workers that may still use the index */
+} REGISTRY_RELEASE;
+
+static SPINLOCK registries_lock = SPINLOCK_INIT;
+static REGISTRY *registries = NULL; /**< The registries that registry_start() builds */
+static bool started = false;        /**< Whether registry_start() has been called */
+
+/** The FNV-1a hash of a name */
+static uint32_t registry_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char *ptr = (const unsigned char*)name; *ptr; ptr++)
+    {
+        hash = (hash ^ *ptr) * 16777619u;
+    }
+
+    return hash;
+}
+
+REGISTRY_INDEX* registry_index_alloc(size_t count)
+{
+    size_t slots = REGISTRY_MIN_SLOTS;
+
+    while (slots < count * 2)
+    {
+        slots *= 2;
+    }
+
+    REGISTRY_INDEX *index = MXS_MALLOC(sizeof(*index));
+    REGISTRY_ENTRY *entries = MXS_CALLOC(slots, sizeof(*entries));
+
+    if (index == NULL || entries == NULL)
+    {
+        MXS_FREE(index);
+        MXS_FREE(entries);
+        return NULL;
+    }
+
+    index->mask = slots - 1;
+    index->count = 0;
+    index->max = count;
+    index->entries = entries;
+
+    return index;
+}
+
+bool registry_index_add(REGISTRY_INDEX *index, const char *name, void *object)
+{
+    if (index->count == index->max)
+    {
+        /** More objects were added than the index was allocated for */
+        return false;
+    }
+
+    uint32_t hash = registry_hash(name);
+    size_t slot = hash & index->mask;
+
+    while (index->entries[slot].name)
+    {
+        if (index->entries[slot].hash == hash && strcmp(index->entries[slot].name, name) == 0)
+        {
+            /** The first object with the name is the one that is found */
+            return true;
+        }
+
+        slot = (slot + 1) & index->mask;
+    }
+
+    char *copy = MXS_STRDUP(name);
+
+    if (copy == NULL)
+    {
+        return false;
+    }
+
+    index->entries[slot].hash = hash;
+    index->entries[slot].name = copy;
+    index->entries[slot].object = object;
+    index->count++;
+
+    return true;
+}
+
+void registry_index_free(REGISTRY_INDEX *index)
+{
+    if (index)
+    {
+        for (size_t i = 0; i <= index->mask; i++)
+        {
+            MXS_FREE(index->entries[i].name);
+        }
+
+        MXS_FREE(index->entries);
+        MXS_FREE(index);
+    }
+}
+
+REGISTRY_INDEX* registry_publish(REGISTRY *registry, REGISTRY_INDEX *index)
+{
+    REGISTRY_INDEX *old = atomic_load_ptr((void**)&registry->current);
+    atomic_store_ptr((void**)&registry->current, index);
+    return old;
+}
+
+/** Build an index of the objects in the list of a registry */
+static REGISTRY_INDEX* registry_build(REGISTRY *registry)
+{
+    size_t count = 0;
+    const char *name;
+
+    for (void *object = registry->iterate(NULL, &name); object;
+         object = registry->iterate(object, &name))
+    {
+        count++;
+    }
+
+    REGISTRY_INDEX *index = registry_index_alloc(count);
+    bool ok = index != NULL;
+
+    for (void *object = registry->iterate(NULL, &name); ok && object;
+         object = registry->iterate(object, &name))
+    {
+        ok = registry_index_add(index, name, object);
+    }
+
+    if (!ok)
+    {
+        registry_index_free(index);
+        index = NULL;
+    }
+
+    return index;
+}
+
+static void registry_release_task(void *data)
+{
+    REGISTRY_RELEASE *release = (REGISTRY_RELEASE*)data;
+
+    if (atomic_add(&release->pending, -1) == 1)
+    {
+        registry_index_free(release->index);
+        MXS_FREE(release);
+    }
+}
+
+/**
+ * Free a replaced index once every worker has processed a message posted after
+ * the replacement. A worker does not look up names while it processes messages.
+ */
+static void registry_retire(REGISTRY_INDEX *index)
+{
+    int n_threads = config_threadcount();
+    REGISTRY_RELEASE *release = MXS_MALLOC(sizeof(*release));
+
+    if (release == NULL)
+    {
+        /** Leaking the index is safer than freeing it while it may be in use */
+        return;
+    }
+
+    release->index = index;
+    release->pending = n_threads + 1;
+
+    for (int i = 0; i < n_threads; i++)
+    {
+        if (!poll_post_task(i, registry_release_task, release))
+        {
+            atomic_add(&release->pending, -1);
+        }
+    }
+
+    /** Drop the reference of this thread, the index is freed if nothing was posted */
+    registry_release_task(release);
+}
+
+void registry_update(REGISTRY *registry)
+{
+    spinlock_acquire(&registries_lock);
+    bool build = started;
+
+    if (!started && !registry->listed)
+    {
+        registry->listed = true;
+        registry->next = registries;
+        registries = registry;
+    }
+
+    spinlock_release(&registries_lock);
+
+    if (build)
+    {
+        REGISTRY_INDEX *old = registry_publish(registry, registry_build(registry));
+
+        if (old)
+        {
+            registry_retire(old);
+        }
+    }
+}
+
+void registry_start()
+{
+    spinlock_acquire(&registries_lock);
+    started = true;
+    REGISTRY *list = registries;
+    spinlock_release(&registries_lock);
+
+    for (REGISTRY *registry = list; registry; registry = registry->next)
+    {
+        spinlock_acquire(registry->lock);
+        REGISTRY_INDEX *old = registry_publish(registry, registry_build(registry));
+        spinlock_release(registry->lock);
+
+        if (old)
+        {
+            registry_retire(old);
+        }
+    }
+}
+
+bool registry_find(REGISTRY *registry, const char *name, void **object)
+{
+    REGISTRY_INDEX *index = atomic_load_ptr((void**)&registry->current);
+
+    if (index == NULL)
+    {
+        return false;
+    }
+
+    uint32_t hash = registry_hash(name);
+    size_t slot = hash & index->mask;
+
+    *object = NULL;
+
+    while (index->entries[slot].name)
+    {
+        if (index->entries[slot].hash == hash && strcmp(index->entries[slot].name, name) == 0)
+        {
+            *object = index->entries[slot].object;
+            break;
+        }
+
+        slot = (slot + 1) & index->mask;
+    }
+
+    return true;
+}
+
+void registry_clear(REGISTRY *registry)
+{
+    registry_index_free(registry_publish(registry, NULL));
+}
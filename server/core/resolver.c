@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file resolver.c  Asynchronous, cached host name resolution
+ *
+ * The worker threads must never block on name resolution. All host names
+ * are resolved by a background thread and the results are stored in a cache.
+ * The worker threads only consult the cache. Entries older than the TTL are
+ * refreshed in the background while the old address is still being served.
+ *
+ * Servers whose address cannot be resolved are marked with SERVER_DNS_ERROR
+ * so that the routers stop using them until the address is resolved again.
+ */
+
+#include "maxscale/resolver.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <time.h>
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+#include <maxscale/config.h>
+#include <maxscale/hashtable.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/semaphore.h>
+#include <maxscale/server.h>
+#include <maxscale/spinlock.h>
+#include <maxscale/thread.h>
+
+/** How often failed resolutions are retried, in seconds */
+#define RESOLVER_RETRY_INTERVAL 1
+
+/** Entries that have not been used for this many TTLs are removed */
+#define RESOLVER_EVICT_TTLS 10
+
+/** Size of the hashtable */
+#define RESOLVER_HASHTABLE_SIZE 101
+
+/**
+ * A cached host name
+ */
+typedef struct resolver_entry
+{
+    struct sockaddr_storage addr; /**< The resolved address */
+    bool   valid;                 /**< Whether addr holds a resolved address */
+    int    error;                 /**< Error of the last resolution, 0 on success */
+    time_t resolved;              /**< When the host was last resolved */
+    time_t last_used;             /**< When the entry was last looked up */
+    bool   pending;               /**< Whether the host has not been resolved yet */
+} RESOLVER_ENTRY;
+
+/**
+ * The cache. All access to the table and the entries is done while holding
+ * resolver_lock. The lock is never held while resolving a name.
+ */
+static HASHTABLE *resolver_table = NULL;
+static SPINLOCK resolver_lock = SPINLOCK_INIT;
+
+static RESOLVER_STATS resolver_stats;
+
+static THREAD resolver_thr;
+static sem_t resolver_sem;
+static bool resolver_running = false;
+static bool do_shutdown = false;
+
+static void resolver_thread(void *data);
+
+static RESOLVER_ENTRY* entry_alloc()
+{
+    RESOLVER_ENTRY *entry = (RESOLVER_ENTRY*)MXS_CALLOC(1, sizeof(RESOLVER_ENTRY));
+
+    if (entry)
+    {
+        entry->pending = true;
+        entry->last_used = time(NULL);
+    }
+
+    return entry;
+}
+
+/**
+ * Get the cache, allocating it if needed. Must be called while holding
+ * resolver_lock.
+ */
+static HASHTABLE* get_table()
+{
+    if (resolver_table == NULL)
+    {
+        resolver_table = hashtable_alloc(RESOLVER_HASHTABLE_SIZE, hashtable_item_strhash,
+                                         hashtable_item_strcmp);
+
+        if (resolver_table)
+        {
+            hashtable_memory_fns(resolver_table, hashtable_item_strdup, NULL,
+                                 hashtable_item_free, hashtable_item_free);
+        }
+    }
+
+    return resolver_table;
+}
+
+/**
+ * Convert a numeric address without consulting the resolver.
+ *
+ * @param host Host name
+ * @param addr Where the address is stored
+ * @return True if @c host was a numeric IPv4 or IPv6 address
+ */
+static bool resolve_numeric(const char *host, struct sockaddr_storage *addr)
+{
+    struct sockaddr_in *in4 = (struct sockaddr_in*)addr;
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6*)addr;
+    bool rval = false;
+
+    memset(addr, 0, sizeof(*addr));
+
+    if (inet_pton(AF_INET, host, &in4->sin_addr) == 1)
+    {
+        in4->sin_family = AF_INET;
+        rval = true;
+    }
+    else if (inet_pton(AF_INET6, host, &in6->sin6_addr) == 1)
+    {
+        in6->sin6_family = AF_INET6;
+        rval = true;
+    }
+
+    return rval;
+}
+
+/**
+ * Get an entry, adding it if it doesn't exist. Must be called while holding
+ * resolver_lock.
+ *
+ * @param host Host name
+ * @param added Set to true if the entry was added
+ * @return The entry or NULL on memory allocation failure
+ */
+static RESOLVER_ENTRY* get_entry(const char *host, bool *added)
+{
+    HASHTABLE *table = get_table();
+    RESOLVER_ENTRY *entry = NULL;
+    *added = false;
+
+    if (table)
+    {
+        entry = (RESOLVER_ENTRY*)hashtable_fetch(table, (void*)host);
+
+        if (entry == NULL && (entry = entry_alloc()))
+        {
+            if (hashtable_add(table, (void*)host, entry))
+            {
+                *added = true;
+            }
+            else
+            {
+                MXS_FREE(entry);
+                entry = NULL;
+            }
+        }
+    }
+
+    return entry;
+}
+
+mxs_resolve_result_t resolver_lookup(const char *host, struct sockaddr_storage *addr)
+{
+    if (resolve_numeric(host, addr))
+    {
+        return MXS_RESOLVE_OK;
+    }
+
+    mxs_resolve_result_t rval = MXS_RESOLVE_PENDING;
+    time_t now = time(NULL);
+    time_t ttl = config_get_global_options()->dns_cache_ttl;
+    bool added = false;
+
+    spinlock_acquire(&resolver_lock);
+
+    RESOLVER_ENTRY *entry = get_entry(host, &added);
+
+    if (entry)
+    {
+        entry->last_used = now;
+
+        if (entry->valid)
+        {
+            memcpy(addr, &entry->addr, sizeof(*addr));
+            resolver_stats.hits++;
+
+            if (entry->resolved + ttl <= now)
+            {
+                resolver_stats.stale_hits++;
+            }
+
+            rval = MXS_RESOLVE_OK;
+        }
+        else if (!entry->pending)
+        {
+            resolver_stats.failures++;
+            rval = MXS_RESOLVE_FAILED;
+        }
+        else
+        {
+            resolver_stats.misses++;
+        }
+    }
+    else
+    {
+        rval = MXS_RESOLVE_FAILED;
+    }
+
+    spinlock_release(&resolver_lock);
+
+    if (added && resolver_running)
+    {
+        /** Wake up the resolver thread so that the new host is resolved immediately */
+        sem_post(&resolver_sem);
+    }
+
+    return rval;
+}
+
+void resolver_prefetch(const char *host)
+{
+    struct sockaddr_storage addr;
+
+    if (!resolve_numeric(host, &addr))
+    {
+        bool added;
+        spinlock_acquire(&resolver_lock);
+        get_entry(host, &added);
+        spinlock_release(&resolver_lock);
+
+        if (added && resolver_running)
+        {
+            sem_post(&resolver_sem);
+        }
+    }
+}
+
+void resolver_get_stats(RESOLVER_STATS *stats)
+{
+    spinlock_acquire(&resolver_lock);
+    *stats = resolver_stats;
+    stats->entries = resolver_table ? hashtable_size(resolver_table) : 0;
+    spinlock_release(&resolver_lock);
+}
+
+/** A cache entry copied for printing */
+typedef struct resolver_row
+{
+    char host[256];                 /**< The host name, at most 253 characters */
+    char addr[INET6_ADDRSTRLEN];    /**< The address or the state of the entry */
+    long age;                       /**< Seconds since the host was resolved, -1 if never */
+} RESOLVER_ROW;
+
+/**
+ * Copy the cache entries so that they can be printed without holding the lock
+ *
+ * @param rows Set to the copied entries, must be freed by the caller
+ * @return Number of copied entries
+ */
+static int resolver_copy_entries(RESOLVER_ROW **rows)
+{
+    spinlock_acquire(&resolver_lock);
+    int n_max = resolver_table ? hashtable_size(resolver_table) : 0;
+    spinlock_release(&resolver_lock);
+
+    *rows = n_max > 0 ? (RESOLVER_ROW*)MXS_MALLOC(n_max * sizeof(RESOLVER_ROW)) : NULL;
+
+    if (*rows == NULL)
+    {
+        return 0;
+    }
+
+    int n_rows = 0;
+    time_t now = time(NULL);
+
+    spinlock_acquire(&resolver_lock);
+    HASHITERATOR *iter = resolver_table ? hashtable_iterator(resolver_table) : NULL;
+
+    if (iter)
+    {
+        char *host;
+
+        while (n_rows < n_max && (host = (char*)hashtable_next(iter)))
+        {
+            RESOLVER_ENTRY *entry = (RESOLVER_ENTRY*)hashtable_fetch(resolver_table, host);
+            RESOLVER_ROW *row = &(*rows)[n_rows++];
+
+            snprintf(row->host, sizeof(row->host), "%s", host);
+
+            if (entry->valid)
+            {
+                const void *src = entry->addr.ss_family == AF_INET ?
+                                  (const void*)&((struct sockaddr_in*)&entry->addr)->sin_addr :
+                                  (const void*)&((struct sockaddr_in6*)&entry->addr)->sin6_addr;
+                inet_ntop(entry->addr.ss_family, src, row->addr, sizeof(row->addr));
+            }
+            else
+            {
+                strcpy(row->addr, entry->pending ? "(pending)" : "(unresolved)");
+            }
+
+            row->age = entry->resolved ? (long)(now - entry->resolved) : -1L;
+        }
+
+        hashtable_iterator_free(iter);
+    }
+
+    spinlock_release(&resolver_lock);
+
+    return n_rows;
+}
+
+void dprintResolverStats(DCB *dcb)
+{
+    RESOLVER_STATS stats;
+    resolver_get_stats(&stats);
+
+    dcb_printf(dcb, "DNS cache TTL:                 %ld seconds\n",
+               (long)config_get_global_options()->dns_cache_ttl);
+    dcb_printf(dcb, "Cached host names:             %d\n", stats.entries);
+    dcb_printf(dcb, "Cache hits:                    %lu\n", stats.hits);
+    dcb_printf(dcb, "Cache hits on stale entries:   %lu\n", stats.stale_hits);
+    dcb_printf(dcb, "Cache misses:                  %lu\n", stats.misses);
+    dcb_printf(dcb, "Lookups of unresolvable hosts: %lu\n", stats.failures);
+    dcb_printf(dcb, "Background resolutions:        %lu\n", stats.resolutions);
+    dcb_printf(dcb, "Failed resolutions:            %lu\n", stats.errors);
+
+    /** dcb_printf() may block or allocate, the lock is not held while printing */
+    RESOLVER_ROW *rows;
+    int n_rows = resolver_copy_entries(&rows);
+
+    if (n_rows > 0)
+    {
+        dcb_printf(dcb, "\n%-40s | %-40s | Age\n", "Host", "Address");
+        dcb_printf(dcb, "-----------------------------------------+"
+                   "------------------------------------------+-------\n");
+
+        for (int i = 0; i < n_rows; i++)
+        {
+            dcb_printf(dcb, "%-40s | %-40s | %ld\n", rows[i].host, rows[i].addr, rows[i].age);
+        }
+    }
+
+    MXS_FREE(rows);
+}
+
+/**
+ * A host that the resolver thread should resolve
+ */
+typedef struct resolver_work
+{
+    char *host;
+    struct resolver_work *next;
+} RESOLVER_WORK;
+
+/**
+ * Collect the hosts that need to be resolved and remove unused entries.
+ *
+ * @param now Current time
+ * @param ttl Cache TTL
+ * @return List of hosts to resolve
+ */
+static RESOLVER_WORK* collect_work(time_t now, time_t ttl)
+{
+    RESOLVER_WORK *work = NULL;
+
+    spinlock_acquire(&resolver_lock);
+
+    if (resolver_table)
+    {
+        HASHITERATOR *iter = hashtable_iterator(resolver_table);
+        char *host;
+
+        while (iter && (host = (char*)hashtable_next(iter)))
+        {
+            RESOLVER_ENTRY *entry = (RESOLVER_ENTRY*)hashtable_fetch(resolver_table, host);
+            bool resolve = entry->pending ||
+                           (entry->valid && entry->resolved + ttl <= now) ||
+                           (!entry->valid && entry->resolved + RESOLVER_RETRY_INTERVAL <= now);
+
+            if (!entry->pending && entry->last_used + RESOLVER_EVICT_TTLS * ttl <= now)
+            {
+                /** Unused entries are not refreshed, they are removed once they expire */
+                resolve = false;
+            }
+
+            if (resolve)
+            {
+                RESOLVER_WORK *item = (RESOLVER_WORK*)MXS_MALLOC(sizeof(RESOLVER_WORK));
+
+                if (item && (item->host = MXS_STRDUP(host)))
+                {
+                    item->next = work;
+                    work = item;
+                }
+                else
+                {
+                    MXS_FREE(item);
+                }
+            }
+        }
+
+        hashtable_iterator_free(iter);
+    }
+
+    spinlock_release(&resolver_lock);
+
+    return work;
+}
+
+/**
+ * Remove entries that have not been used for a long time
+ *
+ * @param now Current time
+ * @param ttl Cache TTL
+ */
+static void evict_unused(time_t now, time_t ttl)
+{
+    RESOLVER_WORK *evict = NULL;
+
+    spinlock_acquire(&resolver_lock);
+
+    if (resolver_table)
+    {
+        HASHITERATOR *iter = hashtable_iterator(resolver_table);
+        char *host;
+
+        while (iter && (host = (char*)hashtable_next(iter)))
+        {
+            RESOLVER_ENTRY *entry = (RESOLVER_ENTRY*)hashtable_fetch(resolver_table, host);
+
+            if (!entry->pending && entry->last_used + RESOLVER_EVICT_TTLS * ttl <= now &&
+                entry->resolved + ttl <= now)
+            {
+                RESOLVER_WORK *item = (RESOLVER_WORK*)MXS_MALLOC(sizeof(RESOLVER_WORK));
+
+                if (item && (item->host = MXS_STRDUP(host)))
+                {
+                    item->next = evict;
+                    evict = item;
+                }
+                else
+                {
+                    MXS_FREE(item);
+                }
+            }
+        }
+
+        hashtable_iterator_free(iter);
+
+        for (RESOLVER_WORK *item = evict; item; item = item->next)
+        {
+            hashtable_delete(resolver_table, item->host);
+        }
+    }
+
+    spinlock_release(&resolver_lock);
+
+    while (evict)
+    {
+        RESOLVER_WORK *next = evict->next;
+        MXS_FREE(evict->host);
+        MXS_FREE(evict);
+        evict = next;
+    }
+}
+
+/**
+ * Resolve one host and store the result in the cache
+ *
+ * @param host Host name
+ */
+static void resolve_host(const char *host)
+{
+    struct addrinfo *ai = NULL, hint = {};
+    hint.ai_socktype = SOCK_STREAM;
+    hint.ai_family = AF_UNSPEC;
+    hint.ai_flags = AI_ALL;
+
+    int rc = getaddrinfo(host, NULL, &hint, &ai);
+    time_t now = time(NULL);
+    bool was_valid = false;
+
+    spinlock_acquire(&resolver_lock);
+
+    RESOLVER_ENTRY *entry = resolver_table ?
+                            (RESOLVER_ENTRY*)hashtable_fetch(resolver_table, (void*)host) : NULL;
+
+    if (entry)
+    {
+        was_valid = entry->valid;
+        entry->resolved = now;
+        entry->pending = false;
+        entry->error = rc;
+        resolver_stats.resolutions++;
+
+        if (rc == 0 && ai)
+        {
+            /* Take the first one */
+            memset(&entry->addr, 0, sizeof(entry->addr));
+            memcpy(&entry->addr, ai->ai_addr, ai->ai_addrlen);
+            entry->valid = true;
+        }
+        else
+        {
+            /** A previously resolved address is kept until the entry is evicted */
+            resolver_stats.errors++;
+        }
+    }
+
+    spinlock_release(&resolver_lock);
+
+    if (ai)
+    {
+        freeaddrinfo(ai);
+    }
+
+    if (rc != 0)
+    {
+        if (was_valid)
+        {
+            MXS_WARNING("Failed to refresh address for host %s, using the previously "
+                        "resolved address: %s", host, gai_strerror(rc));
+        }
+        else
+        {
+            MXS_ERROR("Failed to obtain address for host %s: %s", host, gai_strerror(rc));
+        }
+    }
+
+    server_set_dns_error(host, rc != 0 && !was_valid);
+}
+
+static void resolver_thread(void *data)
+{
+    sem_t *init_sem = (sem_t*)data;
+
+    while (!do_shutdown)
+    {
+        time_t now = time(NULL);
+        time_t ttl = config_get_global_options()->dns_cache_ttl;
+        RESOLVER_WORK *work = collect_work(now, ttl);
+
+        while (work)
+        {
+            RESOLVER_WORK *next = work->next;
+            resolve_host(work->host);
+            MXS_FREE(work->host);
+            MXS_FREE(work);
+            work = next;
+        }
+
+        evict_unused(now, ttl);
+
+        if (init_sem)
+        {
+            /** The hosts known at startup have been resolved */
+            sem_post(init_sem);
+            init_sem = NULL;
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += RESOLVER_RETRY_INTERVAL;
+        sem_timedwait(&resolver_sem, &ts);
+    }
+
+    MXS_NOTICE("Resolver shutting down.");
+}
+
+bool resolver_init()
+{
+    sem_t init_sem;
+    sem_init(&init_sem, 0, 0);
+    sem_init(&resolver_sem, 0, 0);
+
+    if (thread_start(&resolver_thr, resolver_thread, &init_sem) != NULL)
+    {
+        resolver_running = true;
+        sem_wait(&init_sem);
+    }
+    else
+    {
+        MXS_ALERT("Failed to start resolver thread.");
+    }
+
+    sem_destroy(&init_sem);
+    return resolver_running;
+}
+
+void resolver_shutdown()
+{
+    do_shutdown = true;
+    atomic_synchronize();
+
+    if (resolver_running)
+    {
+        sem_post(&resolver_sem);
+    }
+}
+
+void resolver_finish()
+{
+    ss_dassert(do_shutdown);
+
+    if (resolver_running)
+    {
+        thread_wait(resolver_thr);
+        resolver_running = false;
+        sem_destroy(&resolver_sem);
+    }
+}
@@ -33,11 +33,14 @@
  * @endverbatim
  */
 #include <stdio.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <maxscale/atomic.h>
 #include <maxscale/service.h>
 #include <maxscale/session.h>
 #include <maxscale/server.h>
@@ -49,14 +52,22 @@
 #include <maxscale/alloc.h>
 #include <maxscale/paths.h>
 
+#include "maxscale/latency.h"
 #include "maxscale/monitor.h"
 #include "maxscale/poll.h"
+#include "maxscale/registry.h"
+#include "maxscale/resolver.h"
 
 /** The latin1 charset */
 #define SERVER_DEFAULT_CHARSET 0x08
 
+/** A new response time has this share of the moving average, as a divisor */
+#define SERVER_RESPONSE_TIME_DECAY 8
+
 static SPINLOCK server_spin = SPINLOCK_INIT;
 static SERVER *allServers = NULL;
+static void* server_registry_next(void *object, const char **name);
+static REGISTRY server_registry = REGISTRY_INIT(server_registry_next, &server_spin); /**< Index of the active servers */
 
 static void spin_reporter(void *, char *, int);
 static void server_parameter_free(SERVER_PARAM *tofree);
@@ -134,6 +145,9 @@ SERVER* server_alloc(const char *name, const char *address, unsigned short port,
     server->persistmax = 0;
     server->persistmaxtime = 0;
     server->persistpoolmax = 0;
+    server->compression = false;
+    server->gtid_pos[0] = '\0';
+    spinlock_init(&server->gtid_lock);
     server->monuser[0] = '\0';
     server->monpw[0] = '\0';
     server->is_active = true;
@@ -146,8 +160,11 @@ SERVER* server_alloc(const char *name, const char *address, unsigned short port,
     spinlock_acquire(&server_spin);
     server->next = allServers;
     allServers = server;
+    registry_update(&server_registry);
     spinlock_release(&server_spin);
 
+    resolver_prefetch(server->name);
+
     return server;
 }
 
@@ -181,6 +198,7 @@ server_free(SERVER *tofreeserver)
             server->next = tofreeserver->next;
         }
     }
+    registry_update(&server_registry);
     spinlock_release(&server_spin);
 
     /* Clean up session and free the memory */
@@ -188,6 +206,7 @@ server_free(SERVER *tofreeserver)
     MXS_FREE(tofreeserver->unique_name);
     MXS_FREE(tofreeserver->server_string);
     server_parameter_free(tofreeserver->parameters);
+    latency_stats_free(tofreeserver->latency);
 
     if (tofreeserver->persistent)
     {
@@ -274,6 +293,27 @@ static inline SERVER* next_active_server(SERVER *server)
     return server;
 }
 
+/** Iterate over the active servers for the registry, called with the lock held */
+static void* server_registry_next(void *object, const char **name)
+{
+    SERVER *server = next_active_server(object ? ((SERVER*)object)->next : allServers);
+
+    if (server)
+    {
+        *name = server->unique_name;
+    }
+
+    return server;
+}
+
+void server_set_active(SERVER *server, bool active)
+{
+    spinlock_acquire(&server_spin);
+    server->is_active = active;
+    registry_update(&server_registry);
+    spinlock_release(&server_spin);
+}
+
 /**
  * @brief Find a server with the specified name
  *
@@ -282,6 +322,13 @@ static inline SERVER* next_active_server(SERVER *server)
  */
 SERVER * server_find_by_unique_name(const char *name)
 {
+    void *found;
+
+    if (registry_find(&server_registry, name, &found))
+    {
+        return found;
+    }
+
     spinlock_acquire(&server_spin);
     SERVER *server = next_active_server(allServers);
 
@@ -560,6 +607,7 @@ dprintServer(DCB *dcb, const SERVER *server)
     dcb_printf(dcb, "\tNumber of connections:               %d\n", server->stats.n_connections);
     dcb_printf(dcb, "\tCurrent no. of conns:                %d\n", server->stats.n_current);
     dcb_printf(dcb, "\tCurrent no. of operations:           %d\n", server->stats.n_current_ops);
+    dcb_printf(dcb, "\tAverage response time (us):          %" PRId64 "\n", server->stats.response_time);
     if (server->persistpoolmax)
     {
         dcb_printf(dcb, "\tPersistent pool size:                %d\n", server->stats.n_persistent);
@@ -572,6 +620,10 @@ dprintServer(DCB *dcb, const SERVER *server)
         double d =  (double)server->stats.n_from_pool / (double)(server->stats.n_connections + server->stats.n_from_pool + 1);
         dcb_printf(dcb, "\tPool availability:                   %0.2lf%%\n", d * 100.0);
     }
+    if (server->compression)
+    {
+        dcb_printf(dcb, "\tCompressed protocol:                 Enabled\n");
+    }
     if (server->server_ssl)
     {
         SSL_LISTENER *l = server->server_ssl;
@@ -713,6 +765,10 @@ server_status(const SERVER *server)
     {
         strcat(status, "Auth Error, ");
     }
+    if (server_status & SERVER_DNS_ERROR)
+    {
+        strcat(status, "DNS Error, ");
+    }
     if (server_status & SERVER_RUNNING)
     {
         strcat(status, "Running");
@@ -1013,6 +1069,141 @@ serverGetList()
     return set;
 }
 
+/** The stages that are recorded for servers */
+#define SERVER_LATENCY_FIRST    LATENCY_STAGE_BACKEND
+#define SERVER_LATENCY_STAGES   (LATENCY_STAGE_MAX - LATENCY_STAGE_BACKEND)
+
+/**
+ * Print the backend and reply latency of all servers
+ *
+ * @param dcb   DCB to print data to
+ */
+void
+dprintServerLatency(DCB *dcb)
+{
+    dcb_printf(dcb, "%-20s | %-8s | %12s | %10s | %10s | %10s | %10s | %10s\n",
+               "Server", "Stage", "Count", "Avg (us)", "P50 (us)", "P99 (us)",
+               "P99.9 (us)", "Max (us)");
+    dcb_printf(dcb, "---------------------+----------+--------------+------------+"
+               "------------+------------+------------+-----------\n");
+
+    spinlock_acquire(&server_spin);
+    SERVER *server = next_active_server(allServers);
+
+    while (server)
+    {
+        latency_stats_print(dcb, server->unique_name, server->latency,
+                            SERVER_LATENCY_FIRST, LATENCY_STAGE_MAX - 1);
+        server = next_active_server(server->next);
+    }
+
+    spinlock_release(&server_spin);
+}
+
+/**
+ * Add the metrics of all servers to Prometheus output
+ *
+ * @param out   The output
+ * @param data  Not used
+ */
+void
+serverCollectMetrics(PROMETHEUS_OUTPUT *out, void *data)
+{
+    spinlock_acquire(&server_spin);
+    SERVER *server = next_active_server(allServers);
+
+    while (server)
+    {
+        char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+        prometheus_label(labels, "server", server->unique_name);
+
+        prometheus_sample(out, "maxscale_server_up", PROMETHEUS_GAUGE,
+                          "Whether the server is running", labels,
+                          SERVER_IS_RUNNING(server) ? 1 : 0);
+        prometheus_sample(out, "maxscale_server_connections_total", PROMETHEUS_COUNTER,
+                          "Number of connections created to the server", labels,
+                          server->stats.n_connections);
+        prometheus_sample(out, "maxscale_server_connections", PROMETHEUS_GAUGE,
+                          "Current number of connections to the server", labels,
+                          server->stats.n_current);
+        prometheus_sample(out, "maxscale_server_operations", PROMETHEUS_GAUGE,
+                          "Current number of operations on the server", labels,
+                          server->stats.n_current_ops);
+        prometheus_sample(out, "maxscale_server_response_time_seconds", PROMETHEUS_GAUGE,
+                          "Moving average of the response time of the server", labels,
+                          server->stats.response_time / 1000000.0);
+        prometheus_sample(out, "maxscale_server_pooled_connections", PROMETHEUS_GAUGE,
+                          "Current number of connections in the connection pool", labels,
+                          server->stats.n_persistent);
+        latency_stats_collect(out, "maxscale_server_latency_seconds", labels, server->latency,
+                              SERVER_LATENCY_FIRST, LATENCY_STAGE_MAX - 1);
+        server = next_active_server(server->next);
+    }
+
+    spinlock_release(&server_spin);
+}
+
+/**
+ * Provide a row to the result set that defines the latency of servers
+ *
+ * @param set   The result set
+ * @param data  The index of the row to send
+ * @return The next row or NULL
+ */
+static RESULT_ROW *
+serverLatencyRowCallback(RESULTSET *set, void *data)
+{
+    int *rowno = (int *)data;
+    int i = 0;
+    RESULT_ROW *row;
+    SERVER *server;
+
+    spinlock_acquire(&server_spin);
+    server = next_active_server(allServers);
+    while (i < *rowno / SERVER_LATENCY_STAGES && server)
+    {
+        i++;
+        server = next_active_server(server->next);
+    }
+    if (server == NULL)
+    {
+        spinlock_release(&server_spin);
+        MXS_FREE(data);
+        return NULL;
+    }
+    row = latency_make_row(set, server->unique_name, server->latency,
+                           SERVER_LATENCY_FIRST + *rowno % SERVER_LATENCY_STAGES);
+    (*rowno)++;
+    spinlock_release(&server_spin);
+    return row;
+}
+
+/**
+ * Return a result set with the backend and reply latency of all servers
+ *
+ * @return A Result set
+ */
+RESULTSET *
+serverGetLatencyList()
+{
+    RESULTSET *set;
+    int *data;
+
+    if ((data = (int *)MXS_MALLOC(sizeof(int))) == NULL)
+    {
+        return NULL;
+    }
+    *data = 0;
+    if ((set = resultset_create(serverLatencyRowCallback, data)) == NULL)
+    {
+        MXS_FREE(data);
+        return NULL;
+    }
+    latency_add_columns(set);
+
+    return set;
+}
+
 /*
  * Update the address value of a specific server
  *
@@ -1029,6 +1220,11 @@ server_update_address(SERVER *server, const char *address)
         strcpy(server->name, address);
     }
     spinlock_release(&server_spin);
+
+    if (server && address)
+    {
+        resolver_prefetch(address);
+    }
 }
 
 /*
@@ -1113,6 +1309,113 @@ bool server_set_version_string(SERVER* server, const char* string)
     return rval;
 }
 
+void server_add_response_time(SERVER *server, uint64_t us)
+{
+    /**
+     * Until there are enough samples the average of all samples is used so
+     * that the first samples are not weighted towards zero.
+     */
+    uint64_t n = atomic_add_uint64(&server->stats.n_responses, 1);
+    int64_t divisor = n < SERVER_RESPONSE_TIME_DECAY ? n + 1 : SERVER_RESPONSE_TIME_DECAY;
+    int64_t average = server->stats.response_time;
+
+    /**
+     * Concurrent updates all add their share of the difference, none of them
+     * is lost even if they were computed from the same old average.
+     */
+    atomic_add_int64(&server->stats.response_time, ((int64_t)us - average) / divisor);
+}
+
+void server_set_gtid_pos(SERVER *server, const char *gtid_pos)
+{
+    spinlock_acquire(&server->gtid_lock);
+    strncpy(server->gtid_pos, gtid_pos, sizeof(server->gtid_pos) - 1);
+    server->gtid_pos[sizeof(server->gtid_pos) - 1] = '\0';
+    spinlock_release(&server->gtid_lock);
+}
+
+/**
+ * Parse the next GTID from a comma separated list of MariaDB GTIDs
+ *
+ * @param str      Pointer to the list, advanced past the parsed GTID
+ * @param domain   The replication domain of the GTID
+ * @param sequence The sequence number of the GTID
+ * @return True if a GTID was parsed
+ */
+static bool gtid_parse_next(const char **str, unsigned long *domain, unsigned long long *sequence)
+{
+    const char *ptr = *str;
+
+    while (*ptr == ',' || isspace(*ptr))
+    {
+        ptr++;
+    }
+
+    char *end;
+    *domain = strtoul(ptr, &end, 10);
+
+    if (end == ptr || *end != '-')
+    {
+        return false;
+    }
+
+    /** The server ID does not affect the ordering of GTIDs */
+    ptr = end + 1;
+    strtoul(ptr, &end, 10);
+
+    if (end == ptr || *end != '-')
+    {
+        return false;
+    }
+
+    ptr = end + 1;
+    *sequence = strtoull(ptr, &end, 10);
+
+    if (end == ptr || (*end && *end != ',' && !isspace(*end)))
+    {
+        return false;
+    }
+
+    *str = end;
+    return true;
+}
+
+bool server_has_gtid(SERVER *server, const char *gtid)
+{
+    char pos[MAX_SERVER_GTID_POS_LEN];
+    spinlock_acquire(&server->gtid_lock);
+    strcpy(pos, server->gtid_pos);
+    spinlock_release(&server->gtid_lock);
+
+    unsigned long domain;
+    unsigned long long sequence;
+    bool rval = false;
+
+    while (gtid_parse_next(&gtid, &domain, &sequence))
+    {
+        const char *ptr = pos;
+        unsigned long pos_domain;
+        unsigned long long pos_sequence;
+        rval = false;
+
+        while (gtid_parse_next(&ptr, &pos_domain, &pos_sequence))
+        {
+            if (pos_domain == domain)
+            {
+                rval = pos_sequence >= sequence;
+                break;
+            }
+        }
+
+        if (!rval)
+        {
+            break;
+        }
+    }
+
+    return rval;
+}
+
 /**
  * Creates a server configuration at the location pointed by @c filename
  *
@@ -1161,6 +1464,11 @@ static bool create_server_config(const SERVER *server, const char *filename)
         dprintf(file, "persistmaxtime=%ld\n", server->persistmaxtime);
     }
 
+    if (server->compression)
+    {
+        dprintf(file, "compression=true\n");
+    }
+
     for (SERVER_PARAM *p = server->parameters; p; p = p->next)
     {
         if (p->active)
@@ -1318,3 +1626,65 @@ bool server_is_mxs_service(const SERVER *server)
 
     return rval;
 }
+
+void server_set_dns_error(const char *address, bool error)
+{
+    int n_servers = 0;
+
+    spinlock_acquire(&server_spin);
+    for (SERVER *server = allServers; server; server = server->next)
+    {
+        n_servers++;
+    }
+
+    SERVER *servers[n_servers + 1];
+    int n_found = 0;
+
+    /** Servers are never freed so the pointers stay valid after the lock is released */
+    for (SERVER *server = allServers; server && n_found < n_servers; server = server->next)
+    {
+        if (server->is_active && strcmp(server->name, address) == 0)
+        {
+            servers[n_found++] = server;
+        }
+    }
+    spinlock_release(&server_spin);
+
+    for (int i = 0; i < n_found; i++)
+    {
+        SERVER *server = servers[i];
+
+        /**
+         * A monitor holds the server lock for its whole loop, starts the loop
+         * from status_pending and stores the result in both status and
+         * status_pending. Changing both under the lock keeps the monitor from
+         * losing the bit or bringing it back.
+         */
+        spinlock_acquire(&server->lock);
+        bool changed = ((server->status & SERVER_DNS_ERROR) != 0) != error;
+
+        if (error)
+        {
+            server->status |= SERVER_DNS_ERROR;
+            server->status_pending |= SERVER_DNS_ERROR;
+        }
+        else
+        {
+            server->status &= ~SERVER_DNS_ERROR;
+            server->status_pending &= ~SERVER_DNS_ERROR;
+        }
+        spinlock_release(&server->lock);
+
+        if (changed && error)
+        {
+            MXS_ERROR("Address '%s' of server '%s' could not be resolved, the server "
+                      "will not be used until the address is resolved.",
+                      address, server->unique_name);
+        }
+        else if (changed)
+        {
+            MXS_NOTICE("Address '%s' of server '%s' was resolved.",
+                       address, server->unique_name);
+        }
+    }
+}
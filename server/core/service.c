@@ -48,6 +48,8 @@
 #include <sys/types.h>
 #include <math.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <mysql.h>
 #include <maxscale/alloc.h>
 #include <maxscale/dcb.h>
 #include <maxscale/paths.h>
@@ -68,8 +70,10 @@
 
 #include "maxscale/config.h"
 #include "maxscale/filter.h"
+#include "maxscale/latency.h"
 #include "maxscale/modules.h"
 #include "maxscale/queuemanager.h"
+#include "maxscale/registry.h"
 #include "maxscale/service.h"
 
 /** Base value for server weights */
@@ -98,6 +102,8 @@ typelib_t sqlvar_target_type =
 
 static SPINLOCK service_spin = SPINLOCK_INIT;
 static SERVICE  *allServices = NULL;
+static void* service_registry_next(void *object, const char **name);
+static REGISTRY service_registry = REGISTRY_INIT(service_registry_next, &service_spin); /**< Index of the services */
 
 static int find_type(typelib_t* tl, const char* needle, int maxlen);
 
@@ -106,6 +112,9 @@ static void service_add_qualified_param(SERVICE*          svc,
 static void service_internal_restart(void *data);
 static void service_queue_check(void *data);
 static void service_calculate_weights(SERVICE *service);
+static bool service_wake_users_loader(SERVICE *service);
+static void service_refresh_stale_users(SERVICE *service);
+static void service_stop_users_loader(SERVICE *service);
 
 SERVICE* service_alloc(const char *name, const char *router)
 {
@@ -173,10 +182,13 @@ SERVICE* service_alloc(const char *name, const char *router)
     service->stats.n_failed_starts = 0;
     service->state = SERVICE_STATE_ALLOC;
     spinlock_init(&service->spin);
+    sem_init(&service->users_loader.sem, 0, 0);
+    spinlock_init(&service->users_loader.lock);
 
     spinlock_acquire(&service_spin);
     service->next = allServices;
     allServices = service;
+    registry_update(&service_registry);
     spinlock_release(&service_spin);
 
     return service;
@@ -330,6 +342,12 @@ serviceStartPort(SERVICE *service, SERV_LISTENER *port)
                         " might not work.", service->name, port->name);
             break;
 
+        case MXS_AUTH_LOADUSERS_CACHED:
+            MXS_NOTICE("[%s] Using the users persisted by the previous run for listener '%s', "
+                       "the users are reloaded in the background.", service->name, port->name);
+            service->users_loader.stale = true;
+            break;
+
         default:
             break;
         }
@@ -396,6 +414,8 @@ int serviceStartAllPorts(SERVICE* service)
             port = port->next;
         }
 
+        service_refresh_stale_users(service);
+
         if (service->state == SERVICE_STATE_FAILED)
         {
             listeners = 0;
@@ -567,6 +587,8 @@ bool serviceLaunchListener(SERVICE *service, SERV_LISTENER *port)
         rval = false;
     }
 
+    service_refresh_stale_users(service);
+
     spinlock_release(&service->spin);
 
     return rval;
@@ -724,8 +746,13 @@ void service_free(SERVICE *service)
             ptr->next = service->next;
         }
     }
+    registry_update(&service_registry);
     spinlock_release(&service_spin);
 
+    service->svc_do_shutdown = true;
+    service_stop_users_loader(service);
+    sem_destroy(&service->users_loader.sem);
+
     /* Clean up session and free the memory */
     while (service->dbref)
     {
@@ -734,6 +761,8 @@ void service_free(SERVICE *service)
         MXS_FREE(srv);
     }
 
+    latency_stats_free(service->latency);
+    filter_chain_free(service->filter_chain);
     MXS_FREE(service->name);
     MXS_FREE(service->routerModule);
     MXS_FREE(service->weightby);
@@ -1135,6 +1164,9 @@ serviceSetTimeout(SERVICE *service, int val)
         dcb_enable_session_timeouts();
     }
 
+    /** The connections that already exist use the new timeout as well */
+    dcb_update_idle_timeouts(service);
+
     return 1;
 }
 
@@ -1270,10 +1302,18 @@ serviceSetFilters(SERVICE *service, char *filters)
         ptr = strtok_r(NULL, "|", &brkt);
     }
 
+    FILTER_CHAIN *chain = NULL;
+
+    if (rval && (chain = filter_chain_compile(flist, n)) == NULL)
+    {
+        rval = false;
+    }
+
     if (rval)
     {
         service->filters = flist;
         service->n_filters = n;
+        service->filter_chain = chain;
         service->capabilities |= capabilities;
     }
     else
@@ -1284,6 +1324,19 @@ serviceSetFilters(SERVICE *service, char *filters)
     return rval;
 }
 
+/** Iterate over the services for the registry, called with the lock held */
+static void* service_registry_next(void *object, const char **name)
+{
+    SERVICE *service = object ? ((SERVICE*)object)->next : allServices;
+
+    if (service)
+    {
+        *name = service->name;
+    }
+
+    return service;
+}
+
 /**
  * Return a named service
  *
@@ -1294,6 +1347,12 @@ SERVICE *
 service_find(const char *servname)
 {
     SERVICE *service;
+    void *found;
+
+    if (registry_find(&service_registry, servname, &found))
+    {
+        return found;
+    }
 
     spinlock_acquire(&service_spin);
     service = allServices;
@@ -1457,6 +1516,20 @@ void dprintService(DCB *dcb, SERVICE *service)
                service->stats.n_sessions);
     dcb_printf(dcb, "\tCurrently connected:                 %d\n",
                service->stats.n_current);
+
+    for (SERV_LISTENER *port = service->ports; port; port = port->next)
+    {
+        int64_t events = mxs_metric_get(port->stats.batches);
+        int64_t accepted = mxs_metric_get(port->stats.n_accepted);
+
+        dcb_printf(dcb, "\tListener %s:\n", port->name);
+        dcb_printf(dcb, "\t\tAccepted connections:        %" PRId64 "\n", accepted);
+        dcb_printf(dcb, "\t\tFailed accepts:              %" PRId64 "\n",
+                   mxs_metric_get(port->stats.n_errors));
+        dcb_printf(dcb, "\t\tAccept events:               %" PRId64 "\n", events);
+        dcb_printf(dcb, "\t\tConnections per event:       %.1f\n",
+                   events ? (double)accepted / events : 0.0);
+    }
 }
 
 /**
@@ -1605,6 +1678,77 @@ service_update(SERVICE *service, char *router, char *user, char *auth)
     }
 }
 
+/**
+ * Check whether the users of a service may be reloaded now and if they may,
+ * start a new refresh rate limit period. Must be called while holding the
+ * service spinlock.
+ *
+ * @param service The service
+ * @return True if the users may be reloaded
+ */
+static bool service_users_refresh_allowed(SERVICE *service)
+{
+    time_t now = time(NULL);
+    MXS_CONFIG* config = config_get_global_options();
+
+    /* Check if refresh rate limit has been exceeded */
+    if (now < service->rate_limit.last + config->users_refresh_time)
+    {
+        if (!service->rate_limit.warned)
+        {
+            MXS_WARNING("[%s] Refresh rate limit (once every %ld seconds) exceeded for "
+                        "load of users' table.",
+                        service->name, config->users_refresh_time);
+            service->rate_limit.warned = true;
+        }
+
+        return false;
+    }
+
+    service->rate_limit.last = now;
+    service->rate_limit.warned = false;
+
+    return true;
+}
+
+/**
+ * Load the users of all listeners of a service
+ *
+ * @param service The service
+ * @return 0 on success and 1 on error
+ */
+static int service_load_users(SERVICE *service)
+{
+    int ret = 0;
+
+    for (SERV_LISTENER *port = service->ports; port; port = port->next)
+    {
+        /** Load the authentication users before before starting the listener */
+        if (port->listener && port->listener->authfunc.loadusers)
+        {
+            switch (port->listener->authfunc.loadusers(port))
+            {
+            case MXS_AUTH_LOADUSERS_FATAL:
+                MXS_ERROR("[%s] Fatal error when loading users for listener '%s',"
+                          " authentication will not work.", service->name, port->name);
+                ret = 1;
+                break;
+
+            case MXS_AUTH_LOADUSERS_ERROR:
+                MXS_WARNING("[%s] Failed to load users for listener '%s', authentication"
+                            " might not work.", service->name, port->name);
+                ret = 1;
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
 /**
  * Refresh the database users for the service
  * This function replaces the MySQL users used by the service with the latest
@@ -1620,51 +1764,58 @@ int service_refresh_users(SERVICE *service)
 
     if (spinlock_acquire_nowait(&service->spin))
     {
-        time_t now = time(NULL);
-        MXS_CONFIG* config = config_get_global_options();
-
-        /* Check if refresh rate limit has been exceeded */
-        if (now < service->rate_limit.last + config->users_refresh_time)
+        if (service_users_refresh_allowed(service))
         {
-            if (!service->rate_limit.warned)
-            {
-                MXS_WARNING("[%s] Refresh rate limit (once every %ld seconds) exceeded for "
-                            "load of users' table.",
-                            service->name, config->users_refresh_time);
-                service->rate_limit.warned = true;
-            }
+            ret = service_load_users(service);
         }
-        else
+
+        spinlock_release(&service->spin);
+    }
+
+    return ret;
+}
+
+/**
+ * The thread that reloads the users of a service when requested
+ *
+ * @param data The service
+ */
+static void service_users_loader(void *data)
+{
+    SERVICE *service = (SERVICE*)data;
+
+    if (mysql_thread_init())
+    {
+        MXS_ERROR("[%s] mysql_thread_init failed in the users loader. Exiting.", service->name);
+        return;
+    }
+
+    while (true)
+    {
+        sem_wait(&service->users_loader.sem);
+
+        if (service->svc_do_shutdown)
         {
-            service->rate_limit.last = now;
-            service->rate_limit.warned = false;
+            break;
+        }
 
-            ret = 0;
+        service_load_users(service);
+    }
 
-            for (SERV_LISTENER *port = service->ports; port; port = port->next)
-            {
-                /** Load the authentication users before before starting the listener */
-                if (port->listener && port->listener->authfunc.loadusers)
-                {
-                    switch (port->listener->authfunc.loadusers(port))
-                    {
-                    case MXS_AUTH_LOADUSERS_FATAL:
-                        MXS_ERROR("[%s] Fatal error when loading users for listener '%s',"
-                                  " authentication will not work.", service->name, port->name);
-                        ret = 1;
-                        break;
+    mysql_thread_end();
+}
 
-                    case MXS_AUTH_LOADUSERS_ERROR:
-                        MXS_WARNING("[%s] Failed to load users for listener '%s', authentication"
-                                    " might not work.", service->name, port->name);
-                        ret = 1;
-                        break;
+int service_refresh_users_async(SERVICE *service)
+{
+    ss_dassert(service);
+    int ret = 1;
 
-                    default:
-                        break;
-                    }
-                }
-            }
+    if (spinlock_acquire_nowait(&service->spin))
+    {
+        if (!service->svc_do_shutdown && service_users_refresh_allowed(service) &&
+            service_wake_users_loader(service))
+        {
+            ret = 0;
         }
 
         spinlock_release(&service->spin);
@@ -1673,6 +1824,80 @@ int service_refresh_users(SERVICE *service)
     return ret;
 }
 
+/**
+ * Wake up the users loader of a service, starting it if needed
+ *
+ * @param service The service
+ * @return True if the loader will reload the users
+ */
+static bool service_wake_users_loader(SERVICE *service)
+{
+    SERVICE_USERS_LOADER *loader = &service->users_loader;
+
+    spinlock_acquire(&loader->lock);
+
+    if (!loader->running && !service->svc_do_shutdown)
+    {
+        if (thread_start(&loader->thread, service_users_loader, service))
+        {
+            loader->running = true;
+        }
+        else
+        {
+            MXS_ERROR("[%s] Failed to start the thread that loads the users.", service->name);
+        }
+    }
+
+    bool rval = loader->running;
+
+    if (rval)
+    {
+        sem_post(&loader->sem);
+    }
+
+    spinlock_release(&loader->lock);
+
+    return rval;
+}
+
+/**
+ * Reload the users in the background if a listener was started with the
+ * users persisted by the previous run. This is done regardless of the refresh
+ * rate limit once all listeners that are being started have been started.
+ *
+ * @param service The service
+ */
+static void service_refresh_stale_users(SERVICE *service)
+{
+    if (service->users_loader.stale && !config_get_global_options()->config_check)
+    {
+        service->users_loader.stale = false;
+        service_wake_users_loader(service);
+    }
+}
+
+/**
+ * Wait for the users loader of a service to exit. The service must be
+ * shutting down.
+ *
+ * @param service The service
+ */
+static void service_stop_users_loader(SERVICE *service)
+{
+    ss_dassert(service->svc_do_shutdown);
+
+    spinlock_acquire(&service->users_loader.lock);
+    bool running = service->users_loader.running;
+    service->users_loader.running = false;
+    spinlock_release(&service->users_loader.lock);
+
+    if (running)
+    {
+        sem_post(&service->users_loader.sem);
+        thread_wait(service->users_loader.thread);
+    }
+}
+
 void service_add_parameters(SERVICE *service, const MXS_CONFIG_PARAMETER *param)
 {
     while (param)
@@ -1860,6 +2085,7 @@ void service_destroy_instances(void)
     while (svc != NULL)
     {
         ss_dassert(svc->svc_do_shutdown);
+        service_stop_users_loader(svc);
         /* Call destroyInstance hook for routers */
         if (svc->router->destroyInstance && svc->router_instance)
         {
@@ -2068,6 +2294,127 @@ serviceGetList()
     return set;
 }
 
+/**
+ * Print the per-stage latency of all services
+ *
+ * @param dcb   DCB to print data to
+ */
+void
+dprintServiceLatency(DCB *dcb)
+{
+    dcb_printf(dcb, "%-20s | %-8s | %12s | %10s | %10s | %10s | %10s | %10s\n",
+               "Service", "Stage", "Count", "Avg (us)", "P50 (us)", "P99 (us)",
+               "P99.9 (us)", "Max (us)");
+    dcb_printf(dcb, "---------------------+----------+--------------+------------+"
+               "------------+------------+------------+-----------\n");
+
+    spinlock_acquire(&service_spin);
+
+    for (SERVICE *service = allServices; service; service = service->next)
+    {
+        latency_stats_print(dcb, service->name, service->latency,
+                            0, LATENCY_STAGE_MAX - 1);
+    }
+
+    spinlock_release(&service_spin);
+}
+
+/**
+ * Add the metrics of all services to Prometheus output
+ *
+ * @param out   The output
+ * @param data  Not used
+ */
+void
+serviceCollectMetrics(PROMETHEUS_OUTPUT *out, void *data)
+{
+    int sessions = 0;
+
+    spinlock_acquire(&service_spin);
+
+    for (SERVICE *service = allServices; service; service = service->next)
+    {
+        char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+        prometheus_label(labels, "service", service->name);
+        prometheus_label(labels, "router", service->routerModule);
+
+        prometheus_sample(out, "maxscale_service_sessions_total", PROMETHEUS_COUNTER,
+                          "Number of sessions created on the service", labels,
+                          service->stats.n_sessions);
+        prometheus_sample(out, "maxscale_service_sessions", PROMETHEUS_GAUGE,
+                          "Current number of sessions of the service", labels,
+                          service->stats.n_current);
+        latency_stats_collect(out, "maxscale_service_latency_seconds", labels,
+                              service->latency, 0, LATENCY_STAGE_MAX - 1);
+        sessions += service->stats.n_current;
+    }
+
+    spinlock_release(&service_spin);
+
+    prometheus_sample(out, "maxscale_sessions", PROMETHEUS_GAUGE,
+                      "Current number of sessions", NULL, sessions);
+}
+
+/**
+ * Provide a row to the result set that defines the latency of services
+ *
+ * @param set   The result set
+ * @param data  The index of the row to send
+ * @return The next row or NULL
+ */
+static RESULT_ROW *
+serviceLatencyRowCallback(RESULTSET *set, void *data)
+{
+    int *rowno = (int *)data;
+    int i = 0;
+    RESULT_ROW *row;
+    SERVICE *service;
+
+    spinlock_acquire(&service_spin);
+    service = allServices;
+    while (i < *rowno / LATENCY_STAGE_MAX && service)
+    {
+        i++;
+        service = service->next;
+    }
+    if (service == NULL)
+    {
+        spinlock_release(&service_spin);
+        MXS_FREE(data);
+        return NULL;
+    }
+    row = latency_make_row(set, service->name, service->latency, *rowno % LATENCY_STAGE_MAX);
+    (*rowno)++;
+    spinlock_release(&service_spin);
+    return row;
+}
+
+/**
+ * Return a result set with the per-stage latency of all services
+ *
+ * @return A Result set
+ */
+RESULTSET *
+serviceGetLatencyList()
+{
+    RESULTSET *set;
+    int *data;
+
+    if ((data = (int *)MXS_MALLOC(sizeof(int))) == NULL)
+    {
+        return NULL;
+    }
+    *data = 0;
+    if ((set = resultset_create(serviceLatencyRowCallback, data)) == NULL)
+    {
+        MXS_FREE(data);
+        return NULL;
+    }
+    latency_add_columns(set);
+
+    return set;
+}
+
 /**
  * Function called by the housekeeper thread to retry starting of a service
  * @param data Service to restart
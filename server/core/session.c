@@ -47,6 +47,7 @@
 
 #include "maxscale/session.h"
 #include "maxscale/filter.h"
+#include "maxscale/latency.h"
 
 /* A session with null values, used for initialization */
 static MXS_SESSION session_initialized = SESSION_INIT;
@@ -62,6 +63,7 @@ static void session_simple_free(MXS_SESSION *session, DCB *dcb);
 static void session_add_to_all_list(MXS_SESSION *session);
 static MXS_SESSION *session_find_free();
 static void session_final_free(MXS_SESSION *session);
+static int32_t session_route_to_router(void *instance, void *session, GWBUF *data);
 
 /**
  * @brief Initialize a session
@@ -96,7 +98,12 @@ session_initialize(void *session)
 MXS_SESSION *
 session_alloc(SERVICE *service, DCB *client_dcb)
 {
-    MXS_SESSION *session = (MXS_SESSION *)(MXS_MALLOC(sizeof(*session)));
+    FILTER_CHAIN *chain = service->filter_chain;
+    int n_filters = chain ? chain->n_filters : 0;
+
+    /** The filter sessions are tracked in the same block as the session */
+    MXS_SESSION *session = (MXS_SESSION *)(MXS_MALLOC(sizeof(*session) +
+                                                      n_filters * sizeof(SESSION_FILTER)));
 
     if (NULL == session)
     {
@@ -104,6 +111,12 @@ session_alloc(SERVICE *service, DCB *client_dcb)
     }
     session_initialize(session);
 
+    if (n_filters > 0)
+    {
+        session->filters = (SESSION_FILTER *)(session + 1);
+        memset(session->filters, 0, n_filters * sizeof(SESSION_FILTER));
+    }
+
     /** Assign a session id and increase */
     session->ses_id = (size_t)atomic_add(&session_id, 1) + 1;
     session->ses_is_child = (bool) DCB_IS_CLONE(client_dcb);
@@ -113,6 +126,7 @@ session_alloc(SERVICE *service, DCB *client_dcb)
     session->stmt.buffer = NULL;
     session->stmt.target = NULL;
     session->qualifies_for_pooling = false;
+    session->latency.traced = latency_trace_session();
     /*<
      * Associate the session to the client DCB and set the reference count on
      * the session to indicate that there is a single reference to the
@@ -157,18 +171,21 @@ session_alloc(SERVICE *service, DCB *client_dcb)
          * NB This dictates that filters are created starting at the end
          * of the chain nearest the router working back to the client
          * protocol end of the chain.
+         *
+         * The router is called through session_route_to_router which
+         * measures the time spent in the router.
          */
         session->head.instance = service->router_instance;
-        session->head.session = session->router_session;
+        session->head.session = session;
 
-        session->head.routeQuery = (void *)(service->router->routeQuery);
+        session->head.routeQuery = session_route_to_router;
 
         session->tail.instance = session;
         session->tail.session = session;
         session->tail.clientReply = session_reply;
 
         if (SESSION_STATE_TO_BE_FREED != session->state
-            && service->n_filters > 0
+            && n_filters > 0
             && !session_setup_filters(session))
         {
             session->state = SESSION_STATE_TO_BE_FREED;
@@ -350,7 +367,6 @@ static void session_free(MXS_SESSION *session)
                                                              session->filters[i].session);
             }
         }
-        MXS_FREE(session->filters);
     }
 
     MXS_INFO("Stopped %s client session [%lu]", session->service->name, session->ses_id);
@@ -577,7 +593,9 @@ session_state(mxs_session_state_t state)
  * filter in the chain and working back towards the client connection
  * Each filter is passed the current session head of the filter chain
  * this head becomes the destination for the filter. The newly created
- * filter becomes the new head of the filter chain.
+ * filter becomes the new head of the filter chain unless it does not
+ * implement routeQuery. The upstream chain is built in the same way
+ * from the client connection towards the router with clientReply.
  *
  * @param       session         The session that requires the chain
  * @return      0 if filter creation fails
@@ -585,61 +603,52 @@ session_state(mxs_session_state_t state)
 static int
 session_setup_filters(MXS_SESSION *session)
 {
-    SERVICE *service = session->service;
-    MXS_DOWNSTREAM *head;
-    MXS_UPSTREAM *tail;
+    FILTER_CHAIN *chain = session->service->filter_chain;
     int i;
 
-    if ((session->filters = MXS_CALLOC(service->n_filters,
-                                       sizeof(SESSION_FILTER))) == NULL)
-    {
-        return 0;
-    }
-    session->n_filters = service->n_filters;
-    for (i = service->n_filters - 1; i >= 0; i--)
+    session->n_filters = chain->n_filters;
+
+    /** The chain is built from the router towards the client */
+    for (i = chain->n_filters - 1; i >= 0; i--)
     {
-        if (service->filters[i] == NULL)
+        FILTER_CHAIN_ENTRY *entry = &chain->filters[i];
+        MXS_FILTER_SESSION *fsession = entry->obj->newSession(entry->instance, session);
+
+        if (fsession == NULL)
         {
-            MXS_ERROR("Service '%s' contians an unresolved filter.", service->name);
+            MXS_ERROR("Failed to create filter '%s' for service '%s'.",
+                      entry->filter->name, session->service->name);
             return 0;
         }
-        if ((head = filter_apply(service->filters[i], session,
-                                 &session->head)) == NULL)
+
+        session->filters[i].filter = entry->filter;
+        session->filters[i].instance = entry->instance;
+        session->filters[i].session = fsession;
+
+        entry->obj->setDownstream(entry->instance, fsession, &session->head);
+
+        if (entry->routeQuery)
         {
-            MXS_ERROR("Failed to create filter '%s' for "
-                      "service '%s'.\n",
-                      service->filters[i]->name,
-                      service->name);
-            return 0;
+            session->head.instance = entry->instance;
+            session->head.session = fsession;
+            session->head.routeQuery = (void *)entry->routeQuery;
         }
-        session->filters[i].filter = service->filters[i];
-        session->filters[i].session = head->session;
-        session->filters[i].instance = head->instance;
-        session->head = *head;
-        MXS_FREE(head);
     }
 
-    for (i = 0; i < service->n_filters; i++)
+    for (i = 0; i < chain->n_filters; i++)
     {
-        if ((tail = filter_upstream(service->filters[i],
-                                    session->filters[i].session,
-                                    &session->tail)) == NULL)
+        FILTER_CHAIN_ENTRY *entry = &chain->filters[i];
+
+        if (entry->obj->setUpstream)
         {
-            MXS_ERROR("Failed to create filter '%s' for service '%s'.",
-                      service->filters[i]->name,
-                      service->name);
-            return 0;
+            entry->obj->setUpstream(entry->instance, session->filters[i].session, &session->tail);
         }
 
-        /*
-         * filter_upstream may simply return the 3 parameter if
-         * the filter has no upstream entry point. So no need
-         * to copy the contents or free tail in this case.
-         */
-        if (tail != &session->tail)
+        if (entry->clientReply)
         {
-            session->tail = *tail;
-            MXS_FREE(tail);
+            session->tail.instance = entry->instance;
+            session->tail.session = session->filters[i].session;
+            session->tail.clientReply = (void *)entry->clientReply;
         }
     }
 
@@ -659,9 +668,33 @@ session_reply(void *instance, void *session, GWBUF *data)
 {
     MXS_SESSION *the_session = (MXS_SESSION *)session;
 
+    latency_client_reply(the_session);
+
     return the_session->client_dcb->func.write(the_session->client_dcb, data);
 }
 
+/**
+ * Entry point for the final element in the downstream filter chain, i.e. the
+ * router.
+ *
+ * @param       instance        The router instance
+ * @param       session         The session
+ * @param       data            The statement to route
+ */
+static int32_t
+session_route_to_router(void *instance, void *session, GWBUF *data)
+{
+    MXS_SESSION *the_session = (MXS_SESSION *)session;
+
+    latency_router_begin(the_session);
+
+    int32_t rc = the_session->service->router->routeQuery(instance, the_session->router_session, data);
+
+    latency_router_end(the_session);
+
+    return rc;
+}
+
 /**
  * Return the client connection address or name
  *
@@ -689,7 +722,7 @@ bool session_route_query(MXS_SESSION* ses, GWBUF* buf)
         goto return_succp;
     }
 
-    if (ses->head.routeQuery(ses->head.instance, ses->head.session, buf) == 1)
+    if (MXS_SESSION_ROUTE_QUERY(ses, buf) == 1)
     {
         succp = true;
     }
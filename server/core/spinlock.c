@@ -12,14 +12,201 @@
  */
 
 #include <maxscale/spinlock.h>
-#include <maxscale/atomic.h>
+
+#include <dlfcn.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
 #include <maxscale/debug.h>
+#include <maxscale/platform.h>
+
+/** Lock values: 0 is free, 1 is held and 2 is held with parked waiters. */
+#define SPINLOCK_FREE   0
+#define SPINLOCK_HELD   1
+#define SPINLOCK_PARKED 2
+
+/** How many times to pause while spinning before parking the thread. */
+#define SPINLOCK_MAX_SPINS   2048
+/** The maximum number of pauses between two attempts to take the lock. */
+#define SPINLOCK_MAX_BACKOFF 64
+
+/** One in this many acquisitions of a thread is sampled for profiling. */
+#define SPINLOCK_SAMPLE_RATE  16
+/** Number of distinct locks the profiler can keep track of. */
+#define SPINLOCK_SAMPLE_SLOTS 1024
+/** How many slots are probed before a sample is dropped. */
+#define SPINLOCK_SAMPLE_PROBES 32
+
+#if defined(__i386__) || defined(__x86_64__)
+#define spinlock_pause() __asm__ __volatile__("pause" ::: "memory")
+#elif defined(__aarch64__)
+#define spinlock_pause() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define spinlock_pause() __asm__ __volatile__("" ::: "memory")
+#endif
+
+/**
+ * Sampled acquisitions of one lock. The lock is only used as a key and it
+ * is never dereferenced, as it may have been freed since it was sampled.
+ */
+typedef struct spinlock_sample
+{
+    const SPINLOCK* lock;      /*< The sampled lock, NULL if the slot is free */
+    void*           caller;    /*< Where the lock was first sampled */
+    uint64_t        acquired;  /*< Estimated no. of acquisitions */
+    uint64_t        contended; /*< No. of contended acquisitions */
+} SPINLOCK_SAMPLE;
+
+static volatile bool   spinlock_profiling = false;
+static SPINLOCK_SAMPLE spinlock_samples[SPINLOCK_SAMPLE_SLOTS];
+static uint64_t        spinlock_samples_dropped;
+static thread_local unsigned int spinlock_sample_counter;
+
+static void futex_wait(int* addr, int value)
+{
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(int* addr, int count)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/**
+ * Find the sample slot of a lock, claiming a free slot if the lock has not
+ * been sampled before.
+ *
+ * @param lock   The lock
+ * @param caller Where the lock is being acquired
+ *
+ * @return The slot or NULL if no slot could be found
+ */
+static SPINLOCK_SAMPLE* spinlock_sample_get(const SPINLOCK* lock, void* caller)
+{
+    size_t start = ((uintptr_t)lock >> 3) * 2654435761u;
+
+    for (size_t i = 0; i < SPINLOCK_SAMPLE_PROBES; i++)
+    {
+        SPINLOCK_SAMPLE* sample = &spinlock_samples[(start + i) % SPINLOCK_SAMPLE_SLOTS];
+        const SPINLOCK* owner = sample->lock;
+
+        if (owner == lock)
+        {
+            return sample;
+        }
+        else if (owner == NULL)
+        {
+            if (__sync_bool_compare_and_swap(&sample->lock, NULL, lock))
+            {
+                sample->caller = caller;
+                return sample;
+            }
+            else if (sample->lock == lock)
+            {
+                return sample;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Record an acquisition of a lock. Contended acquisitions are always recorded,
+ * as they are slow anyway, while only one in SPINLOCK_SAMPLE_RATE of all the
+ * acquisitions of a thread is counted.
+ *
+ * @param lock      The lock that was acquired
+ * @param contended Whether the lock was held by someone else
+ * @param caller    Where the lock was acquired
+ */
+static void spinlock_sample(const SPINLOCK* lock, bool contended, void* caller)
+{
+    bool sampled = ++spinlock_sample_counter % SPINLOCK_SAMPLE_RATE == 0;
+
+    if (sampled || contended)
+    {
+        SPINLOCK_SAMPLE* sample = spinlock_sample_get(lock, caller);
+
+        if (sample)
+        {
+            if (sampled)
+            {
+                atomic_add_uint64(&sample->acquired, SPINLOCK_SAMPLE_RATE);
+            }
+
+            if (contended)
+            {
+                atomic_add_uint64(&sample->contended, 1);
+            }
+        }
+        else
+        {
+            atomic_add_uint64(&spinlock_samples_dropped, 1);
+        }
+    }
+}
+
+/**
+ * Wait for a lock that was held when it was first tried. The lock is polled
+ * with an exponentially growing number of pauses in between. If that does not
+ * succeed, the thread is parked until the holder releases the lock.
+ *
+ * @param lock The lock to acquire
+ *
+ * @return The number of pauses spent spinning
+ */
+static int spinlock_wait(SPINLOCK* lock)
+{
+    volatile int* value = &lock->lock;
+    int spins = 0;
+    int backoff = 1;
+
+    while (spins < SPINLOCK_MAX_SPINS)
+    {
+        for (int i = 0; i < backoff; i++)
+        {
+            spinlock_pause();
+        }
+
+        spins += backoff;
+
+        if (*value == SPINLOCK_FREE &&
+            __sync_bool_compare_and_swap(&lock->lock, SPINLOCK_FREE, SPINLOCK_HELD))
+        {
+            return spins;
+        }
+
+        if (backoff < SPINLOCK_MAX_BACKOFF)
+        {
+            backoff *= 2;
+        }
+    }
 
+    /**
+     * Marking the lock as having parked waiters makes the holder wake one of
+     * them up on release. As it can not be known whether other threads are
+     * still parked, the lock is also taken in that state.
+     */
+    while (__sync_lock_test_and_set(&lock->lock, SPINLOCK_PARKED) != SPINLOCK_FREE)
+    {
+        futex_wait(&lock->lock, SPINLOCK_PARKED);
+    }
+
+    return spins;
+}
 
 void spinlock_init(SPINLOCK *lock)
 {
-    lock->lock = 0;
+    lock->lock = SPINLOCK_FREE;
 #if SPINLOCK_PROFILE
     lock->spins = 0;
     lock->maxspins = 0;
@@ -34,17 +221,21 @@ void spinlock_init(SPINLOCK *lock)
 void spinlock_acquire(const SPINLOCK *const_lock)
 {
     SPINLOCK *lock = (SPINLOCK*)const_lock;
+    bool contended = false;
 #if SPINLOCK_PROFILE
     int spins = 0;
 
     atomic_add(&(lock->waiting), 1);
 #endif
 
-    while (__sync_lock_test_and_set(&(lock->lock), 1))
+    if (!__sync_bool_compare_and_swap(&lock->lock, SPINLOCK_FREE, SPINLOCK_HELD))
     {
+        contended = true;
 #if SPINLOCK_PROFILE
-        atomic_add(&(lock->spins), 1);
-        spins++;
+        spins = spinlock_wait(lock);
+        atomic_add(&(lock->spins), spins);
+#else
+        spinlock_wait(lock);
 #endif
     }
 
@@ -61,13 +252,18 @@ void spinlock_acquire(const SPINLOCK *const_lock)
     lock->owner = thread_self();
     atomic_add(&(lock->waiting), -1);
 #endif
+
+    if (spinlock_profiling)
+    {
+        spinlock_sample(lock, contended, __builtin_return_address(0));
+    }
 }
 
 bool
 spinlock_acquire_nowait(const SPINLOCK *const_lock)
 {
     SPINLOCK *lock = (SPINLOCK*)const_lock;
-    if (__sync_lock_test_and_set(&(lock->lock), 1))
+    if (!__sync_bool_compare_and_swap(&lock->lock, SPINLOCK_FREE, SPINLOCK_HELD))
     {
         return false;
     }
@@ -77,13 +273,18 @@ spinlock_acquire_nowait(const SPINLOCK *const_lock)
     lock->owner = thread_self();
 #endif
 
+    if (spinlock_profiling)
+    {
+        spinlock_sample(lock, false, __builtin_return_address(0));
+    }
+
     return true;
 }
 
 void spinlock_release(const SPINLOCK *const_lock)
 {
     SPINLOCK *lock = (SPINLOCK*)const_lock;
-    ss_dassert(lock->lock != 0);
+    ss_dassert(lock->lock != SPINLOCK_FREE);
 #if SPINLOCK_PROFILE
     if (lock->waiting > lock->max_waiting)
     {
@@ -91,7 +292,12 @@ void spinlock_release(const SPINLOCK *const_lock)
     }
 #endif
 
-    __sync_lock_release(&lock->lock);
+    if (__sync_fetch_and_sub(&lock->lock, 1) != SPINLOCK_HELD)
+    {
+        /** There may be parked threads, wake one of them up. */
+        __sync_lock_release(&lock->lock);
+        futex_wake(&lock->lock, 1);
+    }
 }
 
 void spinlock_stats(const SPINLOCK *lock, void (*reporter)(void *, char *, int), void *hdl)
@@ -119,3 +325,79 @@ void spinlock_stats(const SPINLOCK *lock, void (*reporter)(void *, char *, int),
     }
 #endif
 }
+
+void spinlock_profile_enable(bool enable)
+{
+    if (enable && !spinlock_profiling)
+    {
+        /** Samples recorded while the table is cleared only skew the results. */
+        memset(spinlock_samples, 0, sizeof(spinlock_samples));
+        spinlock_samples_dropped = 0;
+        atomic_synchronize();
+    }
+
+    spinlock_profiling = enable;
+}
+
+bool spinlock_profile_enabled()
+{
+    return spinlock_profiling;
+}
+
+static int spinlock_sample_cmp(const void *a, const void *b)
+{
+    const SPINLOCK_SAMPLE *s1 = (const SPINLOCK_SAMPLE*)a;
+    const SPINLOCK_SAMPLE *s2 = (const SPINLOCK_SAMPLE*)b;
+
+    if (s1->contended != s2->contended)
+    {
+        return s1->contended < s2->contended ? 1 : -1;
+    }
+    else if (s1->acquired != s2->acquired)
+    {
+        return s1->acquired < s2->acquired ? 1 : -1;
+    }
+
+    return 0;
+}
+
+uint64_t spinlock_profile_report(spinlock_profile_reporter_t reporter, void *hdl)
+{
+    SPINLOCK_SAMPLE *samples = MXS_MALLOC(sizeof(spinlock_samples));
+    size_t n_samples = 0;
+
+    if (samples)
+    {
+        for (size_t i = 0; i < SPINLOCK_SAMPLE_SLOTS; i++)
+        {
+            if (spinlock_samples[i].lock)
+            {
+                samples[n_samples++] = spinlock_samples[i];
+            }
+        }
+
+        qsort(samples, n_samples, sizeof(SPINLOCK_SAMPLE), spinlock_sample_cmp);
+
+        for (size_t i = 0; i < n_samples; i++)
+        {
+            char caller[256];
+            Dl_info info;
+
+            if (dladdr(samples[i].caller, &info) && info.dli_sname)
+            {
+                snprintf(caller, sizeof(caller), "%s+%#lx", info.dli_sname,
+                         (unsigned long)((char*)samples[i].caller - (char*)info.dli_saddr));
+            }
+            else
+            {
+                snprintf(caller, sizeof(caller), "%p", samples[i].caller);
+            }
+
+            reporter(hdl, samples[i].lock, caller, samples[i].acquired, samples[i].contended);
+        }
+
+        MXS_FREE(samples);
+    }
+
+    return spinlock_samples_dropped;
+}
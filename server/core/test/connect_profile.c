@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * Opens and closes connections to a listener as fast as possible and reports
+ * the rate of connections and the time it took to connect. With -g the greeting
+ * of the server is read before the connection is closed, which also measures
+ * the creation of the session and the sending of the handshake. With -u the
+ * client authenticates with mysql_native_password and measures the time to the
+ * end of the result of the first query, which includes the connections to the
+ * backends. With -r the connections are closed with a reset so that the client
+ * does not run out of local ports because of the sockets in the TIME_WAIT state.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <maxscale/alloc.h>
+#include <maxscale/utils.h>
+
+static const char USAGE[] =
+    "usage: connect_profile [-h host] [-p port] [-t threads] [-d seconds] [-g] [-r]\n"
+    "                       [-u user] [-w password] [-q query]\n";
+
+/** Largest packet the client reads */
+#define MAX_PACKET 65536
+
+/** Length of the mysql_native_password scramble */
+#define SCRAMBLE_LEN 20
+
+/** CLIENT_LONG_PASSWORD | CLIENT_PROTOCOL_41 | CLIENT_TRANSACTIONS |
+ *  CLIENT_SECURE_CONNECTION | CLIENT_PLUGIN_AUTH */
+#define CLIENT_CAPABILITIES 0x0008a201
+
+typedef struct client
+{
+    pthread_t thread;
+    uint64_t  failures;    /**< Connections that failed */
+    uint32_t *samples;     /**< Microseconds it took to connect */
+    size_t    n_samples;   /**< Number of connections that were opened and closed */
+    size_t    max_samples; /**< Size of the sample array */
+} CLIENT;
+
+static struct addrinfo *address;
+static bool read_greeting = false;
+static bool reset = false;
+static const char *user = NULL;
+static const char *password = "";
+static const char *query = "SELECT 1";
+static volatile bool running = true;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Read one packet
+ *
+ * @param fd  The socket
+ * @param buf Buffer of MAX_PACKET bytes for the payload
+ *
+ * @return Length of the payload or -1 on error
+ */
+static int read_packet(int fd, uint8_t *buf)
+{
+    uint8_t header[4];
+
+    if (recv(fd, header, sizeof(header), MSG_WAITALL) != sizeof(header))
+    {
+        return -1;
+    }
+
+    int len = header[0] | header[1] << 8 | header[2] << 16;
+
+    if (len > MAX_PACKET || (len > 0 && recv(fd, buf, len, MSG_WAITALL) != len))
+    {
+        return -1;
+    }
+
+    return len;
+}
+
+/**
+ * Write one packet
+ *
+ * @return True if the whole packet was written
+ */
+static bool write_packet(int fd, uint8_t seq, const uint8_t *payload, int len)
+{
+    uint8_t buf[MAX_PACKET + 4] = {len, len >> 8, len >> 16, seq};
+    memcpy(buf + 4, payload, len);
+
+    return send(fd, buf, len + 4, MSG_NOSIGNAL) == len + 4;
+}
+
+/**
+ * Authenticate with mysql_native_password
+ *
+ * @param fd The socket, the handshake has not yet been read
+ * @return True if the server accepted the credentials
+ */
+static bool authenticate(int fd)
+{
+    uint8_t buf[MAX_PACKET];
+    int len = read_packet(fd, buf);
+    uint8_t *version_end;
+
+    if (len <= 0 || buf[0] != 10 || (version_end = memchr(buf + 1, 0, len - 1)) == NULL ||
+        version_end + 45 > buf + len)
+    {
+        return false;
+    }
+
+    /** The scramble is in two parts around the capabilities and the status */
+    uint8_t scramble[SCRAMBLE_LEN];
+    memcpy(scramble, version_end + 5, 8);
+    memcpy(scramble + 8, version_end + 32, 12);
+
+    uint8_t response[MAX_PACKET] = {};
+    uint8_t *ptr = response;
+    uint32_t caps = CLIENT_CAPABILITIES;
+    memcpy(ptr, &caps, sizeof(caps));
+    ptr += 4;
+    ptr[2] = 1;                 /** Max packet size of 64kB */
+    ptr += 4;
+    *ptr++ = 33;                /** utf8_general_ci */
+    ptr += 23;
+
+    strcpy((char*)ptr, user);
+    ptr += strlen(user) + 1;
+
+    if (*password)
+    {
+        uint8_t hash1[SCRAMBLE_LEN];
+        uint8_t hash2[SCRAMBLE_LEN];
+        uint8_t hash3[SCRAMBLE_LEN];
+
+        /** SHA1(password) XOR SHA1(scramble + SHA1(SHA1(password))) */
+        gw_sha1_str((const uint8_t*)password, strlen(password), hash1);
+        gw_sha1_str(hash1, SCRAMBLE_LEN, hash2);
+        gw_sha1_2_str(scramble, SCRAMBLE_LEN, hash2, SCRAMBLE_LEN, hash3);
+
+        *ptr++ = SCRAMBLE_LEN;
+        gw_str_xor(ptr, hash3, hash1, SCRAMBLE_LEN);
+        ptr += SCRAMBLE_LEN;
+    }
+    else
+    {
+        *ptr++ = 0;
+    }
+
+    strcpy((char*)ptr, "mysql_native_password");
+    ptr += strlen("mysql_native_password") + 1;
+
+    return write_packet(fd, 1, response, ptr - response) &&
+           read_packet(fd, buf) > 0 && buf[0] == 0x00;
+}
+
+/**
+ * Execute the query and read the whole result
+ *
+ * @param fd The authenticated socket
+ * @return True if the query succeeded
+ */
+static bool execute_query(int fd)
+{
+    uint8_t buf[MAX_PACKET];
+    int len = strlen(query);
+
+    buf[0] = 0x03;              /** COM_QUERY */
+    memcpy(buf + 1, query, len);
+
+    if (!write_packet(fd, 0, buf, len + 1) || (len = read_packet(fd, buf)) <= 0 || buf[0] == 0xff)
+    {
+        return false;
+    }
+
+    /** A result set ends with the EOF packet that follows the rows */
+    int eofs = buf[0] == 0x00 ? 2 : 0;
+
+    while (eofs < 2)
+    {
+        if ((len = read_packet(fd, buf)) <= 0 || buf[0] == 0xff)
+        {
+            return false;
+        }
+
+        if (buf[0] == 0xfe && len < 9)
+        {
+            eofs++;
+        }
+    }
+
+    buf[0] = 0x01;              /** COM_QUIT */
+    write_packet(fd, 0, buf, 1);
+
+    return true;
+}
+
+/**
+ * Open a connection, optionally read the greeting or execute a query, and close it
+ *
+ * @return True if the connection was opened
+ */
+static bool connect_once()
+{
+    int fd = socket(address->ai_family, SOCK_STREAM, 0);
+    bool ok = false;
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+    {
+        ok = true;
+
+        if (user)
+        {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ok = authenticate(fd) && execute_query(fd);
+        }
+        else if (read_greeting)
+        {
+            char buf[1024];
+            ok = recv(fd, buf, sizeof(buf), 0) > 0;
+        }
+    }
+
+    if (reset)
+    {
+        struct linger lin = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+    }
+
+    close(fd);
+    return ok;
+}
+
+static void* client_main(void *data)
+{
+    CLIENT *client = data;
+
+    while (running)
+    {
+        uint64_t start = now_ns();
+
+        if (connect_once())
+        {
+            if (client->n_samples == client->max_samples)
+            {
+                client->max_samples = client->max_samples ? client->max_samples * 2 : 4096;
+                client->samples = MXS_REALLOC(client->samples,
+                                              client->max_samples * sizeof(client->samples[0]));
+                MXS_ABORT_IF_NULL(client->samples);
+            }
+
+            client->samples[client->n_samples++] = (now_ns() - start) / 1000;
+        }
+        else
+        {
+            client->failures++;
+        }
+    }
+
+    return NULL;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    uint32_t lhs = *(const uint32_t*)a;
+    uint32_t rhs = *(const uint32_t*)b;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    const char *port = "4006";
+    int threads = 4;
+    int seconds = 10;
+    int c;
+
+    while ((c = getopt(argc, argv, "h:p:t:d:gru:w:q:")) != -1)
+    {
+        switch (c)
+        {
+        case 'h':
+            host = optarg;
+            break;
+
+        case 'p':
+            port = optarg;
+            break;
+
+        case 't':
+            threads = atoi(optarg);
+            break;
+
+        case 'd':
+            seconds = atoi(optarg);
+            break;
+
+        case 'g':
+            read_greeting = true;
+            break;
+
+        case 'r':
+            reset = true;
+            break;
+
+        case 'u':
+            user = optarg;
+            break;
+
+        case 'w':
+            password = optarg;
+            break;
+
+        case 'q':
+            query = optarg;
+            break;
+
+        default:
+            printf(USAGE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (threads <= 0 || seconds <= 0 ||
+        (user && strlen(user) + strlen(query) > MAX_PACKET / 2))
+    {
+        printf(USAGE);
+        return EXIT_FAILURE;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    int rc = getaddrinfo(host, port, &hints, &address);
+
+    if (rc != 0)
+    {
+        printf("Failed to resolve %s:%s: %s\n", host, port, gai_strerror(rc));
+        return EXIT_FAILURE;
+    }
+
+    CLIENT *clients = MXS_CALLOC(threads, sizeof(CLIENT));
+    MXS_ABORT_IF_NULL(clients);
+
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_create(&clients[i].thread, NULL, client_main, &clients[i]);
+    }
+
+    sleep(seconds);
+    running = false;
+
+    uint64_t failures = 0;
+    size_t n_samples = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(clients[i].thread, NULL);
+        failures += clients[i].failures;
+        n_samples += clients[i].n_samples;
+    }
+
+    double elapsed = (now_ns() - start) / 1e9;
+    uint32_t *samples = MXS_MALLOC((n_samples + 1) * sizeof(uint32_t));
+    MXS_ABORT_IF_NULL(samples);
+    size_t n = 0;
+    uint64_t total_us = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+        for (size_t j = 0; j < clients[i].n_samples; j++)
+        {
+            total_us += clients[i].samples[j];
+            samples[n++] = clients[i].samples[j];
+        }
+
+        MXS_FREE(clients[i].samples);
+    }
+
+    qsort(samples, n_samples, sizeof(uint32_t), compare_samples);
+
+    const char *what = user ? "first query" : "connect";
+    char label[64];
+
+    printf("%-24s %10zu\n", "connections", n_samples);
+    printf("%-24s %10" PRIu64 "\n", "failures", failures);
+    printf("%-24s %10.0f\n", "connections/s", n_samples / elapsed);
+
+    if (n_samples > 0)
+    {
+        snprintf(label, sizeof(label), "avg %s us", what);
+        printf("%-24s %10.1f\n", label, (double)total_us / n_samples);
+        snprintf(label, sizeof(label), "p50 %s us", what);
+        printf("%-24s %10" PRIu32 "\n", label, samples[n_samples / 2]);
+        snprintf(label, sizeof(label), "p99 %s us", what);
+        printf("%-24s %10" PRIu32 "\n", label, samples[n_samples * 99 / 100]);
+        snprintf(label, sizeof(label), "max %s us", what);
+        printf("%-24s %10" PRIu32 "\n", label, samples[n_samples - 1]);
+    }
+
+    MXS_FREE(samples);
+    MXS_FREE(clients);
+    freeaddrinfo(address);
+
+    return n_samples > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
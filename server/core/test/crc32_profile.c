@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * Measures the throughput of zlib's crc32() and mxs_crc32() for buffers of the
+ * sizes of typical binlog events, from small row events to large ones.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <zlib.h>
+
+#include <maxscale/alloc.h>
+#include <maxscale/crc32.h>
+
+static const char USAGE[] = "usage: crc32_profile [-m megabytes]\n";
+
+static const size_t sizes[] = {19, 64, 256, 1024, 8192, 65536, 1048576};
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Compute the CRC-32 of @c total bytes in pieces of @c size bytes
+ *
+ * @return Megabytes per second
+ */
+static double profile(bool zlib, const uint8_t *data, size_t size, size_t total)
+{
+    size_t count = total / size + 1;
+    uint32_t crc = 0;
+    uint64_t start = now_ns();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        crc = zlib ? crc32(crc, data, size) : mxs_crc32(crc, data, size);
+    }
+
+    uint64_t ns = now_ns() - start;
+
+    /** Use the CRC so that the loop is not optimized away */
+    if (crc == 0)
+    {
+        printf("CRC-32 was 0\n");
+    }
+
+    return ns ? (double)count * size * 1000 / ns : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int megabytes = 1024;
+    int c;
+
+    while ((c = getopt(argc, argv, "m:")) != -1)
+    {
+        switch (c)
+        {
+        case 'm':
+            megabytes = atoi(optarg);
+            break;
+
+        default:
+            printf(USAGE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (megabytes <= 0)
+    {
+        printf(USAGE);
+        return EXIT_FAILURE;
+    }
+
+    size_t max_size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    uint8_t *data = MXS_MALLOC(max_size);
+    MXS_ABORT_IF_NULL(data);
+
+    for (size_t i = 0; i < max_size; i++)
+    {
+        data[i] = rand();
+    }
+
+    size_t total = (size_t)megabytes * 1024 * 1024;
+
+    printf("mxs_crc32 uses %s\n", mxs_crc32_is_accelerated() ? "PCLMULQDQ" : "slicing-by-8");
+    printf("%8s %14s %14s %8s\n", "bytes", "zlib MB/s", "mxs MB/s", "speedup");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        double zlib_mbs = profile(true, data, sizes[i], total);
+        double mxs_mbs = profile(false, data, sizes[i], total);
+
+        printf("%8lu %14.1f %14.1f %8.2f\n", sizes[i], zlib_mbs, mxs_mbs,
+               zlib_mbs > 0 ? mxs_mbs / zlib_mbs : 0);
+    }
+
+    MXS_FREE(data);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * Measures the cost of creating sessions and of routing packets through
+ * chains of filters that do nothing. The chains are built from 0 to 10 filters
+ * that either forward the packets themselves, as the filters did before the
+ * chains were compiled, or leave routeQuery and clientReply out, as the
+ * nullfilter does.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <maxscale/alloc.h>
+#include <maxscale/buffer.h>
+#include <maxscale/dcb.h>
+#include <maxscale/filter.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/paths.h>
+#include <maxscale/router.h>
+#include <maxscale/service.h>
+#include <maxscale/session.h>
+#include "../maxscale/filter.h"
+
+#define MAX_FILTERS 10
+
+static const char USAGE[] = "usage: filterchain_profile [-s sessions] [-p packets]\n";
+
+typedef struct bench_session
+{
+    MXS_DOWNSTREAM down;
+    MXS_UPSTREAM   up;
+} BENCH_SESSION;
+
+static char router_session;
+
+static MXS_ROUTER_SESSION* router_new_session(MXS_ROUTER *instance, MXS_SESSION *session)
+{
+    return (MXS_ROUTER_SESSION*)&router_session;
+}
+
+static void router_close_session(MXS_ROUTER *instance, MXS_ROUTER_SESSION *session)
+{
+}
+
+static void router_free_session(MXS_ROUTER *instance, MXS_ROUTER_SESSION *session)
+{
+}
+
+static int32_t router_route_query(MXS_ROUTER *instance, MXS_ROUTER_SESSION *session, GWBUF *queue)
+{
+    return 1;
+}
+
+static MXS_ROUTER_OBJECT router_object =
+{
+    NULL,
+    router_new_session,
+    router_close_session,
+    router_free_session,
+    router_route_query,
+};
+
+static MXS_FILTER_SESSION* filter_new_session(MXS_FILTER *instance, MXS_SESSION *session)
+{
+    return (MXS_FILTER_SESSION*)MXS_CALLOC(1, sizeof(BENCH_SESSION));
+}
+
+static void filter_close_session(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession)
+{
+}
+
+static void filter_free_session(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession)
+{
+    MXS_FREE(fsession);
+}
+
+static void filter_set_downstream(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession,
+                                  MXS_DOWNSTREAM *down)
+{
+    ((BENCH_SESSION*)fsession)->down = *down;
+}
+
+static void filter_set_upstream(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession,
+                                MXS_UPSTREAM *up)
+{
+    ((BENCH_SESSION*)fsession)->up = *up;
+}
+
+static int32_t filter_route_query(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue)
+{
+    BENCH_SESSION *session = (BENCH_SESSION*)fsession;
+    return session->down.routeQuery(session->down.instance, session->down.session, queue);
+}
+
+static int32_t filter_client_reply(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue)
+{
+    BENCH_SESSION *session = (BENCH_SESSION*)fsession;
+    return session->up.clientReply(session->up.instance, session->up.session, queue);
+}
+
+/** A filter that forwards everything itself */
+static MXS_FILTER_OBJECT forwarding_object =
+{
+    NULL,
+    filter_new_session,
+    filter_close_session,
+    filter_free_session,
+    filter_set_downstream,
+    filter_set_upstream,
+    filter_route_query,
+    filter_client_reply,
+};
+
+/** A filter that leaves routeQuery and clientReply out */
+static MXS_FILTER_OBJECT skipped_object =
+{
+    NULL,
+    filter_new_session,
+    filter_close_session,
+    filter_free_session,
+    filter_set_downstream,
+    filter_set_upstream,
+    NULL,
+    NULL,
+};
+
+static int client_write(DCB *dcb, GWBUF *queue)
+{
+    return 1;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Create and free sessions
+ *
+ * @return Nanoseconds per session
+ */
+static double profile_sessions(SERVICE *service, int count)
+{
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < count; i++)
+    {
+        DCB *dcb = dcb_alloc(DCB_ROLE_CLIENT_HANDLER, NULL);
+        MXS_SESSION *session = dcb ? session_alloc(service, dcb) : NULL;
+
+        if (session == NULL)
+        {
+            fprintf(stderr, "error: Could not create a session.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        session_put_ref(session);
+    }
+
+    return (double)(now_ns() - start) / count;
+}
+
+/**
+ * Route packets to the router and replies to the client
+ *
+ * @return Nanoseconds per packet and reply
+ */
+static double profile_packets(SERVICE *service, GWBUF *packet, int count)
+{
+    DCB *dcb = dcb_alloc(DCB_ROLE_CLIENT_HANDLER, NULL);
+    MXS_SESSION *session = dcb ? session_alloc(service, dcb) : NULL;
+
+    if (session == NULL)
+    {
+        fprintf(stderr, "error: Could not create a session.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    dcb->func.write = client_write;
+    uint64_t start = now_ns();
+
+    for (int i = 0; i < count; i++)
+    {
+        MXS_SESSION_ROUTE_QUERY(session, packet);
+        MXS_SESSION_ROUTE_REPLY(session, packet);
+    }
+
+    uint64_t end = now_ns();
+    session_put_ref(session);
+
+    return (double)(end - start) / count;
+}
+
+static void profile(SERVICE *service, MXS_FILTER_DEF *filters, MXS_FILTER_DEF **chain,
+                    GWBUF *packet, int sessions, int packets)
+{
+    printf("%8s %14s %14s\n", "filters", "ns/session", "ns/packet");
+
+    for (int n = 0; n <= MAX_FILTERS; n++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            chain[i] = &filters[i];
+        }
+
+        service->filters = chain;
+        service->n_filters = n;
+        service->filter_chain = n > 0 ? filter_chain_compile(chain, n) : NULL;
+
+        if (n > 0 && service->filter_chain == NULL)
+        {
+            fprintf(stderr, "error: Could not compile the filter chain.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        double session_ns = profile_sessions(service, sessions);
+        double packet_ns = profile_packets(service, packet, packets);
+
+        printf("%8d %14.1f %14.1f\n", n, session_ns, packet_ns);
+
+        filter_chain_free(service->filter_chain);
+        service->filter_chain = NULL;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int sessions = 100000;
+    int packets = 10000000;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:p:")) != -1)
+    {
+        switch (c)
+        {
+        case 's':
+            sessions = atoi(optarg);
+            break;
+
+        case 'p':
+            packets = atoi(optarg);
+            break;
+
+        default:
+            printf(USAGE);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (sessions <= 0 || packets <= 0)
+    {
+        printf(USAGE);
+        return EXIT_FAILURE;
+    }
+
+    set_datadir(MXS_STRDUP_A("/tmp"));
+    set_langdir(MXS_STRDUP_A("."));
+    set_process_datadir(MXS_STRDUP_A("/tmp"));
+
+    if (!mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        fprintf(stderr, "error: Could not initialize log.\n");
+        return EXIT_FAILURE;
+    }
+
+    SERVICE *service = (SERVICE*)MXS_CALLOC(1, sizeof(SERVICE));
+    MXS_FILTER_DEF filters[MAX_FILTERS];
+    MXS_FILTER_DEF *chain[MAX_FILTERS];
+    uint8_t data[] = {0x01, 0x00, 0x00, 0x00, 0x0e};
+    GWBUF *packet = gwbuf_alloc_and_load(sizeof(data), data);
+
+    MXS_ABORT_IF_NULL(service);
+    MXS_ABORT_IF_NULL(packet);
+    service->name = "profile";
+    service->router = &router_object;
+    memset(filters, 0, sizeof(filters));
+
+    for (int i = 0; i < MAX_FILTERS; i++)
+    {
+        filters[i].name = "filter";
+        filters[i].obj = &forwarding_object;
+    }
+
+    printf("Filters that forward the packets themselves:\n");
+    profile(service, filters, chain, packet, sessions, packets);
+
+    for (int i = 0; i < MAX_FILTERS; i++)
+    {
+        filters[i].obj = &skipped_object;
+    }
+
+    printf("\nFilters without routeQuery and clientReply:\n");
+    profile(service, filters, chain, packet, sessions, packets);
+
+    gwbuf_free(packet);
+    MXS_FREE(service);
+    mxs_log_finish();
+
+    return EXIT_SUCCESS;
+}
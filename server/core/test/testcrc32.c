@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <maxscale/crc32.h>
+#include <maxscale/debug.h>
+
+#define DATA_SIZE 70000
+#define MAX_LENGTH 1100
+
+static uint8_t data[DATA_SIZE];
+
+/**
+ * test1    The CRC-32 of known data
+ */
+static int test1()
+{
+    ss_dfprintf(stderr, "testcrc32 : known values");
+
+    ss_info_dassert(mxs_crc32(0, "", 0) == 0, "CRC-32 of nothing should be 0");
+    ss_info_dassert(mxs_crc32(0, "123456789", 9) == 0xcbf43926,
+                    "CRC-32 of the check string should be 0xcbf43926");
+    ss_info_dassert(mxs_crc32(0xcbf43926, NULL, 0) == 0xcbf43926,
+                    "An empty piece should not change the CRC-32");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    The CRC-32 is the same as the one zlib computes for all lengths and alignments
+ */
+static int test2()
+{
+    ss_dfprintf(stderr, "testcrc32 : comparison with zlib (%s)",
+                mxs_crc32_is_accelerated() ? "PCLMULQDQ" : "slicing-by-8");
+
+    for (size_t offset = 0; offset < 16; offset++)
+    {
+        for (size_t len = 0; len <= MAX_LENGTH; len++)
+        {
+            uint32_t seed = len * 2654435761u;
+
+            ss_info_dassert(mxs_crc32(0, data + offset, len) == crc32(0, data + offset, len),
+                            "CRC-32 should match zlib");
+            ss_info_dassert(mxs_crc32(seed, data + offset, len) == crc32(seed, data + offset, len),
+                            "CRC-32 with a preceding CRC should match zlib");
+        }
+    }
+
+    ss_info_dassert(mxs_crc32(0, data, DATA_SIZE) == crc32(0, data, DATA_SIZE),
+                    "CRC-32 of a large buffer should match zlib");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test3    The CRC-32 of data in pieces is the same as the CRC-32 of the whole data
+ */
+static int test3()
+{
+    ss_dfprintf(stderr, "testcrc32 : data in pieces");
+
+    uint32_t whole = mxs_crc32(0, data, DATA_SIZE);
+
+    for (size_t piece = 1; piece < 300; piece += 7)
+    {
+        uint32_t crc = 0;
+
+        for (size_t pos = 0; pos < DATA_SIZE; pos += piece)
+        {
+            size_t len = DATA_SIZE - pos < piece ? DATA_SIZE - pos : piece;
+            crc = mxs_crc32(crc, data + pos, len);
+        }
+
+        ss_info_dassert(crc == whole, "CRC-32 of the pieces should match the whole data");
+    }
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    srand(4711);
+
+    for (int i = 0; i < DATA_SIZE; i++)
+    {
+        data[i] = rand();
+    }
+
+    result += test1();
+    result += test2();
+    result += test3();
+
+    exit(result);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <maxscale/config.h>
+#include <maxscale/debug.h>
+#include <maxscale/server.h>
+#include <maxscale/service.h>
+#include "../maxscale/latency.h"
+
+static void sleep_us(long us)
+{
+    struct timespec ts = {0, us * 1000};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * test1    Values map to buckets whose bounds contain them and the buckets
+ *          are at most one eighth of the value wide
+ */
+static int test1()
+{
+    ss_dfprintf(stderr, "testlatency : histogram buckets");
+
+    int prev = -1;
+
+    for (uint64_t v = 0; v < (1ULL << LATENCY_MAX_EXP); v = v < 64 ? v + 1 : v + v / 7)
+    {
+        int b = latency_bucket(v);
+        ss_info_dassert(b >= prev, "Buckets should grow with the value");
+        ss_info_dassert(b < LATENCY_HIST_BUCKETS, "Bucket should be in range");
+        ss_info_dassert(latency_bucket_upper(b) >= v, "Upper bound should not be below the value");
+        ss_info_dassert(b == 0 || latency_bucket_upper(b - 1) < v,
+                        "Upper bound of the previous bucket should be below the value");
+        ss_info_dassert(latency_bucket_upper(b) - v <= v / LATENCY_SUB_BUCKETS,
+                        "Bucket should be at most 1/8th of the value wide");
+        prev = b;
+    }
+
+    ss_info_dassert(latency_bucket(UINT64_MAX) == LATENCY_HIST_BUCKETS - 1,
+                    "Huge values should go to the last bucket");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    The stages of statements are recorded into the service and the server
+ */
+static int test2()
+{
+    SERVICE service;
+    SERVER server;
+    MXS_SESSION session;
+    LATENCY_SUMMARY s;
+
+    ss_dfprintf(stderr, "testlatency : recording of stages");
+
+    memset(&service, 0, sizeof(service));
+    memset(&server, 0, sizeof(server));
+    memset(&session, 0, sizeof(session));
+    session.service = &service;
+
+    for (int i = 0; i < 10; i++)
+    {
+        latency_client_read(&session, latency_now());
+        latency_route_begin(&session);
+        latency_router_begin(&session);
+        latency_classify_add(5000);
+        latency_router_end(&session);
+        sleep_us(2000);
+        latency_backend_reply(&session, &server);
+        latency_backend_reply(&session, &server);
+        latency_client_reply(&session);
+        latency_client_reply(&session);
+    }
+
+    for (int stage = 0; stage < LATENCY_STAGE_MAX; stage++)
+    {
+        latency_stats_summary(service.latency, stage, &s);
+        ss_info_dassert(s.count == 10, "Each stage of the service should be recorded once per statement");
+        ss_info_dassert(s.p50 <= s.p99 && s.p99 <= s.p999 && s.p999 <= s.max,
+                        "Percentiles should be in order");
+    }
+
+    latency_stats_summary(service.latency, LATENCY_STAGE_CLASSIFY, &s);
+    ss_info_dassert(s.avg == 5.0, "Classification time should be recorded");
+
+    latency_stats_summary(service.latency, LATENCY_STAGE_BACKEND, &s);
+    ss_info_dassert(s.p50 >= 2000, "Backend stage should include the round trip");
+
+    latency_stats_summary(server.latency, LATENCY_STAGE_BACKEND, &s);
+    ss_info_dassert(s.count == 10, "Backend stage should be recorded for the server");
+    latency_stats_summary(server.latency, LATENCY_STAGE_PROTOCOL, &s);
+    ss_info_dassert(s.count == 0, "Protocol stage should not be recorded for the server");
+
+    latency_stats_free(service.latency);
+    latency_stats_free(server.latency);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    config_get_global_options()->n_threads = 1;
+
+    result += test1();
+    result += test2();
+
+    exit(result);
+}
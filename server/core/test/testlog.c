@@ -15,13 +15,20 @@
 #define SS_DEBUG
 #endif
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <maxscale/alloc.h>
 #include "../maxscale/skygw_utils.h"
 #include <maxscale/log_manager.h>
 
+#define BENCHMARK_LOGFILE  "/tmp/maxscale.log"
+#define BENCHMARK_THREADS  4
+#define BENCHMARK_MESSAGES 10000
+#define BENCHMARK_MAX_THREADS 64
+
 static void skygw_log_enable(int priority)
 {
     mxs_log_set_priority_enabled(priority, true);
@@ -32,6 +39,109 @@ static void skygw_log_disable(int priority)
     mxs_log_set_priority_enabled(priority, false);
 }
 
+typedef struct benchmark_arg
+{
+    int id;
+    int n_messages;
+} benchmark_arg_t;
+
+static void* benchmark_thread(void* data)
+{
+    benchmark_arg_t* arg = (benchmark_arg_t*)data;
+
+    for (int i = 0; i < arg->n_messages; i++)
+    {
+        MXS_NOTICE("benchmark %d %d", arg->id, i);
+    }
+
+    return NULL;
+}
+
+/**
+ * Log from several threads at the same time and report the throughput.
+ * Then check that every message of every thread is in the log exactly
+ * once and in the order the thread logged them.
+ *
+ * @param n_threads  Number of logging threads
+ * @param n_messages Number of messages each thread logs
+ *
+ * @return 0 on success, 1 on failure
+ */
+static int run_benchmark(int n_threads, int n_messages)
+{
+    pthread_t tids[BENCHMARK_MAX_THREADS];
+    benchmark_arg_t args[BENCHMARK_MAX_THREADS];
+    int expected[BENCHMARK_MAX_THREADS];
+    struct timespec start, end;
+    int rval = 0;
+
+    FILE* log = fopen(BENCHMARK_LOGFILE, "r");
+
+    if (log == NULL)
+    {
+        fprintf(stderr, "Could not open %s.\n", BENCHMARK_LOGFILE);
+        return 1;
+    }
+
+    mxs_log_flush_sync();
+    fseek(log, 0, SEEK_END);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < n_threads; i++)
+    {
+        args[i].id = i;
+        args[i].n_messages = n_messages;
+        expected[i] = 0;
+        pthread_create(&tids[i], NULL, benchmark_thread, &args[i]);
+    }
+
+    for (int i = 0; i < n_threads; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+
+    mxs_log_flush_sync();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    fprintf(stderr, "%d threads logged %d messages in %.3f seconds, %.0f messages/second.\n",
+            n_threads, n_threads * n_messages, secs, (n_threads * n_messages) / secs);
+
+    char line[1024];
+
+    while (fgets(line, sizeof(line), log))
+    {
+        const char* msg = strstr(line, "benchmark ");
+        int id, seq;
+
+        if (msg && sscanf(msg, "benchmark %d %d", &id, &seq) == 2)
+        {
+            if (id < 0 || id >= n_threads || seq != expected[id])
+            {
+                fprintf(stderr, "Unexpected message: %s", line);
+                rval = 1;
+                break;
+            }
+
+            expected[id]++;
+        }
+    }
+
+    for (int i = 0; i < n_threads && rval == 0; i++)
+    {
+        if (expected[i] != n_messages)
+        {
+            fprintf(stderr, "Thread %d: expected %d messages, found %d.\n",
+                    i, n_messages, expected[i]);
+            rval = 1;
+        }
+    }
+
+    fclose(log);
+    return rval;
+}
+
 int main(int argc, char* argv[])
 {
     int              err = 0;
@@ -269,6 +379,21 @@ int main(int argc, char* argv[])
                     (int)3);
     ss_dassert(err == 0);
 
+    int n_threads = argc > 1 ? atoi(argv[1]) : BENCHMARK_THREADS;
+    int n_messages = argc > 2 ? atoi(argv[2]) : BENCHMARK_MESSAGES;
+
+    if (n_threads < 1 || n_threads > BENCHMARK_MAX_THREADS || n_messages < 1)
+    {
+        fprintf(stderr, "Usage: %s [threads (1-%d)] [messages per thread]\n",
+                argv[0], BENCHMARK_MAX_THREADS);
+        err = 1;
+    }
+    else
+    {
+        mxs_log_set_priority_enabled(LOG_NOTICE, true);
+        err = run_benchmark(n_threads, n_messages);
+    }
+
     mxs_log_finish();
 
     fprintf(stderr, ".. done.\n");
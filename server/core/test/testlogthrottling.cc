@@ -37,9 +37,16 @@ namespace
 const char LOGNAME[] = "/tmp/maxscale.log";
 const size_t N_THREADS = 4;
 
-sem_t u_semstart;
 sem_t u_semfinish;
 
+// The throttling statistics are kept per thread, so the same threads are
+// used for all the runs.
+pthread_t u_tids[N_THREADS];
+sem_t u_semstart[N_THREADS];
+size_t u_n_generate;
+int u_priority;
+bool u_stop;
+
 void ensure(bool ok)
 {
     if (!ok)
@@ -83,25 +90,53 @@ void log_messages(uint32_t id, size_t n_generate, int priority)
     }
 }
 
-struct THREAD_ARG
-{
-    uint32_t id;
-    size_t n_generate;
-    int priority;
-};
-
 void* thread_main(void* pv)
 {
-    THREAD_ARG *parg = static_cast<THREAD_ARG*>(pv);
+    uint32_t id = static_cast<uint32_t>(reinterpret_cast<intptr_t>(pv));
+
+    while (true)
+    {
+        sem_wait(&u_semstart[id]);
+
+        if (u_stop)
+        {
+            break;
+        }
 
-    sem_wait(&u_semstart);
+        log_messages(id, u_n_generate, u_priority);
 
-    log_messages(parg->id, parg->n_generate, parg->priority);
+        sem_post(&u_semfinish);
+    }
 
-    sem_post(&u_semfinish);
     return 0;
 }
 
+void start_threads()
+{
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        int rc = pthread_create(&u_tids[i], 0, thread_main, reinterpret_cast<void*>(i));
+        ensure(rc == 0);
+    }
+}
+
+void stop_threads()
+{
+    u_stop = true;
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        int rc = sem_post(&u_semstart[i]);
+        ensure(rc == 0);
+    }
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        void* rv;
+        pthread_join(u_tids[i], &rv);
+    }
+}
+
 bool run(const MXS_LOG_THROTTLING& throttling, int priority, size_t n_generate, size_t n_expect)
 {
     cout << "Logging " << n_generate << " messages with throttling as " << throttling << "," << endl;
@@ -112,27 +147,13 @@ bool run(const MXS_LOG_THROTTLING& throttling, int priority, size_t n_generate,
     ifstream in(LOGNAME);
     in.seekg(0, ios_base::end);
 
-    THREAD_ARG args[N_THREADS];
-    pthread_t tids[N_THREADS];
-
-    // Create the threads.
-    for (size_t i = 0; i < N_THREADS; ++i)
-    {
-        THREAD_ARG* parg = &args[i];
-        parg->id = i;
-        parg->n_generate = n_generate;
-        parg->priority = priority;
-
-        int rc = pthread_create(&tids[i], 0, thread_main, parg);
-        ensure(rc == 0);
-    }
-
-    sleep(1);
+    u_n_generate = n_generate;
+    u_priority = priority;
 
     // Let them loose.
     for (size_t i = 0; i < N_THREADS; ++i)
     {
-        int rc = sem_post(&u_semstart);
+        int rc = sem_post(&u_semstart[i]);
         ensure(rc == 0);
     }
 
@@ -145,12 +166,6 @@ bool run(const MXS_LOG_THROTTLING& throttling, int priority, size_t n_generate,
 
     mxs_log_flush_sync();
 
-    for (size_t i = 0; i < N_THREADS; ++i)
-    {
-        void* rv;
-        pthread_join(tids[i], &rv);
-    }
-
     return check_messages(in, n_expect);
 }
 
@@ -160,8 +175,11 @@ int main(int argc, char* argv[])
 
     std::ios::sync_with_stdio();
     random_jkiss_init();
-    rc = sem_init(&u_semstart, 0, 0);
-    ensure(rc == 0);
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        rc = sem_init(&u_semstart[i], 0, 0);
+        ensure(rc == 0);
+    }
 
     rc = sem_init(&u_semfinish, 0, 0);
     ensure(rc == 0);
@@ -170,6 +188,8 @@ int main(int argc, char* argv[])
 
     if (mxs_log_init(NULL, "/tmp", MXS_LOG_TARGET_FS))
     {
+        start_threads();
+
         MXS_LOG_THROTTLING t;
 
         t.count = 0;
@@ -186,8 +206,9 @@ int main(int argc, char* argv[])
         t.window_ms = 2000;
         t.suppress_ms = 5000;
 
-        // 100 messages * N_THREADS, but due to the throttling we should get only 10 messages.
-        if (!run(t, LOG_ERR, 100, 10))
+        // 100 messages * N_THREADS, but due to the throttling we should get only 10 messages
+        // from each thread.
+        if (!run(t, LOG_ERR, 100, 10 * N_THREADS))
         {
             rc = EXIT_FAILURE;
         }
@@ -195,10 +216,10 @@ int main(int argc, char* argv[])
         cout << "Sleeping 7 seconds." << endl;
         sleep(7);
 
-        // 100 messages * N_THREADS, but due to the throttling we should get only 10 messages.
-        // Since we slept longer than the suppression window, the previous message batch should
-        // not affect.
-        if (!run(t, LOG_ERR, 100, 10))
+        // 100 messages * N_THREADS, but due to the throttling we should get only 10 messages
+        // from each thread. Since we slept longer than the suppression window, the previous
+        // message batch should not affect.
+        if (!run(t, LOG_ERR, 100, 10 * N_THREADS))
         {
             rc = EXIT_FAILURE;
         }
@@ -221,8 +242,8 @@ int main(int argc, char* argv[])
         t.suppress_ms = 5000;
 
         // 100 messages * N_THREADS, and since we slept longer than the suppression window,
-        // we should get 20 messages.
-        if (!run(t, LOG_ERR, 100, 20))
+        // we should get 20 messages from each thread.
+        if (!run(t, LOG_ERR, 100, 20 * N_THREADS))
         {
             rc = EXIT_FAILURE;
         }
@@ -258,6 +279,7 @@ int main(int argc, char* argv[])
             rc = EXIT_FAILURE;
         }
 
+        stop_threads();
         mxs_log_finish();
     }
     else
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/buffer.h>
+#include <maxscale/config.h>
+#include <maxscale/debug.h>
+#include <maxscale/prometheus.h>
+#include "../maxscale/metrics.h"
+
+#define N_THREADS 4
+#define N_ITERATIONS 100000
+
+static const int64_t test_bounds[] = {10, 100, 1000};
+
+static const MXS_METRIC_DEF test_metrics[] =
+{
+    {"test_total", MXS_METRIC_COUNTER, "A counter"},
+    {"test_gauge", MXS_METRIC_GAUGE, "A gauge"},
+    {"test_max", MXS_METRIC_MAX, "A maximum"},
+    {"test_size", MXS_METRIC_HISTOGRAM, "A histogram", test_bounds, 3},
+    MXS_END_MODULE_METRICS
+};
+
+static MXS_METRIC *counter;
+static MXS_METRIC *gauge;
+static MXS_METRIC *max;
+static MXS_METRIC *histogram;
+
+static void* worker(void *data)
+{
+    int id = (int)(intptr_t)data;
+    metrics_thread_init(id);
+
+    for (int i = 0; i < N_ITERATIONS; i++)
+    {
+        mxs_metric_inc(counter);
+        mxs_metric_set_max(max, id * N_ITERATIONS + i);
+        mxs_metric_observe(histogram, i % 2000);
+    }
+
+    mxs_metric_set(gauge, id);
+    return NULL;
+}
+
+static char* collect()
+{
+    GWBUF *buffer = prometheus_collect();
+    ss_info_dassert(buffer, "Collecting should succeed");
+
+    char *text = malloc(GWBUF_LENGTH(buffer) + 1);
+    memcpy(text, GWBUF_DATA(buffer), GWBUF_LENGTH(buffer));
+    text[GWBUF_LENGTH(buffer)] = '\0';
+    gwbuf_free(buffer);
+
+    return text;
+}
+
+/**
+ * test1    Families are defined once and instruments need a family
+ */
+static int test1()
+{
+    ss_dfprintf(stderr, "testmetrics : definition of families");
+
+    for (const MXS_METRIC_DEF *def = test_metrics; def->name; def++)
+    {
+        ss_info_dassert(mxs_metric_define("test", def), "Defining should succeed");
+        ss_info_dassert(mxs_metric_define("test", def), "Redefining with the same type should succeed");
+    }
+
+    MXS_METRIC_DEF wrong_type = {"test_total", MXS_METRIC_GAUGE, "A gauge"};
+    ss_info_dassert(!mxs_metric_define(NULL, &wrong_type), "Redefining with another type should fail");
+
+    static const int64_t unordered[] = {10, 5};
+    MXS_METRIC_DEF bad_bounds = {"test_bad", MXS_METRIC_HISTOGRAM, "Bad", unordered, 2};
+    ss_info_dassert(!mxs_metric_define(NULL, &bad_bounds), "Unordered bounds should be rejected");
+
+    ss_info_dassert(mxs_metric_create("test_bad", NULL) == NULL,
+                    "Creating an undefined metric should fail");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    The values of the worker threads and other threads are combined
+ */
+static int test2()
+{
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+    pthread_t threads[N_THREADS];
+
+    ss_dfprintf(stderr, "testmetrics : updates from several threads");
+
+    prometheus_label(labels, "name", "one");
+    counter = mxs_metric_create("test_total", labels);
+    gauge = mxs_metric_create("test_gauge", NULL);
+    max = mxs_metric_create("test_max", NULL);
+    histogram = mxs_metric_create("test_size", NULL);
+    ss_info_dassert(counter && gauge && max && histogram, "Creating should succeed");
+    ss_info_dassert(strcmp(mxs_metric_labels(counter), "name=\"one\"") == 0, "Labels should be stored");
+    ss_info_dassert(strcmp(mxs_metric_name(counter), "test_total") == 0, "Name should be stored");
+
+    for (int i = 0; i < N_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, worker, (void*)(intptr_t)i);
+    }
+
+    /** This thread is not a worker and updates the shared values */
+    for (int i = 0; i < N_ITERATIONS; i++)
+    {
+        mxs_metric_add(counter, 2);
+    }
+
+    for (int i = 0; i < N_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    ss_info_dassert(mxs_metric_get(counter) == (N_THREADS + 2) * N_ITERATIONS,
+                    "Counter should be the sum of all threads");
+    ss_info_dassert(mxs_metric_get(gauge) == N_THREADS * (N_THREADS - 1) / 2,
+                    "Gauge should be the sum of all threads");
+    ss_info_dassert(mxs_metric_get(max) == N_THREADS * N_ITERATIONS - 1,
+                    "Maximum should be the highest value of all threads");
+
+    int64_t buckets[MXS_METRIC_BOUNDS_MAX + 1];
+    int64_t sum;
+    int n = mxs_metric_get_buckets(histogram, buckets, &sum);
+    int64_t per_cycle = N_ITERATIONS / 2000 * N_THREADS;
+
+    ss_info_dassert(n == 4, "Histogram should have one bucket more than bounds");
+    ss_info_dassert(buckets[0] == 11 * per_cycle, "Values up to 10 should be in the first bucket");
+    ss_info_dassert(buckets[1] == 90 * per_cycle, "Values up to 100 should be in the second bucket");
+    ss_info_dassert(buckets[2] == 900 * per_cycle, "Values up to 1000 should be in the third bucket");
+    ss_info_dassert(buckets[3] == 999 * per_cycle, "Larger values should be in the last bucket");
+    ss_info_dassert(sum == 1999 * 1000 * per_cycle, "Sum should be the sum of the observations");
+    ss_info_dassert(mxs_metric_get(histogram) == N_THREADS * N_ITERATIONS,
+                    "Value of a histogram should be the number of observations");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test3    The values of freed instruments are reset when they are reused
+ */
+static int test3()
+{
+    ss_dfprintf(stderr, "testmetrics : reuse of freed instruments");
+
+    mxs_metric_free(gauge);
+    gauge = mxs_metric_create("test_gauge", NULL);
+    ss_info_dassert(gauge, "Creating should succeed");
+    ss_info_dassert(mxs_metric_get(gauge) == 0, "A new instrument should start from zero");
+
+    /** Enough instruments to need more than one chunk of values */
+    MXS_METRIC *many[1000];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        many[i] = mxs_metric_create("test_size", NULL);
+        ss_info_dassert(many[i], "Creating should succeed");
+        mxs_metric_observe(many[i], i);
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        ss_info_dassert(mxs_metric_get(many[i]) == 1, "Instruments should not share values");
+        mxs_metric_free(many[i]);
+    }
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test4    All instruments are in the Prometheus output
+ */
+static int test4()
+{
+    ss_dfprintf(stderr, "testmetrics : Prometheus output");
+
+    ss_info_dassert(prometheus_add_collector(metrics_collect, NULL), "Adding should succeed");
+    char *text = collect();
+    const char *expected =
+        "# HELP test_total A counter\n"
+        "# TYPE test_total counter\n"
+        "test_total{name=\"one\"} 600000\n"
+        "# HELP test_gauge A gauge\n"
+        "# TYPE test_gauge gauge\n"
+        "test_gauge 0\n"
+        "# HELP test_max A maximum\n"
+        "# TYPE test_max gauge\n"
+        "test_max 399999\n"
+        "# HELP test_size A histogram\n"
+        "# TYPE test_size histogram\n"
+        "test_size_bucket{le=\"10\"} 2200\n"
+        "test_size_bucket{le=\"100\"} 20200\n"
+        "test_size_bucket{le=\"1000\"} 200200\n"
+        "test_size_bucket{le=\"+Inf\"} 400000\n"
+        "test_size_sum 399800000\n"
+        "test_size_count 400000\n";
+
+    ss_info_dassert(strcmp(text, expected) == 0, "Output should contain all instruments");
+    free(text);
+    prometheus_remove_collector(metrics_collect, NULL);
+
+    mxs_metric_free(counter);
+    mxs_metric_free(gauge);
+    mxs_metric_free(max);
+    mxs_metric_free(histogram);
+    metrics_end();
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    config_get_global_options()->n_threads = N_THREADS;
+
+    result += test1();
+    result += test2();
+    result += test3();
+    result += test4();
+
+    exit(result);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/buffer.h>
+#include <maxscale/debug.h>
+#include <maxscale/prometheus.h>
+
+static char one[] = "one";
+static char two[] = "two";
+
+static void collect_first(PROMETHEUS_OUTPUT *out, void *data)
+{
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+    prometheus_label(labels, "name", (const char*)data);
+
+    prometheus_sample(out, "test_total", PROMETHEUS_COUNTER, "A counter", labels, 1);
+    prometheus_sample(out, "test_gauge", PROMETHEUS_GAUGE, "A gauge", NULL, 0.5);
+}
+
+static void collect_second(PROMETHEUS_OUTPUT *out, void *data)
+{
+    static const double quantiles[] = {0.5, 0.99};
+    static const double values[] = {0.001, 0.25};
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+    prometheus_label(labels, "name", (const char*)data);
+
+    prometheus_sample(out, "test_total", PROMETHEUS_COUNTER, "A counter", labels, 12345678901.0);
+    prometheus_summary(out, "test_seconds", "A summary", labels, 10, 1.5, 2, quantiles, values);
+}
+
+static char* collect()
+{
+    GWBUF *buffer = prometheus_collect();
+    ss_info_dassert(buffer, "Collecting should succeed");
+
+    char *text = malloc(GWBUF_LENGTH(buffer) + 1);
+    memcpy(text, GWBUF_DATA(buffer), GWBUF_LENGTH(buffer));
+    text[GWBUF_LENGTH(buffer)] = '\0';
+    gwbuf_free(buffer);
+
+    return text;
+}
+
+/**
+ * test1    Labels are escaped
+ */
+static int test1()
+{
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+
+    ss_dfprintf(stderr, "testprometheus : label escaping");
+
+    prometheus_label(labels, "a", "x\"y\\z\nw");
+    prometheus_label(labels, "b", "");
+    ss_info_dassert(strcmp(labels, "a=\"x\\\"y\\\\z\\nw\",b=\"\"") == 0,
+                    "Labels should be escaped and separated by commas");
+
+    char value[PROMETHEUS_LABELS_MAXLEN * 2];
+    memset(value, '"', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    labels[0] = '\0';
+    prometheus_label(labels, "long", value);
+    size_t len = strlen(labels);
+    ss_info_dassert(len < PROMETHEUS_LABELS_MAXLEN, "Long labels should be truncated");
+    ss_info_dassert(labels[len - 1] == '"' && labels[len - 2] == '"' && labels[len - 3] == '\\',
+                    "Truncation should not split an escape sequence");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    Samples of a family are grouped even when several collectors add them
+ */
+static int test2()
+{
+    ss_dfprintf(stderr, "testprometheus : grouping of families");
+
+    ss_info_dassert(prometheus_add_collector(collect_first, one), "Adding should succeed");
+    ss_info_dassert(prometheus_add_collector(collect_second, two), "Adding should succeed");
+
+    char *text = collect();
+    const char *expected =
+        "# HELP test_total A counter\n"
+        "# TYPE test_total counter\n"
+        "test_total{name=\"one\"} 1\n"
+        "test_total{name=\"two\"} 12345678901\n"
+        "# HELP test_gauge A gauge\n"
+        "# TYPE test_gauge gauge\n"
+        "test_gauge 0.5\n"
+        "# HELP test_seconds A summary\n"
+        "# TYPE test_seconds summary\n"
+        "test_seconds{name=\"two\",quantile=\"0.5\"} 0.001\n"
+        "test_seconds{name=\"two\",quantile=\"0.99\"} 0.25\n"
+        "test_seconds_sum{name=\"two\"} 1.5\n"
+        "test_seconds_count{name=\"two\"} 10\n";
+
+    ss_info_dassert(strcmp(text, expected) == 0, "Output should be grouped by family");
+    free(text);
+
+    prometheus_remove_collector(collect_first, one);
+    text = collect();
+    ss_info_dassert(strstr(text, "name=\"one\"") == NULL, "Removed collector should not run");
+    ss_info_dassert(strstr(text, "test_gauge") == NULL, "Removed collector should not run");
+    free(text);
+
+    prometheus_remove_collector(collect_second, two);
+    GWBUF *buffer = prometheus_collect();
+    ss_info_dassert(buffer && GWBUF_LENGTH(buffer) == 0, "Output should be empty without collectors");
+    gwbuf_free(buffer);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    result += test1();
+    result += test2();
+
+    exit(result);
+}
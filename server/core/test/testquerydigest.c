@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/debug.h>
+#include <maxscale/query_digest.h>
+#include <maxscale/resultset.h>
+#include <maxscale/thread.h>
+
+#define N_THREADS   4
+#define N_CALLS     1000
+
+#define COL_STATEMENT 1
+#define COL_CALLS     2
+#define COL_ERRORS    3
+#define COL_ROWS      11
+
+static const char *statements[] =
+{
+    "SELECT * FROM t1 WHERE id = ?",
+    "UPDATE t1 SET a = ? WHERE id = ?",
+    "INSERT INTO t2 VALUES (?)"
+};
+
+#define N_STATEMENTS (sizeof(statements) / sizeof(statements[0]))
+
+/**
+ * Count the rows of the digest list and find the row of a statement
+ *
+ * @param statement The statement to look for
+ * @param calls     The number of calls of the statement is stored here
+ * @param errors    The number of errors of the statement is stored here
+ * @param rows      The number of rows of the statement is stored here
+ *
+ * @return Number of rows in the list
+ */
+static int find_digest(const char *statement, long *calls, long *errors, long *rows)
+{
+    RESULTSET *set = queryDigestGetList();
+    ss_info_dassert(set, "Result set should be created");
+
+    RESULT_ROW *row;
+    int n = 0;
+    *calls = *errors = *rows = 0;
+
+    while ((row = set->fetchrow(set, set->userdata)))
+    {
+        if (statement && strcmp(row->cols[COL_STATEMENT], statement) == 0)
+        {
+            *calls = atol(row->cols[COL_CALLS]);
+            *errors = atol(row->cols[COL_ERRORS]);
+            *rows = atol(row->cols[COL_ROWS]);
+        }
+
+        resultset_free_row(row);
+        n++;
+    }
+
+    resultset_free(set);
+    return n;
+}
+
+static void recorder(void *data)
+{
+    for (int i = 0; i < N_CALLS; i++)
+    {
+        for (size_t s = 0; s < N_STATEMENTS; s++)
+        {
+            query_digest_record(statements[s], i, s, 10, i % 10 == 0);
+        }
+    }
+}
+
+/**
+ * test1    Statistics recorded by several threads are merged into one row
+ *          per digest
+ */
+static int test1()
+{
+    THREAD threads[N_THREADS];
+    long calls, errors, rows;
+
+    ss_dfprintf(stderr, "testquerydigest : merging of thread shards");
+
+    for (int i = 0; i < N_THREADS; i++)
+    {
+        ss_info_dassert(thread_start(&threads[i], recorder, NULL), "Thread should start");
+    }
+
+    for (int i = 0; i < N_THREADS; i++)
+    {
+        thread_wait(threads[i]);
+    }
+
+    ss_info_dassert(find_digest(statements[1], &calls, &errors, &rows) == N_STATEMENTS,
+                    "There should be one row per statement");
+    ss_info_dassert(calls == N_THREADS * N_CALLS, "All calls should be counted");
+    ss_info_dassert(errors == N_THREADS * N_CALLS / 10, "All errors should be counted");
+    ss_info_dassert(rows == N_THREADS * N_CALLS, "All rows should be counted");
+
+    query_digest_reset();
+    ss_info_dassert(find_digest(NULL, &calls, &errors, &rows) == 0,
+                    "Reset should discard all digests");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    A full shard evicts rarely executed digests instead of frequent ones
+ */
+static int test2()
+{
+    long calls, errors, rows;
+    char buf[64];
+
+    ss_dfprintf(stderr, "testquerydigest : eviction of rare digests");
+
+    for (int i = 0; i < 100; i++)
+    {
+        query_digest_record(statements[0], 1, 1, 1, false);
+    }
+
+    for (int i = 0; i < QUERY_DIGEST_MAX_ENTRIES * 4; i++)
+    {
+        snprintf(buf, sizeof(buf), "SELECT %d", i);
+        query_digest_record(buf, 1, 1, 1, false);
+    }
+
+    ss_info_dassert(find_digest(statements[0], &calls, &errors, &rows) == QUERY_DIGEST_MAX_ENTRIES,
+                    "The shard should be full");
+    ss_info_dassert(calls == 100, "The frequent digest should not be evicted");
+
+    query_digest_reset();
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    result += test1();
+    result += test2();
+
+    exit(result);
+}
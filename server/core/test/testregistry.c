@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/atomic.h>
+#include <maxscale/debug.h>
+#include <maxscale/spinlock.h>
+#include <maxscale/thread.h>
+#include "../maxscale/registry.h"
+
+#define N_OBJECTS 500
+#define N_READERS 4
+#define N_PUBLISHES 200
+
+static int objects[N_OBJECTS];
+static char names[N_OBJECTS][32];
+static int readers_done = 0;
+static REGISTRY shared = REGISTRY_INIT(NULL, NULL);
+
+/** The objects in the list of the registry that registry_start() builds */
+static SPINLOCK list_lock = SPINLOCK_INIT;
+static int list_count = 0;
+
+static void* list_next(void *object, const char **name)
+{
+    int i = object ? (int*)object - objects + 1 : 0;
+
+    if (i >= list_count)
+    {
+        return NULL;
+    }
+
+    *name = names[i];
+    return &objects[i];
+}
+
+static REGISTRY listed = REGISTRY_INIT(list_next, &list_lock);
+
+/**
+ * Publish an index of the first @c count objects
+ *
+ * @return The replaced index
+ */
+static REGISTRY_INDEX* publish(REGISTRY *registry, int count)
+{
+    REGISTRY_INDEX *index = registry_index_alloc(count);
+    ss_info_dassert(index, "Index should be allocated");
+
+    for (int i = 0; i < count; i++)
+    {
+        ss_info_dassert(registry_index_add(index, names[i], &objects[i]),
+                        "Object should be added to the index");
+    }
+
+    return registry_publish(registry, index);
+}
+
+/**
+ * test1    Lookups from published indexes
+ */
+static int test1()
+{
+    REGISTRY registry = REGISTRY_INIT(NULL, NULL);
+    void *found;
+
+    ss_dfprintf(stderr, "testregistry : lookups");
+
+    ss_info_dassert(!registry_find(&registry, names[0], &found),
+                    "Lookup without an index should fall back to the list");
+
+    ss_info_dassert(publish(&registry, N_OBJECTS) == NULL, "Nothing should be replaced");
+
+    for (int i = 0; i < N_OBJECTS; i++)
+    {
+        ss_info_dassert(registry_find(&registry, names[i], &found), "Index should be used");
+        ss_info_dassert(found == &objects[i], "The object with the name should be found");
+    }
+
+    ss_info_dassert(registry_find(&registry, "not-an-object", &found), "Index should be used");
+    ss_info_dassert(found == NULL, "Unknown name should not be found");
+
+    REGISTRY_INDEX *old = publish(&registry, 0);
+    ss_info_dassert(old, "The first index should be replaced");
+    registry_index_free(old);
+    ss_info_dassert(registry_find(&registry, names[0], &found), "Index should be used");
+    ss_info_dassert(found == NULL, "Empty index should not find objects");
+
+    registry_index_free(registry_publish(&registry, NULL));
+    ss_info_dassert(!registry_find(&registry, names[0], &found),
+                    "Lookup should fall back to the list after a NULL index is published");
+
+    REGISTRY_INDEX *index = registry_index_alloc(2);
+    ss_info_dassert(index, "Index should be allocated");
+    ss_info_dassert(registry_index_add(index, "a", &objects[0]), "Object should be added");
+    ss_info_dassert(registry_index_add(index, "a", &objects[1]), "Duplicate should be accepted");
+    ss_info_dassert(registry_index_add(index, "b", &objects[2]), "Object should be added");
+    ss_info_dassert(!registry_index_add(index, "c", &objects[3]),
+                    "Adding more objects than allocated for should fail");
+    ss_info_dassert(registry_publish(&registry, index) == NULL, "Nothing should be replaced");
+
+    ss_info_dassert(registry_find(&registry, "a", &found) && found == &objects[0],
+                    "The first object with a duplicate name should be found");
+
+    registry_clear(&registry);
+    ss_info_dassert(!registry_find(&registry, "a", &found), "Cleared registry should have no index");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+static void reader(void *data)
+{
+    int *lookups = (int*)data;
+
+    while (atomic_add(&readers_done, 0) == 0)
+    {
+        for (int i = 0; i < N_OBJECTS / 2; i++)
+        {
+            void *found;
+            ss_info_dassert(registry_find(&shared, names[i], &found), "Index should be used");
+            ss_info_dassert(found == &objects[i], "Object in every index should be found");
+            (*lookups)++;
+        }
+    }
+}
+
+/**
+ * test2    Readers always find the objects while new indexes are published
+ */
+static int test2()
+{
+    THREAD threads[N_READERS];
+    int lookups[N_READERS] = {0};
+    REGISTRY_INDEX *replaced[N_PUBLISHES];
+
+    ss_dfprintf(stderr, "testregistry : concurrent publishing");
+
+    ss_info_dassert(publish(&shared, N_OBJECTS / 2) == NULL, "Nothing should be replaced");
+
+    for (int i = 0; i < N_READERS; i++)
+    {
+        ss_info_dassert(thread_start(&threads[i], reader, &lookups[i]), "Thread should start");
+    }
+
+    for (int i = 0; i < N_PUBLISHES; i++)
+    {
+        /** The readers may still use the replaced indexes */
+        replaced[i] = publish(&shared, N_OBJECTS / 2 + i % (N_OBJECTS / 2));
+    }
+
+    atomic_add(&readers_done, 1);
+
+    for (int i = 0; i < N_READERS; i++)
+    {
+        thread_wait(threads[i]);
+        ss_info_dassert(lookups[i] > 0, "Reader should have done lookups");
+    }
+
+    for (int i = 0; i < N_PUBLISHES; i++)
+    {
+        registry_index_free(replaced[i]);
+    }
+
+    registry_clear(&shared);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test3    Indexes are built from the lists when registry_start() is called
+ */
+static int test3()
+{
+    void *found;
+
+    ss_dfprintf(stderr, "testregistry : building at startup");
+
+    for (int i = 0; i < N_OBJECTS; i++)
+    {
+        spinlock_acquire(&list_lock);
+        list_count++;
+        registry_update(&listed);
+        spinlock_release(&list_lock);
+    }
+
+    ss_info_dassert(!registry_find(&listed, names[0], &found),
+                    "No index should be built before startup");
+
+    registry_start();
+
+    for (int i = 0; i < N_OBJECTS; i++)
+    {
+        ss_info_dassert(registry_find(&listed, names[i], &found), "Index should be used");
+        ss_info_dassert(found == &objects[i], "Every object in the list should be found");
+    }
+
+    registry_clear(&listed);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    for (int i = 0; i < N_OBJECTS; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "object-%d", i);
+    }
+
+    result += test1();
+    result += test2();
+    result += test3();
+
+    exit(result);
+}
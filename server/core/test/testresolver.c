@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include <maxscale/config.h>
+#include <maxscale/log_manager.h>
+#include <maxscale/thread.h>
+#include "../maxscale/resolver.h"
+
+/**
+ * test1    Numeric addresses are converted without the resolver thread
+ */
+static int
+test1()
+{
+    struct sockaddr_storage addr;
+
+    ss_dfprintf(stderr, "testresolver : numeric addresses");
+    ss_info_dassert(resolver_lookup("127.0.0.1", &addr) == MXS_RESOLVE_OK,
+                    "IPv4 address should be converted");
+    ss_info_dassert(addr.ss_family == AF_INET, "Address family should be AF_INET");
+    ss_info_dassert(resolver_lookup("::1", &addr) == MXS_RESOLVE_OK,
+                    "IPv6 address should be converted");
+    ss_info_dassert(addr.ss_family == AF_INET6, "Address family should be AF_INET6");
+
+    RESOLVER_STATS stats;
+    resolver_get_stats(&stats);
+    ss_info_dassert(stats.entries == 0, "Numeric addresses should not be cached");
+    ss_dfprintf(stderr, "\t..done\n");
+
+    return 0;
+}
+
+/**
+ * test2    Prefetched hosts are resolved when the resolver starts and
+ *          unknown hosts are resolved in the background
+ */
+static int
+test2()
+{
+    struct sockaddr_storage addr;
+    RESOLVER_STATS stats;
+
+    ss_dfprintf(stderr, "testresolver : cached lookups");
+    resolver_prefetch("localhost");
+    ss_info_dassert(resolver_init(), "Resolver should start");
+
+    ss_info_dassert(resolver_lookup("localhost", &addr) == MXS_RESOLVE_OK,
+                    "Prefetched host should be resolved");
+    resolver_get_stats(&stats);
+    ss_info_dassert(stats.hits == 1, "Lookup should be a cache hit");
+
+    ss_info_dassert(resolver_lookup("nonexistent.invalid", &addr) == MXS_RESOLVE_PENDING,
+                    "Unknown host should be queued for resolution");
+
+    mxs_resolve_result_t res = MXS_RESOLVE_PENDING;
+
+    for (int i = 0; i < 100 && res == MXS_RESOLVE_PENDING; i++)
+    {
+        thread_millisleep(100);
+        res = resolver_lookup("nonexistent.invalid", &addr);
+    }
+
+    ss_info_dassert(res == MXS_RESOLVE_FAILED, "Invalid host should fail to resolve");
+    resolver_get_stats(&stats);
+    ss_info_dassert(stats.entries == 2, "Two hosts should be cached");
+    ss_info_dassert(stats.misses >= 1, "The first lookup should be a miss");
+    ss_info_dassert(stats.errors >= 1, "The resolution should have failed");
+
+    resolver_shutdown();
+    resolver_finish();
+    ss_dfprintf(stderr, "\t..done\n");
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    mxs_log_init(NULL, "/tmp", MXS_LOG_TARGET_FS);
+    config_get_global_options()->dns_cache_ttl = DEFAULT_DNS_CACHE_TTL;
+
+    result += test1();
+    result += test2();
+
+    mxs_log_finish();
+    exit(result);
+}
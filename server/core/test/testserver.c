@@ -174,6 +174,54 @@ bool test_serialize()
     return true;
 }
 
+bool test_gtid()
+{
+    SERVER *server = server_alloc("gtid-server", "127.0.0.1", 9876, "HTTPD", "NullAuthAllow", NULL);
+    TEST(server, "Server allocation failed");
+
+    TEST(!server_has_gtid(server, "0-1-10"), "A server without a position should not have a GTID");
+
+    server_set_gtid_pos(server, "0-1-10,1-2-5");
+    TEST(server_has_gtid(server, "0-1-10"), "Server should have an equal GTID");
+    TEST(server_has_gtid(server, "0-3-9"), "Server should have an older GTID");
+    TEST(!server_has_gtid(server, "0-1-11"), "Server should not have a newer GTID");
+    TEST(server_has_gtid(server, "0-1-10,1-1-5"), "Server should have both GTIDs");
+    TEST(!server_has_gtid(server, "0-1-10,1-1-6"), "Server should not have the second GTID");
+    TEST(!server_has_gtid(server, "2-1-1"), "Server should not have a GTID of an unknown domain");
+    TEST(!server_has_gtid(server, "garbage"), "An invalid GTID should not match");
+    TEST(!server_has_gtid(server, ""), "An empty GTID should not match");
+
+    return true;
+}
+
+bool test_response_time()
+{
+    SERVER *server = server_alloc("rtime-server", "127.0.0.1", 9876, "HTTPD", "NullAuthAllow", NULL);
+    TEST(server, "Server allocation failed");
+
+    TEST(server->stats.response_time == 0, "A new server should not have a response time");
+
+    server_add_response_time(server, 100);
+    TEST(server->stats.response_time == 100, "The first response time should be the average");
+
+    server_add_response_time(server, 200);
+    TEST(server->stats.response_time == 150, "The first response times should be averaged");
+
+    for (int i = 0; i < 100; i++)
+    {
+        server_add_response_time(server, 1000);
+    }
+
+    TEST(server->stats.response_time > 990 && server->stats.response_time <= 1000,
+         "Old response times should decay");
+
+    server_add_response_time(server, 9000);
+    TEST(server->stats.response_time > 1990 && server->stats.response_time <= 2000,
+         "A new response time should have an eighth of the average");
+
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     int result = 0;
@@ -185,5 +233,15 @@ int main(int argc, char **argv)
         result++;
     }
 
+    if (!test_gtid())
+    {
+        result++;
+    }
+
+    if (!test_response_time())
+    {
+        result++;
+    }
+
     exit(result);
 }
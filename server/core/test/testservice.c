@@ -80,11 +80,45 @@ test1()
 
 }
 
+/**
+ * test2    Users are reloaded in the background at most once per refresh period
+ */
+static int
+test2()
+{
+    SERVICE *service;
+
+    ss_dfprintf(stderr, "testservice : background reload of users");
+    set_libdir(MXS_STRDUP_A("../../modules/routing/readconnroute/"));
+    service = service_alloc("AsyncService", "readconnroute");
+    ss_info_dassert(NULL != service, "New service with valid router must not be null");
+
+    config_get_global_options()->users_refresh_time = 3600;
+    service->rate_limit.last = time(NULL) - 3600;
+
+    ss_info_dassert(service_refresh_users_async(service) == 0, "First reload should be requested");
+    ss_info_dassert(service->users_loader.running, "Loader thread should be started");
+    ss_info_dassert(service_refresh_users_async(service) != 0,
+                    "Second reload should exceed the rate limit");
+    ss_info_dassert(service_refresh_users(service) != 0,
+                    "Synchronous reload should exceed the rate limit");
+
+    service_shutdown();
+    service_destroy_instances();
+    ss_info_dassert(!service->users_loader.running, "Loader thread should be stopped");
+    ss_info_dassert(service_refresh_users_async(service) != 0,
+                    "Reload should not be requested after shutdown");
+    ss_dfprintf(stderr, "\t..done\n");
+
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     int result = 0;
 
     result += test1();
+    result += test2();
 
     exit(result);
 }
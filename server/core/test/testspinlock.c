@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <maxscale/spinlock.h>
 #include <maxscale/thread.h>
@@ -245,6 +246,96 @@ test3()
     return 0 == failures ? 0 : 1;
 }
 
+/**
+ * test4    spinlock profiling tests
+ *
+ * Check that a contended lock shows up in the profile, that waiting threads
+ * that have been parked get the lock, and that re-enabling the profiling
+ * discards earlier results.
+ */
+#define TEST4_THREADS 8
+#define TEST4_ITERATIONS 20000
+
+static SPINLOCK test4_lock = SPINLOCK_INIT;
+static int test4_counter;
+static bool test4_found;
+static uint64_t test4_contended;
+
+static void
+test4_helper(void *data)
+{
+    for (int i = 0; i < TEST4_ITERATIONS; i++)
+    {
+        spinlock_acquire(&test4_lock);
+        test4_counter++;
+        if (i % 1000 == 0)
+        {
+            /** Hold the lock long enough for the waiters to be parked. */
+            struct timespec ts = { 0, 1000000 };
+            nanosleep(&ts, NULL);
+        }
+        spinlock_release(&test4_lock);
+    }
+}
+
+static void
+test4_reporter(void *hdl, const void *lock, const char *caller, uint64_t acquired, uint64_t contended)
+{
+    if (lock == &test4_lock)
+    {
+        test4_found = true;
+        test4_contended = contended;
+    }
+}
+
+static int
+test4()
+{
+    THREAD handle[TEST4_THREADS];
+    int failures = 0;
+
+    spinlock_profile_enable(true);
+
+    for (int i = 0; i < TEST4_THREADS; i++)
+    {
+        thread_start(&handle[i], test4_helper, NULL);
+    }
+
+    for (int i = 0; i < TEST4_THREADS; i++)
+    {
+        thread_wait(handle[i]);
+    }
+
+    if (test4_counter != TEST4_THREADS * TEST4_ITERATIONS)
+    {
+        fprintf(stderr, "spinlock: test 4.1 failed, counter is %d.\n", test4_counter);
+        failures++;
+    }
+
+    spinlock_profile_report(test4_reporter, NULL);
+
+    if (!test4_found || test4_contended == 0)
+    {
+        fprintf(stderr, "spinlock: test 4.2 failed, contended lock not in profile.\n");
+        failures++;
+    }
+
+    spinlock_profile_enable(false);
+    spinlock_profile_enable(true);
+    test4_found = false;
+    spinlock_profile_report(test4_reporter, NULL);
+
+    if (test4_found)
+    {
+        fprintf(stderr, "spinlock: test 4.3 failed, profile not cleared.\n");
+        failures++;
+    }
+
+    spinlock_profile_enable(false);
+
+    return failures;
+}
+
 int main(int argc, char **argv)
 {
     int result = 0;
@@ -252,6 +343,7 @@ int main(int argc, char **argv)
     result += test1();
     result += test2();
     result += test3();
+    result += test4();
 
     exit(result);
 }
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/timer_wheel.h>
+#include <maxscale/debug.h>
+
+#define N_TIMERS 5000
+
+typedef struct
+{
+    MXS_TIMER timer;
+    long      due;    /**< Tick at which the timer should fire */
+    long      fired;  /**< Tick at which the timer fired, 0 if not yet */
+    int       rearm;  /**< How many times the callback re-arms the timer */
+} test_timer_t;
+
+static MXS_TIMER_WHEEL wheel;
+
+static void test_callback(MXS_TIMER *timer, void *data)
+{
+    test_timer_t *t = (test_timer_t*)data;
+    ss_info_dassert(!timer_is_armed(timer), "Fired timer should be disarmed");
+    ss_info_dassert(t->fired == 0, "Timer should fire only once");
+    t->fired = wheel.now;
+
+    if (t->rearm > 0)
+    {
+        t->rearm--;
+        t->due = wheel.now + 10;
+        t->fired = 0;
+        timer_wheel_add(&wheel, timer, t->due);
+    }
+}
+
+/**
+ * test1    Timers with delays on every level expire at the right tick
+ */
+static int test1()
+{
+    static test_timer_t timers[N_TIMERS];
+    long delays[] = {1, 2, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+                     TIMER_WHEEL_MAX_DELAY, TIMER_WHEEL_MAX_DELAY + 1,
+                     TIMER_WHEEL_MAX_DELAY + 100
+                    };
+    int n_delays = sizeof(delays) / sizeof(delays[0]);
+    long start = 12345;
+
+    ss_dfprintf(stderr, "testtimerwheel : expiry on every level");
+    timer_wheel_init(&wheel, start);
+
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        test_timer_t *t = &timers[i];
+        t->due = start + (i < n_delays ? delays[i] : random() % 100000 + 1);
+        t->fired = 0;
+        t->rearm = 0;
+        timer_init(&t->timer, test_callback, t);
+        timer_wheel_add(&wheel, &t->timer, t->due);
+    }
+
+    ss_info_dassert(wheel.count == N_TIMERS, "All timers should be armed");
+
+    /** Advance in uneven steps to make sure that skipped ticks are processed */
+    long end = start + TIMER_WHEEL_MAX_DELAY + 200;
+    int fired = 0;
+
+    for (long now = start; now < end; now += 1 + random() % 7)
+    {
+        fired += timer_wheel_advance(&wheel, now);
+    }
+
+    fired += timer_wheel_advance(&wheel, end);
+
+    ss_info_dassert(fired == N_TIMERS, "All timers should fire");
+    ss_info_dassert(wheel.count == 0, "The wheel should be empty");
+
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        ss_info_dassert(timers[i].fired == timers[i].due, "Timer should fire at its due tick");
+    }
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    Removed timers do not fire and re-armed timers fire again
+ */
+static int test2()
+{
+    static test_timer_t timers[N_TIMERS];
+    long start = 0;
+
+    ss_dfprintf(stderr, "testtimerwheel : removal and re-arming");
+    timer_wheel_init(&wheel, start);
+
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        test_timer_t *t = &timers[i];
+        t->due = start + 1 + random() % 5000;
+        t->fired = 0;
+        t->rearm = i % 3 == 0 ? 2 : 0;
+        timer_init(&t->timer, test_callback, t);
+        timer_wheel_add(&wheel, &t->timer, t->due);
+    }
+
+    /** Remove every other timer, and move some of the rest */
+    for (int i = 0; i < N_TIMERS; i += 2)
+    {
+        timer_wheel_remove(&wheel, &timers[i].timer);
+        ss_info_dassert(!timer_is_armed(&timers[i].timer), "Removed timer should be disarmed");
+        timer_wheel_remove(&wheel, &timers[i].timer);
+    }
+
+    for (int i = 1; i < N_TIMERS; i += 4)
+    {
+        timers[i].due = start + 1 + random() % 5000;
+        timer_wheel_add(&wheel, &timers[i].timer, timers[i].due);
+    }
+
+    ss_info_dassert(wheel.count == N_TIMERS / 2, "Half of the timers should be armed");
+
+    for (long now = start; now <= start + 6000; now++)
+    {
+        timer_wheel_advance(&wheel, now);
+    }
+
+    ss_info_dassert(wheel.count == 0, "The wheel should be empty");
+
+    for (int i = 0; i < N_TIMERS; i++)
+    {
+        if (i % 2 == 0)
+        {
+            ss_info_dassert(timers[i].fired == 0, "Removed timer should not fire");
+        }
+        else
+        {
+            ss_info_dassert(timers[i].rearm == 0, "Re-armed timer should fire again");
+            ss_info_dassert(timers[i].fired == timers[i].due, "Timer should fire at its due tick");
+        }
+    }
+
+    /** A timer added in the past expires on the next tick */
+    test_timer_t t = {.fired = 0, .rearm = 0};
+    timer_init(&t.timer, test_callback, &t);
+    timer_wheel_add(&wheel, &t.timer, wheel.now - 100);
+    ss_info_dassert(timer_wheel_advance(&wheel, wheel.now) == 0, "Timer should not fire on the current tick");
+    ss_info_dassert(timer_wheel_advance(&wheel, wheel.now + 1) == 1, "Timer should fire on the next tick");
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    srandom(4321);
+    result += test1();
+    result += test2();
+
+    exit(result);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/alloc.h>
+#include <maxscale/debug.h>
+#include <maxscale/thread.h>
+#include "../maxscale/worker_queue.h"
+
+#define N_PRODUCERS 4
+#define N_MESSAGES  100000
+
+typedef struct
+{
+    WORKER_MSG msg;
+    int        producer;
+    int        seq;
+} test_msg_t;
+
+static WORKER_QUEUE queue;
+static int next_seq[N_PRODUCERS];
+static int received = 0;
+
+static void test_handler(int thread_id, WORKER_MSG *msg)
+{
+    test_msg_t *m = (test_msg_t*)msg;
+    ss_info_dassert(thread_id == 1, "Handler should get the consumer's thread ID");
+    ss_info_dassert(m->seq == next_seq[m->producer], "Messages of a producer should arrive in order");
+    next_seq[m->producer]++;
+    received++;
+    MXS_FREE(m);
+}
+
+static void producer(void *data)
+{
+    int id = (int)(intptr_t)data;
+
+    for (int i = 0; i < N_MESSAGES; i++)
+    {
+        test_msg_t *m = MXS_MALLOC(sizeof(*m));
+        MXS_ABORT_IF_NULL(m);
+        m->producer = id;
+        m->seq = i;
+        worker_queue_post(&queue, &m->msg, test_handler);
+    }
+}
+
+/**
+ * test1    Messages from several producers are all delivered, in order, and
+ *          the consumer is woken up through the eventfd
+ */
+static int test1()
+{
+    THREAD threads[N_PRODUCERS];
+
+    ss_dfprintf(stderr, "testworkerqueue : multiple producers");
+    ss_info_dassert(worker_queue_init(&queue), "Queue should be initialized");
+    ss_info_dassert(worker_queue_take(&queue) == NULL, "New queue should be empty");
+
+    for (int i = 0; i < N_PRODUCERS; i++)
+    {
+        ss_info_dassert(thread_start(&threads[i], producer, (void*)(intptr_t)i), "Thread should start");
+    }
+
+    struct pollfd pfd = {.fd = queue.fd, .events = POLLIN};
+
+    while (received < N_PRODUCERS * N_MESSAGES)
+    {
+        /** All messages are posted within the timeout, a timeout means that
+         * a wakeup was lost */
+        int rc = poll(&pfd, 1, 5000);
+        ss_info_dassert(rc == 1, "Consumer should be woken up");
+        worker_queue_process(&queue, 1);
+    }
+
+    for (int i = 0; i < N_PRODUCERS; i++)
+    {
+        thread_wait(threads[i]);
+    }
+
+    ss_info_dassert(!worker_queue_pending(&queue), "Queue should be empty");
+    ss_info_dassert(poll(&pfd, 1, 0) == 0, "The eventfd should not be readable");
+
+    worker_queue_wake(&queue);
+    ss_info_dassert(poll(&pfd, 1, 0) == 1, "A wakeup should make the eventfd readable");
+    ss_info_dassert(worker_queue_process(&queue, 1) == 0, "A wakeup should not post messages");
+    ss_info_dassert(poll(&pfd, 1, 0) == 0, "The eventfd should be cleared");
+
+    worker_queue_destroy(&queue);
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    result += test1();
+
+    exit(result);
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file timer_wheel.c Hierarchical timer wheel
+ *
+ * The wheel consists of TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots.
+ * A slot on level 0 covers one tick, a slot on level 1 covers
+ * TIMER_WHEEL_SLOTS ticks and so on. A timer is placed on the lowest level
+ * whose range covers its expiry time. Whenever the index of level 0 wraps
+ * around, the timers in the current slot of the next level are redistributed
+ * to the levels below it ("cascading").
+ */
+
+#include <maxscale/timer_wheel.h>
+#include <string.h>
+#include <maxscale/debug.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static inline int level_index(long tick, int level)
+{
+    return (tick >> (level * TIMER_WHEEL_LEVEL_BITS)) & SLOT_MASK;
+}
+
+static inline void slot_push(MXS_TIMER **slot, MXS_TIMER *timer)
+{
+    timer->next = *slot;
+
+    if (timer->next)
+    {
+        timer->next->pprev = &timer->next;
+    }
+
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+static inline void slot_unlink(MXS_TIMER *timer)
+{
+    *timer->pprev = timer->next;
+
+    if (timer->next)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * Place a timer into the slot that covers its expiry time. The expiry time
+ * must not be before the current tick.
+ */
+static void wheel_place(MXS_TIMER_WHEEL *wheel, MXS_TIMER *timer)
+{
+    long expires = timer->expires;
+    long delta = expires - wheel->now;
+    ss_dassert(delta >= 0);
+
+    if (delta > TIMER_WHEEL_MAX_DELAY)
+    {
+        /** Park the timer in the slot that is cascaded last, it will be
+         * placed again with its real expiry time when that happens. */
+        expires = wheel->now + TIMER_WHEEL_MAX_DELAY;
+        delta = TIMER_WHEEL_MAX_DELAY;
+    }
+
+    int level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= 1L << ((level + 1) * TIMER_WHEEL_LEVEL_BITS))
+    {
+        level++;
+    }
+
+    slot_push(&wheel->slots[level][level_index(expires, level)], timer);
+}
+
+/**
+ * Move the timers of the current slot on a level to the levels below it
+ *
+ * @return True if the index of this level wrapped around and the next
+ * level needs to be cascaded as well
+ */
+static bool wheel_cascade(MXS_TIMER_WHEEL *wheel, int level)
+{
+    int idx = level_index(wheel->now, level);
+    MXS_TIMER *timer;
+
+    while ((timer = wheel->slots[level][idx]))
+    {
+        slot_unlink(timer);
+        wheel_place(wheel, timer);
+    }
+
+    return idx == 0;
+}
+
+void timer_wheel_init(MXS_TIMER_WHEEL *wheel, long now)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now;
+}
+
+void timer_init(MXS_TIMER *timer, mxs_timer_cb_t callback, void *data)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+void timer_wheel_add(MXS_TIMER_WHEEL *wheel, MXS_TIMER *timer, long expires)
+{
+    if (timer_is_armed(timer))
+    {
+        slot_unlink(timer);
+        wheel->count--;
+    }
+
+    timer->expires = expires > wheel->now ? expires : wheel->now + 1;
+    wheel_place(wheel, timer);
+    wheel->count++;
+}
+
+void timer_wheel_remove(MXS_TIMER_WHEEL *wheel, MXS_TIMER *timer)
+{
+    if (timer_is_armed(timer))
+    {
+        slot_unlink(timer);
+        wheel->count--;
+        ss_dassert(wheel->count >= 0);
+    }
+}
+
+int timer_wheel_advance(MXS_TIMER_WHEEL *wheel, long now)
+{
+    int fired = 0;
+
+    while (wheel->now < now)
+    {
+        if (wheel->count == 0)
+        {
+            /** Nothing to expire, jump straight to the target tick */
+            wheel->now = now;
+            break;
+        }
+
+        wheel->now++;
+
+        for (int level = 1; level < TIMER_WHEEL_LEVELS &&
+                 level_index(wheel->now, level - 1) == 0; level++)
+        {
+            if (!wheel_cascade(wheel, level))
+            {
+                break;
+            }
+        }
+
+        MXS_TIMER **slot = &wheel->slots[0][level_index(wheel->now, 0)];
+        MXS_TIMER *timer;
+
+        /** The slot is re-read after every callback as the callbacks are
+         * free to add and remove timers */
+        while ((timer = *slot))
+        {
+            slot_unlink(timer);
+
+            if (timer->expires > wheel->now)
+            {
+                /** A clamped timer that is not yet due */
+                wheel_place(wheel, timer);
+                continue;
+            }
+
+            wheel->count--;
+            fired++;
+            timer->callback(timer, timer->data);
+        }
+    }
+
+    return fired;
+}
@@ -36,6 +36,7 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <netinet/tcp.h>
 #include <openssl/sha.h>
@@ -46,8 +47,10 @@
 #include <maxscale/log_manager.h>
 #include <maxscale/limits.h>
 #include <maxscale/pcre2.h>
+#include <maxscale/platform.h>
 #include <maxscale/poll.h>
 #include <maxscale/random_jkiss.h>
+#include <maxscale/resolver.h>
 #include <maxscale/secrets.h>
 #include <maxscale/session.h>
 
@@ -134,6 +137,111 @@ char *gw_strend(register const char *s)
     return (char*) (s - 1);
 }
 
+/** Size of the per-thread buffer of random bytes */
+#define RANDOM_BUFFER_SIZE 1024
+
+/**
+ * Random bytes from the kernel, read a buffer at a time so that generating a
+ * scramble does not cost a system call.
+ */
+static thread_local struct
+{
+    uint8_t data[RANDOM_BUFFER_SIZE];
+    size_t  pos;
+    bool    filled;
+} random_buffer;
+
+/**
+ * Fill a buffer with random bytes from the kernel
+ *
+ * @param buf Buffer to fill
+ * @param len Length of the buffer
+ *
+ * @return True if the whole buffer was filled
+ */
+static bool random_fill(uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+
+#if defined(SYS_getrandom)
+    while (n < len)
+    {
+        long rc = syscall(SYS_getrandom, buf + n, len - n, 0);
+
+        if (rc > 0)
+        {
+            n += rc;
+        }
+        else if (rc == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            break;
+        }
+    }
+#endif
+
+    if (n < len)
+    {
+        /** No getrandom(), use the device instead */
+        int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+        if (fd != -1)
+        {
+            while (n < len)
+            {
+                ssize_t rc = read(fd, buf + n, len - n);
+
+                if (rc > 0)
+                {
+                    n += rc;
+                }
+                else if (rc == 0 || errno != EINTR)
+                {
+                    break;
+                }
+            }
+
+            close(fd);
+        }
+    }
+
+    return n == len;
+}
+
+bool mxs_random_bytes(uint8_t *output, size_t len)
+{
+    while (len > 0)
+    {
+        if (!random_buffer.filled || random_buffer.pos == RANDOM_BUFFER_SIZE)
+        {
+            if (!random_fill(random_buffer.data, RANDOM_BUFFER_SIZE))
+            {
+                return false;
+            }
+
+            random_buffer.filled = true;
+            random_buffer.pos = 0;
+        }
+
+        size_t n = RANDOM_BUFFER_SIZE - random_buffer.pos;
+
+        if (n > len)
+        {
+            n = len;
+        }
+
+        memcpy(output, random_buffer.data + random_buffer.pos, n);
+        random_buffer.pos += n;
+        output += n;
+        len -= n;
+    }
+
+    return true;
+}
+
 /*****************************************
  * generate a random char
  *****************************************/
@@ -148,9 +256,33 @@ static char gw_randomchar()
  *****************************************/
 int gw_generate_random_str(char *output, int len)
 {
-    int i;
+    int i = 0;
+
+    /**
+     * The characters are 30 to 107, the same as gw_randomchar() produces.
+     * Bytes above the largest multiple of 78 are discarded so that every
+     * character is equally likely.
+     */
+    while (i < len)
+    {
+        uint8_t bytes[32];
+
+        if (!mxs_random_bytes(bytes, sizeof(bytes)))
+        {
+            break;
+        }
+
+        for (size_t j = 0; j < sizeof(bytes) && i < len; j++)
+        {
+            if (bytes[j] < 234)
+            {
+                output[i++] = (char)(bytes[j] % 78 + 30);
+            }
+        }
+    }
 
-    for (i = 0; i < len; ++i )
+    /** The kernel had no random bytes to give */
+    for (; i < len; ++i)
     {
         output[i] = gw_randomchar();
     }
@@ -928,9 +1060,14 @@ static bool configure_network_socket(int so)
 
 static bool configure_listener_socket(int so)
 {
+    /** The accepted client sockets inherit the buffer sizes and TCP_NODELAY */
+    int sndbufsize = MXS_CLIENT_SO_SNDBUF;
+    int rcvbufsize = MXS_CLIENT_SO_RCVBUF;
     int one = 1;
 
     if (setsockopt(so, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        setsockopt(so, SOL_SOCKET, SO_SNDBUF, &sndbufsize, sizeof(sndbufsize)) != 0 ||
+        setsockopt(so, SOL_SOCKET, SO_RCVBUF, &rcvbufsize, sizeof(rcvbufsize)) != 0 ||
         setsockopt(so, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0)
     {
         MXS_ERROR("Failed to set socket option: %d, %s.", errno, mxs_strerror(errno));
@@ -959,16 +1096,99 @@ static void set_port(struct sockaddr_storage *addr, uint16_t port)
     }
 }
 
+/**
+ * Bind a connecting socket to the configured local address
+ *
+ * @param so Socket to bind
+ */
+static void bind_local_address(int so)
+{
+    MXS_CONFIG* config = config_get_global_options();
+
+    if (config->local_address)
+    {
+        struct sockaddr_storage local_address = {};
+        mxs_resolve_result_t res = resolver_lookup(config->local_address, &local_address);
+
+        if (res == MXS_RESOLVE_OK)
+        {
+            if (bind(so, (struct sockaddr*)&local_address, sizeof(local_address)) == 0)
+            {
+                MXS_INFO("Bound connecting socket to \"%s\".", config->local_address);
+            }
+            else
+            {
+                MXS_ERROR("Could not bind connecting socket to local address \"%s\", "
+                          "connecting to server using default local address: %s",
+                          config->local_address, mxs_strerror(errno));
+            }
+        }
+        else
+        {
+            MXS_ERROR("Could not get address information for local address \"%s\", "
+                      "connecting to server using default local address: %s",
+                      config->local_address, res == MXS_RESOLVE_PENDING ?
+                      "Address is being resolved" : "Address could not be resolved");
+        }
+    }
+}
+
+/**
+ * Create a connecting socket. The address is looked up from the resolver
+ * cache so that the calling worker thread never blocks on name resolution.
+ */
+static int open_connecting_socket(struct sockaddr_storage *addr, const char *host, uint16_t port)
+{
+    int so = -1;
+    mxs_resolve_result_t res = resolver_lookup(host, addr);
+
+    if (res == MXS_RESOLVE_PENDING)
+    {
+        MXS_ERROR("Address for host %s is being resolved, cannot connect yet.", host);
+    }
+    else if (res == MXS_RESOLVE_FAILED)
+    {
+        MXS_ERROR("Failed to obtain address for host %s.", host);
+    }
+    else if ((so = socket(addr->ss_family, SOCK_STREAM, 0)) == -1)
+    {
+        MXS_ERROR("Socket creation failed: %d, %s.", errno, mxs_strerror(errno));
+    }
+    else
+    {
+        set_port(addr, port);
+
+        if (!configure_network_socket(so))
+        {
+            close(so);
+            so = -1;
+        }
+        else
+        {
+            bind_local_address(so);
+        }
+    }
+
+    return so;
+}
+
 int open_network_socket(enum mxs_socket_type type, struct sockaddr_storage *addr, const char *host, uint16_t port)
 {
     ss_dassert(type == MXS_SOCKET_NETWORK || type == MXS_SOCKET_LISTENER);
 #ifdef __USE_POSIX
+    if (type == MXS_SOCKET_NETWORK)
+    {
+        return open_connecting_socket(addr, host, port);
+    }
+
     struct addrinfo *ai = NULL, hint = {};
     int so = 0, rc = 0;
     hint.ai_socktype = SOCK_STREAM;
     hint.ai_family = AF_UNSPEC;
     hint.ai_flags = AI_ALL;
 
+    /** Listeners are only created at startup and from the admin interface
+     * so the name can be resolved directly */
     if ((rc = getaddrinfo(host, NULL, &hint, &ai)) != 0)
     {
         MXS_ERROR("Failed to obtain address for host %s: %s", host, gai_strerror(rc));
@@ -987,47 +1207,14 @@ int open_network_socket(enum mxs_socket_type type, struct sockaddr_storage *addr
             memcpy(addr, ai->ai_addr, ai->ai_addrlen);
             set_port(addr, port);
 
-            freeaddrinfo(ai);
-
-            if ((type == MXS_SOCKET_NETWORK && !configure_network_socket(so)) ||
-                (type == MXS_SOCKET_LISTENER && !configure_listener_socket(so)))
+            if (!configure_listener_socket(so))
             {
                 close(so);
                 so = -1;
             }
-            else if (type == MXS_SOCKET_NETWORK)
-            {
-                MXS_CONFIG* config = config_get_global_options();
-
-                if (config->local_address)
-                {
-                    if ((rc = getaddrinfo(config->local_address, NULL, &hint, &ai)) == 0)
-                    {
-                        struct sockaddr_storage local_address = {};
-
-                        memcpy(&local_address, ai->ai_addr, ai->ai_addrlen);
-                        freeaddrinfo(ai);
-
-                        if (bind(so, (struct sockaddr*)&local_address, sizeof(local_address)) == 0)
-                        {
-                            MXS_INFO("Bound connecting socket to \"%s\".", config->local_address);
-                        }
-                        else
-                        {
-                            MXS_ERROR("Could not bind connecting socket to local address \"%s\", "
-                                      "connecting to server using default local address: %s",
-                                      config->local_address, mxs_strerror(errno));
-                        }
-                    }
-                    else
-                    {
-                        MXS_ERROR("Could not get address information for local address \"%s\", "
-                                  "connecting to server using default local address: %s",
-                                  config->local_address, mxs_strerror(errno));
-                    }
-                }
-            }
         }
+
+        freeaddrinfo(ai);
     }
 
 #else
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file worker_queue.c - Cross-thread message queue of a worker
+ *
+ * The producers push messages onto a lock-free stack with a compare-and-swap.
+ * The consumer never removes individual messages, it swaps the whole stack out
+ * and reverses it. As the head is only ever replaced by a producer pushing on
+ * top of it or by the consumer emptying it, the stack does not suffer from the
+ * ABA problem.
+ *
+ * Only the producer that finds the queue empty signals the eventfd. The
+ * consumer clears the eventfd before taking the messages so a message posted
+ * after that is always either taken or signaled.
+ */
+
+#include "maxscale/worker_queue.h"
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <maxscale/debug.h>
+#include <maxscale/log_manager.h>
+
+bool worker_queue_init(WORKER_QUEUE *queue)
+{
+    queue->head = NULL;
+
+    if ((queue->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    {
+        char errbuf[MXS_STRERROR_BUFLEN];
+        MXS_ERROR("Failed to create eventfd: %d, %s", errno,
+                  strerror_r(errno, errbuf, sizeof(errbuf)));
+        return false;
+    }
+
+    return true;
+}
+
+void worker_queue_destroy(WORKER_QUEUE *queue)
+{
+    ss_dassert(queue->head == NULL);
+
+    if (queue->fd != -1)
+    {
+        close(queue->fd);
+        queue->fd = -1;
+    }
+}
+
+void worker_queue_wake(WORKER_QUEUE *queue)
+{
+    uint64_t one = 1;
+
+    /** The write can only fail if the counter would overflow, in which case
+     * the consumer is going to wake up anyway. */
+    if (write(queue->fd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+    {
+        char errbuf[MXS_STRERROR_BUFLEN];
+        MXS_ERROR("Failed to signal eventfd: %d, %s", errno,
+                  strerror_r(errno, errbuf, sizeof(errbuf)));
+    }
+}
+
+void worker_queue_post(WORKER_QUEUE *queue, WORKER_MSG *msg, worker_msg_handler_t handler)
+{
+    WORKER_MSG *head;
+
+    msg->handler = handler;
+
+    do
+    {
+        head = queue->head;
+        msg->next = head;
+    }
+    while (!__sync_bool_compare_and_swap(&queue->head, head, msg));
+
+    if (head == NULL)
+    {
+        worker_queue_wake(queue);
+    }
+}
+
+WORKER_MSG* worker_queue_take(WORKER_QUEUE *queue)
+{
+    uint64_t value;
+
+    /** Clear the eventfd first, see the file comment */
+    while (read(queue->fd, &value, sizeof(value)) == -1 && errno == EINTR)
+    {
+        ;
+    }
+
+    WORKER_MSG *msg = __sync_lock_test_and_set(&queue->head, NULL);
+    WORKER_MSG *list = NULL;
+
+    /** The stack is in LIFO order, reverse it */
+    while (msg)
+    {
+        WORKER_MSG *next = msg->next;
+        msg->next = list;
+        list = msg;
+        msg = next;
+    }
+
+    return list;
+}
+
+int worker_queue_process(WORKER_QUEUE *queue, int thread_id)
+{
+    WORKER_MSG *msg = worker_queue_take(queue);
+    int n = 0;
+
+    while (msg)
+    {
+        /** The handler owns the message, read the next pointer first */
+        WORKER_MSG *next = msg->next;
+        msg->handler(thread_id, msg);
+        msg = next;
+        n++;
+    }
+
+    return n;
+}
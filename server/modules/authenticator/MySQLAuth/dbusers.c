@@ -32,6 +32,7 @@
 #include <maxscale/mysql_utils.h>
 #include <maxscale/alloc.h>
 #include <maxscale/paths.h>
+#include <maxscale/thread.h>
 
 /** Don't include the root user */
 #define USERS_QUERY_NO_ROOT " AND user.user NOT IN ('root')"
@@ -128,6 +129,19 @@ static bool check_password(const char *output, uint8_t *token, size_t token_len,
     return memcmp(final_step, stored_token, stored_token_len) == 0;
 }
 
+/**
+ * Execute a query on the users of an instance. If the users are being
+ * replaced, the query waits until the new users have been committed.
+ */
+static int users_exec(MYSQL_AUTH *instance, const char *sql,
+                      int (*callback)(void*, int, char**, char**), void *data, char **err)
+{
+    pthread_rwlock_rdlock(&instance->lock);
+    int rc = sqlite3_exec(instance->handle, sql, callback, data, err);
+    pthread_rwlock_unlock(&instance->lock);
+    return rc;
+}
+
 /** Callback for check_database() */
 static int database_cb(void *data, int columns, char** rows, char** row_names)
 {
@@ -136,7 +150,7 @@ static int database_cb(void *data, int columns, char** rows, char** row_names)
     return 0;
 }
 
-static bool check_database(sqlite3 *handle, const char *database)
+static bool check_database(MYSQL_AUTH *instance, const char *database)
 {
     bool rval = true;
 
@@ -150,7 +164,7 @@ static bool check_database(sqlite3 *handle, const char *database)
 
         char *err;
 
-        if (sqlite3_exec(handle, sql, database_cb, &rval, &err) != SQLITE_OK)
+        if (users_exec(instance, sql, database_cb, &rval, &err) != SQLITE_OK)
         {
             MXS_ERROR("Failed to execute auth query: %s", err);
             sqlite3_free(err);
@@ -185,7 +199,6 @@ static int auth_cb(void *data, int columns, char** rows, char** row_names)
 int validate_mysql_user(MYSQL_AUTH* instance, DCB *dcb, MYSQL_session *session,
                         uint8_t *scramble, size_t scramble_len)
 {
-    sqlite3 *handle = instance->handle;
     const char* validate_query = instance->lower_case_table_names ?
         mysqlauth_validate_user_query_lower :
         mysqlauth_validate_user_query;
@@ -207,7 +220,7 @@ int validate_mysql_user(MYSQL_AUTH* instance, DCB *dcb, MYSQL_session *session,
 
     struct user_query_result res = {};
 
-    if (sqlite3_exec(handle, sql, auth_cb, &res, &err) != SQLITE_OK)
+    if (users_exec(instance, sql, auth_cb, &res, &err) != SQLITE_OK)
     {
         MXS_ERROR("Failed to execute auth query: %s", err);
         sqlite3_free(err);
@@ -220,7 +233,7 @@ int validate_mysql_user(MYSQL_AUTH* instance, DCB *dcb, MYSQL_session *session,
         sprintf(sql, validate_query, session->user, ipv4, ipv4,
                 session->db, session->db);
 
-        if (sqlite3_exec(handle, sql, auth_cb, &res, &err) != SQLITE_OK)
+        if (users_exec(instance, sql, auth_cb, &res, &err) != SQLITE_OK)
         {
             MXS_ERROR("Failed to execute auth query: %s", err);
             sqlite3_free(err);
@@ -239,7 +252,7 @@ int validate_mysql_user(MYSQL_AUTH* instance, DCB *dcb, MYSQL_session *session,
         sprintf(sql, validate_query, session->user, client_hostname,
                 client_hostname, session->db, session->db);
 
-        if (sqlite3_exec(handle, sql, auth_cb, &res, &err) != SQLITE_OK)
+        if (users_exec(instance, sql, auth_cb, &res, &err) != SQLITE_OK)
         {
             MXS_ERROR("Failed to execute auth query: %s", err);
             sqlite3_free(err);
@@ -255,7 +268,7 @@ int validate_mysql_user(MYSQL_AUTH* instance, DCB *dcb, MYSQL_session *session,
                            scramble, scramble_len, session->client_sha1))
         {
             /** Password is OK, check that the database exists */
-            if (check_database(handle, session->db))
+            if (check_database(instance, session->db))
             {
                 rval = MXS_AUTH_SUCCEEDED;
             }
@@ -732,62 +745,64 @@ void commit_sqlite_transaction(sqlite3 *handle)
     }
 }
 
-int get_users_from_server(MYSQL *con, SERVER_REF *server, SERVICE *service, SERV_LISTENER *listener)
+/** The users and the databases fetched from one server */
+typedef struct users_fetch
 {
-    if (server->server->server_string == NULL)
-    {
-        const char *server_string = mysql_get_server_info(con);
-        if (!server_set_version_string(server->server, server_string))
-        {
-            return -1;
-        }
-    }
+    SERVICE    *service;   /**< The service */
+    SERVER_REF *server;    /**< The server to fetch from */
+    const char *user;      /**< The service user */
+    const char *password;  /**< Decrypted password of the service user */
+    MYSQL      *con;       /**< The connection, NULL if connecting failed */
+    MYSQL_RES  *users;     /**< Result of the users query */
+    MYSQL_RES  *databases; /**< Result of SHOW DATABASES */
+    THREAD      thread;    /**< The thread that fetches from the server */
+    bool        started;   /**< Whether the thread was started */
+} USERS_FETCH;
 
-    char *query = get_new_users_query(server->server->server_string, service->enable_root);
-    MYSQL_AUTH *instance = (MYSQL_AUTH*)listener->auth_instance;
-    bool anon_user = false;
-    int users = 0;
+/**
+ * Connect to a server and fetch the users and the databases. The results are
+ * stored in memory so that the users can be replaced without waiting for
+ * the server.
+ *
+ * @param data The USERS_FETCH of the server
+ */
+static void fetch_users(void *data)
+{
+    USERS_FETCH *fetch = (USERS_FETCH*)data;
+    SERVER *server = fetch->server->server;
+    MYSQL *con = gw_mysql_init();
 
-    if (query)
+    if (con == NULL)
     {
-        if (mxs_mysql_query(con, query) == 0)
-        {
-            MYSQL_RES *result = mysql_store_result(con);
+        return;
+    }
 
-            if (result)
-            {
-                start_sqlite_transaction(instance->handle);
+    if (mxs_mysql_real_connect(con, server, fetch->user, fetch->password) == NULL)
+    {
+        MXS_ERROR("Failure loading users data from backend "
+                  "[%s:%i] for service [%s]. MySQL error %i, %s",
+                  server->name, server->port, fetch->service->name,
+                  mysql_errno(con), mysql_error(con));
+        mysql_close(con);
+        return;
+    }
 
-                MYSQL_ROW row;
+    /** Successfully connected to a server */
+    fetch->con = con;
 
-                while ((row = mysql_fetch_row(result)))
-                {
-                    if (service->strip_db_esc)
-                    {
-                        strip_escape_chars(row[2]);
-                    }
-
-                    if (strchr(row[1], '/'))
-                    {
-                        merge_netmask(row[1]);
-                    }
-
-                    add_mysql_user(instance->handle, row[0], row[1], row[2],
-                                   row[3] && strcmp(row[3], "Y") == 0, row[4]);
-                    users++;
-
-                    if (row[0] && *row[0] == '\0')
-                    {
-                        /** Empty username is used for the anonymous user. This means
-                         that localhost does not match wildcard host. */
-                        anon_user = true;
-                    }
-                }
+    if (server->server_string == NULL &&
+        !server_set_version_string(server, mysql_get_server_info(con)))
+    {
+        return;
+    }
 
-                commit_sqlite_transaction(instance->handle);
+    char *query = get_new_users_query(server->server_string, fetch->service->enable_root);
 
-                mysql_free_result(result);
-            }
+    if (query)
+    {
+        if (mxs_mysql_query(con, query) == 0)
+        {
+            fetch->users = mysql_store_result(con);
         }
         else
         {
@@ -797,30 +812,78 @@ int get_users_from_server(MYSQL *con, SERVER_REF *server, SERVICE *service, SERV
         MXS_FREE(query);
     }
 
-    /** Set the parameter if it is not configured by the user */
-    if (service->localhost_match_wildcard_host == SERVICE_PARAM_UNINIT)
+    /** Load the list of databases */
+    if (mxs_mysql_query(con, "SHOW DATABASES") == 0)
+    {
+        fetch->databases = mysql_store_result(con);
+    }
+    else
     {
-        service->localhost_match_wildcard_host = anon_user ? 0 : 1;
+        MXS_ERROR("Failed to load list of databases: %s", mysql_error(con));
     }
+}
 
-    /** Load the list of databases */
-    if (mxs_mysql_query(con, "SHOW DATABASES") == 0)
+/**
+ * The thread that fetches the users from one server when the users are loaded
+ * from all servers at the same time
+ *
+ * @param data The USERS_FETCH of the server
+ */
+static void fetch_users_thread(void *data)
+{
+    if (mysql_thread_init())
     {
-        MYSQL_RES *result = mysql_store_result(con);
-        if (result)
+        MXS_ERROR("mysql_thread_init failed when loading users. Exiting.");
+        return;
+    }
+
+    fetch_users(data);
+    mysql_thread_end();
+}
+
+/**
+ * Add the users and the databases fetched from one server
+ *
+ * @param listener  The listener whose users are replaced
+ * @param fetch     The users and databases of the server
+ * @param anon_user Set to true if the server has an anonymous user
+ *
+ * @return Number of users added
+ */
+static int add_fetched_users(SERV_LISTENER *listener, USERS_FETCH *fetch, bool *anon_user)
+{
+    MYSQL_AUTH *instance = (MYSQL_AUTH*)listener->auth_instance;
+    SERVICE *service = listener->service;
+    MYSQL_ROW row;
+    int users = 0;
+
+    while (fetch->users && (row = mysql_fetch_row(fetch->users)))
+    {
+        if (service->strip_db_esc)
         {
-            MYSQL_ROW row;
-            while ((row = mysql_fetch_row(result)))
-            {
-                add_database(instance->handle, row[0]);
-            }
+            strip_escape_chars(row[2]);
+        }
 
-            mysql_free_result(result);
+        if (strchr(row[1], '/'))
+        {
+            merge_netmask(row[1]);
+        }
+
+        add_mysql_user(instance->handle, row[0], row[1], row[2],
+                       row[3] && strcmp(row[3], "Y") == 0, row[4]);
+        users++;
+
+        if (row[0] && *row[0] == '\0')
+        {
+            /** Empty username is used for the anonymous user. This means
+             that localhost does not match wildcard host. */
+            *anon_user = true;
         }
     }
-    else
+
+    while (fetch->databases && (row = mysql_fetch_row(fetch->databases)))
     {
-        MXS_ERROR("Failed to load list of databases: %s", mysql_error(con));
+        add_database(instance->handle, row[0]);
     }
 
     return users;
@@ -830,6 +893,12 @@ int get_users_from_server(MYSQL *con, SERVER_REF *server, SERVICE *service, SERV
  * Load the user/passwd form mysql.user table into the service users' hashtable
  * environment.
  *
+ * The users are first fetched from the servers, in parallel if they are loaded
+ * from all servers. The old users are then replaced in one transaction while
+ * holding the instance lock so that clients are authenticated either against
+ * the old or the new users. If no server could be connected to, the old users
+ * are kept.
+ *
  * @param service   The current service
  * @param users     The users table into which to load the users
  * @return          -1 on any error or the number of users inserted
@@ -852,15 +921,26 @@ static int get_users(SERV_LISTENER *listener, bool skip_local)
         return -1;
     }
 
-    /** Delete the old users */
-    MYSQL_AUTH *instance = (MYSQL_AUTH*)listener->auth_instance;
-    delete_mysql_users(instance->handle);
+    int n_servers = 0;
 
-    SERVER_REF *server = service->dbref;
-    int total_users = -1;
-    bool no_active_servers = true;
+    for (SERVER_REF *server = service->dbref; server; server = server->next)
+    {
+        n_servers++;
+    }
 
-    for (server = service->dbref; !service->svc_do_shutdown && server; server = server->next)
+    USERS_FETCH *fetches = MXS_CALLOC(n_servers + 1, sizeof(USERS_FETCH));
+
+    if (fetches == NULL)
+    {
+        MXS_FREE(dpwd);
+        return -1;
+    }
+
+    int n_fetches = 0;
+
+    for (SERVER_REF *server = service->dbref;
+         !service->svc_do_shutdown && server && n_fetches < n_servers;
+         server = server->next)
     {
         if (!SERVER_REF_IS_ACTIVE(server) || !SERVER_IS_ACTIVE(server->server) ||
             (skip_local && server_is_mxs_service(server->server)))
@@ -868,47 +948,105 @@ static int get_users(SERV_LISTENER *listener, bool skip_local)
             continue;
         }
 
-        no_active_servers = false;
+        USERS_FETCH *fetch = &fetches[n_fetches++];
+        fetch->service = service;
+        fetch->server = server;
+        fetch->user = service_user;
+        fetch->password = dpwd;
 
-        MYSQL *con = gw_mysql_init();
-        if (con)
+        if (service->users_from_all)
         {
-            if (mxs_mysql_real_connect(con, server->server, service_user, dpwd) == NULL)
+            if (thread_start(&fetch->thread, fetch_users_thread, fetch))
             {
-                MXS_ERROR("Failure loading users data from backend "
-                          "[%s:%i] for service [%s]. MySQL error %i, %s",
-                          server->server->name, server->server->port,
-                          service->name, mysql_errno(con), mysql_error(con));
-                mysql_close(con);
+                fetch->started = true;
             }
             else
             {
-                /** Successfully connected to a server */
-                int users = get_users_from_server(con, server, service, listener);
+                fetch_users(fetch);
+            }
+        }
+        else
+        {
+            fetch_users(fetch);
+
+            if (fetch->con)
+            {
+                break;
+            }
+        }
+    }
+
+    bool connected = false;
+
+    for (int i = 0; i < n_fetches; i++)
+    {
+        if (fetches[i].started)
+        {
+            thread_wait(fetches[i].thread);
+        }
+
+        if (fetches[i].con)
+        {
+            connected = true;
+        }
+    }
+
+    MXS_FREE(dpwd);
+
+    int total_users = -1;
+
+    if (connected)
+    {
+        MYSQL_AUTH *instance = (MYSQL_AUTH*)listener->auth_instance;
+        bool anon_user = false;
+
+        pthread_rwlock_wrlock(&instance->lock);
+        start_sqlite_transaction(instance->handle);
+
+        /** Delete the old users */
+        delete_mysql_users(instance->handle);
+
+        for (int i = 0; i < n_fetches; i++)
+        {
+            if (fetches[i].con)
+            {
+                int users = add_fetched_users(listener, &fetches[i], &anon_user);
 
                 if (users > total_users)
                 {
                     total_users = users;
                 }
+            }
+        }
 
-                mysql_close(con);
+        commit_sqlite_transaction(instance->handle);
+        pthread_rwlock_unlock(&instance->lock);
 
-                if (!service->users_from_all)
-                {
-                    break;
-                }
-            }
+        /** Set the parameter if it is not configured by the user */
+        if (service->localhost_match_wildcard_host == SERVICE_PARAM_UNINIT)
+        {
+            service->localhost_match_wildcard_host = anon_user ? 0 : 1;
         }
     }
 
-    MXS_FREE(dpwd);
+    for (int i = 0; i < n_fetches; i++)
+    {
+        if (fetches[i].con)
+        {
+            mysql_free_result(fetches[i].users);
+            mysql_free_result(fetches[i].databases);
+            mysql_close(fetches[i].con);
+        }
+    }
+
+    MXS_FREE(fetches);
 
-    if (no_active_servers)
+    if (n_fetches == 0)
     {
         // This service has no servers or all servers are local MaxScale services
         total_users = 0;
     }
-    else if (server == NULL && total_users == -1)
+    else if (!connected)
     {
         MXS_ERROR("Unable to get user data from backend database for service [%s]."
                   " Failed to connect to any of the backend databases.", service->name);
@@ -185,6 +185,8 @@ static void* mysql_auth_init(char **options)
         instance->skip_auth = false;
         instance->lower_case_table_names = false;
         instance->handle = NULL;
+        instance->check_permissions = false;
+        pthread_rwlock_init(&instance->lock, NULL);
 
         for (int i = 0; options[i]; i++)
         {
@@ -229,6 +231,7 @@ static void* mysql_auth_init(char **options)
 
         if (error)
         {
+            pthread_rwlock_destroy(&instance->lock);
             MXS_FREE(instance->cache_dir);
             MXS_FREE(instance);
             instance = NULL;
@@ -290,8 +293,8 @@ static bool is_localhost_address(struct sockaddr_storage *addr)
  * First call the SSL authentication function, passing the DCB and a boolean
  * indicating whether the client is SSL capable. If SSL authentication is
  * successful, check whether connection is complete. Fail if we do not have a
- * user name.  Call other functions to validate the user, reloading the user
- * data if the first attempt fails.
+ * user name.  Call other functions to validate the user, requesting a
+ * background reload of the user data if the validation fails.
  *
  * @param dcb Request handler DCB connected to the client
  * @return Authentication status
@@ -337,11 +340,11 @@ mysql_auth_authenticate(DCB *dcb)
         auth_ret = validate_mysql_user(instance, dcb, client_data,
                                        protocol->scramble, sizeof(protocol->scramble));
 
-        if (auth_ret != MXS_AUTH_SUCCEEDED &&
-            service_refresh_users(dcb->service) == 0)
+        if (auth_ret != MXS_AUTH_SUCCEEDED)
         {
-            auth_ret = validate_mysql_user(instance, dcb, client_data,
-                                           protocol->scramble, sizeof(protocol->scramble));
+            /** The users are reloaded in the background, this client is
+             * authenticated against the users that are currently loaded */
+            service_refresh_users_async(dcb->service);
         }
 
         /* on successful authentication, set user into dcb field */
@@ -597,14 +600,45 @@ static bool add_service_user(SERV_LISTENER *port)
     return rval;
 }
 
+static int persisted_users_cb(void *data, int columns, char** rows, char** row_names)
+{
+    bool *found = (bool*)data;
+    *found = true;
+    return 0;
+}
+
+/**
+ * @brief Check whether the users database contains users stored by the previous run
+ *
+ * @param instance Authenticator instance
+ * @return True if at least one user was found
+ */
+static bool has_persisted_users(MYSQL_AUTH *instance)
+{
+    bool found = false;
+    char *err;
+
+    if (sqlite3_exec(instance->handle, "SELECT 1 FROM " MYSQLAUTH_USERS_TABLE_NAME " LIMIT 1",
+                     persisted_users_cb, &found, &err) != SQLITE_OK)
+    {
+        MXS_ERROR("Failed to query persisted users: %s", err);
+        sqlite3_free(err);
+    }
+
+    return found;
+}
+
 /**
  * @brief Load MySQL authentication users
  *
- * This function loads MySQL users from the backend database.
+ * This function loads MySQL users from the backend database. If the users
+ * persisted by the previous run are used at startup, the permissions of the
+ * service user are checked when the users are reloaded in the background.
  *
  * @param port Listener definition
  * @return MXS_AUTH_LOADUSERS_OK on success, MXS_AUTH_LOADUSERS_ERROR and
- * MXS_AUTH_LOADUSERS_FATAL on fatal error
+ * MXS_AUTH_LOADUSERS_FATAL on fatal error, MXS_AUTH_LOADUSERS_CACHED if the
+ * persisted users are used
  */
 static int mysql_auth_load_users(SERV_LISTENER *port)
 {
@@ -618,12 +652,35 @@ static int mysql_auth_load_users(SERV_LISTENER *port)
         skip_local = true;
         char path[PATH_MAX];
         get_database_path(port, path, sizeof(path));
-        if (!check_service_permissions(port->service) ||
-            !open_instance_database(path, &instance->handle))
+
+        if (!open_instance_database(path, &instance->handle))
+        {
+            return MXS_AUTH_LOADUSERS_FATAL;
+        }
+
+        if (has_persisted_users(instance))
+        {
+            /** The users of the previous run are used until the service
+             * reloads them in the background */
+            instance->check_permissions = true;
+            return MXS_AUTH_LOADUSERS_CACHED;
+        }
+
+        if (!check_service_permissions(port->service))
         {
             return MXS_AUTH_LOADUSERS_FATAL;
         }
     }
+    else if (instance->check_permissions)
+    {
+        /** The persisted users are kept until the check passes */
+        if (!check_service_permissions(port->service))
+        {
+            return MXS_AUTH_LOADUSERS_FATAL;
+        }
+
+        instance->check_permissions = false;
+    }
 
     int loaded = replace_mysql_users(port, skip_local);
     bool injected = false;
@@ -711,8 +768,12 @@ void mysql_auth_diagnostic(DCB *dcb, SERV_LISTENER *port)
     MYSQL_AUTH *instance = (MYSQL_AUTH*)port->auth_instance;
     char *err;
 
-    if (sqlite3_exec(instance->handle, "SELECT user, host FROM " MYSQLAUTH_USERS_TABLE_NAME,
-                     diag_cb, dcb, &err) != SQLITE_OK)
+    pthread_rwlock_rdlock(&instance->lock);
+    int rc = sqlite3_exec(instance->handle, "SELECT user, host FROM " MYSQLAUTH_USERS_TABLE_NAME,
+                          diag_cb, dcb, &err);
+    pthread_rwlock_unlock(&instance->lock);
+
+    if (rc != SQLITE_OK)
     {
         dcb_printf(dcb, "Failed to print users: %s\n", err);
         MXS_ERROR("Failed to print users: %s", err);
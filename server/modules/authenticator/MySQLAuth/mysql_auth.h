@@ -27,6 +27,7 @@
 #include <maxscale/cdefs.h>
 
 #include <stdint.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 
 #include <maxscale/authenticator.h>
@@ -113,10 +114,12 @@ static int db_flags = SQLITE_OPEN_READWRITE |
 typedef struct mysql_auth
 {
     sqlite3 *handle;             /**< SQLite3 database handle */
+    pthread_rwlock_t lock;       /**< Held for writing while the users are replaced */
     char *cache_dir;             /**< Custom cache directory location */
     bool inject_service_user;    /**< Inject the service user into the list of users */
     bool skip_auth;              /**< Authentication will always be successful */
     bool lower_case_table_names; /**< Disable database case-sensitivity */
+    bool check_permissions;      /**< The service permissions have not been checked yet */
 } MYSQL_AUTH;
 
 /** Common structure for both backend and client authenticators */
@@ -20,6 +20,7 @@
 #include <maxscale/alloc.h>
 #include <maxscale/buffer.h>
 #include <maxscale/modutil.h>
+#include <maxscale/prometheus.h>
 #include <maxscale/query_classifier.h>
 #include <maxscale/paths.h>
 #include "storagefactory.hh"
@@ -36,10 +37,51 @@ Cache::Cache(const std::string&  name,
     , m_sRules(sRules)
     , m_sFactory(sFactory)
 {
+    for (int i = 0; i < STAT_MAX; ++i)
+    {
+        m_stats[i] = NULL;
+    }
 }
 
 Cache::~Cache()
 {
+    for (int i = 0; i < STAT_MAX; ++i)
+    {
+        mxs_metric_free(m_stats[i]);
+    }
+}
+
+void Cache::increment(stat_t stat)
+{
+    if (m_stats[stat])
+    {
+        mxs_metric_inc(m_stats[stat]);
+    }
+}
+
+bool Cache::create_metrics()
+{
+    static const char* names[STAT_MAX] =
+    {
+        "maxscale_cache_hits_total",
+        "maxscale_cache_misses_total",
+        "maxscale_cache_stores_total"
+    };
+
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+    prometheus_label(labels, "filter", m_name.c_str());
+
+    bool rv = true;
+
+    for (int i = 0; i < STAT_MAX; ++i)
+    {
+        if (!m_stats[i] && !(m_stats[i] = mxs_metric_create(names[i], labels)))
+        {
+            rv = false;
+        }
+    }
+
+    return rv;
 }
 
 //static
@@ -17,6 +17,7 @@
 #include <tr1/memory>
 #include <string>
 #include <maxscale/buffer.h>
+#include <maxscale/metrics.h>
 #include <maxscale/session.h>
 #include "cachefilter.h"
 #include "cache_storage_api.h"
@@ -35,6 +36,14 @@ public:
         INFO_ALL     = (INFO_RULES | INFO_PENDING | INFO_STORAGE)
     };
 
+    enum stat_t
+    {
+        STAT_HITS,   /*< Statements answered from the cache. */
+        STAT_MISSES, /*< Statements sent to the server. */
+        STAT_STORES, /*< Results stored into the cache. */
+        STAT_MAX
+    };
+
     typedef std::tr1::shared_ptr<CacheRules> SCacheRules;
     typedef std::tr1::shared_ptr<StorageFactory> SStorageFactory;
 
@@ -49,6 +58,22 @@ public:
 
     virtual json_t* get_info(uint32_t what = INFO_ALL) const = 0;
 
+    /**
+     * Increments a statistic of the calling worker thread.
+     *
+     * @param stat  The statistic.
+     */
+    void increment(stat_t stat);
+
+    /**
+     * Creates the statistics of the cache. Only the cache of the filter
+     * instance should have statistics, the caches it may delegate to
+     * should not.
+     *
+     * @return True, if the statistics could be created.
+     */
+    bool create_metrics();
+
     /**
      * Returns whether the results of a particular query should be stored.
      *
@@ -151,4 +176,5 @@ protected:
     const CACHE_CONFIG& m_config;   // The configuration of the cache instance.
     SCacheRules         m_sRules;   // The rules of the cache instance.
     SStorageFactory     m_sFactory; // The storage factory.
+    MXS_METRIC*         m_stats[STAT_MAX]; // Per-thread statistics, may be NULL.
 };
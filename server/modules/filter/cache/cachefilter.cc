@@ -122,6 +122,24 @@ int cache_process_init()
 // Global symbols of the Module
 //
 
+// The statistics of the cache instances
+static const MXS_METRIC_DEF cache_metrics[] =
+{
+    {
+        "maxscale_cache_hits_total", MXS_METRIC_COUNTER,
+        "Number of statements answered from the cache"
+    },
+    {
+        "maxscale_cache_misses_total", MXS_METRIC_COUNTER,
+        "Number of cacheable statements sent to the server"
+    },
+    {
+        "maxscale_cache_stores_total", MXS_METRIC_COUNTER,
+        "Number of results stored into the cache"
+    },
+    MXS_END_MODULE_METRICS
+};
+
 // Enumeration values for `cached_data`
 static const MXS_ENUM_VALUE parameter_cached_data_values[] =
 {
@@ -227,7 +245,8 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
                 parameter_selects_values
             },
             {MXS_END_MODULE_PARAMS}
-        }
+        },
+        cache_metrics
     };
 
     return &info;
@@ -278,6 +297,11 @@ CacheFilter* CacheFilter::create(const char* zName, char** pzOptions, MXS_CONFIG
         if (pCache)
         {
             pFilter->m_sCache = auto_ptr<Cache>(pCache);
+
+            if (!pCache->create_metrics())
+            {
+                MXS_WARNING("Could not create the statistics of the cache.");
+            }
         }
         else
         {
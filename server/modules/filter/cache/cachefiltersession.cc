@@ -346,10 +346,12 @@ int CacheFilterSession::routeQuery(GWBUF* pPacket)
 
                     if (fetch_from_server)
                     {
+                        m_pCache->increment(Cache::STAT_MISSES);
                         m_state = CACHE_EXPECTING_RESPONSE;
                     }
                     else
                     {
+                        m_pCache->increment(Cache::STAT_HITS);
                         m_state = CACHE_EXPECTING_NOTHING;
                         gwbuf_free(pPacket);
                         DCB *dcb = m_pSession->client_dcb;
@@ -808,7 +810,11 @@ void CacheFilterSession::store_result()
 
         cache_result_t result = m_pCache->put_value(m_key, m_res.pData);
 
-        if (!CACHE_RESULT_IS_OK(result))
+        if (CACHE_RESULT_IS_OK(result))
+        {
+            m_pCache->increment(Cache::STAT_STORES);
+        }
+        else
         {
             MXS_ERROR("Could not store cache item, deleting it.");
 
@@ -23,6 +23,9 @@
 #include <maxscale/query_classifier.h>
 #include <regex.h>
 #include <maxscale/alloc.h>
+#include <maxscale/service.h>
+#include <maxscale/mysql_utils.h>
+#include <maxscale/protocol/mysql.h>
 
 /**
  * @file ccrfilter.c - a very simple filter designed to send queries to the
@@ -38,6 +41,12 @@
  *      time=<time period>          Seconds to wait before queries are routed to slaves.
  *      match=<regex>               Regex for matching
  *      ignore=<regex>              Regex for ignoring
+ *      mode=time|gtid              How reads are made consistent after a write
+ *
+ * In gtid mode, the GTID of the last write is read from the session state
+ * information of the OK packet. Reads are then routed to a slave that has
+ * replicated the GTID, or to the master if none has. The count and time
+ * parameters are used if the GTID of a write is not known.
  *
  * The filter also has two options:
  *     @c case, which makes the regex case-sensitive, and
@@ -54,17 +63,37 @@ static  MXS_FILTER_SESSION *newSession(MXS_FILTER *instance, MXS_SESSION *sessio
 static  void   closeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session);
 static  void   freeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session);
 static  void   setDownstream(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, MXS_DOWNSTREAM *downstream);
+static  void   setUpstream(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, MXS_UPSTREAM *upstream);
 static  int    routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue);
+static  int    clientReply(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue);
 static  void   diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb);
 static uint64_t getCapabilities(MXS_FILTER* instance);
 
 #define CCR_DEFAULT_TIME "60"
 
+/** Maximum length of a stored GTID */
+#define CCR_MAX_GTID_LEN 256
+
+/** Server status flag telling that the OK packet contains session state changes */
+#define CCR_SESSION_STATE_CHANGED 0x4000
+
+/** Session state change types */
+#define CCR_SESSION_TRACK_SYSTEM_VARIABLES 0
+#define CCR_SESSION_TRACK_GTIDS            3
+
+typedef enum ccr_mode
+{
+    CCR_MODE_TIME,
+    CCR_MODE_GTID
+} ccr_mode_t;
+
 typedef struct lagstats
 {
     int n_add_count;  /*< No. of statements diverted based on count */
     int n_add_time;   /*< No. of statements diverted based on time */
     int n_modified;   /*< No. of statements not diverted */
+    int n_gtid_slave; /*< No. of statements routed to an up-to-date slave */
+    int n_gtid_master;/*< No. of statements routed to the master as no slave had the GTID */
 } LAGSTATS;
 
 /**
@@ -79,6 +108,7 @@ typedef struct
                       * is done. */
     int count;       /*< Number of hints to add after each operation
                      * that modifies data. */
+    ccr_mode_t mode; /*< How reads after writes are routed */
     LAGSTATS stats;
     regex_t re;      /* Compiled regex text of match */
     regex_t nore;    /* Compiled regex text of ignore */
@@ -90,8 +120,11 @@ typedef struct
 typedef struct
 {
     MXS_DOWNSTREAM down;              /*< The downstream filter */
+    MXS_UPSTREAM   up;                /*< The upstream filter */
+    MXS_SESSION   *session;           /*< The client session */
     int            hints_left;        /*< Number of hints left to add to queries*/
     time_t         last_modification; /*< Time of the last data modifying operation */
+    char           last_gtid[CCR_MAX_GTID_LEN]; /*< GTID of the last write, empty if not known */
 } CCR_SESSION;
 
 static const MXS_ENUM_VALUE option_values[] =
@@ -102,6 +135,13 @@ static const MXS_ENUM_VALUE option_values[] =
     {NULL}
 };
 
+static const MXS_ENUM_VALUE mode_values[] =
+{
+    {"time", CCR_MODE_TIME},
+    {"gtid", CCR_MODE_GTID},
+    {NULL}
+};
+
 /**
  * The module entry point routine. It is this routine that
  * must populate the structure that is referred to as the
@@ -119,9 +159,9 @@ MXS_MODULE* MXS_CREATE_MODULE()
         closeSession,
         freeSession,
         setDownstream,
-        NULL,               // No Upstream requirement
+        setUpstream,
         routeQuery,
-        NULL, // No clientReply
+        clientReply,
         diagnostic,
         getCapabilities,
         NULL, // No destroyInstance
@@ -133,7 +173,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
         MXS_MODULE_GA,
         MXS_FILTER_VERSION,
         "A routing hint filter that send queries to the master after data modification",
-        "V1.1.0",
+        "V1.2.0",
         &MyObject,
         NULL, /* Process init. */
         NULL, /* Process finish. */
@@ -151,6 +191,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
              MXS_MODULE_OPT_NONE,
              option_values
             },
+            {"mode", MXS_MODULE_PARAM_ENUM, "time", MXS_MODULE_OPT_NONE, mode_values},
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -177,6 +218,7 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
     {
         my_instance->count = config_get_integer(params, "count");
         my_instance->time = config_get_integer(params, "time");
+        my_instance->mode = config_get_enum(params, "mode", mode_values);
         my_instance->stats.n_add_count = 0;
         my_instance->stats.n_add_time = 0;
         my_instance->stats.n_modified = 0;
@@ -218,8 +260,10 @@ newSession(MXS_FILTER *instance, MXS_SESSION *session)
 
     if (my_session)
     {
+        my_session->session = session;
         my_session->hints_left = 0;
         my_session->last_modification = 0;
+        my_session->last_gtid[0] = '\0';
     }
 
     return (MXS_FILTER_SESSION*)my_session;
@@ -264,6 +308,75 @@ setDownstream(MXS_FILTER *instance, MXS_FILTER_SESSION *session, MXS_DOWNSTREAM
     my_session->down = *downstream;
 }
 
+/**
+ * Set the upstream component for this filter.
+ *
+ * @param instance    The filter instance data
+ * @param session     The filter session
+ * @param upstream    The upstream filter or router
+ */
+static void
+setUpstream(MXS_FILTER *instance, MXS_FILTER_SESSION *session, MXS_UPSTREAM *upstream)
+{
+    CCR_SESSION *my_session = (CCR_SESSION *)session;
+
+    my_session->up = *upstream;
+}
+
+/**
+ * Pick the server that a read is routed to after a write with a known GTID
+ *
+ * If all slaves have replicated the GTID, no hint is needed and the GTID is
+ * forgotten. Otherwise the least busy slave that has replicated it is used
+ * and if none has, the read goes to the master.
+ *
+ * @param my_instance The filter instance
+ * @param my_session  The filter session
+ * @param queue       The read that is routed
+ */
+static void route_by_gtid(CCR_INSTANCE *my_instance, CCR_SESSION *my_session, GWBUF *queue)
+{
+    SERVER *best = NULL;
+    int n_slaves = 0;
+    int n_uptodate = 0;
+
+    for (SERVER_REF *ref = my_session->session->service->dbref; ref; ref = ref->next)
+    {
+        if (SERVER_REF_IS_ACTIVE(ref) && SERVER_IS_SLAVE(ref->server))
+        {
+            n_slaves++;
+
+            if (server_has_gtid(ref->server, my_session->last_gtid))
+            {
+                n_uptodate++;
+
+                if (best == NULL || ref->server->stats.n_current < best->stats.n_current)
+                {
+                    best = ref->server;
+                }
+            }
+        }
+    }
+
+    if (n_slaves > 0 && n_uptodate == n_slaves)
+    {
+        /** All slaves have the write, the reads can go anywhere from now on */
+        my_session->last_gtid[0] = '\0';
+    }
+    else if (best)
+    {
+        queue->hint = hint_create_route(queue->hint, HINT_ROUTE_TO_NAMED_SERVER, best->unique_name);
+        my_instance->stats.n_gtid_slave++;
+        MXS_INFO("Server '%s' has replicated GTID %s", best->unique_name, my_session->last_gtid);
+    }
+    else
+    {
+        queue->hint = hint_create_route(queue->hint, HINT_ROUTE_TO_MASTER, NULL);
+        my_instance->stats.n_gtid_master++;
+        MXS_INFO("No slave has replicated GTID %s", my_session->last_gtid);
+    }
+}
+
 /**
  * The routeQuery entry point. This is passed the query buffer
  * to which the filter should be applied. Once applied the
@@ -303,6 +416,9 @@ routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
                     if (my_instance->match == NULL ||
                         (my_instance->match && regexec(&my_instance->re, sql, 0, limits, REG_STARTEND) == 0))
                     {
+                        /** The GTID of this write is read from the reply */
+                        my_session->last_gtid[0] = '\0';
+
                         if (my_instance->count)
                         {
                             my_session->hints_left = my_instance->count;
@@ -320,6 +436,10 @@ routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
                 }
             }
         }
+        else if (my_session->last_gtid[0])
+        {
+            route_by_gtid(my_instance, my_session, queue);
+        }
         else if (my_session->hints_left > 0)
         {
             queue->hint = hint_create_route(queue->hint, HINT_ROUTE_TO_MASTER, NULL);
@@ -345,6 +465,113 @@ routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
                                        queue);
 }
 
+/**
+ * Extract the GTID from the session state information of an OK packet
+ *
+ * The GTID is either reported by the @c last_gtid system variable of MariaDB
+ * or as a GTID state change.
+ *
+ * @param ptr  Start of the session state information
+ * @param end  End of the session state information
+ * @param dest Where the GTID is stored
+ * @return True if a GTID was found
+ */
+static bool extract_gtid(uint8_t *ptr, uint8_t *end, char *dest)
+{
+    while (ptr < end)
+    {
+        uint8_t type = *ptr++;
+        uint64_t len = mxs_leint_consume(&ptr);
+        uint8_t *next = ptr + len;
+        const char *value = NULL;
+        size_t value_len = 0;
+
+        if (next > end)
+        {
+            break;
+        }
+
+        if (type == CCR_SESSION_TRACK_SYSTEM_VARIABLES)
+        {
+            size_t name_len;
+            char *name = mxs_lestr_consume(&ptr, &name_len);
+
+            if (name_len == strlen("last_gtid") && strncasecmp(name, "last_gtid", name_len) == 0)
+            {
+                value = mxs_lestr_consume(&ptr, &value_len);
+            }
+        }
+        else if (type == CCR_SESSION_TRACK_GTIDS)
+        {
+            /** Skip the encoding specification */
+            ptr++;
+            value = mxs_lestr_consume(&ptr, &value_len);
+        }
+
+        if (value && value_len > 0 && value_len < CCR_MAX_GTID_LEN && ptr <= next)
+        {
+            memcpy(dest, value, value_len);
+            dest[value_len] = '\0';
+            return true;
+        }
+
+        ptr = next;
+    }
+
+    return false;
+}
+
+/**
+ * The clientReply entry point. OK packets are inspected for the GTID
+ * of the last write before they are passed upstream.
+ *
+ * @param instance  The filter instance data
+ * @param session   The filter session
+ * @param reply     The response data
+ */
+static int
+clientReply(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *reply)
+{
+    CCR_INSTANCE *my_instance = (CCR_INSTANCE *)instance;
+    CCR_SESSION  *my_session = (CCR_SESSION *)session;
+
+    if (my_instance->mode == CCR_MODE_GTID && GWBUF_LENGTH(reply) > MYSQL_HEADER_LEN &&
+        MYSQL_GET_COMMAND(GWBUF_DATA(reply)) == MYSQL_REPLY_OK)
+    {
+        uint8_t *data = GWBUF_DATA(reply);
+        uint8_t *end = data + MXS_MIN(GWBUF_LENGTH(reply), gw_mysql_get_byte3(data) + MYSQL_HEADER_LEN);
+        uint8_t *ptr = data + MYSQL_HEADER_LEN + 1;
+
+        mxs_leint_consume(&ptr); // Affected rows
+        mxs_leint_consume(&ptr); // Last insert ID
+        uint16_t status = gw_mysql_get_byte2(ptr);
+        ptr += 4; // Status and warnings
+
+        if ((status & CCR_SESSION_STATE_CHANGED) && ptr < end)
+        {
+            size_t len;
+            mxs_lestr_consume(&ptr, &len); // Human readable info
+
+            if (ptr < end)
+            {
+                uint64_t state_len = mxs_leint_consume(&ptr);
+
+                if (ptr + state_len <= end &&
+                    extract_gtid(ptr, ptr + state_len, my_session->last_gtid))
+                {
+                    /** The position of the write is known, the fallbacks are not needed */
+                    my_session->hints_left = 0;
+                    my_session->last_modification = 0;
+                }
+            }
+        }
+    }
+
+    return my_session->up.clientReply(my_session->up.instance,
+                                      my_session->up.session,
+                                      reply);
+}
+
 /**
  * Diagnostics routine
  *
@@ -363,6 +590,7 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
 
     dcb_printf(dcb, "Configuration:\n\tCount: %d\n", my_instance->count);
     dcb_printf(dcb, "\tTime: %d seconds\n", my_instance->time);
+    dcb_printf(dcb, "\tMode: %s\n", my_instance->mode == CCR_MODE_GTID ? "gtid" : "time");
 
     if (my_instance->match)
     {
@@ -378,6 +606,12 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
     dcb_printf(dcb, "\tNo. of data modifications: %d\n", my_instance->stats.n_modified);
     dcb_printf(dcb, "\tNo. of hints added based on count: %d\n", my_instance->stats.n_add_count);
     dcb_printf(dcb, "\tNo. of hints added based on time: %d\n",  my_instance->stats.n_add_time);
+
+    if (my_instance->mode == CCR_MODE_GTID)
+    {
+        dcb_printf(dcb, "\tNo. of reads routed to up-to-date slaves: %d\n", my_instance->stats.n_gtid_slave);
+        dcb_printf(dcb, "\tNo. of reads routed to master by GTID: %d\n", my_instance->stats.n_gtid_master);
+    }
 }
 
 /**
@@ -387,5 +621,14 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
  */
 static uint64_t getCapabilities(MXS_FILTER* instance)
 {
-    return RCAP_TYPE_CONTIGUOUS_INPUT;
+    CCR_INSTANCE *my_instance = (CCR_INSTANCE *)instance;
+    uint64_t rval = RCAP_TYPE_CONTIGUOUS_INPUT;
+
+    if (my_instance->mode == CCR_MODE_GTID)
+    {
+        /** The OK packets are parsed for the session state changes */
+        rval |= RCAP_TYPE_CONTIGUOUS_OUTPUT | RCAP_TYPE_SESSION_TRACKING;
+    }
+
+    return rval;
 }
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file digestfilter.c - Server-wide statement statistics
+ *
+ * The filter measures the time from sending a statement to receiving the
+ * complete response and counts the rows and bytes in the response. The
+ * measurements are recorded into the server-wide digest table of the core,
+ * grouped by the canonical form of the statement.
+ *
+ * Only COM_QUERY statements are measured.
+ */
+
+#define MXS_MODULE_NAME "digestfilter"
+
+#include <string.h>
+#include <time.h>
+#include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+#include <maxscale/buffer.h>
+#include <maxscale/filter.h>
+#include <maxscale/modinfo.h>
+#include <maxscale/modutil.h>
+#include <maxscale/mysql_utils.h>
+#include <maxscale/protocol/mysql.h>
+#include <maxscale/query_digest.h>
+
+/*
+ * The filter entry points
+ */
+static MXS_FILTER *createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *);
+static MXS_FILTER_SESSION *newSession(MXS_FILTER *instance, MXS_SESSION *session);
+static void closeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session);
+static void freeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session);
+static void setDownstream(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, MXS_DOWNSTREAM *downstream);
+static void setUpstream(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, MXS_UPSTREAM *upstream);
+static int routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue);
+static int clientReply(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF *queue);
+static void diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb);
+static uint64_t getCapabilities(MXS_FILTER* instance);
+
+typedef struct
+{
+    int sessions;   /* Number of sessions created */
+    int statements; /* Number of statements measured */
+} DIGEST_INSTANCE;
+
+/** Where in the response the session is */
+typedef enum
+{
+    DIGEST_EXPECT_FIRST,   /* OK, ERR or the column count of a result set */
+    DIGEST_EXPECT_COLUMNS, /* Column definitions */
+    DIGEST_EXPECT_COL_EOF, /* The EOF after the column definitions */
+    DIGEST_EXPECT_ROWS     /* Rows and the final EOF or ERR */
+} digest_state_t;
+
+typedef struct
+{
+    MXS_DOWNSTREAM down;
+    MXS_UPSTREAM up;
+    char *canonical;        /* The statement being measured, NULL if none */
+    struct timespec start;  /* When the statement was sent */
+    digest_state_t state;
+    uint64_t columns;       /* Column definitions still expected */
+    uint64_t rows;
+    uint64_t bytes;
+    bool error;
+} DIGEST_SESSION;
+
+/**
+ * The module entry point routine.
+ *
+ * @return The module object
+ */
+MXS_MODULE* MXS_CREATE_MODULE()
+{
+    static MXS_FILTER_OBJECT MyObject =
+    {
+        createInstance,
+        newSession,
+        closeSession,
+        freeSession,
+        setDownstream,
+        setUpstream,
+        routeQuery,
+        clientReply,
+        diagnostic,
+        getCapabilities,
+        NULL, // No destroyInstance
+    };
+
+    static MXS_MODULE info =
+    {
+        MXS_MODULE_API_FILTER,
+        MXS_MODULE_IN_DEVELOPMENT,
+        MXS_FILTER_VERSION,
+        "A filter that collects server-wide statement statistics",
+        "V1.0.0",
+        &MyObject,
+        NULL, /* Process init. */
+        NULL, /* Process finish. */
+        NULL, /* Thread init. */
+        NULL, /* Thread finish. */
+        {
+            {MXS_END_MODULE_PARAMS}
+        }
+    };
+
+    return &info;
+}
+
+/**
+ * Create an instance of the filter for a particular service
+ * within MaxScale.
+ *
+ * @param name      The name of the instance (as defined in the config file).
+ * @param options   The options for this filter
+ * @param params    The array of name/value pair parameters for the filter
+ *
+ * @return The instance data for this new instance
+ */
+static MXS_FILTER *
+createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
+{
+    DIGEST_INSTANCE *my_instance = (DIGEST_INSTANCE*)MXS_CALLOC(1, sizeof(DIGEST_INSTANCE));
+    return (MXS_FILTER *) my_instance;
+}
+
+/**
+ * Associate a new session with this instance of the filter.
+ *
+ * @param instance  The filter instance data
+ * @param session   The session itself
+ * @return Session specific data for this session
+ */
+static MXS_FILTER_SESSION *
+newSession(MXS_FILTER *instance, MXS_SESSION *session)
+{
+    DIGEST_INSTANCE *my_instance = (DIGEST_INSTANCE *) instance;
+    DIGEST_SESSION *my_session = MXS_CALLOC(1, sizeof(DIGEST_SESSION));
+
+    if (my_session)
+    {
+        atomic_add(&my_instance->sessions, 1);
+    }
+
+    return (MXS_FILTER_SESSION*)my_session;
+}
+
+/**
+ * Close a session with the filter. A statement whose response was not
+ * completely received is not recorded.
+ *
+ * @param instance  The filter instance data
+ * @param session   The session being closed
+ */
+static void
+closeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session)
+{
+    DIGEST_SESSION *my_session = (DIGEST_SESSION *) session;
+
+    MXS_FREE(my_session->canonical);
+    my_session->canonical = NULL;
+}
+
+/**
+ * Free the memory associated with the session
+ *
+ * @param instance  The filter instance
+ * @param session   The filter session
+ */
+static void
+freeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session)
+{
+    MXS_FREE(session);
+}
+
+/**
+ * Set the downstream filter or router to which queries will be
+ * passed from this filter.
+ *
+ * @param instance  The filter instance data
+ * @param session   The filter session
+ * @param downstream    The downstream filter or router.
+ */
+static void
+setDownstream(MXS_FILTER *instance, MXS_FILTER_SESSION *session, MXS_DOWNSTREAM *downstream)
+{
+    DIGEST_SESSION *my_session = (DIGEST_SESSION *) session;
+
+    my_session->down = *downstream;
+}
+
+/**
+ * Set the upstream filter or session to which results will be
+ * passed from this filter.
+ *
+ * @param instance  The filter instance data
+ * @param session   The filter session
+ * @param upstream  The upstream filter or session.
+ */
+static void
+setUpstream(MXS_FILTER *instance, MXS_FILTER_SESSION *session, MXS_UPSTREAM *upstream)
+{
+    DIGEST_SESSION *my_session = (DIGEST_SESSION *) session;
+
+    my_session->up = *upstream;
+}
+
+/**
+ * The routeQuery entry point. Starts the measurement of a statement.
+ *
+ * @param instance  The filter instance data
+ * @param session   The filter session
+ * @param queue     The query data
+ */
+static int
+routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
+{
+    DIGEST_SESSION *my_session = (DIGEST_SESSION *) session;
+
+    /** A statement that is sent before the previous response is complete
+     * replaces the previous one */
+    MXS_FREE(my_session->canonical);
+    my_session->canonical = NULL;
+
+    if (modutil_is_SQL(queue) && (my_session->canonical = modutil_get_canonical(queue)))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &my_session->start);
+        my_session->state = DIGEST_EXPECT_FIRST;
+        my_session->columns = 0;
+        my_session->rows = 0;
+        my_session->bytes = 0;
+        my_session->error = false;
+    }
+
+    /* Pass the query downstream */
+    return my_session->down.routeQuery(my_session->down.instance,
+                                       my_session->down.session, queue);
+}
+
+/**
+ * Check whether an OK or EOF packet says that more results follow
+ */
+static bool
+more_results(const uint8_t *payload, uint32_t len)
+{
+    uint16_t status = 0;
+
+    if (payload[0] == MYSQL_REPLY_EOF)
+    {
+        /** Header, warnings, status */
+        if (len >= 5)
+        {
+            status = gw_mysql_get_byte2(payload + 3);
+        }
+    }
+    else
+    {
+        /** Header, affected rows, last insert id, status */
+        const uint8_t *end = payload + len;
+        const uint8_t *ptr = payload + 1;
+        ptr += mxs_leint_bytes(ptr);
+
+        if (ptr < end)
+        {
+            ptr += mxs_leint_bytes(ptr);
+        }
+
+        if (ptr + 2 <= end)
+        {
+            status = gw_mysql_get_byte2(ptr);
+        }
+    }
+
+    return status & SERVER_MORE_RESULTS_EXIST;
+}
+
+/**
+ * Process one packet of a response
+ *
+ * @return True if this was the last packet of the response
+ */
+static bool
+process_packet(DIGEST_SESSION *my_session, const uint8_t *payload, uint32_t len)
+{
+    if (len == 0)
+    {
+        return false;
+    }
+
+    bool is_eof = payload[0] == MYSQL_REPLY_EOF && len < 9;
+
+    switch (my_session->state)
+    {
+    case DIGEST_EXPECT_FIRST:
+        switch (payload[0])
+        {
+        case MYSQL_REPLY_OK:
+            return !more_results(payload, len);
+
+        case MYSQL_REPLY_ERR:
+            my_session->error = true;
+            return true;
+
+        case MYSQL_REPLY_LOCAL_INFILE:
+            /** The client sends the file next, the rest is not measured */
+            return true;
+
+        default:
+            my_session->columns = mxs_leint_value(payload);
+            my_session->state = my_session->columns ? DIGEST_EXPECT_COLUMNS : DIGEST_EXPECT_COL_EOF;
+            break;
+        }
+        break;
+
+    case DIGEST_EXPECT_COLUMNS:
+        if (--my_session->columns == 0)
+        {
+            my_session->state = DIGEST_EXPECT_COL_EOF;
+        }
+        break;
+
+    case DIGEST_EXPECT_COL_EOF:
+        my_session->state = DIGEST_EXPECT_ROWS;
+        break;
+
+    case DIGEST_EXPECT_ROWS:
+        if (is_eof)
+        {
+            if (more_results(payload, len))
+            {
+                my_session->state = DIGEST_EXPECT_FIRST;
+            }
+            else
+            {
+                return true;
+            }
+        }
+        else if (payload[0] == MYSQL_REPLY_ERR)
+        {
+            my_session->error = true;
+            return true;
+        }
+        else
+        {
+            my_session->rows++;
+        }
+        break;
+    }
+
+    return false;
+}
+
+/**
+ * The clientReply entry point. Follows the response and records the
+ * statement once the response is complete.
+ *
+ * The buffer is contiguous and contains only complete packets.
+ *
+ * @param instance  The filter instance data
+ * @param session   The filter session
+ * @param reply     The response data
+ */
+static int
+clientReply(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *reply)
+{
+    DIGEST_INSTANCE *my_instance = (DIGEST_INSTANCE *) instance;
+    DIGEST_SESSION *my_session = (DIGEST_SESSION *) session;
+
+    if (my_session->canonical)
+    {
+        const uint8_t *data = GWBUF_DATA(reply);
+        size_t len = GWBUF_LENGTH(reply);
+        size_t offset = 0;
+        bool done = false;
+
+        my_session->bytes += len;
+
+        while (!done && offset + MYSQL_HEADER_LEN <= len)
+        {
+            uint32_t payload_len = MYSQL_GET_PAYLOAD_LEN(data + offset);
+
+            if (offset + MYSQL_HEADER_LEN + payload_len > len)
+            {
+                break;
+            }
+
+            done = process_packet(my_session, data + offset + MYSQL_HEADER_LEN, payload_len);
+            offset += MYSQL_HEADER_LEN + payload_len;
+        }
+
+        if (done)
+        {
+            struct timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            uint64_t latency_us = (end.tv_sec - my_session->start.tv_sec) * 1000000 +
+                                  (end.tv_nsec - my_session->start.tv_nsec) / 1000;
+
+            query_digest_record(my_session->canonical, latency_us, my_session->rows,
+                                my_session->bytes, my_session->error);
+            atomic_add(&my_instance->statements, 1);
+            MXS_FREE(my_session->canonical);
+            my_session->canonical = NULL;
+        }
+    }
+
+    /* Pass the result upstream */
+    return my_session->up.clientReply(my_session->up.instance,
+                                      my_session->up.session, reply);
+}
+
+/**
+ * Diagnostics routine
+ *
+ * @param   instance    The filter instance
+ * @param   fsession    Filter session, may be NULL
+ * @param   dcb     The DCB for diagnostic output
+ */
+static void
+diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
+{
+    DIGEST_INSTANCE *my_instance = (DIGEST_INSTANCE *) instance;
+
+    dcb_printf(dcb, "\t\tSessions                 %d\n", my_instance->sessions);
+    dcb_printf(dcb, "\t\tStatements measured      %d\n", my_instance->statements);
+    dcb_printf(dcb, "\t\tUse 'show digests' to see the statistics\n");
+}
+
+/**
+ * Capability routine.
+ *
+ * @return The capabilities of the filter.
+ */
+static uint64_t getCapabilities(MXS_FILTER* instance)
+{
+    return RCAP_TYPE_CONTIGUOUS_INPUT | RCAP_TYPE_CONTIGUOUS_OUTPUT;
+}
@@ -27,6 +27,10 @@
  * 20/12/2016   Massimiliano Pinto    csdata->res.n_rows counter works with MULTI_RESULT
  *                                    and large packets (> 16MB)
  *
+ * With max_resultset_streaming enabled, the result is forwarded as it arrives
+ * and cut short with an EOF or ERR packet when the limit is hit. The rest of
+ * the result is read from the backend and discarded.
+ *
  * @endverbatim
  */
 
@@ -117,7 +121,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
         MXS_MODULE_IN_DEVELOPMENT,
         MXS_FILTER_VERSION,
         "A filter that is capable of limiting the resultset number of rows.",
-        "V1.0.0",
+        "V1.1.0",
         &object,
         NULL, /* Process init. */
         NULL, /* Process finish. */
@@ -146,6 +150,11 @@ MXS_MODULE* MXS_CREATE_MODULE()
                 MXS_MODULE_OPT_ENUM_UNIQUE,
                 return_option_values
             },
+            {
+                "max_resultset_streaming",
+                MXS_MODULE_PARAM_BOOL,
+                "false"
+            },
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -161,6 +170,7 @@ typedef struct maxrows_config
     uint32_t        max_resultset_size;
     uint32_t                     debug;
     enum maxrows_return_mode  m_return;
+    bool                     streaming;
 } MAXROWS_CONFIG;
 
 typedef struct maxrows_instance
@@ -176,6 +186,7 @@ typedef enum maxrows_session_state
     MAXROWS_EXPECTING_ROWS,         // A select has been sent, and we want more rows.
     MAXROWS_EXPECTING_NOTHING,      // We are not expecting anything from the server.
     MAXROWS_IGNORING_RESPONSE,      // We are not interested in the data received from the server.
+    MAXROWS_DRAINING_RESPONSE,      // The limit was hit while streaming, the rest is discarded.
 } maxrows_session_state_t;
 
 typedef struct maxrows_response_state
@@ -202,6 +213,7 @@ typedef struct maxrows_session_data
     bool                    large_packet;      /**< Large packet (> 16MB)) indicator */
     bool                    discard_resultset; /**< Discard resultset indicator */
     GWBUF                   *input_sql;        /**< Input query */
+    uint8_t                 last_seq;          /**< Sequence number of the last streamed packet */
 } MAXROWS_SESSION_DATA;
 
 static MAXROWS_SESSION_DATA *maxrows_session_data_create(MAXROWS_INSTANCE *instance,
@@ -213,6 +225,7 @@ static int handle_expecting_nothing(MAXROWS_SESSION_DATA *csdata);
 static int handle_expecting_response(MAXROWS_SESSION_DATA *csdata);
 static int handle_rows(MAXROWS_SESSION_DATA *csdata, GWBUF* buffer, size_t extra_offset);
 static int handle_ignoring_response(MAXROWS_SESSION_DATA *csdata);
+static int handle_streaming(MAXROWS_SESSION_DATA *csdata, GWBUF *data);
 static bool process_params(char **options,
                            MXS_CONFIG_PARAMETER *params,
                            MAXROWS_CONFIG* config);
@@ -221,6 +234,7 @@ static int send_upstream(MAXROWS_SESSION_DATA *csdata);
 static int send_eof_upstream(MAXROWS_SESSION_DATA *csdata);
 static int send_error_upstream(MAXROWS_SESSION_DATA *csdata);
 static int send_maxrows_reply_limit(MAXROWS_SESSION_DATA *csdata);
+static GWBUF *create_error_packet(MAXROWS_SESSION_DATA *csdata, uint8_t seq);
 
 /* API BEGIN */
 
@@ -251,6 +265,7 @@ static MXS_FILTER *createInstance(const char *name,
                                                      "max_resultset_return",
                                                      return_option_values);
         cinstance->config.debug = config_get_integer(params, "debug");
+        cinstance->config.streaming = config_get_bool(params, "max_resultset_streaming");
     }
 
     return (MXS_FILTER*)cinstance;
@@ -362,6 +377,10 @@ static int routeQuery(MXS_FILTER *instance,
     case MYSQL_COM_QUERY:
     case MYSQL_COM_STMT_EXECUTE:
         {
+            /* A streamed response does not always consume the saved query */
+            gwbuf_free(csdata->input_sql);
+            csdata->input_sql = NULL;
+
             /* Set input query only with MAXROWS_RETURN_ERR */
             if (csdata->instance->config.m_return == MAXROWS_RETURN_ERR &&
                 (csdata->input_sql = gwbuf_clone(packet)) == NULL)
@@ -413,6 +432,11 @@ static int clientReply(MXS_FILTER *instance,
 
     int rv;
 
+    if (csdata->instance->config.streaming)
+    {
+        return handle_streaming(csdata, data);
+    }
+
     if (csdata->res.data)
     {
         if (csdata->discard_resultset &&
@@ -569,6 +593,7 @@ static void maxrows_session_data_free(MAXROWS_SESSION_DATA* data)
 {
     if (data)
     {
+        gwbuf_free(data->input_sql);
         MXS_FREE(data);
     }
 }
@@ -1008,6 +1033,186 @@ static int handle_rows(MAXROWS_SESSION_DATA *csdata, GWBUF* buffer, size_t extra
     return rv;
 }
 
+/**
+ * Create the packet that ends a streamed result when the limit is hit
+ *
+ * @param csdata The maxrows session data
+ *
+ * @return An EOF packet or, with max_resultset_return=error, an ERR packet
+ */
+static GWBUF *create_stream_terminator(MAXROWS_SESSION_DATA *csdata)
+{
+    uint8_t seq = csdata->last_seq + 1;
+
+    if (csdata->instance->config.m_return == MAXROWS_RETURN_ERR && csdata->input_sql)
+    {
+        GWBUF *err = create_error_packet(csdata, seq);
+        gwbuf_free(csdata->input_sql);
+        csdata->input_sql = NULL;
+        return err;
+    }
+
+    uint8_t eof[MYSQL_EOF_PACKET_LEN] = {05, 00, 00, seq, 0xfe, 00, 00, 02, 00};
+
+    return gwbuf_alloc_and_load(MYSQL_EOF_PACKET_LEN, eof);
+}
+
+/**
+ * Process a response in streaming mode
+ *
+ * Complete packets are forwarded as soon as they arrive. When the row or size
+ * limit is hit inside a result set, the rows seen so far are forwarded followed
+ * by an EOF or ERR packet and the rest of the response is discarded as it
+ * arrives. This bounds the memory used by a session to one network read.
+ *
+ * @param csdata The maxrows session data
+ * @param data   Complete packets from the backend
+ *
+ * @return The return value of the upstream component
+ */
+static int handle_streaming(MAXROWS_SESSION_DATA *csdata, GWBUF *data)
+{
+    size_t buflen = gwbuf_length(data);
+    size_t offset = 0;
+    size_t forward = csdata->state == MAXROWS_DRAINING_RESPONSE ? 0 : buflen;
+    GWBUF *terminator = NULL;
+
+    while (offset + MYSQL_HEADER_LEN <= buflen &&
+           csdata->state != MAXROWS_IGNORING_RESPONSE &&
+           csdata->state != MAXROWS_EXPECTING_NOTHING)
+    {
+        // Enough for the header, command byte and two length-encoded integers
+        uint8_t header[MYSQL_HEADER_LEN + 1 + 9 + 9 + 2];
+        size_t n = gwbuf_copy_data(data, offset, sizeof(header), header);
+        size_t packetlen = MYSQL_HEADER_LEN + MYSQL_GET_PAYLOAD_LEN(header);
+        int command = n > MYSQL_HEADER_LEN ? (int)MYSQL_GET_COMMAND(header) : -1;
+        bool continued = csdata->large_packet;
+
+        csdata->large_packet = packetlen == MYSQL_PACKET_LENGTH_MAX + MYSQL_HEADER_LEN;
+
+        switch (csdata->state)
+        {
+        case MAXROWS_EXPECTING_RESPONSE:
+            if (command == 0x00) // OK, possibly followed by more results
+            {
+                uint8_t *ptr = header + MYSQL_HEADER_LEN + 1;
+                ptr += mxs_leint_bytes(ptr);
+                ptr += mxs_leint_bytes(ptr);
+
+                if (ptr + 2 > header + n || !(gw_mysql_get_byte2(ptr) & SERVER_MORE_RESULTS_EXIST))
+                {
+                    csdata->state = MAXROWS_IGNORING_RESPONSE;
+                }
+            }
+            else if (command == 0xff || command == 0xfb) // ERR or LOCAL INFILE
+            {
+                csdata->state = MAXROWS_IGNORING_RESPONSE;
+            }
+            else
+            {
+                csdata->res.n_totalfields = mxs_leint_value(header + MYSQL_HEADER_LEN);
+                csdata->res.n_fields = 0;
+                csdata->res.n_rows = 0;
+                csdata->state = MAXROWS_EXPECTING_FIELDS;
+            }
+            break;
+
+        case MAXROWS_EXPECTING_FIELDS:
+            if (command == 0xfe && packetlen <= MYSQL_EOF_PACKET_LEN)
+            {
+                csdata->state = MAXROWS_EXPECTING_ROWS;
+            }
+            else
+            {
+                ++csdata->res.n_fields;
+            }
+            break;
+
+        case MAXROWS_EXPECTING_ROWS:
+        case MAXROWS_DRAINING_RESPONSE:
+            if (!continued && command == 0xfe && packetlen <= MYSQL_EOF_PACKET_LEN)
+            {
+                int flags = gw_mysql_get_byte2(header + MAXROWS_MYSQL_EOF_PACKET_FLAGS_OFFSET);
+
+                if (csdata->state == MAXROWS_DRAINING_RESPONSE)
+                {
+                    // A terminator was already sent, discard any further results
+                    if (!(flags & SERVER_MORE_RESULTS_EXIST))
+                    {
+                        csdata->state = MAXROWS_IGNORING_RESPONSE;
+                    }
+                }
+                else
+                {
+                    csdata->state = flags & SERVER_MORE_RESULTS_EXIST ?
+                        MAXROWS_EXPECTING_RESPONSE : MAXROWS_IGNORING_RESPONSE;
+                }
+            }
+            else if (!continued && command == 0xff)
+            {
+                csdata->state = MAXROWS_IGNORING_RESPONSE;
+            }
+            else if (!continued && csdata->state == MAXROWS_EXPECTING_ROWS)
+            {
+                // The first packet of a row
+                csdata->res.n_rows++;
+
+                if (csdata->res.n_rows > csdata->instance->config.max_resultset_rows ||
+                    csdata->res.length + packetlen > csdata->instance->config.max_resultset_size)
+                {
+                    if (csdata->instance->config.debug & MAXROWS_DEBUG_DISCARDING)
+                    {
+                        MXS_NOTICE("Limit hit after %lu rows and %lu bytes, ending the "
+                                   "streamed resultset.", csdata->res.n_rows - 1,
+                                   csdata->res.length);
+                    }
+
+                    forward = offset;
+                    terminator = create_stream_terminator(csdata);
+                    csdata->state = MAXROWS_DRAINING_RESPONSE;
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        if (csdata->state != MAXROWS_DRAINING_RESPONSE)
+        {
+            csdata->last_seq = header[3];
+            csdata->res.length += packetlen;
+        }
+
+        offset += packetlen;
+    }
+
+    if (csdata->state == MAXROWS_DRAINING_RESPONSE && terminator == NULL)
+    {
+        // Still draining, nothing from this buffer is forwarded
+        forward = 0;
+    }
+
+    GWBUF *reply = forward ? gwbuf_split(&data, forward) : NULL;
+    gwbuf_free(data);
+
+    if (terminator)
+    {
+        reply = gwbuf_append(reply, terminator);
+    }
+
+    int rv = 1;
+
+    if (reply)
+    {
+        rv = csdata->up.clientReply(csdata->up.instance,
+                                    csdata->up.session,
+                                    reply);
+    }
+
+    return rv;
+}
+
 /**
  * Called when all data from the server is ignored.
  *
@@ -1182,9 +1387,46 @@ static int send_ok_upstream(MAXROWS_SESSION_DATA *csdata)
  * @return            Non-Zero if successful, 0 on errors
  */
 static int send_error_upstream(MAXROWS_SESSION_DATA *csdata)
+{
+    ss_dassert(csdata->res.data != NULL);
+
+    /* Note: sequence id is always 01 (4th byte) */
+    GWBUF *err_pkt = create_error_packet(csdata, 1);
+    int rv = 0;
+
+    if (err_pkt)
+    {
+        rv = csdata->up.clientReply(csdata->up.instance,
+                                    csdata->up.session,
+                                    err_pkt);
+    }
+    else
+    {
+        /* Abort client connection */
+        poll_fake_hangup_event(csdata->session->client_dcb);
+    }
+
+    /* Free server result buffer */
+    gwbuf_free(csdata->res.data);
+    csdata->res.data = NULL;
+
+    /* Free input_sql buffer */
+    gwbuf_free(csdata->input_sql);
+    csdata->input_sql = NULL;
+
+    return rv;
+}
+
+/**
+ * Create an ERR packet with a message prefix plus the original SQL input
+ *
+ * @param   csdata    Session data
+ * @param   seq       Sequence number of the packet
+ * @return            The ERR packet or NULL on error
+ */
+static GWBUF *create_error_packet(MAXROWS_SESSION_DATA *csdata, uint8_t seq)
 {
     GWBUF *err_pkt;
-    uint8_t hdr_err[MYSQL_ERR_PACKET_MIN_LEN];
     unsigned long bytes_copied;
     char *err_msg_prefix = "Row limit/size exceeded for query: ";
     int err_prefix_len = strlen(err_msg_prefix);
@@ -1199,8 +1441,6 @@ static int send_error_upstream(MAXROWS_SESSION_DATA *csdata)
               MAXROWS_INPUT_SQL_MAX_LEN : sql_len;
     uint8_t sql[sql_len];
 
-    ss_dassert(csdata->res.data != NULL);
-
     pkt_len += sql_len;
 
     bytes_copied = gwbuf_copy_data(csdata->input_sql,
@@ -1211,25 +1451,16 @@ static int send_error_upstream(MAXROWS_SESSION_DATA *csdata)
     if (!bytes_copied ||
         (err_pkt = gwbuf_alloc(MYSQL_HEADER_LEN + pkt_len)) == NULL)
     {
-        /* Abort client connection */
-        poll_fake_hangup_event(csdata->session->client_dcb);
-        gwbuf_free(csdata->res.data);
-        gwbuf_free(csdata->input_sql);
-        csdata->res.data = NULL;
-        csdata->input_sql = NULL;
-
-        return 0;
+        return NULL;
     }
 
     uint8_t *ptr = GWBUF_DATA(err_pkt);
-    memcpy(ptr, &hdr_err, MYSQL_ERR_PACKET_MIN_LEN);
     unsigned int err_errno = 1415;
     char err_state[7] = "#0A000";
 
     /* Set the payload length of the whole error message */
     gw_mysql_set_byte3(&ptr[0], pkt_len);
-    /* Note: sequence id is always 01 (4th byte) */
-    ptr[3] = 1;
+    ptr[3] = seq;
     /* Error indicator */
     ptr[4] = 0xff;
     /* MySQL error code: 2 bytes */
@@ -1241,19 +1472,7 @@ static int send_error_upstream(MAXROWS_SESSION_DATA *csdata)
     /* Copy SQL input */
     memcpy(&ptr[13 +  err_prefix_len], sql, sql_len);
 
-    int rv = csdata->up.clientReply(csdata->up.instance,
-                                    csdata->up.session,
-                                    err_pkt);
-
-    /* Free server result buffer */
-    gwbuf_free(csdata->res.data);
-    csdata->res.data = NULL;
-
-    /* Free input_sql buffer */
-    gwbuf_free(csdata->input_sql);
-    csdata->input_sql = NULL;
-
-    return rv;
+    return err_pkt;
 }
 
 /**
@@ -37,6 +37,7 @@ const MXS_ENUM_VALUE capability_values[] =
     { "RCAP_TYPE_STMT_OUTPUT",          RCAP_TYPE_STMT_OUTPUT },
     { "RCAP_TYPE_CONTIGUOUS_OUTPUT",    RCAP_TYPE_CONTIGUOUS_OUTPUT },
     { "RCAP_TYPE_RESULTSET_OUTPUT",     RCAP_TYPE_RESULTSET_OUTPUT },
+    { "RCAP_TYPE_SESSION_TRACKING",     RCAP_TYPE_SESSION_TRACKING },
     { NULL, 0 }
 };
 
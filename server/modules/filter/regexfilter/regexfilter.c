@@ -14,6 +14,7 @@
 #define MXS_MODULE_NAME "regexfilter"
 
 #include <maxscale/cdefs.h>
+#include <ctype.h>
 #include <string.h>
 #include <stdio.h>
 #include <maxscale/alloc.h>
@@ -24,15 +25,19 @@
 #include <maxscale/modinfo.h>
 #include <maxscale/modutil.h>
 #include <maxscale/pcre2.h>
+#include <maxscale/platform.h>
 
 /**
  * @file regexfilter.c - a very simple regular expression rewrite filter.
  * @verbatim
  *
  * A simple regular expression query rewrite filter.
- * Two parameters should be defined in the filter configuration
+ * At least one rule should be defined in the filter configuration
  *      match=<regular expression>
  *      replace=<replacement text>
+ * Additional rules are applied in order
+ *      matchNN=<regular expression>
+ *      replaceNN=<replacement text>
  * Two optional parameters
  *      source=<source address to limit filter>
  *      user=<username to limit filter>
@@ -51,20 +56,35 @@ static int routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF
 static void diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb);
 static uint64_t getCapabilities(MXS_FILTER* instance);
 
-static char *regex_replace(const char *sql, pcre2_code *re, pcre2_match_data *study,
-                           const char *replace);
+static void thread_finish(void);
+
+/** The maximum number of numbered matchNN/replaceNN rules */
+#define REGEX_MAX_RULES 10
 
 /**
- * Instance structure
+ * A single match/replace rule
  */
 typedef struct
 {
-    char *source; /*< Source address to restrict matches */
-    char *user; /*< User name to restrict matches */
     char *match; /*< Regular expression to match */
     char *replace; /*< Replacement text */
     pcre2_code *re; /*< Compiled regex text */
-    pcre2_match_data *match_data; /*< Matching data used by the compiled regex */
+    char *literal; /*< Substring every match must contain, NULL if unknown */
+    bool caseless; /*< Whether the literal is compared case-insensitively */
+    uint32_t ovector_size; /*< Number of ovector pairs the regex needs */
+    uint64_t hits; /*< No. of statements this rule has rewritten */
+    uint64_t skipped; /*< No. of statements rejected by the literal prefilter */
+} REGEX_RULE;
+
+/**
+ * Instance structure
+ */
+typedef struct
+{
+    char *source; /*< Source address to restrict matches */
+    char *user; /*< User name to restrict matches */
+    REGEX_RULE *rules; /*< The rules, applied in order */
+    int n_rules; /*< Number of rules */
     FILE* logfile; /*< Log file */
     bool log_trace; /*< Whether messages should be printed to tracelog */
 } REGEX_INSTANCE;
@@ -75,15 +95,23 @@ typedef struct
 typedef struct
 {
     MXS_DOWNSTREAM down; /* The downstream filter */
-    SPINLOCK lock;
     int no_change; /* No. of unchanged requests */
     int replacements; /* No. of changed requests */
     int active; /* Is filter active */
 } REGEX_SESSION;
 
+static char *regex_replace(const char *sql, REGEX_RULE *rule);
+static char *regex_required_literal(const char *pattern);
+
 void log_match(REGEX_INSTANCE* inst, char* re, char* old, char* new);
 void log_nomatch(REGEX_INSTANCE* inst, char* re, char* old);
 
+/**
+ * Matching data shared by all regexfilter instances on this thread. It is
+ * grown to fit the regex with the most capture groups that has been used.
+ */
+static thread_local pcre2_match_data *thr_match_data = NULL;
+
 static const MXS_ENUM_VALUE option_values[] =
 {
     {"ignorecase", PCRE2_CASELESS},
@@ -122,15 +150,35 @@ MXS_MODULE* MXS_CREATE_MODULE()
         MXS_MODULE_GA,
         MXS_FILTER_VERSION,
         "A query rewrite filter that uses regular expressions to rewrite queries",
-        "V1.1.0",
+        "V1.2.0",
         &MyObject,
         NULL, /* Process init. */
         NULL, /* Process finish. */
         NULL, /* Thread init. */
-        NULL, /* Thread finish. */
+        thread_finish,
         {
-            {"match", MXS_MODULE_PARAM_STRING, NULL, MXS_MODULE_OPT_REQUIRED},
-            {"replace", MXS_MODULE_PARAM_STRING, NULL, MXS_MODULE_OPT_REQUIRED},
+            {"match", MXS_MODULE_PARAM_STRING},
+            {"replace", MXS_MODULE_PARAM_STRING},
+            {"match01", MXS_MODULE_PARAM_STRING},
+            {"replace01", MXS_MODULE_PARAM_STRING},
+            {"match02", MXS_MODULE_PARAM_STRING},
+            {"replace02", MXS_MODULE_PARAM_STRING},
+            {"match03", MXS_MODULE_PARAM_STRING},
+            {"replace03", MXS_MODULE_PARAM_STRING},
+            {"match04", MXS_MODULE_PARAM_STRING},
+            {"replace04", MXS_MODULE_PARAM_STRING},
+            {"match05", MXS_MODULE_PARAM_STRING},
+            {"replace05", MXS_MODULE_PARAM_STRING},
+            {"match06", MXS_MODULE_PARAM_STRING},
+            {"replace06", MXS_MODULE_PARAM_STRING},
+            {"match07", MXS_MODULE_PARAM_STRING},
+            {"replace07", MXS_MODULE_PARAM_STRING},
+            {"match08", MXS_MODULE_PARAM_STRING},
+            {"replace08", MXS_MODULE_PARAM_STRING},
+            {"match09", MXS_MODULE_PARAM_STRING},
+            {"replace09", MXS_MODULE_PARAM_STRING},
+            {"match10", MXS_MODULE_PARAM_STRING},
+            {"replace10", MXS_MODULE_PARAM_STRING},
             {"source", MXS_MODULE_PARAM_STRING},
             {"user", MXS_MODULE_PARAM_STRING},
             {"log_trace", MXS_MODULE_PARAM_BOOL, "false"},
@@ -143,6 +191,48 @@ MXS_MODULE* MXS_CREATE_MODULE()
     return &info;
 }
 
+/**
+ * Thread finalization routine. Frees this thread's matching data.
+ */
+static void thread_finish(void)
+{
+    if (thr_match_data)
+    {
+        pcre2_match_data_free(thr_match_data);
+        thr_match_data = NULL;
+    }
+}
+
+/**
+ * Get matching data that is large enough for a regex.
+ *
+ * @param ovector_size Number of ovector pairs required
+ * @return Matching data or NULL if memory allocation failed
+ */
+static pcre2_match_data* get_match_data(uint32_t ovector_size)
+{
+    if (thr_match_data == NULL || pcre2_get_ovector_count(thr_match_data) < ovector_size)
+    {
+        pcre2_match_data *data = pcre2_match_data_create(ovector_size, NULL);
+
+        if (data)
+        {
+            if (thr_match_data)
+            {
+                pcre2_match_data_free(thr_match_data);
+            }
+            thr_match_data = data;
+        }
+        else
+        {
+            MXS_OOM();
+            return NULL;
+        }
+    }
+
+    return thr_match_data;
+}
+
 /**
  * Free a regexfilter instance.
  * @param instance instance to free
@@ -151,24 +241,75 @@ void free_instance(REGEX_INSTANCE *instance)
 {
     if (instance)
     {
-        if (instance->re)
+        for (int i = 0; i < instance->n_rules; i++)
         {
-            pcre2_code_free(instance->re);
+            REGEX_RULE *rule = &instance->rules[i];
+
+            if (rule->re)
+            {
+                pcre2_code_free(rule->re);
+            }
+
+            MXS_FREE(rule->match);
+            MXS_FREE(rule->replace);
+            MXS_FREE(rule->literal);
         }
 
-        if (instance->match_data)
+        if (instance->logfile)
         {
-            pcre2_match_data_free(instance->match_data);
+            fclose(instance->logfile);
         }
 
-        MXS_FREE(instance->match);
-        MXS_FREE(instance->replace);
+        MXS_FREE(instance->rules);
         MXS_FREE(instance->source);
         MXS_FREE(instance->user);
         MXS_FREE(instance);
     }
 }
 
+/**
+ * Compile one match/replace rule.
+ *
+ * @param rule    The rule to initialize
+ * @param match   Regular expression
+ * @param replace Replacement text
+ * @param cflags  PCRE2 compilation options
+ * @return True if the rule was successfully compiled
+ */
+static bool rule_init(REGEX_RULE *rule, const char *match, const char *replace, int cflags)
+{
+    int errnumber;
+    PCRE2_SIZE erroffset;
+
+    rule->match = MXS_STRDUP_A(match);
+    rule->replace = MXS_STRDUP_A(replace);
+    rule->caseless = (cflags & PCRE2_CASELESS);
+
+    if ((rule->re = pcre2_compile((PCRE2_SPTR) rule->match,
+                                  PCRE2_ZERO_TERMINATED,
+                                  cflags,
+                                  &errnumber,
+                                  &erroffset,
+                                  NULL)) == NULL)
+    {
+        char errbuffer[1024];
+        pcre2_get_error_message(errnumber, (PCRE2_UCHAR*) & errbuffer, sizeof(errbuffer));
+        MXS_ERROR("Compiling regular expression '%s' failed at %lu: %s",
+                  rule->match, erroffset, errbuffer);
+        return false;
+    }
+
+    // If JIT is not available, the interpreter is used instead
+    pcre2_jit_compile(rule->re, PCRE2_JIT_COMPLETE);
+
+    uint32_t capture_count = 0;
+    pcre2_pattern_info(rule->re, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+    rule->ovector_size = capture_count + 1;
+    rule->literal = regex_required_literal(rule->match);
+
+    return true;
+}
+
 /**
  * Create an instance of the filter for a particular service
  * within MaxScale.
@@ -186,11 +327,16 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
 
     if (my_instance)
     {
-        my_instance->match = MXS_STRDUP_A(config_get_string(params, "match"));
-        my_instance->replace = MXS_STRDUP_A(config_get_string(params, "replace"));
         my_instance->source = config_copy_string(params, "source");
         my_instance->user = config_copy_string(params, "user");
         my_instance->log_trace = config_get_bool(params, "log_trace");
+        my_instance->rules = MXS_CALLOC(REGEX_MAX_RULES + 1, sizeof(REGEX_RULE));
+
+        if (my_instance->rules == NULL)
+        {
+            free_instance(my_instance);
+            return NULL;
+        }
 
         const char *logfile = config_get_string(params, "log_file");
 
@@ -207,32 +353,51 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
             fflush(my_instance->logfile);
         }
 
-        int errnumber;
-        PCRE2_SIZE erroffset;
         int cflags = config_get_enum(params, "options", option_values);
+        bool error = false;
 
-        if ((my_instance->re = pcre2_compile((PCRE2_SPTR) my_instance->match,
-                                             PCRE2_ZERO_TERMINATED,
-                                             cflags,
-                                             &errnumber,
-                                             &erroffset,
-                                             NULL)) == NULL)
+        /** The unnumbered match/replace pair is the first rule, followed
+         * by the numbered rules in ascending order */
+        for (int i = 0; i <= REGEX_MAX_RULES && !error; i++)
         {
-            char errbuffer[1024];
-            pcre2_get_error_message(errnumber, (PCRE2_UCHAR*) & errbuffer, sizeof(errbuffer));
-            MXS_ERROR("Compiling regular expression '%s' failed at %lu: %s",
-                      my_instance->match, erroffset, errbuffer);
-            free_instance(my_instance);
-            return NULL;
+            char match_param[20] = "match";
+            char replace_param[20] = "replace";
+
+            if (i > 0)
+            {
+                snprintf(match_param, sizeof(match_param), "match%02d", i);
+                snprintf(replace_param, sizeof(replace_param), "replace%02d", i);
+            }
+
+            const char *match = config_get_string(params, match_param);
+            const char *replace = config_get_string(params, replace_param);
+            bool has_replace = config_get_param(params, replace_param) != NULL;
+
+            if (*match && has_replace)
+            {
+                if (!rule_init(&my_instance->rules[my_instance->n_rules++], match, replace, cflags))
+                {
+                    error = true;
+                }
+            }
+            else if (*match || has_replace)
+            {
+                MXS_ERROR("Filter '%s': both '%s' and '%s' must be defined.",
+                          name, match_param, replace_param);
+                error = true;
+            }
+        }
+
+        if (!error && my_instance->n_rules == 0)
+        {
+            MXS_ERROR("Filter '%s': no 'match' and 'replace' parameters defined.", name);
+            error = true;
         }
 
-        if ((my_instance->match_data =
-                 pcre2_match_data_create_from_pattern(my_instance->re, NULL)) == NULL)
+        if (error)
         {
-            MXS_ERROR("Failure to create PCRE2 matching data. "
-                      "This is most likely caused by a lack of available memory.");
             free_instance(my_instance);
-            return NULL;
+            my_instance = NULL;
         }
     }
 
@@ -331,34 +496,53 @@ routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
 {
     REGEX_INSTANCE *my_instance = (REGEX_INSTANCE *) instance;
     REGEX_SESSION *my_session = (REGEX_SESSION *) session;
-    char *sql, *newsql;
+    char *sql;
 
     if (my_session->active && modutil_is_SQL(queue))
     {
         if ((sql = modutil_get_SQL(queue)) != NULL)
         {
-            newsql = regex_replace(sql,
-                                   my_instance->re,
-                                   my_instance->match_data,
-                                   my_instance->replace);
-            if (newsql)
+            char *orig = sql;
+            bool changed = false;
+
+            /** Every rule is applied to the output of the previous one and
+             * the buffer is rewritten only once after all rules */
+            for (int i = 0; i < my_instance->n_rules; i++)
+            {
+                REGEX_RULE *rule = &my_instance->rules[i];
+                char *newsql = regex_replace(sql, rule);
+
+                if (newsql)
+                {
+                    atomic_add_uint64(&rule->hits, 1);
+                    log_match(my_instance, rule->match, sql, newsql);
+
+                    if (sql != orig)
+                    {
+                        MXS_FREE(sql);
+                    }
+
+                    sql = newsql;
+                    changed = true;
+                }
+                else
+                {
+                    log_nomatch(my_instance, rule->match, sql);
+                }
+            }
+
+            if (changed)
             {
-                queue = modutil_replace_SQL(queue, newsql);
+                queue = modutil_replace_SQL(queue, sql);
                 queue = gwbuf_make_contiguous(queue);
-                spinlock_acquire(&my_session->lock);
-                log_match(my_instance, my_instance->match, sql, newsql);
-                spinlock_release(&my_session->lock);
-                MXS_FREE(newsql);
+                MXS_FREE(sql);
                 my_session->replacements++;
             }
             else
             {
-                spinlock_acquire(&my_session->lock);
-                log_nomatch(my_instance, my_instance->match, sql);
-                spinlock_release(&my_session->lock);
                 my_session->no_change++;
             }
-            MXS_FREE(sql);
+            MXS_FREE(orig);
         }
 
     }
@@ -383,8 +567,18 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
     REGEX_INSTANCE *my_instance = (REGEX_INSTANCE *) instance;
     REGEX_SESSION *my_session = (REGEX_SESSION *) fsession;
 
-    dcb_printf(dcb, "\t\tSearch and replace:            s/%s/%s/\n",
-               my_instance->match, my_instance->replace);
+    for (int i = 0; i < my_instance->n_rules; i++)
+    {
+        REGEX_RULE *rule = &my_instance->rules[i];
+        dcb_printf(dcb, "\t\tSearch and replace:            s/%s/%s/\n",
+                   rule->match, rule->replace);
+        dcb_printf(dcb, "\t\t\tRequired literal:                  %s\n",
+                   rule->literal ? rule->literal : "(none)");
+        dcb_printf(dcb, "\t\t\tNo. of queries altered by rule:    %lu\n",
+                   rule->hits);
+        dcb_printf(dcb, "\t\t\tNo. of queries skipped by literal: %lu\n",
+                   rule->skipped);
+    }
     if (my_session)
     {
         dcb_printf(dcb, "\t\tNo. of queries unaltered by filter:    %d\n",
@@ -406,32 +600,55 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
     }
 }
 
+/**
+ * Check whether a statement contains the literal required by a rule
+ *
+ * @param sql  The SQL text
+ * @param rule The rule
+ * @return True if the regex of the rule can match the statement
+ */
+static inline bool regex_literal_found(const char *sql, const REGEX_RULE *rule)
+{
+    if (rule->literal == NULL)
+    {
+        return true;
+    }
+
+    return (rule->caseless ? strcasestr(sql, rule->literal) : strstr(sql, rule->literal)) != NULL;
+}
+
 /**
  * Perform a regular expression match and substitution on the SQL
  *
- * @param   sql The original SQL text
- * @param   re  The compiled regular expression
- * @param   match_data The PCRE2 matching data buffer
- * @param   replace The replacement text
+ * @param   sql  The original SQL text
+ * @param   rule The rule to apply
  * @return  The replaced text or NULL if no replacement was done.
  */
 static char *
-regex_replace(const char *sql, pcre2_code *re, pcre2_match_data *match_data, const char *replace)
+regex_replace(const char *sql, REGEX_RULE *rule)
 {
     char *result = NULL;
     size_t result_size;
 
-    /** This should never fail with rc == 0 because we used pcre2_match_data_create_from_pattern() */
-    if (pcre2_match(re, (PCRE2_SPTR) sql, PCRE2_ZERO_TERMINATED, 0, 0, match_data, NULL) > 0)
+    if (!regex_literal_found(sql, rule))
+    {
+        atomic_add_uint64(&rule->skipped, 1);
+        return NULL;
+    }
+
+    pcre2_match_data *match_data = get_match_data(rule->ovector_size);
+
+    if (match_data &&
+        pcre2_match(rule->re, (PCRE2_SPTR) sql, PCRE2_ZERO_TERMINATED, 0, 0, match_data, NULL) > 0)
     {
-        result_size = strlen(sql) + strlen(replace);
+        result_size = strlen(sql) + strlen(rule->replace);
         result = MXS_MALLOC(result_size);
 
         size_t result_size_tmp = result_size;
         while (result &&
-               pcre2_substitute(re, (PCRE2_SPTR) sql, PCRE2_ZERO_TERMINATED, 0,
+               pcre2_substitute(rule->re, (PCRE2_SPTR) sql, PCRE2_ZERO_TERMINATED, 0,
                                 PCRE2_SUBSTITUTE_GLOBAL, match_data, NULL,
-                                (PCRE2_SPTR) replace, PCRE2_ZERO_TERMINATED,
+                                (PCRE2_SPTR) rule->replace, PCRE2_ZERO_TERMINATED,
                                 (PCRE2_UCHAR*) result, (PCRE2_SIZE*) & result_size_tmp) == PCRE2_ERROR_NOMEMORY)
         {
             result_size_tmp = 1.5 * result_size;
@@ -448,6 +665,159 @@ regex_replace(const char *sql, pcre2_code *re, pcre2_match_data *match_data, con
     return result;
 }
 
+/**
+ * Extract the longest run of literal characters that any string matched by
+ * the pattern must contain. The analysis is conservative: if the pattern
+ * contains constructs that could make a literal optional, no literal is
+ * returned and the regex is always evaluated.
+ *
+ * @param pattern The regular expression
+ * @return The required literal or NULL if none could be determined
+ */
+static char *
+regex_required_literal(const char *pattern)
+{
+    if (strchr(pattern, '|') || strstr(pattern, "(?"))
+    {
+        /** Top level alternation and inline options are not analyzed */
+        return NULL;
+    }
+
+    size_t len = strlen(pattern);
+    char run[len + 1];
+    char best[len + 1];
+    size_t run_len = 0;
+    size_t best_len = 0;
+    int depth = 0;
+    const char *p = pattern;
+
+    while (*p)
+    {
+        char c = 0;
+        bool literal = false;
+
+        if (*p == '\\')
+        {
+            p++;
+
+            if (*p && !isalnum(*p))
+            {
+                c = *p++;
+                literal = depth == 0;
+            }
+            else if (*p && strchr("sSdDwWbBAzZGhHvVRN", *p))
+            {
+                /** Character types and assertions are not literal */
+                p++;
+            }
+            else
+            {
+                /** Numeric escapes, back references and quoting are not analyzed */
+                return NULL;
+            }
+        }
+        else if (*p == '[')
+        {
+            /** Skip the character class */
+            p++;
+            if (*p == '^')
+            {
+                p++;
+            }
+            if (*p == ']')
+            {
+                p++;
+            }
+            while (*p && *p != ']')
+            {
+                if (*p == '\\' && p[1])
+                {
+                    p++;
+                }
+                p++;
+            }
+            if (*p)
+            {
+                p++;
+            }
+        }
+        else if (*p == '(')
+        {
+            depth++;
+            p++;
+        }
+        else if (*p == ')')
+        {
+            depth--;
+            p++;
+        }
+        else if (*p == '{')
+        {
+            /** Skip the repetition count */
+            while (*p && *p != '}')
+            {
+                p++;
+            }
+            if (*p)
+            {
+                p++;
+            }
+        }
+        else if (strchr(".^$+*?", *p))
+        {
+            p++;
+        }
+        else
+        {
+            c = *p++;
+            literal = depth == 0;
+        }
+
+        if (literal && (*p == '?' || *p == '*' || *p == '{'))
+        {
+            /** The character is optional */
+            literal = false;
+        }
+
+        if (literal)
+        {
+            run[run_len++] = c;
+
+            if (*p == '+')
+            {
+                /** The character is required but the run can't continue */
+                literal = false;
+            }
+        }
+
+        if (!literal)
+        {
+            if (run_len > best_len)
+            {
+                memcpy(best, run, run_len);
+                best_len = run_len;
+            }
+            run_len = 0;
+        }
+    }
+
+    if (run_len > best_len)
+    {
+        memcpy(best, run, run_len);
+        best_len = run_len;
+    }
+
+    char *rval = NULL;
+
+    if (best_len > 0)
+    {
+        best[best_len] = '\0';
+        rval = MXS_STRDUP_A(best);
+    }
+
+    return rval;
+}
+
 /**
  * Log a matching query to either MaxScale's trace log or a separate log file.
  * The old SQL and the new SQL statements are printed in the log.
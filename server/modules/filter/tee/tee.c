@@ -29,6 +29,14 @@
  *          of the request (optional)
  * user     A user name to match against. If present only requests that
  *          originate from this user will be duplciated (optional)
+ * mode     sync to send the duplicates to the branch as they arrive or async
+ *          to replay them from a queue of each session (optional)
+ * queue_size         The maximum number of queued duplicates of a session
+ *                    in async mode (optional)
+ * drop_policy        Whether the newest or the oldest statement is dropped
+ *                    when the queue is full (optional)
+ * session_sampling   Percentage of sessions that are duplicated (optional)
+ * statement_sampling Percentage of statements that are duplicated (optional)
  *
  * Revision History
  * ================
@@ -60,6 +68,10 @@
 #include <maxscale/protocol/mysql.h>
 #include <maxscale/housekeeper.h>
 #include <maxscale/alloc.h>
+#include <maxscale/atomic.h>
+#include <maxscale/latency.h>
+#include <maxscale/mysql_utils.h>
+#include <maxscale/random_jkiss.h>
 
 #define MYSQL_COM_QUIT                  0x01
 #define MYSQL_COM_INITDB                0x02
@@ -72,6 +84,8 @@
 #define MYSQL_COM_STMT_RESET            0x1a
 #define MYSQL_COM_CONNECT               0x1b
 
+#define TEE_LATENCY_BUCKETS             32
+
 #define REPLY_TIMEOUT_SECOND            5
 #define REPLY_TIMEOUT_MILLISECOND       1
 #define PARENT                          0
@@ -109,6 +123,24 @@ static int clientReply(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, GWBUF
 static void diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb);
 static uint64_t getCapabilities(MXS_FILTER* instance);
 
+/** What is dropped when the queue of a session is full */
+typedef enum
+{
+    TEE_DROP_NEWEST, /* The statement that does not fit into the queue */
+    TEE_DROP_OLDEST  /* The oldest queued statement */
+} tee_drop_t;
+
+/**
+ * Latencies of the duplicated statements on one side of the tee. Bucket n
+ * counts the replies that took less than 2^n microseconds.
+ */
+typedef struct
+{
+    int count; /* Number of replies */
+    uint64_t total; /* Sum of the latencies in microseconds */
+    int buckets[TEE_LATENCY_BUCKETS];
+} TEE_LATENCY;
+
 /**
  * The instance structure for the TEE filter - this holds the configuration
  * information for the filter.
@@ -122,8 +154,49 @@ typedef struct
     regex_t re; /* Compiled regex text */
     char *nomatch; /* Optional text to match against for exclusion */
     regex_t nore; /* Compiled regex nomatch text */
+    bool async; /* Replay the duplicates from a queue */
+    int queue_size; /* Maximum number of queued statements per session */
+    tee_drop_t drop_policy; /* What is dropped when the queue is full */
+    int session_sampling; /* Percentage of sessions that are duplicated */
+    int statement_sampling; /* Percentage of statements that are duplicated */
+    int n_sessions; /* Number of sessions that were duplicated */
+    int n_duped; /* Number of duplicated statements */
+    int n_dropped; /* Number of statements dropped from full queues */
+    int n_sampled_out; /* Number of statements skipped by sampling */
+    TEE_LATENCY latency[2]; /* Latencies of the main and the branch service */
 } TEE_INSTANCE;
 
+/** Where in the reply to a statement a session is */
+typedef enum
+{
+    TEE_REPLY_NONE, /* No reply is followed */
+    TEE_REPLY_FIRST, /* OK, ERR or the first packet of a result */
+    TEE_REPLY_COLUMNS, /* Column definitions */
+    TEE_REPLY_COL_EOF, /* The EOF after the column definitions */
+    TEE_REPLY_ROWS, /* Rows and the final EOF or ERR */
+    TEE_REPLY_DEFINITIONS /* Parameter and column definitions of a prepared statement */
+} tee_reply_state_t;
+
+/** The reply to the latest statement on one side of the tee */
+typedef struct
+{
+    tee_reply_state_t state;
+    uint8_t command; /* The command that is replied to */
+    uint64_t remaining; /* Definitions still expected */
+    uint64_t start; /* When the statement was sent */
+    bool measured; /* Whether the latency is recorded */
+    bool infile; /* The server is reading a LOAD DATA LOCAL INFILE file */
+} TEE_REPLY;
+
+/** A duplicated statement waiting to be replayed */
+typedef struct tee_stmt
+{
+    GWBUF *buffer; /* The packets of the statement */
+    bool required; /* Needed for the consistency of the branch, never dropped */
+    bool infile; /* Contents of a LOAD DATA LOCAL INFILE file */
+    struct tee_stmt *next;
+} TEE_STMT;
+
 /**
  * The session structure for this TEE filter.
  * This stores the downstream filter information, such that the
@@ -153,9 +226,24 @@ typedef struct
     int residual; /* Any outstanding SQL text */
     GWBUF* tee_replybuf; /* Buffer for reply */
     GWBUF* tee_partials[2];
-    GWBUF* queue;
     SPINLOCK tee_lock;
     DCB* client_dcb;
+    MXS_SESSION* session; /* The main session */
+    int thread_id; /* The worker of the main and the branch session */
+    MXS_UPSTREAM branch_up; /* The original reply handler of the branch session */
+    bool sampled; /* Whether the latest statement was duplicated */
+    bool large_packet; /* The latest packet continues in the next one */
+    bool infile_data; /* The latest packet is LOAD DATA LOCAL INFILE data */
+    TEE_STMT* pending; /* A statement whose last packet has not arrived */
+    TEE_STMT* queue; /* Statements waiting to be replayed, oldest first */
+    TEE_STMT* queue_tail;
+    int n_queued; /* Number of statements in the queue */
+    int max_queued; /* The longest the queue has been */
+    bool branch_busy; /* The branch has not replied to the latest statement */
+    bool dispatch_posted; /* Replaying of the queue has been posted */
+    TEE_REPLY reply[2]; /* Replies of the main and the branch session */
+    int n_dropped; /* Number of statements dropped from the full queue */
+    int n_sampled_out; /* Number of statements skipped by sampling */
 
 #ifdef SS_DEBUG
     long d_id;
@@ -181,12 +269,21 @@ static int packet_is_required(GWBUF *queue);
 static int detect_loops(TEE_INSTANCE *instance, HASHTABLE* ht, SERVICE* session);
 int internal_route(DCB* dcb);
 GWBUF* clone_query(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* buffer);
+static GWBUF* duplicate_packet(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* buffer);
 int route_single_query(TEE_INSTANCE* my_instance,
                        TEE_SESSION* my_session,
                        GWBUF* buffer,
                        GWBUF* clone);
 int reset_session_state(TEE_SESSION* my_session, GWBUF* buffer);
 void create_orphan(MXS_SESSION* ses);
+static int32_t branch_reply(void *instance, void *session, GWBUF *reply);
+static void detach_branch(TEE_SESSION *my_session);
+static void queue_packet(TEE_INSTANCE *my_instance, TEE_SESSION *my_session, GWBUF *packet);
+static void dispatch_queue(TEE_INSTANCE *my_instance, TEE_SESSION *my_session);
+static void free_queue(TEE_SESSION *my_session);
+static void reply_start(TEE_REPLY *reply, uint8_t command, bool measured);
+static bool reply_packet(TEE_INSTANCE *my_instance, TEE_SESSION *my_session,
+                         int side, const uint8_t *data);
 
 static void
 orphan_free(void* data)
@@ -289,6 +386,20 @@ static const MXS_ENUM_VALUE option_values[] =
     {NULL}
 };
 
+static const MXS_ENUM_VALUE mode_values[] =
+{
+    {"sync",  0},
+    {"async", 1},
+    {NULL}
+};
+
+static const MXS_ENUM_VALUE drop_values[] =
+{
+    {"newest", TEE_DROP_NEWEST},
+    {"oldest", TEE_DROP_OLDEST},
+    {NULL}
+};
+
 /**
  * The module entry point routine. It is this routine that
  * must populate the structure that is referred to as the
@@ -344,6 +455,23 @@ MXS_MODULE* MXS_CREATE_MODULE()
                 MXS_MODULE_OPT_NONE,
                 option_values
             },
+            {
+                "mode",
+                MXS_MODULE_PARAM_ENUM,
+                "sync",
+                MXS_MODULE_OPT_NONE,
+                mode_values
+            },
+            {"queue_size", MXS_MODULE_PARAM_COUNT, "100"},
+            {
+                "drop_policy",
+                MXS_MODULE_PARAM_ENUM,
+                "newest",
+                MXS_MODULE_OPT_NONE,
+                drop_values
+            },
+            {"session_sampling", MXS_MODULE_PARAM_COUNT, "100"},
+            {"statement_sampling", MXS_MODULE_PARAM_COUNT, "100"},
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -373,9 +501,28 @@ createInstance(const char *name, char **options, MXS_CONFIG_PARAMETER *params)
         my_instance->userName = config_copy_string(params, "user");
         my_instance->match = config_copy_string(params, "match");
         my_instance->nomatch = config_copy_string(params, "exclude");
+        my_instance->async = config_get_enum(params, "mode", mode_values);
+        my_instance->queue_size = config_get_integer(params, "queue_size");
+        my_instance->drop_policy = config_get_enum(params, "drop_policy", drop_values);
+        my_instance->session_sampling = config_get_integer(params, "session_sampling");
+        my_instance->statement_sampling = config_get_integer(params, "statement_sampling");
 
         int cflags = config_get_enum(params, "options", option_values);
 
+        if (my_instance->queue_size == 0 ||
+            my_instance->session_sampling > 100 ||
+            my_instance->statement_sampling > 100)
+        {
+            MXS_ERROR("The queue_size parameter must be positive and the sampling "
+                      "parameters must be percentages between 0 and 100.");
+            MXS_FREE(my_instance->match);
+            MXS_FREE(my_instance->nomatch);
+            MXS_FREE(my_instance->source);
+            MXS_FREE(my_instance->userName);
+            MXS_FREE(my_instance);
+            return NULL;
+        }
+
         if (my_instance->match && regcomp(&my_instance->re, my_instance->match, cflags))
         {
             MXS_ERROR("Invalid regular expression '%s' for the match parameter.",
@@ -453,6 +600,8 @@ newSession(MXS_FILTER *instance, MXS_SESSION *session)
         my_session->instance = my_instance;
         my_session->client_multistatement = false;
         my_session->queue = NULL;
+        my_session->session = session;
+        my_session->thread_id = session->client_dcb->thread.id;
         spinlock_init(&my_session->tee_lock);
         if (my_instance->source &&
             (remote = session_get_remote(session)) != NULL)
@@ -475,6 +624,12 @@ newSession(MXS_FILTER *instance, MXS_SESSION *session)
             MXS_WARNING("Tee filter is not active.");
         }
 
+        if (my_session->active && my_instance->session_sampling < 100 &&
+            (int)(random_jkiss() % 100) >= my_instance->session_sampling)
+        {
+            my_session->active = 0;
+        }
+
         if (my_session->active)
         {
             DCB* dcb;
@@ -505,6 +660,15 @@ newSession(MXS_FILTER *instance, MXS_SESSION *session)
 
             my_session->branch_session = ses;
             my_session->branch_dcb = dcb;
+
+            /** Follow the replies of the branch before they are discarded */
+            my_session->branch_up = ses->tail;
+            ses->tail.instance = my_instance;
+            ses->tail.session = my_session;
+            ses->tail.clientReply = branch_reply;
+            ses->tail.error = NULL;
+
+            atomic_add(&my_instance->n_sessions, 1);
         }
     }
 retblock:
@@ -530,6 +694,8 @@ closeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session)
 #ifdef SS_DEBUG
     MXS_INFO("Tee close: %d", atomic_add(&debug_seq, 1));
 #endif
+    detach_branch(my_session);
+
     if (my_session->active)
     {
 
@@ -585,6 +751,9 @@ freeSession(MXS_FILTER *instance, MXS_FILTER_SESSION *session)
 #ifdef SS_DEBUG
     MXS_INFO("Tee free: %d", atomic_add(&debug_seq, 1));
 #endif
+    detach_branch(my_session);
+    free_queue(my_session);
+
     if (ses != NULL)
     {
         state = ses->state;
@@ -674,7 +843,12 @@ routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
 {
     TEE_INSTANCE *my_instance = (TEE_INSTANCE *) instance;
     TEE_SESSION *my_session = (TEE_SESSION *) session;
-    GWBUF *clone = clone_query(my_instance, my_session, queue);
+    GWBUF *clone = NULL;
+
+    if (my_session->active)
+    {
+        clone = duplicate_packet(my_instance, my_session, queue);
+    }
 
     return route_single_query(my_instance, my_session, queue, clone);
 }
@@ -692,12 +866,69 @@ routeQuery(MXS_FILTER *instance, MXS_FILTER_SESSION *session, GWBUF *queue)
 static int
 clientReply(MXS_FILTER* instance, MXS_FILTER_SESSION *session, GWBUF *reply)
 {
-    int rc = 1, branch, eof;
+    TEE_INSTANCE *my_instance = (TEE_INSTANCE *) instance;
     TEE_SESSION *my_session = (TEE_SESSION *) session;
 
-    return my_session->up.clientReply(my_session->up.instance,
-                                      my_session->up.session,
-                                      reply);
+    if (my_session->reply[PARENT].state != TEE_REPLY_NONE)
+    {
+        /** The buffer is contiguous and contains only complete packets */
+        const uint8_t *data = GWBUF_DATA(reply);
+        size_t len = GWBUF_LENGTH(reply);
+        size_t offset = 0;
+        bool done = false;
+
+        while (!done && offset + MYSQL_HEADER_LEN <= len)
+        {
+            done = reply_packet(my_instance, my_session, PARENT, data + offset);
+            offset += MYSQL_HEADER_LEN + MYSQL_GET_PAYLOAD_LEN(data + offset);
+        }
+    }
+
+    int rc = my_session->up.clientReply(my_session->up.instance,
+                                        my_session->up.session,
+                                        reply);
+
+    if (my_session->queue)
+    {
+        dispatch_queue(my_instance, my_session);
+    }
+
+    return rc;
+}
+
+/**
+ * Print the latencies of one side of the tee
+ *
+ * @param dcb     The DCB for diagnostic output
+ * @param name    Name of the side
+ * @param latency The latencies
+ */
+static void
+print_latency(DCB *dcb, const char *name, TEE_LATENCY *latency)
+{
+    int count = latency->count;
+    uint64_t p50 = 0, p99 = 0;
+    uint64_t seen = 0;
+
+    /** The percentiles are the upper bounds of the buckets they fall into */
+    for (int i = 0; i < TEE_LATENCY_BUCKETS && count > 0; i++)
+    {
+        seen += latency->buckets[i];
+
+        if (p50 == 0 && seen * 100 >= (uint64_t)count * 50)
+        {
+            p50 = 1ULL << i;
+        }
+
+        if (seen * 100 >= (uint64_t)count * 99)
+        {
+            p99 = 1ULL << i;
+            break;
+        }
+    }
+
+    dcb_printf(dcb, "\t\t%-8s		%-8d	%-8lu	%-8lu	%-8lu (us)\n", name, count,
+               count ? latency->total / count : 0, p50, p99);
 }
 
 /**
@@ -739,12 +970,51 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
         dcb_printf(dcb, "\t\tExclude queries that match		%s\n",
                    my_instance->nomatch);
     }
+    dcb_printf(dcb, "\t\tMode					%s\n",
+               my_instance->async ? "async" : "sync");
+    if (my_instance->async)
+    {
+        dcb_printf(dcb, "\t\tQueue size				%d\n",
+                   my_instance->queue_size);
+        dcb_printf(dcb, "\t\tDrop policy				%s\n",
+                   my_instance->drop_policy == TEE_DROP_OLDEST ? "oldest" : "newest");
+    }
+    dcb_printf(dcb, "\t\tSession sampling			%d%%\n",
+               my_instance->session_sampling);
+    dcb_printf(dcb, "\t\tStatement sampling			%d%%\n",
+               my_instance->statement_sampling);
     if (my_session)
     {
         dcb_printf(dcb, "\t\tNo. of statements duplicated:	%d.\n",
                    my_session->n_duped);
         dcb_printf(dcb, "\t\tNo. of statements rejected:	%d.\n",
                    my_session->n_rejected);
+        dcb_printf(dcb, "\t\tNo. of statements sampled out:	%d.\n",
+                   my_session->n_sampled_out);
+        if (my_instance->async)
+        {
+            dcb_printf(dcb, "\t\tNo. of statements dropped:	%d.\n",
+                       my_session->n_dropped);
+            dcb_printf(dcb, "\t\tStatements in queue:		%d (max %d).\n",
+                       my_session->n_queued, my_session->max_queued);
+        }
+    }
+    else
+    {
+        dcb_printf(dcb, "\t\tNo. of sessions duplicated:	%d.\n",
+                   my_instance->n_sessions);
+        dcb_printf(dcb, "\t\tNo. of statements duplicated:	%d.\n",
+                   my_instance->n_duped);
+        dcb_printf(dcb, "\t\tNo. of statements sampled out:	%d.\n",
+                   my_instance->n_sampled_out);
+        if (my_instance->async)
+        {
+            dcb_printf(dcb, "\t\tNo. of statements dropped:	%d.\n",
+                       my_instance->n_dropped);
+            dcb_printf(dcb, "\t\tLatency			Count		Average		p50		p99\n");
+            print_latency(dcb, "Main", &my_instance->latency[PARENT]);
+            print_latency(dcb, "Branch", &my_instance->latency[CHILD]);
+        }
     }
 }
 
@@ -755,7 +1025,7 @@ diagnostic(MXS_FILTER *instance, MXS_FILTER_SESSION *fsession, DCB *dcb)
  */
 static uint64_t getCapabilities(MXS_FILTER* instance)
 {
-    return RCAP_TYPE_CONTIGUOUS_INPUT;
+    return RCAP_TYPE_CONTIGUOUS_INPUT | RCAP_TYPE_CONTIGUOUS_OUTPUT;
 }
 
 /**
@@ -863,6 +1133,103 @@ GWBUF* clone_query(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* bu
     return clone;
 }
 
+/**
+ * Check whether a statement is sampled
+ *
+ * @param percent Percentage of statements that are sampled
+ * @return True if the statement is sampled
+ */
+static inline bool
+is_sampled(int percent)
+{
+    return percent >= 100 || (int)(random_jkiss() % 100) < percent;
+}
+
+/**
+ * Check whether the server replies to a command
+ *
+ * @param command The command
+ * @return True if a reply is sent
+ */
+static inline bool
+command_has_reply(uint8_t command)
+{
+    return command != MYSQL_COM_QUIT &&
+           command != MYSQL_COM_STMT_SEND_LONG_DATA &&
+           command != MYSQL_COM_STMT_CLOSE;
+}
+
+/**
+ * Decide whether a packet from the client is duplicated to the branch.
+ *
+ * Packets that continue a large statement and the contents of a LOAD DATA
+ * LOCAL INFILE file follow the decision made for the statement. Commands
+ * that keep the branch session consistent are always duplicated. The rest
+ * are subject to the match and exclude patterns and to statement sampling.
+ *
+ * Also starts following the reply of the main service to the statement.
+ *
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ * @param buffer The packet, contiguous
+ * @return Clone of the packet or NULL if it is not duplicated
+ */
+static GWBUF*
+duplicate_packet(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF* buffer)
+{
+    TEE_REPLY *reply = &my_session->reply[PARENT];
+    uint8_t *data = GWBUF_DATA(buffer);
+    uint32_t len = GWBUF_LENGTH(buffer) >= MYSQL_HEADER_LEN ? MYSQL_GET_PAYLOAD_LEN(data) : 0;
+    bool continuation = my_session->large_packet;
+    GWBUF *clone = NULL;
+
+    my_session->large_packet = len == GW_MYSQL_MAX_PACKET_LEN;
+    my_session->infile_data = reply->infile;
+
+    if (continuation || reply->infile)
+    {
+        if (reply->infile && !continuation && len == 0)
+        {
+            /** An empty packet ends the file, the server replies to it */
+            reply->infile = false;
+        }
+
+        if (my_session->sampled)
+        {
+            clone = gwbuf_clone(buffer);
+        }
+    }
+    else
+    {
+        uint8_t command = len > 0 ? data[MYSQL_HEADER_LEN] : 0;
+
+        if ((clone = clone_query(my_instance, my_session, buffer)) == NULL)
+        {
+            my_session->n_rejected++;
+        }
+        else if (!packet_is_required(buffer) && !is_sampled(my_instance->statement_sampling))
+        {
+            gwbuf_free(clone);
+            clone = NULL;
+            my_session->n_sampled_out++;
+            atomic_add(&my_instance->n_sampled_out, 1);
+        }
+
+        my_session->sampled = clone != NULL;
+
+        if (command_has_reply(command))
+        {
+            reply_start(reply, command, clone && my_instance->async);
+        }
+        else
+        {
+            reply->state = TEE_REPLY_NONE;
+        }
+    }
+
+    return clone;
+}
+
 /**
  * Route the main query downstream along the main filter chain and possibly route
  * a clone of the buffer to the branch session. If the clone buffer is NULL, nothing
@@ -877,8 +1244,16 @@ int route_single_query(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF
 {
     int rval = 0;
 
-    if (my_session->active && my_session->branch_session &&
-        my_session->branch_session->state == SESSION_STATE_ROUTER_READY)
+    if (!my_session->active)
+    {
+        /** Nothing is duplicated from this session */
+        ss_dassert(clone == NULL);
+        rval = my_session->down.routeQuery(my_session->down.instance,
+                                           my_session->down.session,
+                                           buffer);
+    }
+    else if (my_session->branch_session &&
+             my_session->branch_session->state == SESSION_STATE_ROUTER_READY)
     {
 
         rval = my_session->down.routeQuery(my_session->down.instance,
@@ -887,10 +1262,18 @@ int route_single_query(TEE_INSTANCE* my_instance, TEE_SESSION* my_session, GWBUF
         if (clone)
         {
             my_session->n_duped++;
+            atomic_add(&my_instance->n_duped, 1);
 
             if (my_session->branch_session->state == SESSION_STATE_ROUTER_READY)
             {
-                MXS_SESSION_ROUTE_QUERY(my_session->branch_session, clone);
+                if (my_instance->async)
+                {
+                    queue_packet(my_instance, my_session, clone);
+                }
+                else
+                {
+                    MXS_SESSION_ROUTE_QUERY(my_session->branch_session, clone);
+                }
             }
             else
             {
@@ -960,3 +1343,551 @@ void create_orphan(MXS_SESSION* ses)
         spinlock_release(&orphanLock);
     }
 }
+
+/**
+ * Start following the reply to a statement
+ *
+ * @param reply The reply
+ * @param command The command of the statement
+ * @param measured Whether the latency of the reply is recorded
+ */
+static void
+reply_start(TEE_REPLY *reply, uint8_t command, bool measured)
+{
+    reply->state = TEE_REPLY_FIRST;
+    reply->command = command;
+    reply->remaining = 0;
+    reply->start = latency_now();
+    reply->measured = measured;
+    reply->infile = false;
+}
+
+/**
+ * Check the server status of an OK or EOF packet for more results
+ *
+ * @param payload Packet payload
+ * @param len Payload length
+ * @return True if more results follow
+ */
+static bool
+more_results(const uint8_t *payload, uint32_t len)
+{
+    uint16_t status = 0;
+
+    if (payload[0] == MYSQL_REPLY_EOF)
+    {
+        /** Header, warnings, status */
+        if (len >= 5)
+        {
+            status = gw_mysql_get_byte2(payload + 3);
+        }
+    }
+    else
+    {
+        /** Header, affected rows, last insert id, status */
+        const uint8_t *end = payload + len;
+        const uint8_t *ptr = payload + 1;
+        ptr += mxs_leint_bytes(ptr);
+
+        if (ptr < end)
+        {
+            ptr += mxs_leint_bytes(ptr);
+        }
+
+        if (ptr + 2 <= end)
+        {
+            status = gw_mysql_get_byte2(ptr);
+        }
+    }
+
+    return status & SERVER_MORE_RESULTS_EXIST;
+}
+
+/**
+ * Process one packet of a reply
+ *
+ * @param reply The reply
+ * @param payload Packet payload
+ * @param len Payload length
+ * @return True if this was the last packet of the reply
+ */
+static bool
+reply_process(TEE_REPLY *reply, const uint8_t *payload, uint32_t len)
+{
+    if (len == 0)
+    {
+        return false;
+    }
+
+    bool is_eof = payload[0] == MYSQL_REPLY_EOF && len < 9;
+
+    switch (reply->state)
+    {
+    case TEE_REPLY_NONE:
+        break;
+
+    case TEE_REPLY_FIRST:
+        if (payload[0] == MYSQL_REPLY_ERR)
+        {
+            return true;
+        }
+
+        switch (reply->command)
+        {
+        case MYSQL_COM_QUERY:
+        case MYSQL_COM_STMT_EXECUTE:
+            if (payload[0] == MYSQL_REPLY_OK)
+            {
+                return !more_results(payload, len);
+            }
+            else if (payload[0] == MYSQL_REPLY_LOCAL_INFILE)
+            {
+                /** The client sends the file next and the server replies
+                 * with an OK or ERR once the file ends */
+                reply->infile = true;
+                reply->command = 0;
+            }
+            else
+            {
+                reply->remaining = mxs_leint_value(payload);
+                reply->state = reply->remaining ? TEE_REPLY_COLUMNS : TEE_REPLY_COL_EOF;
+            }
+            break;
+
+        case MYSQL_COM_STMT_PREPARE:
+            if (payload[0] == MYSQL_REPLY_OK && len >= 9)
+            {
+                /** Header, statement ID, columns, parameters */
+                uint64_t columns = gw_mysql_get_byte2(payload + 5);
+                uint64_t params = gw_mysql_get_byte2(payload + 7);
+
+                reply->remaining = columns + (columns ? 1 : 0) + params + (params ? 1 : 0);
+                reply->state = TEE_REPLY_DEFINITIONS;
+                return reply->remaining == 0;
+            }
+            return true;
+
+        case MYSQL_COM_FIELD_LIST:
+        case MYSQL_COM_STMT_FETCH:
+            /** Column definitions or rows up to an EOF */
+            reply->state = TEE_REPLY_ROWS;
+            return is_eof;
+
+        default:
+            return true;
+        }
+        break;
+
+    case TEE_REPLY_COLUMNS:
+        if (--reply->remaining == 0)
+        {
+            reply->state = TEE_REPLY_COL_EOF;
+        }
+        break;
+
+    case TEE_REPLY_COL_EOF:
+        reply->state = TEE_REPLY_ROWS;
+        break;
+
+    case TEE_REPLY_ROWS:
+        if (is_eof)
+        {
+            if (more_results(payload, len))
+            {
+                reply->state = TEE_REPLY_FIRST;
+            }
+            else
+            {
+                return true;
+            }
+        }
+        else if (payload[0] == MYSQL_REPLY_ERR)
+        {
+            return true;
+        }
+        break;
+
+    case TEE_REPLY_DEFINITIONS:
+        return --reply->remaining == 0;
+    }
+
+    return false;
+}
+
+/**
+ * Process one packet of the reply of the main or the branch session and
+ * record the latency once the reply is complete
+ *
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ * @param side PARENT or CHILD
+ * @param data A complete packet
+ * @return True if this was the last packet of the reply
+ */
+static bool
+reply_packet(TEE_INSTANCE *my_instance, TEE_SESSION *my_session, int side, const uint8_t *data)
+{
+    TEE_REPLY *reply = &my_session->reply[side];
+    bool done = reply_process(reply, data + MYSQL_HEADER_LEN, MYSQL_GET_PAYLOAD_LEN(data));
+
+    if (done)
+    {
+        if (reply->measured)
+        {
+            TEE_LATENCY *latency = &my_instance->latency[side];
+            uint64_t us = (latency_now() - reply->start) / 1000;
+            int bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+            atomic_add(&latency->buckets[MXS_MIN(bucket, TEE_LATENCY_BUCKETS - 1)], 1);
+            atomic_add_uint64(&latency->total, us);
+            atomic_add(&latency->count, 1);
+        }
+
+        reply->state = TEE_REPLY_NONE;
+    }
+
+    return done;
+}
+
+/**
+ * Make room for a statement in the queue of a session
+ *
+ * Statements that keep the branch session consistent are always queued.
+ *
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ * @param required Whether the statement is required by the branch
+ * @return True if the statement can be queued, false if it is dropped
+ */
+static bool
+make_room(TEE_INSTANCE *my_instance, TEE_SESSION *my_session, bool required)
+{
+    if (required || my_session->n_queued < my_instance->queue_size)
+    {
+        return true;
+    }
+
+    bool rval = false;
+
+    if (my_instance->drop_policy == TEE_DROP_OLDEST)
+    {
+        TEE_STMT *prev = NULL;
+
+        for (TEE_STMT *stmt = my_session->queue; stmt; prev = stmt, stmt = stmt->next)
+        {
+            if (!stmt->required)
+            {
+                if (prev)
+                {
+                    prev->next = stmt->next;
+                }
+                else
+                {
+                    my_session->queue = stmt->next;
+                }
+
+                if (my_session->queue_tail == stmt)
+                {
+                    my_session->queue_tail = prev;
+                }
+
+                my_session->n_queued--;
+                gwbuf_free(stmt->buffer);
+                MXS_FREE(stmt);
+                rval = true;
+                break;
+            }
+        }
+    }
+
+    my_session->n_dropped++;
+    atomic_add(&my_instance->n_dropped, 1);
+
+    return rval;
+}
+
+/**
+ * Queue a duplicated packet for replaying on the branch session
+ *
+ * The packets of a large statement are queued together once the last one
+ * has arrived.
+ *
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ * @param packet The duplicated packet
+ */
+static void
+queue_packet(TEE_INSTANCE *my_instance, TEE_SESSION *my_session, GWBUF *packet)
+{
+    TEE_STMT *stmt = my_session->pending;
+
+    if (stmt == NULL)
+    {
+        bool infile = my_session->infile_data;
+        bool required = infile || packet_is_required(packet);
+
+        if (!make_room(my_instance, my_session, required) ||
+            (stmt = MXS_CALLOC(1, sizeof(TEE_STMT))) == NULL)
+        {
+            /** The rest of the statement is not duplicated either */
+            my_session->sampled = false;
+            gwbuf_free(packet);
+            return;
+        }
+
+        stmt->required = required;
+        stmt->infile = infile;
+    }
+
+    stmt->buffer = gwbuf_append(stmt->buffer, packet);
+
+    if (MYSQL_GET_PAYLOAD_LEN(GWBUF_DATA(packet)) == GW_MYSQL_MAX_PACKET_LEN)
+    {
+        my_session->pending = stmt;
+    }
+    else
+    {
+        my_session->pending = NULL;
+
+        if (my_session->queue_tail)
+        {
+            my_session->queue_tail->next = stmt;
+        }
+        else
+        {
+            my_session->queue = stmt;
+        }
+
+        my_session->queue_tail = stmt;
+
+        if (++my_session->n_queued > my_session->max_queued)
+        {
+            my_session->max_queued = my_session->n_queued;
+        }
+
+        dispatch_queue(my_instance, my_session);
+    }
+}
+
+/**
+ * Replay queued statements on the branch session
+ *
+ * Only one statement at a time waits for a reply from the branch. The
+ * statements that the server does not reply to are sent right away.
+ *
+ * @param my_instance Tee instance
+ * @param my_session Tee session
+ */
+static void
+dispatch_queue(TEE_INSTANCE *my_instance, TEE_SESSION *my_session)
+{
+    TEE_REPLY *reply = &my_session->reply[CHILD];
+
+    while (!my_session->branch_busy && my_session->queue)
+    {
+        MXS_SESSION *ses = my_session->branch_session;
+
+        if (!my_session->active || ses == NULL || ses->state != SESSION_STATE_ROUTER_READY)
+        {
+            free_queue(my_session);
+            break;
+        }
+
+        TEE_STMT *stmt = my_session->queue;
+
+        if (reply->infile && !stmt->infile)
+        {
+            /** The branch asked for a file the main service did not ask for,
+             * end it with an empty packet */
+            GWBUF *empty = gwbuf_alloc(MYSQL_HEADER_LEN);
+
+            if (empty == NULL)
+            {
+                break;
+            }
+
+            uint8_t *ptr = GWBUF_DATA(empty);
+            ptr[0] = ptr[1] = ptr[2] = 0;
+            ptr[3] = 2;
+            reply->infile = false;
+            my_session->branch_busy = true;
+            MXS_SESSION_ROUTE_QUERY(ses, empty);
+            continue;
+        }
+
+        if ((my_session->queue = stmt->next) == NULL)
+        {
+            my_session->queue_tail = NULL;
+        }
+
+        my_session->n_queued--;
+        bool send = true;
+
+        if (stmt->infile && !reply->infile)
+        {
+            /** The branch did not ask for the file */
+            send = false;
+        }
+        else if (stmt->infile)
+        {
+            if (gwbuf_length(stmt->buffer) == MYSQL_HEADER_LEN)
+            {
+                /** The end of the file, the branch replies to it */
+                reply->infile = false;
+                my_session->branch_busy = true;
+            }
+        }
+        else
+        {
+            uint8_t command = GWBUF_DATA(stmt->buffer)[MYSQL_HEADER_LEN];
+
+            if (command_has_reply(command))
+            {
+                reply_start(reply, command, true);
+                my_session->branch_busy = true;
+            }
+        }
+
+        if (send)
+        {
+            GWBUF *packet;
+
+            while ((packet = modutil_get_next_MySQL_packet(&stmt->buffer)))
+            {
+                MXS_SESSION_ROUTE_QUERY(ses, packet);
+            }
+        }
+
+        gwbuf_free(stmt->buffer);
+        MXS_FREE(stmt);
+    }
+}
+
+/**
+ * Replay the queue of a session, called by the worker of the session
+ *
+ * @param data The tee session
+ */
+static void
+dispatch_task(void *data)
+{
+    TEE_SESSION *my_session = (TEE_SESSION *) data;
+    MXS_SESSION *session = my_session->session;
+
+    my_session->dispatch_posted = false;
+    dispatch_queue(my_session->instance, my_session);
+
+    /** This may free the tee session */
+    session_put_ref(session);
+}
+
+/**
+ * Handle a reply from the branch session before it is discarded
+ *
+ * The reply of a replayed statement completes when the branch router is
+ * still processing it. Replaying of the next statement is posted to the
+ * worker so that the branch router is not entered recursively.
+ *
+ * @param instance The tee instance
+ * @param session The tee session
+ * @param reply The reply
+ * @return The return value of the original reply handler
+ */
+static int32_t
+branch_reply(void *instance, void *session, GWBUF *reply)
+{
+    TEE_INSTANCE *my_instance = (TEE_INSTANCE *) instance;
+    TEE_SESSION *my_session = (TEE_SESSION *) session;
+    TEE_REPLY *tracker = &my_session->reply[CHILD];
+
+    if (my_session->branch_busy && tracker->state != TEE_REPLY_NONE)
+    {
+        GWBUF *packet;
+        bool done = false;
+
+        my_session->tee_replybuf = gwbuf_append(my_session->tee_replybuf, gwbuf_clone(reply));
+
+        while (!done && (packet = modutil_get_next_MySQL_packet(&my_session->tee_replybuf)))
+        {
+            if ((packet = gwbuf_make_contiguous(packet)))
+            {
+                done = reply_packet(my_instance, my_session, CHILD, GWBUF_DATA(packet));
+                gwbuf_free(packet);
+            }
+        }
+
+        if (done || tracker->infile)
+        {
+            gwbuf_free(my_session->tee_replybuf);
+            my_session->tee_replybuf = NULL;
+            my_session->branch_busy = false;
+        }
+    }
+
+    int32_t rc = my_session->branch_up.clientReply(my_session->branch_up.instance,
+                                                   my_session->branch_up.session,
+                                                   reply);
+
+    if (!my_session->branch_busy && my_session->queue && !my_session->dispatch_posted)
+    {
+        session_get_ref(my_session->session);
+
+        if (poll_post_task(my_session->thread_id, dispatch_task, my_session))
+        {
+            my_session->dispatch_posted = true;
+        }
+        else
+        {
+            /** The queue is replayed when the main session is next active */
+            session_put_ref(my_session->session);
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Give the replies of the branch session back to its original handler
+ *
+ * @param my_session Tee session
+ */
+static void
+detach_branch(TEE_SESSION *my_session)
+{
+    MXS_SESSION *ses = my_session->branch_session;
+
+    if (ses && ses->tail.session == my_session)
+    {
+        ses->tail = my_session->branch_up;
+    }
+}
+
+/**
+ * Discard the statements waiting to be replayed
+ *
+ * @param my_session Tee session
+ */
+static void
+free_queue(TEE_SESSION *my_session)
+{
+    TEE_STMT *stmt = my_session->queue;
+
+    while (stmt)
+    {
+        TEE_STMT *next = stmt->next;
+        gwbuf_free(stmt->buffer);
+        MXS_FREE(stmt);
+        stmt = next;
+    }
+
+    if (my_session->pending)
+    {
+        gwbuf_free(my_session->pending->buffer);
+        MXS_FREE(my_session->pending);
+    }
+
+    my_session->queue = NULL;
+    my_session->queue_tail = NULL;
+    my_session->pending = NULL;
+    my_session->n_queued = 0;
+}
@@ -501,6 +501,36 @@ static inline void monitor_mysql_db(MXS_MONITOR_SERVERS* database, MYSQL_SERVER_
     }
 }
 
+/**
+ * @brief Read the GTID position of a MariaDB server
+ *
+ * The position is used by filters that route reads to servers which
+ * have replicated a specific transaction.
+ *
+ * @param database Monitored server
+ */
+static void update_gtid_pos(MXS_MONITOR_SERVERS *database)
+{
+    MYSQL_RES *result;
+
+    if (mxs_mysql_query(database->con, "SELECT @@gtid_current_pos") == 0
+        && (result = mysql_store_result(database->con)) != NULL)
+    {
+        MYSQL_ROW row = mysql_fetch_row(result);
+
+        if (row && row[0])
+        {
+            server_set_gtid_pos(database->server, row[0]);
+        }
+
+        mysql_free_result(result);
+    }
+    else
+    {
+        mon_report_query_error(database);
+    }
+}
+
 /**
  * Build the replication tree for a MySQL 5.1 cluster
  *
@@ -737,6 +767,7 @@ monitorDatabase(MXS_MONITOR *mon, MXS_MONITOR_SERVERS *database)
     if (server_version >= 100000)
     {
         monitor_mysql_db(database, serv_info, MYSQL_SERVER_VERSION_100);
+        update_gtid_pos(database);
     }
     else if (server_version >= 5 * 10000 + 5 * 100)
     {
@@ -54,7 +54,8 @@ static int httpd_accept(DCB *dcb);
 static int httpd_close(DCB *dcb);
 static int httpd_listen(DCB *dcb, char *config);
 static int httpd_get_line(int sock, char *buf, int size);
-static void httpd_send_headers(DCB *dcb, int final, bool auth_ok);
+static void httpd_send_headers(DCB *dcb, int final, bool auth_ok, const char *content_type);
+static const char* httpd_content_type(const char *url);
 static char *httpd_default_auth();
 
 /**
@@ -257,7 +258,7 @@ static int httpd_read_event(DCB* dcb)
      */
 
     /* send all the basic headers and close with \r\n */
-    httpd_send_headers(dcb, 1, auth_ok);
+    httpd_send_headers(dcb, 1, auth_ok, httpd_content_type(url));
 
 #if 0
     /**
@@ -453,10 +454,27 @@ static int httpd_get_line(int sock, char *buf, int size)
     return i;
 }
 
+/**
+ * Get the content type of the reply to a URL
+ *
+ * @param url The requested URL
+ * @return The content type
+ */
+static const char* httpd_content_type(const char *url)
+{
+    /** The Prometheus text exposition format */
+    if (strcmp(url, "/metrics") == 0)
+    {
+        return "text/plain; version=0.0.4";
+    }
+
+    return "application/json";
+}
+
 /**
  * HTTPD send basic headers with 200 OK
  */
-static void httpd_send_headers(DCB *dcb, int final, bool auth_ok)
+static void httpd_send_headers(DCB *dcb, int final, bool auth_ok, const char *content_type)
 {
     char date[64] = "";
     const char *fmt = "%a, %d %b %Y %H:%M:%S GMT";
@@ -472,8 +490,8 @@ static void httpd_send_headers(DCB *dcb, int final, bool auth_ok)
                "Server: %s\r\n"
                "Connection: close\r\n"
                "WWW-Authenticate: Basic realm=\"MaxInfo\"\r\n"
-               "Content-Type: application/json\r\n",
-               response, date, HTTP_SERVER_STRING);
+               "Content-Type: %s\r\n",
+               response, date, HTTP_SERVER_STRING, content_type);
 
     /* close the headers */
     if (final)
@@ -14,6 +14,7 @@
 #define MXS_MODULE_NAME "MySQLBackend"
 
 #include <maxscale/protocol/mysql.h>
+#include <maxscale/latency.h>
 #include <maxscale/limits.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/modutil.h>
@@ -62,6 +63,7 @@ static int gw_backend_hangup(DCB *dcb);
 static int backend_write_delayqueue(DCB *dcb, GWBUF *buffer);
 static void backend_set_delayqueue(DCB *dcb, GWBUF *queue);
 static int gw_change_user(DCB *backend_dcb, SERVER *server, MXS_SESSION *in_session, GWBUF *queue);
+static int gw_backend_reuse(DCB *dcb);
 static char *gw_backend_default_auth();
 static GWBUF* process_response_data(DCB* dcb, GWBUF** readbuf, int nbytes_to_process);
 extern char* create_auth_failed_msg(GWBUF* readbuf, char* hostaddr, uint8_t* sha1);
@@ -104,7 +106,8 @@ MXS_MODULE* MXS_CREATE_MODULE()
         NULL,                       /* Session                       */
         gw_backend_default_auth,    /* Default authenticator         */
         NULL,                       /* Connection limit reached      */
-        gw_connection_established
+        gw_connection_established,  /* Connection established        */
+        gw_backend_reuse            /* Reuse a pooled connection     */
     };
 
     static MXS_MODULE info =
@@ -361,7 +364,7 @@ static void handle_error_response(DCB *dcb, GWBUF *buffer)
         if (dcb->session->state != SESSION_STATE_DUMMY)
         {
             // Authentication failed, reload users
-            service_refresh_users(dcb->service);
+            service_refresh_users_async(dcb->service);
         }
     }
 }
@@ -512,6 +515,7 @@ gw_read_backend_event(DCB *dcb)
             if (proto->protocol_auth_state == MXS_AUTH_STATE_COMPLETE)
             {
                 /** Authentication completed successfully */
+                proto->compress = mxs_mysql_backend_compression(proto);
                 GWBUF *localq = dcb->delayq;
                 dcb->delayq = NULL;
 
@@ -656,7 +660,7 @@ gw_read_and_write(DCB *dcb)
     CHK_SESSION(session);
 
     /* read available backend data */
-    return_code = dcb_read(dcb, &read_buffer, 0);
+    return_code = mxs_mysql_read(dcb, &read_buffer, 0);
 
     if (return_code < 0)
     {
@@ -871,6 +875,7 @@ gw_read_and_write(DCB *dcb)
         if (session_ok_to_route(dcb))
         {
             gwbuf_set_type(stmt, GWBUF_TYPE_MYSQL);
+            latency_backend_reply(session, dcb->server);
             session->service->router->clientReply(session->service->router_instance,
                                                   session->router_session,
                                                   stmt, dcb);
@@ -948,6 +953,62 @@ static int gw_write_backend_event(DCB *dcb)
     return rc;
 }
 
+/**
+ * Prepare a connection taken from the persistent pool for a new session
+ *
+ * The COM_CHANGE_USER that resets the session state of the connection is sent
+ * right away instead of with the first query of the session. This way the
+ * round trip to the backend overlaps with the client sending its first query
+ * and the query only has to wait for the reply if it arrives before it.
+ *
+ * @param dcb The backend DCB that was taken from the pool
+ * @return 1 if the COM_CHANGE_USER was sent, 0 if the DCB can't be used
+ */
+static int gw_backend_reuse(DCB *dcb)
+{
+    MySQLProtocol *backend_protocol = dcb->protocol;
+
+    CHK_DCB(dcb);
+    ss_dassert(dcb->was_persistent);
+    ss_dassert(!dcb->dcb_fakequeue);
+    ss_dassert(!dcb->dcb_readqueue);
+    ss_dassert(!dcb->delayq);
+    ss_dassert(!dcb->writeq);
+    ss_dassert(dcb->persistentstart == 0);
+    dcb->was_persistent = false;
+    backend_protocol->ignore_reply = false;
+
+    if (dcb->state != DCB_STATE_POLLING ||
+        backend_protocol->protocol_auth_state != MXS_AUTH_STATE_COMPLETE)
+    {
+        MXS_INFO("DCB and protocol state do not qualify for pooling: %s, %s",
+                 STRDCBSTATE(dcb->state),
+                 STRPROTOCOLSTATE(backend_protocol->protocol_auth_state));
+        return 0;
+    }
+
+    if (backend_protocol->stored_query)
+    {
+        /** It is possible that the client DCB is closed before the COM_CHANGE_USER
+         * response is received. */
+        gwbuf_free(backend_protocol->stored_query);
+        backend_protocol->stored_query = NULL;
+    }
+
+    GWBUF *buf = gw_create_change_user_packet(dcb->session->client_dcb->data, backend_protocol);
+
+    if (!mxs_mysql_write(dcb, buf))
+    {
+        /** Don't let the DCB go back to the pool when it is closed */
+        backend_protocol->protocol_auth_state = MXS_AUTH_STATE_FAILED;
+        return 0;
+    }
+
+    MXS_INFO("Sent COM_CHANGE_USER");
+    backend_protocol->ignore_reply = true;
+    return 1;
+}
+
 /*
  * Write function for backend DCB. Store command to protocol.
  *
@@ -962,70 +1023,27 @@ static int gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue)
 
     CHK_DCB(dcb);
 
-    if (dcb->was_persistent)
+    if (dcb->was_persistent && !gw_backend_reuse(dcb))
     {
-        ss_dassert(!dcb->dcb_fakequeue);
-        ss_dassert(!dcb->dcb_readqueue);
-        ss_dassert(!dcb->delayq);
-        ss_dassert(!dcb->writeq);
-        ss_dassert(dcb->persistentstart == 0);
-        dcb->was_persistent = false;
-        backend_protocol->ignore_reply = false;
-
-        if (dcb->state != DCB_STATE_POLLING ||
-            backend_protocol->protocol_auth_state != MXS_AUTH_STATE_COMPLETE)
-        {
-            MXS_INFO("DCB and protocol state do not qualify for pooling: %s, %s",
-                     STRDCBSTATE(dcb->state),
-                     STRPROTOCOLSTATE(backend_protocol->protocol_auth_state));
-            gwbuf_free(queue);
-            return 0;
-        }
-
-
-        /**
-         * This is a DCB that was just taken out of the persistent connection pool.
-         * We need to sent a COM_CHANGE_USER query to the backend to reset the
-         * session state.
-         */
-        if (backend_protocol->stored_query)
-        {
-            /** It is possible that the client DCB is closed before the COM_CHANGE_USER
-             * response is received. */
-            gwbuf_free(backend_protocol->stored_query);
-        }
+        /** The COM_CHANGE_USER is usually sent by dcb_connect() */
+        gwbuf_free(queue);
+        return 0;
+    }
 
-        if (MYSQL_IS_COM_QUIT(GWBUF_DATA(queue)))
+    if (backend_protocol->ignore_reply)
+    {
+        if (MYSQL_IS_COM_QUIT((uint8_t*)GWBUF_DATA(queue)) && backend_protocol->stored_query == NULL)
         {
             /** The connection is being closed before the first write to this
              * backend was done. The COM_QUIT is ignored and the DCB will be put
-             * back into the pool once it's closed. */
-            MXS_INFO("COM_QUIT received as the first write, ignoring and "
-                     "sending the DCB back to the pool.");
+             * back into the pool once it's closed if the COM_CHANGE_USER has
+             * completed by then. */
+            MXS_INFO("COM_QUIT received as the first write, ignoring it so "
+                     "that the DCB can be sent back to the pool.");
             gwbuf_free(queue);
-            return 1;
-        }
-
-        GWBUF *buf = gw_create_change_user_packet(dcb->session->client_dcb->data, dcb->protocol);
-        int rc = 0;
-
-        if (dcb_write(dcb, buf))
-        {
-            MXS_INFO("Sent COM_CHANGE_USER");
-            backend_protocol->ignore_reply = true;
-            backend_protocol->stored_query = queue;
             rc = 1;
         }
-        else
-        {
-            gwbuf_free(queue);
-        }
-
-        return rc;
-    }
-    else if (backend_protocol->ignore_reply)
-    {
-        if (MYSQL_IS_COM_QUIT((uint8_t*)GWBUF_DATA(queue)))
+        else if (MYSQL_IS_COM_QUIT((uint8_t*)GWBUF_DATA(queue)))
         {
             /** The COM_CHANGE_USER was already sent but the session is already
              * closing. */
@@ -1037,10 +1055,11 @@ static int gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue)
         else
         {
             /**
-             * We're still waiting on the reply to the COM_CHANGE_USER, append the
-             * buffer to the stored query. This is possible if the client sends
-             * BLOB data on the first command or is sending multiple COM_QUERY
-             * packets at one time.
+             * We're still waiting on the reply to the COM_CHANGE_USER, store the
+             * buffer until it arrives. This is possible if the client sends its
+             * first command before the backend has replied, if it sends BLOB data
+             * on the first command or if it sends multiple COM_QUERY packets at
+             * one time.
              */
             MXS_INFO("COM_CHANGE_USER in progress, appending query to queue");
             backend_protocol->stored_query = gwbuf_append(backend_protocol->stored_query, queue);
@@ -1116,7 +1135,7 @@ static int gw_MySQLWrite_backend(DCB *dcb, GWBUF *queue)
             else
             {
                 /** Write to backend */
-                rc = dcb_write(dcb, queue);
+                rc = mxs_mysql_write(dcb, queue);
             }
         }
         break;
@@ -1416,12 +1435,12 @@ static void backend_set_delayqueue(DCB *dcb, GWBUF *queue)
 }
 
 /**
- * This routine writes the delayq via dcb_write
+ * This routine writes the delayq via mxs_mysql_write
  * The dcb->delayq contains data received from the client before
  * mysql backend authentication succeded
  *
  * @param dcb The current backend DCB
- * @return The dcb_write status
+ * @return The mxs_mysql_write status
  */
 static int backend_write_delayqueue(DCB *dcb, GWBUF *buffer)
 {
@@ -1448,7 +1467,7 @@ static int backend_write_delayqueue(DCB *dcb, GWBUF *buffer)
     }
     else
     {
-        rc = dcb_write(dcb, buffer);
+        rc = mxs_mysql_write(dcb, buffer);
     }
 
     if (rc == 0)
@@ -1597,20 +1616,9 @@ static int gw_change_user(DCB *backend,
 
     if (auth_ret != 0)
     {
-        if (service_refresh_users(backend->session->client_dcb->service) == 0)
-        {
-            /* Try authentication again with new repository data */
-            /* Note: if no auth client authentication will fail */
-            *current_session->db = 0;
-
-            auth_ret = dcb->authfunc.reauthenticate(dcb, username,
-                                                    auth_token, auth_token_len,
-                                                    client_protocol->scramble,
-                                                    sizeof(client_protocol->scramble),
-                                                    client_sha1, sizeof(client_sha1));
-
-            strcpy(current_session->db, current_database);
-        }
+        /** The users are reloaded in the background, the user is
+         * authenticated against the users that are currently loaded */
+        service_refresh_users_async(backend->session->client_dcb->service);
     }
 
     MXS_FREE(auth_token);
@@ -50,11 +50,13 @@
 
 #include <maxscale/protocol.h>
 #include <maxscale/alloc.h>
+#include <maxscale/latency.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/protocol/mysql.h>
 #include <maxscale/ssl.h>
 #include <maxscale/poll.h>
 #include <maxscale/modinfo.h>
+#include <maxscale/platform.h>
 #include <sys/stat.h>
 #include <maxscale/modutil.h>
 #include <netinet/tcp.h>
@@ -78,6 +80,7 @@ static int gw_client_hangup_event(DCB *dcb);
 static char *gw_default_auth();
 static int gw_connection_limit(DCB *dcb, int limit);
 static int MySQLSendHandshake(DCB* dcb);
+static void free_handshake_templates();
 static int route_by_statement(MXS_SESSION *, uint64_t, GWBUF **);
 static void mysql_client_auth_error_handling(DCB *dcb, int auth_val, int packet_number);
 static int gw_read_do_authentication(DCB *dcb, GWBUF *read_buffer, int nbytes_read);
@@ -188,6 +191,7 @@ static int thread_init(void)
  */
 static void thread_finish(void)
 {
+    free_handshake_templates();
     mysql_thread_end();
 }
 
@@ -201,71 +205,61 @@ static char *gw_default_auth()
     return "MySQLAuth";
 }
 
+/** Number of handshake templates each thread keeps */
+#define HANDSHAKE_TEMPLATES 8
+
+/** Offset of the thread ID from the end of the version string */
+#define HANDSHAKE_THREAD_ID_OFFSET 1
+
+/** Offset of the first part of the scramble from the end of the version string */
+#define HANDSHAKE_SCRAMBLE_OFFSET (HANDSHAKE_THREAD_ID_OFFSET + 4)
+
+/** Offset of the second part of the scramble from the end of the version string */
+#define HANDSHAKE_PLUGIN_DATA_OFFSET (HANDSHAKE_SCRAMBLE_OFFSET + 8 + 1 + 2 + 1 + 2 + 2 + 1 + 10)
+
 /**
- * MySQLSendHandshake
+ * The parts of the handshake that are the same for all clients of a listener.
+ * Only the thread ID and the scramble change from one client to the next.
+ */
+typedef struct handshake_template
+{
+    const SERV_LISTENER *listener;      /**< The listener the template is for */
+    char                *version;       /**< The version string */
+    uint8_t              charset;       /**< The character set of the server */
+    bool                 is_maria;      /**< Whether extended capabilities are sent */
+    bool                 ssl;           /**< Whether SSL is offered */
+    bool                 session_track; /**< Whether session tracking is offered */
+    GWBUF               *packet;        /**< The handshake packet */
+} HANDSHAKE_TEMPLATE;
+
+/** The templates of this thread, replaced in round-robin order */
+static thread_local HANDSHAKE_TEMPLATE handshake_templates[HANDSHAKE_TEMPLATES];
+static thread_local int handshake_next_template = 0;
+
+/**
+ * Create a handshake packet with an empty thread ID and scramble
  *
- * @param dcb The descriptor control block to use for sending the handshake request
- * @return      The packet length sent
+ * @param tmpl The parameters of the handshake
+ * @return The handshake packet or NULL on memory allocation failure
  */
-int MySQLSendHandshake(DCB* dcb)
+static GWBUF* create_handshake_packet(const HANDSHAKE_TEMPLATE *tmpl)
 {
     uint8_t *outbuf = NULL;
     uint32_t mysql_payload_size = 0;
     uint8_t mysql_packet_header[4];
     uint8_t mysql_packet_id = 0;
-    /* uint8_t mysql_filler = GW_MYSQL_HANDSHAKE_FILLER; not needed*/
     uint8_t mysql_protocol_version = GW_MYSQL_PROTOCOL_VERSION;
     uint8_t *mysql_handshake_payload = NULL;
-    uint8_t mysql_thread_id_num[4];
-    uint8_t mysql_scramble_buf[9] = "";
-    uint8_t mysql_plugin_data[13] = "";
     uint8_t mysql_server_capabilities_one[2];
     uint8_t mysql_server_capabilities_two[2];
-    uint8_t mysql_server_language = 8;
+    uint8_t mysql_server_language = tmpl->charset;
     uint8_t mysql_server_status[2];
     uint8_t mysql_scramble_len = 21;
     uint8_t mysql_filler_ten[10] = {};
-    /* uint8_t mysql_last_byte = 0x00; not needed */
-    char server_scramble[GW_MYSQL_SCRAMBLE_SIZE + 1] = "";
-    char *version_string;
-    int len_version_string = 0;
-    int id_num;
-
-    bool is_maria = false;
-
-    if (dcb->service->dbref)
-    {
-        mysql_server_language = dcb->service->dbref->server->charset;
-
-        if (dcb->service->dbref->server->server_string &&
-            strstr(dcb->service->dbref->server->server_string, "10.2."))
-        {
-            /** The backend servers support the extended capabilities */
-            is_maria = true;
-        }
-    }
-
-    MySQLProtocol *protocol = DCB_PROTOCOL(dcb, MySQLProtocol);
+    int len_version_string = strlen(tmpl->version);
     GWBUF *buf;
 
-    /* get the version string from service property if available*/
-    if (dcb->service->version_string != NULL)
-    {
-        version_string = dcb->service->version_string;
-        len_version_string = strlen(version_string);
-    }
-    else
-    {
-        version_string = GW_MYSQL_VERSION;
-        len_version_string = strlen(GW_MYSQL_VERSION);
-    }
-
-    gw_generate_random_str(server_scramble, GW_MYSQL_SCRAMBLE_SIZE);
-
-    // copy back to the caller
-    memcpy(protocol->scramble, server_scramble, GW_MYSQL_SCRAMBLE_SIZE);
-
-    if (is_maria)
+    if (tmpl->is_maria)
     {
         /**
          * The new 10.2 capability flags are stored in the last 4 bytes of the
@@ -275,14 +269,6 @@ int MySQLSendHandshake(DCB* dcb)
         memcpy(mysql_filler_ten + 6, &new_flags, sizeof(new_flags));
     }
 
-    // thread id, now put thePID
-    id_num = getpid() + dcb->fd;
-    gw_mysql_set_byte4(mysql_thread_id_num, id_num);
-
-    memcpy(mysql_scramble_buf, server_scramble, 8);
-
-    memcpy(mysql_plugin_data, server_scramble + 8, 12);
-
     /**
      * Use the default authentication plugin name in the initial handshake. If the
      * authenticator needs to change the authentication method, it should send
@@ -292,7 +278,7 @@ int MySQLSendHandshake(DCB* dcb)
     int plugin_name_len = strlen(plugin_name);
 
     mysql_payload_size =
-        sizeof(mysql_protocol_version) + (len_version_string + 1) + sizeof(mysql_thread_id_num) + 8 +
+        sizeof(mysql_protocol_version) + (len_version_string + 1) + 4 + 8 +
         sizeof(/* mysql_filler */ uint8_t) + sizeof(mysql_server_capabilities_one) + sizeof(mysql_server_language) +
         sizeof(mysql_server_status) + sizeof(mysql_server_capabilities_two) + sizeof(mysql_scramble_len) +
         sizeof(mysql_filler_ten) + 12 + sizeof(/* mysql_last_byte */ uint8_t) + plugin_name_len +
@@ -301,8 +287,7 @@ int MySQLSendHandshake(DCB* dcb)
     // allocate memory for packet header + payload
     if ((buf = gwbuf_alloc(sizeof(mysql_packet_header) + mysql_payload_size)) == NULL)
     {
-        ss_dassert(buf != NULL);
-        return 0;
+        return NULL;
     }
     outbuf = GWBUF_DATA(buf);
 
@@ -321,19 +306,19 @@ int MySQLSendHandshake(DCB* dcb)
     mysql_handshake_payload = mysql_handshake_payload + sizeof(mysql_protocol_version);
 
     // write server version plus 0 filler
-    strcpy((char *)mysql_handshake_payload, version_string);
+    strcpy((char *)mysql_handshake_payload, tmpl->version);
     mysql_handshake_payload = mysql_handshake_payload + len_version_string;
 
     *mysql_handshake_payload = 0x00;
 
     mysql_handshake_payload++;
 
-    // write thread id
-    memcpy(mysql_handshake_payload, mysql_thread_id_num, sizeof(mysql_thread_id_num));
-    mysql_handshake_payload = mysql_handshake_payload + sizeof(mysql_thread_id_num);
+    // thread id, written for each client
+    memset(mysql_handshake_payload, 0, 4);
+    mysql_handshake_payload = mysql_handshake_payload + 4;
 
-    // write scramble buf
-    memcpy(mysql_handshake_payload, mysql_scramble_buf, 8);
+    // scramble buf, written for each client
+    memset(mysql_handshake_payload, 0, 8);
     mysql_handshake_payload = mysql_handshake_payload + 8;
     *mysql_handshake_payload = GW_MYSQL_HANDSHAKE_FILLER;
     mysql_handshake_payload++;
@@ -346,18 +331,21 @@ int MySQLSendHandshake(DCB* dcb)
     ss_dassert(mysql_server_capabilities_one[0] = 0xff);
     ss_dassert(mysql_server_capabilities_one[1] = 0xf7);
 
-    if (is_maria)
+    if (tmpl->is_maria)
     {
         /** A MariaDB 10.2 server doesn't send the CLIENT_MYSQL capability
          * to signal that it supports extended capabilities */
         mysql_server_capabilities_one[0] &= ~(uint8_t)GW_MYSQL_CAPABILITIES_CLIENT_MYSQL;
     }
 
-    if (ssl_required_by_dcb(dcb))
+    if (tmpl->ssl)
     {
         mysql_server_capabilities_one[1] |= (int)GW_MYSQL_CAPABILITIES_SSL >> 8;
     }
 
+    /** The compressed protocol is offered to all clients */
+    mysql_server_capabilities_one[0] |= (uint8_t)GW_MYSQL_CAPABILITIES_COMPRESS;
+
     memcpy(mysql_handshake_payload, mysql_server_capabilities_one, sizeof(mysql_server_capabilities_one));
     mysql_handshake_payload = mysql_handshake_payload + sizeof(mysql_server_capabilities_one);
 
@@ -380,6 +368,12 @@ int MySQLSendHandshake(DCB* dcb)
     /** NOTE: pre-2.1 versions sent the fourth byte of the capabilities as
      the value 128 even though there's no such capability. */
 
+    if (tmpl->session_track)
+    {
+        /** Session state tracking is only offered if a module needs it */
+        mysql_server_capabilities_two[0] |= (uint8_t)(GW_MYSQL_CAPABILITIES_SESSION_TRACK >> 16);
+    }
+
     memcpy(mysql_handshake_payload, mysql_server_capabilities_two, sizeof(mysql_server_capabilities_two));
     mysql_handshake_payload = mysql_handshake_payload + sizeof(mysql_server_capabilities_two);
 
@@ -391,8 +385,8 @@ int MySQLSendHandshake(DCB* dcb)
     memcpy(mysql_handshake_payload, mysql_filler_ten, sizeof(mysql_filler_ten));
     mysql_handshake_payload = mysql_handshake_payload + sizeof(mysql_filler_ten);
 
-    // write plugin data
-    memcpy(mysql_handshake_payload, mysql_plugin_data, 12);
+    // plugin data, the rest of the scramble, written for each client
+    memset(mysql_handshake_payload, 0, 12);
     mysql_handshake_payload = mysql_handshake_payload + 12;
 
     //write last byte, 0
@@ -406,10 +400,137 @@ int MySQLSendHandshake(DCB* dcb)
     //write last byte, 0
     *mysql_handshake_payload = 0x00;
 
+    return buf;
+}
+
+/**
+ * Get the handshake template of a client's listener
+ *
+ * The template is created when the first client of the listener connects to
+ * this thread and it is created again if the values it depends on change.
+ *
+ * @param dcb The client DCB
+ * @return The template or NULL on memory allocation failure
+ */
+static HANDSHAKE_TEMPLATE* get_handshake_template(DCB *dcb)
+{
+    HANDSHAKE_TEMPLATE key = {};
+
+    key.listener = dcb->listener;
+    key.charset = 8;
+    key.ssl = ssl_required_by_dcb(dcb);
+    key.session_track = rcap_type_required(service_get_capabilities(dcb->service),
+                                           RCAP_TYPE_SESSION_TRACKING);
+
+    if (dcb->service->dbref)
+    {
+        key.charset = dcb->service->dbref->server->charset;
+
+        if (dcb->service->dbref->server->server_string &&
+            strstr(dcb->service->dbref->server->server_string, "10.2."))
+        {
+            /** The backend servers support the extended capabilities */
+            key.is_maria = true;
+        }
+    }
+
+    /* get the version string from service property if available*/
+    key.version = dcb->service->version_string ? dcb->service->version_string : GW_MYSQL_VERSION;
+
+    for (int i = 0; i < HANDSHAKE_TEMPLATES; i++)
+    {
+        HANDSHAKE_TEMPLATE *tmpl = &handshake_templates[i];
+
+        if (tmpl->packet && tmpl->listener == key.listener && tmpl->charset == key.charset &&
+            tmpl->is_maria == key.is_maria && tmpl->ssl == key.ssl &&
+            tmpl->session_track == key.session_track && strcmp(tmpl->version, key.version) == 0)
+        {
+            return tmpl;
+        }
+    }
+
+    GWBUF *packet = create_handshake_packet(&key);
+    char *version = MXS_STRDUP(key.version);
+
+    if (packet == NULL || version == NULL)
+    {
+        gwbuf_free(packet);
+        MXS_FREE(version);
+        return NULL;
+    }
+
+    HANDSHAKE_TEMPLATE *tmpl = &handshake_templates[handshake_next_template];
+    handshake_next_template = (handshake_next_template + 1) % HANDSHAKE_TEMPLATES;
+
+    gwbuf_free(tmpl->packet);
+    MXS_FREE(tmpl->version);
+
+    *tmpl = key;
+    tmpl->version = version;
+    tmpl->packet = packet;
+
+    return tmpl;
+}
+
+/**
+ * Free the handshake templates of this thread
+ */
+static void free_handshake_templates()
+{
+    for (int i = 0; i < HANDSHAKE_TEMPLATES; i++)
+    {
+        gwbuf_free(handshake_templates[i].packet);
+        MXS_FREE(handshake_templates[i].version);
+        handshake_templates[i].packet = NULL;
+        handshake_templates[i].version = NULL;
+    }
+}
+
+/**
+ * MySQLSendHandshake
+ *
+ * The handshake is copied from the template of the listener and only the
+ * thread ID and the scramble are written for each client.
+ *
+ * @param dcb The descriptor control block to use for sending the handshake request
+ * @return      The packet length sent
+ */
+int MySQLSendHandshake(DCB* dcb)
+{
+    char server_scramble[GW_MYSQL_SCRAMBLE_SIZE + 1] = "";
+    HANDSHAKE_TEMPLATE *tmpl = get_handshake_template(dcb);
+    GWBUF *buf;
+
+    if (tmpl == NULL || (buf = gwbuf_alloc(GWBUF_LENGTH(tmpl->packet))) == NULL)
+    {
+        return 0;
+    }
+
+    MySQLProtocol *protocol = DCB_PROTOCOL(dcb, MySQLProtocol);
+
+    gw_generate_random_str(server_scramble, GW_MYSQL_SCRAMBLE_SIZE);
+
+    // copy back to the caller
+    memcpy(protocol->scramble, server_scramble, GW_MYSQL_SCRAMBLE_SIZE);
+
+    uint8_t *outbuf = GWBUF_DATA(buf);
+    memcpy(outbuf, GWBUF_DATA(tmpl->packet), GWBUF_LENGTH(tmpl->packet));
+
+    /** The version string starts after the header and the protocol version */
+    uint8_t *version_end = outbuf + MYSQL_HEADER_LEN + 1 + strlen(tmpl->version);
+
+    // thread id, now put thePID
+    gw_mysql_set_byte4(version_end + HANDSHAKE_THREAD_ID_OFFSET, getpid() + dcb->fd);
+
+    memcpy(version_end + HANDSHAKE_SCRAMBLE_OFFSET, server_scramble, 8);
+    memcpy(version_end + HANDSHAKE_PLUGIN_DATA_OFFSET, server_scramble + 8, 12);
+
+    int len = GWBUF_LENGTH(buf);
+
     // writing data in the Client buffer queue
     dcb->func.write(dcb, buf);
 
-    return sizeof(mysql_packet_header) + mysql_payload_size;
+    return len;
 }
 
 /**
@@ -420,7 +541,7 @@ int MySQLSendHandshake(DCB* dcb)
  */
 int gw_MySQLWrite_client(DCB *dcb, GWBUF *queue)
 {
-    return dcb_write(dcb, queue);
+    return mxs_mysql_write(dcb, queue);
 }
 
 /**
@@ -436,6 +557,7 @@ int gw_read_client_event(DCB* dcb)
     int return_code = 0;
     int nbytes_read = 0;
     int max_bytes = 0;
+    uint64_t read_start = latency_now();
 
     CHK_DCB(dcb);
     if (dcb->dcb_role != DCB_ROLE_CLIENT_HANDLER)
@@ -475,7 +597,7 @@ int gw_read_client_event(DCB* dcb)
     {
         max_bytes = 36;
     }
-    return_code = dcb_read(dcb, &read_buffer, max_bytes);
+    return_code = mxs_mysql_read(dcb, &read_buffer, max_bytes);
     if (return_code < 0)
     {
         dcb_close(dcb);
@@ -529,6 +651,7 @@ int gw_read_client_event(DCB* dcb)
      *
      */
     case MXS_AUTH_STATE_COMPLETE:
+        latency_client_read(dcb->session, read_start);
         /* After this call read_buffer will point to freed data */
         return_code = gw_read_normal_data(dcb, read_buffer, nbytes_read);
         break;
@@ -721,6 +844,10 @@ gw_read_do_authentication(DCB *dcb, GWBUF *read_buffer, int nbytes_read)
                        session->state != SESSION_STATE_DUMMY);
             protocol->protocol_auth_state = MXS_AUTH_STATE_COMPLETE;
             mxs_mysql_send_ok(dcb, next_sequence, 0, NULL);
+
+            /** Everything after the OK packet is compressed if the client
+             * requested it */
+            protocol->compress = protocol->client_capabilities & GW_MYSQL_CAPABILITIES_COMPRESS;
         }
         else
         {
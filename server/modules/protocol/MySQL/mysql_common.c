@@ -48,6 +48,7 @@
 #include <maxscale/log_manager.h>
 #include <netinet/tcp.h>
 #include <maxscale/modutil.h>
+#include <zlib.h>
 
 uint8_t null_client_sha1[MYSQL_SCRAMBLE_LEN] = "";
 
@@ -105,6 +106,14 @@ MySQLProtocol* mysql_protocol_init(DCB* dcb, int fd)
     p->stored_query = NULL;
     p->extra_capabilities = 0;
     p->ignore_reply = false;
+    p->compress = false;
+    p->compress_seq = 0;
+    p->compress_readq = NULL;
+    p->compress_header_len = 0;
+    p->compress_packet_left = 0;
+    p->compress_in_command = false;
+    p->compress_load_data = false;
+    p->compress_reply_expected = false;
 #if defined(SS_DEBUG)
     p->protocol_chk_top = CHK_NUM_PROTOCOL;
     p->protocol_chk_tail = CHK_NUM_PROTOCOL;
@@ -146,6 +155,7 @@ void mysql_protocol_done(DCB* dcb)
         }
 
         gwbuf_free(p->stored_query);
+        gwbuf_free(p->compress_readq);
 
         p->protocol_state = MYSQL_PROTOCOL_DONE;
     }
@@ -1255,13 +1265,13 @@ load_hashed_password(uint8_t *scramble, uint8_t *payload, uint8_t *passwd)
  * We start by taking the default bitmask and removing any bits not set in
  * the bitmask contained in the connection structure. Then add SSL flag if
  * the connection requires SSL (set from the MaxScale configuration). The
- * compression flag may be set, although compression is NOT SUPPORTED. If a
+ * compression flag is set if the compressed protocol is to be used. If a
  * database name has been specified in the function call, the relevant flag
  * is set.
  *
  * @param conn  The MySQLProtocol structure for the connection
  * @param db_specified Whether the connection request specified a database
- * @param compress Whether compression is requested - NOT SUPPORTED
+ * @param compress Whether compression is requested
  * @return Bit mask (32 bits)
  * @note Capability bits are defined in maxscale/protocol/mysql.h
  */
@@ -1273,6 +1283,11 @@ create_capabilities(MySQLProtocol *conn, bool db_specified, bool compress)
     /** Copy client's flags to backend but with the known capabilities mask */
     final_capabilities = (conn->client_capabilities & (uint32_t)GW_MYSQL_CAPABILITIES_CLIENT);
 
+    /** Session tracking is only offered to clients when a module requires it
+     * and it is passed on if the server supports it */
+    final_capabilities |= conn->client_capabilities & conn->server_capabilities &
+                          (uint32_t)GW_MYSQL_CAPABILITIES_SESSION_TRACK;
+
     if (conn->owner_dcb->server->server_ssl)
     {
         final_capabilities |= (uint32_t)GW_MYSQL_CAPABILITIES_SSL;
@@ -1281,7 +1296,6 @@ create_capabilities(MySQLProtocol *conn, bool db_specified, bool compress)
         /* final_capabilities |= (uint32_t)GW_MYSQL_CAPABILITIES_SSL_VERIFY_SERVER_CERT; */
     }
 
-    /* Compression is not currently supported */
     if (compress)
     {
         final_capabilities |= (uint32_t)GW_MYSQL_CAPABILITIES_COMPRESS;
@@ -1334,7 +1348,8 @@ mxs_auth_state_t gw_send_backend_auth(DCB *dcb)
     }
 
     MySQLProtocol *conn = (MySQLProtocol*)dcb->protocol;
-    uint32_t capabilities = create_capabilities(conn, (local_session.db && strlen(local_session.db)), false);
+    uint32_t capabilities = create_capabilities(conn, (local_session.db && strlen(local_session.db)),
+                                                mxs_mysql_backend_compression(conn));
     gw_mysql_set_byte4(client_capabilities, capabilities);
 
     /**
@@ -1433,7 +1448,7 @@ int send_mysql_native_password_response(DCB* dcb)
     data[3] = 2; // This is the third packet after the COM_CHANGE_USER
     calculate_hash(proto->scramble, curr_passwd, data + MYSQL_HEADER_LEN);
 
-    return dcb_write(dcb, buffer);
+    return mxs_mysql_write(dcb, buffer);
 }
 
 /**
@@ -1496,6 +1511,7 @@ gw_decode_mysql_server_handshake(MySQLProtocol *conn, uint8_t *payload)
 
     // get capabilities part 2 (2 bytes)
     memcpy(&capab_ptr[2], &mysql_server_capabilities_two, 2);
+    conn->server_capabilities = mysql_server_capabilities_one | ((uint32_t)mysql_server_capabilities_two << 16);
 
     // 2 bytes shift
     payload += 2;
@@ -1597,3 +1613,416 @@ bool mxs_mysql_is_result_set(GWBUF *buffer)
 
     return rval;
 }
+
+/**
+ * Payloads shorter than this are sent uncompressed, compressing them
+ * would only make them longer.
+ */
+#define MYSQL_COMPRESS_MIN_LEN 50
+
+/**
+ * @brief Decompress all complete compressed packets in a buffer
+ *
+ * The compressed packets are inflated into a single buffer which contains
+ * the uncompressed MySQL packets. Any trailing partial compressed packet is
+ * left in @c readbuf.
+ *
+ * The next compressed packet that is written continues the sequence of the
+ * last one that was read. A client starts the sequence from zero for every
+ * command and the reply continues it. When reading from a backend, the first
+ * packet of a reply tells whether the backend expects more data for the
+ * command, which is the case with LOAD DATA LOCAL INFILE and authentication
+ * method switches.
+ *
+ * @param proto   Protocol of the connection
+ * @param backend Whether the data was read from a backend
+ * @param readbuf Buffer containing compressed packets, residue is stored here
+ * @param output  Where the uncompressed data is stored
+ * @return True on success, false if the data could not be decompressed
+ */
+static bool mysql_decompress(MySQLProtocol *proto, bool backend, GWBUF **readbuf, GWBUF **output)
+{
+    size_t total = gwbuf_length(*readbuf);
+    size_t consumed = 0;
+    size_t outlen = 0;
+    uint8_t header[MYSQL_COMPRESSED_HEADER_LEN];
+
+    /** Find out how much data there is in the complete packets */
+    while (consumed + MYSQL_COMPRESSED_HEADER_LEN <= total)
+    {
+        gwbuf_copy_data(*readbuf, consumed, MYSQL_COMPRESSED_HEADER_LEN, header);
+        size_t len = gw_mysql_get_byte3(header);
+        size_t uncompressed = gw_mysql_get_byte3(header + 4);
+
+        if (consumed + MYSQL_COMPRESSED_HEADER_LEN + len > total)
+        {
+            break;
+        }
+
+        outlen += uncompressed ? uncompressed : len;
+        consumed += MYSQL_COMPRESSED_HEADER_LEN + len;
+    }
+
+    if (consumed == 0)
+    {
+        return true;
+    }
+
+    GWBUF *input = gwbuf_make_contiguous(*readbuf);
+
+    if (input == NULL)
+    {
+        return false;
+    }
+
+    *readbuf = input;
+    GWBUF *result = gwbuf_alloc(outlen);
+
+    if (result == NULL)
+    {
+        return false;
+    }
+
+    uint8_t *src = GWBUF_DATA(input);
+    uint8_t *end = src + consumed;
+    uint8_t *dest = GWBUF_DATA(result);
+    bool rval = true;
+
+    while (src < end)
+    {
+        size_t len = gw_mysql_get_byte3(src);
+        size_t uncompressed = gw_mysql_get_byte3(src + 4);
+        proto->compress_seq = src[3] + 1;
+        src += MYSQL_COMPRESSED_HEADER_LEN;
+
+        if (uncompressed == 0)
+        {
+            /** The payload was stored without compression */
+            memcpy(dest, src, len);
+            dest += len;
+        }
+        else
+        {
+            uLongf destlen = uncompressed;
+
+            if (uncompress(dest, &destlen, src, len) != Z_OK || destlen != uncompressed)
+            {
+                MXS_ERROR("Failed to decompress a compressed packet of %lu bytes.", len);
+                rval = false;
+                break;
+            }
+
+            dest += uncompressed;
+        }
+
+        src += len;
+    }
+
+    *readbuf = gwbuf_consume(input, consumed);
+
+    if (rval && backend && proto->compress_reply_expected && outlen > MYSQL_HEADER_LEN)
+    {
+        uint8_t *reply = GWBUF_DATA(result);
+        proto->compress_reply_expected = false;
+
+        if (reply[MYSQL_HEADER_LEN] == MYSQL_REPLY_LOCAL_INFILE)
+        {
+            /** The file contents follow until an empty packet */
+            proto->compress_load_data = true;
+            proto->compress_in_command = true;
+        }
+        else if (reply[MYSQL_HEADER_LEN] == MYSQL_REPLY_AUTHSWITCHREQUEST &&
+                 gw_mysql_get_byte3(reply) + MYSQL_HEADER_LEN > MYSQL_EOF_PACKET_LEN)
+        {
+            /** The authentication response follows */
+            proto->compress_in_command = true;
+        }
+    }
+
+    if (rval)
+    {
+        *output = gwbuf_append(*output, result);
+    }
+    else
+    {
+        gwbuf_free(result);
+    }
+
+    return rval;
+}
+
+/**
+ * @brief Follow the MySQL packets written to a backend
+ *
+ * The packets are followed across writes, so a write can begin or end in
+ * the middle of a packet. A new command starts at a packet boundary unless
+ * the previous packet was a full packet that continues in the next one, the
+ * data is the contents of a file requested with LOAD DATA LOCAL INFILE or
+ * the backend asked for an authentication response.
+ *
+ * @param proto Protocol of the backend connection
+ * @param data  Data being written
+ * @param len   Length of the data
+ *
+ * @return Number of bytes before the next command, @c len if no new command
+ *         starts in the data after its first byte
+ */
+static size_t mysql_track_packets(MySQLProtocol *proto, const uint8_t *data, size_t len)
+{
+    size_t pos = 0;
+
+    while (pos < len)
+    {
+        if (proto->compress_header_len == 0)
+        {
+            if (!proto->compress_in_command)
+            {
+                if (pos > 0)
+                {
+                    /** A new command starts here */
+                    break;
+                }
+
+                proto->compress_in_command = true;
+            }
+        }
+
+        if (proto->compress_header_len < MYSQL_HEADER_LEN)
+        {
+            size_t n = MXS_MIN(MYSQL_HEADER_LEN - proto->compress_header_len, len - pos);
+            memcpy(proto->compress_header + proto->compress_header_len, data + pos, n);
+            proto->compress_header_len += n;
+            pos += n;
+
+            if (proto->compress_header_len < MYSQL_HEADER_LEN)
+            {
+                break;
+            }
+
+            proto->compress_packet_left = gw_mysql_get_byte3(proto->compress_header);
+        }
+
+        size_t n = MXS_MIN(proto->compress_packet_left, len - pos);
+        proto->compress_packet_left -= n;
+        pos += n;
+
+        if (proto->compress_packet_left == 0)
+        {
+            uint32_t payload = gw_mysql_get_byte3(proto->compress_header);
+            proto->compress_header_len = 0;
+
+            if (payload == MYSQL_PACKET_LENGTH_MAX)
+            {
+                /** The payload continues in the next packet */
+            }
+            else if (proto->compress_load_data)
+            {
+                /** An empty packet ends the file */
+                proto->compress_load_data = payload > 0;
+                proto->compress_in_command = payload > 0;
+            }
+            else
+            {
+                proto->compress_in_command = false;
+            }
+        }
+    }
+
+    return pos;
+}
+
+/**
+ * @brief Compress data into compressed packets
+ *
+ * The data is split into compressed packets with at most 16MB of uncompressed
+ * payload. Short payloads and payloads that do not compress are stored as-is.
+ *
+ * @param proto Protocol of the connection
+ * @param src   The data
+ * @param total Length of the data
+ *
+ * @return Buffer with the compressed packets or NULL on memory allocation failure
+ */
+static GWBUF* mysql_compress_data(MySQLProtocol *proto, const uint8_t *src, size_t total)
+{
+    size_t npackets = total / MYSQL_PACKET_LENGTH_MAX + 1;
+    GWBUF *result = gwbuf_alloc(compressBound(total) + npackets * MYSQL_COMPRESSED_HEADER_LEN);
+
+    if (result == NULL)
+    {
+        return NULL;
+    }
+
+    uint8_t *dest = GWBUF_DATA(result);
+    size_t offset = 0;
+
+    do
+    {
+        size_t len = MXS_MIN(total - offset, MYSQL_PACKET_LENGTH_MAX);
+        uint8_t *header = dest;
+        dest += MYSQL_COMPRESSED_HEADER_LEN;
+        uLongf destlen = compressBound(len);
+        bool stored = true;
+
+        if (len >= MYSQL_COMPRESS_MIN_LEN &&
+            compress(dest, &destlen, src + offset, len) == Z_OK && destlen < len)
+        {
+            stored = false;
+        }
+
+        if (stored)
+        {
+            memcpy(dest, src + offset, len);
+            destlen = len;
+        }
+
+        gw_mysql_set_byte3(header, destlen);
+        header[3] = proto->compress_seq++;
+        gw_mysql_set_byte3(header + 4, stored ? 0 : len);
+        dest += destlen;
+        offset += len;
+    }
+    while (offset < total);
+
+    return gwbuf_rtrim(result, GWBUF_LENGTH(result) - (dest - GWBUF_DATA(result)));
+}
+
+/**
+ * @brief Compress a buffer of MySQL packets
+ *
+ * Data written to a client continues the compressed sequence of the command
+ * that was read from it. Data written to a backend starts a new compressed
+ * sequence at every new command, so a write that contains more than one
+ * command is split into separate compressed packets at the command boundaries.
+ *
+ * @param proto   Protocol of the connection
+ * @param backend Whether the data is written to a backend
+ * @param buffer  Buffer with MySQL packets, freed by this function
+ * @return Buffer with the compressed packets or NULL on memory allocation failure
+ */
+static GWBUF* mysql_compress(MySQLProtocol *proto, bool backend, GWBUF *buffer)
+{
+    GWBUF *input = gwbuf_make_contiguous(buffer);
+
+    if (input == NULL)
+    {
+        gwbuf_free(buffer);
+        return NULL;
+    }
+
+    uint8_t *src = GWBUF_DATA(input);
+    size_t total = GWBUF_LENGTH(input);
+    size_t offset = 0;
+    GWBUF *result = NULL;
+
+    do
+    {
+        size_t len = total - offset;
+
+        if (backend)
+        {
+            if (proto->compress_header_len == 0 && !proto->compress_in_command)
+            {
+                /** A new command starts the compressed sequence from zero */
+                proto->compress_seq = 0;
+                proto->compress_reply_expected = true;
+            }
+
+            len = mysql_track_packets(proto, src + offset, len);
+        }
+
+        GWBUF *packets = mysql_compress_data(proto, src + offset, len);
+
+        if (packets == NULL)
+        {
+            gwbuf_free(result);
+            result = NULL;
+            break;
+        }
+
+        result = gwbuf_append(result, packets);
+        offset += len;
+    }
+    while (offset < total);
+
+    gwbuf_free(input);
+    return result;
+}
+
+/**
+ * @brief Read data from a DCB
+ *
+ * If the compressed protocol is in use, the data read from the network is
+ * decompressed. Partial compressed packets are stored in the protocol and the
+ * DCB's readqueue only ever contains uncompressed data.
+ *
+ * @param dcb      DCB to read from
+ * @param head     Pointer to a list of buffers where the data is appended
+ * @param maxbytes Maximum number of bytes to read, 0 for no limit
+ * @return -1 on error, otherwise the number of bytes in @c head
+ */
+int mxs_mysql_read(DCB *dcb, GWBUF **head, int maxbytes)
+{
+    MySQLProtocol *proto = (MySQLProtocol*)dcb->protocol;
+
+    if (!proto->compress)
+    {
+        return dcb_read(dcb, head, maxbytes);
+    }
+
+    /** Already decompressed data that was not yet processed */
+    *head = gwbuf_append(*head, dcb->dcb_readqueue);
+    *head = gwbuf_append(*head, dcb->dcb_fakequeue);
+    dcb->dcb_readqueue = NULL;
+    dcb->dcb_fakequeue = NULL;
+
+    GWBUF *readbuf = proto->compress_readq;
+    proto->compress_readq = NULL;
+
+    int rc = dcb_read(dcb, &readbuf, maxbytes);
+
+    if (readbuf && !mysql_decompress(proto, dcb->dcb_role == DCB_ROLE_BACKEND_HANDLER, &readbuf, head))
+    {
+        rc = -1;
+    }
+
+    proto->compress_readq = readbuf;
+
+    return rc < 0 ? rc : (int)gwbuf_length(*head);
+}
+
+/**
+ * @brief Write data to a DCB
+ *
+ * @param dcb    DCB to write to
+ * @param buffer Buffer with complete MySQL packets
+ * @return 1 on success, 0 on error
+ */
+int mxs_mysql_write(DCB *dcb, GWBUF *buffer)
+{
+    MySQLProtocol *proto = (MySQLProtocol*)dcb->protocol;
+
+    if (proto->compress &&
+        (buffer = mysql_compress(proto, dcb->dcb_role == DCB_ROLE_BACKEND_HANDLER, buffer)) == NULL)
+    {
+        return 0;
+    }
+
+    return dcb_write(dcb, buffer);
+}
+
+/**
+ * @brief Check whether the compressed protocol is used with a backend server
+ *
+ * Compression is used if it is enabled for the server in the configuration
+ * and the server offered it in its handshake. This is negotiated independently
+ * of the client connection.
+ *
+ * @param proto Backend protocol
+ * @return True if the connection is compressed after authentication
+ */
+bool mxs_mysql_backend_compression(MySQLProtocol *proto)
+{
+    return proto->owner_dcb->server->compression &&
+           (proto->server_capabilities & GW_MYSQL_CAPABILITIES_COMPRESS);
+}
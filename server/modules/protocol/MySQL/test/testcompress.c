@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file testcompress.c The sequence numbers of the compressed MySQL protocol
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+
+#include "../mysql_common.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/debug.h>
+
+/** Number of rows in the result set, more than the 256 sequence numbers */
+#define N_ROWS 600
+
+/** Maximum number of compressed packets in one test */
+#define MAX_PACKETS 1024
+
+/**
+ * Create a MySQL packet
+ *
+ * @param seq     Sequence number of the packet
+ * @param payload The payload
+ * @param len     Length of the payload
+ */
+static GWBUF* create_packet(uint8_t seq, const void *payload, size_t len)
+{
+    GWBUF *buf = gwbuf_alloc(MYSQL_HEADER_LEN + len);
+    uint8_t *data = GWBUF_DATA(buf);
+    gw_mysql_set_byte3(data, len);
+    data[3] = seq;
+    memcpy(data + MYSQL_HEADER_LEN, payload, len);
+    return buf;
+}
+
+/**
+ * Read the sequence numbers of compressed packets
+ *
+ * @param buf  Buffer with complete compressed packets
+ * @param seqs The sequence numbers are stored here
+ *
+ * @return Number of compressed packets
+ */
+static int compressed_seqs(GWBUF *buf, uint8_t *seqs)
+{
+    size_t len = gwbuf_length(buf);
+    size_t offset = 0;
+    int n = 0;
+
+    while (offset < len)
+    {
+        uint8_t header[MYSQL_COMPRESSED_HEADER_LEN];
+        gwbuf_copy_data(buf, offset, sizeof(header), header);
+        seqs[n++] = header[3];
+        offset += MYSQL_COMPRESSED_HEADER_LEN + gw_mysql_get_byte3(header);
+    }
+
+    ss_dassert(offset == len);
+    return n;
+}
+
+/**
+ * Decompress the packets read by the peer
+ */
+static GWBUF* peer_read(MySQLProtocol *peer, bool backend, GWBUF *compressed)
+{
+    GWBUF *output = NULL;
+    ss_info_dassert(mysql_decompress(peer, backend, &compressed, &output),
+                    "Decompression should succeed");
+    ss_info_dassert(compressed == NULL, "All compressed packets should be consumed");
+    return output;
+}
+
+/**
+ * test1    A result set of more than 256 packets written to a client
+ */
+static int test1()
+{
+    MySQLProtocol client = {};
+    MySQLProtocol peer = {};
+    uint8_t seqs[MAX_PACKETS];
+    char row[64];
+
+    ss_dfprintf(stderr, "testcompress : result set to a client");
+
+    /** The client starts the compressed sequence of a command from zero */
+    GWBUF *query = create_packet(0, "\x03SELECT * FROM t1", 17);
+    peer.compress_seq = 0;
+    GWBUF *output = peer_read(&client, false, mysql_compress(&peer, false, query));
+    ss_info_dassert(client.compress_seq == 1, "The reply should continue the client's sequence");
+    gwbuf_free(output);
+
+    /** The rows are written in pieces that begin and end in the middle of packets */
+    GWBUF *resultset = NULL;
+
+    for (int i = 0; i < N_ROWS; i++)
+    {
+        int len = snprintf(row, sizeof(row), "row number %d of the result set", i);
+        resultset = gwbuf_append(resultset, create_packet(i + 1, row, len));
+    }
+
+    resultset = gwbuf_make_contiguous(resultset);
+    size_t total = gwbuf_length(resultset);
+    GWBUF *compressed = NULL;
+
+    for (size_t offset = 0; offset < total; offset += 1000)
+    {
+        size_t len = MXS_MIN(1000, total - offset);
+        GWBUF *piece = gwbuf_alloc_and_load(len, GWBUF_DATA(resultset) + offset);
+        compressed = gwbuf_append(compressed, mysql_compress(&client, false, piece));
+    }
+
+    int n = compressed_seqs(compressed, seqs);
+
+    for (int i = 0; i < n; i++)
+    {
+        ss_info_dassert(seqs[i] == (uint8_t)(i + 1), "Compressed sequence should not restart");
+    }
+
+    output = gwbuf_make_contiguous(peer_read(&peer, false, compressed));
+    ss_info_dassert(gwbuf_length(output) == total, "The result set should be intact");
+    ss_info_dassert(memcmp(GWBUF_DATA(output), GWBUF_DATA(resultset), total) == 0,
+                    "The result set should be intact");
+
+    for (size_t offset = 0, i = 0; offset < total; i++)
+    {
+        uint8_t *data = GWBUF_DATA(output) + offset;
+        ss_info_dassert(data[3] == (uint8_t)(i + 1), "Inner sequence numbers should be kept");
+        offset += MYSQL_HEADER_LEN + gw_mysql_get_byte3(data);
+    }
+
+    ss_info_dassert(peer.compress_seq == (uint8_t)(n + 1), "The peer should follow the sequence");
+
+    gwbuf_free(output);
+    gwbuf_free(resultset);
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test2    Commands written to a backend
+ */
+static int test2()
+{
+    MySQLProtocol backend = {};
+    MySQLProtocol server = {};
+    uint8_t seqs[MAX_PACKETS];
+
+    ss_dfprintf(stderr, "testcompress : commands to a backend");
+
+    /** A command starts from zero */
+    GWBUF *compressed = mysql_compress(&backend, true, create_packet(0, "\x03SELECT 1", 9));
+    ss_info_dassert(compressed_seqs(compressed, seqs) == 1 && seqs[0] == 0,
+                    "The first command should start from zero");
+    gwbuf_free(peer_read(&server, false, compressed));
+
+    /** The reply continues the sequence */
+    GWBUF *reply = create_packet(1, "\x00\x00\x00\x02\x00\x00\x00", 7);
+    gwbuf_free(peer_read(&backend, true, mysql_compress(&server, false, reply)));
+    ss_info_dassert(backend.compress_seq == 2, "The reply should set the sequence");
+
+    /** The next command starts from zero even if the reply was not read */
+    compressed = mysql_compress(&backend, true, create_packet(0, "\x03SELECT 2", 9));
+    ss_info_dassert(compressed_seqs(compressed, seqs) == 1 && seqs[0] == 0,
+                    "The second command should start from zero");
+    gwbuf_free(compressed);
+
+    /** Two commands in one write are compressed separately */
+    GWBUF *two = gwbuf_append(create_packet(0, "\x03SELECT 3", 9),
+                              create_packet(0, "\x03SELECT 4", 9));
+    compressed = mysql_compress(&backend, true, two);
+    ss_info_dassert(compressed_seqs(compressed, seqs) == 2 && seqs[0] == 0 && seqs[1] == 0,
+                    "Both commands should start from zero");
+    gwbuf_free(compressed);
+
+    /** A command that is split in the middle of the header continues the sequence */
+    GWBUF *cmd = gwbuf_make_contiguous(create_packet(0, "\x03SELECT 5", 9));
+    compressed = mysql_compress(&backend, true, gwbuf_alloc_and_load(2, GWBUF_DATA(cmd)));
+    ss_info_dassert(compressed_seqs(compressed, seqs) == 1 && seqs[0] == 0,
+                    "The first piece should start from zero");
+    gwbuf_free(compressed);
+    compressed = mysql_compress(&backend, true, gwbuf_alloc_and_load(11, GWBUF_DATA(cmd) + 2));
+    ss_info_dassert(compressed_seqs(compressed, seqs) == 1 && seqs[0] == 1,
+                    "The second piece should continue the sequence");
+    gwbuf_free(compressed);
+    gwbuf_free(cmd);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+/**
+ * test3    LOAD DATA LOCAL INFILE with more than 256 packets of data
+ */
+static int test3()
+{
+    MySQLProtocol backend = {};
+    MySQLProtocol server = {};
+    uint8_t seqs[MAX_PACKETS];
+    char line[64];
+
+    ss_dfprintf(stderr, "testcompress : LOAD DATA LOCAL INFILE to a backend");
+
+    GWBUF *query = create_packet(0, "\x03LOAD DATA LOCAL INFILE 'f' INTO TABLE t1", 41);
+    gwbuf_free(peer_read(&server, false, mysql_compress(&backend, true, query)));
+
+    /** The server asks for the file */
+    GWBUF *request = create_packet(1, "\xfb" "f", 2);
+    gwbuf_free(peer_read(&backend, true, mysql_compress(&server, false, request)));
+    ss_info_dassert(backend.compress_load_data, "The file should be expected");
+
+    /** The file is sent one packet at a time and ends with an empty packet */
+    for (int i = 0; i <= N_ROWS; i++)
+    {
+        int len = i < N_ROWS ? snprintf(line, sizeof(line), "%d,line number %d\n", i, i) : 0;
+        GWBUF *compressed = mysql_compress(&backend, true, create_packet(i + 2, line, len));
+        ss_info_dassert(compressed_seqs(compressed, seqs) == 1 && seqs[0] == (uint8_t)(i + 2),
+                        "The file should continue the sequence");
+        gwbuf_free(compressed);
+    }
+
+    ss_info_dassert(!backend.compress_load_data, "The file should be complete");
+
+    GWBUF *compressed = mysql_compress(&backend, true, create_packet(0, "\x03SELECT 1", 9));
+    ss_info_dassert(compressed_seqs(compressed, seqs) == 1 && seqs[0] == 0,
+                    "The next command should start from zero");
+    gwbuf_free(compressed);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    result += test1();
+    result += test2();
+    result += test3();
+
+    exit(result);
+}
@@ -48,6 +48,7 @@
 #include <maxscale/alloc.h>
 #include <maxscale/modulecmd.h>
 #include <maxscale/paths.h>
+#include <maxscale/prometheus.h>
 #include <maxscale/random_jkiss.h>
 #include <binlog_common.h>
 
@@ -74,6 +75,7 @@ static void closeSession(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_sessio
 static void freeSession(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session);
 static int routeQuery(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session, GWBUF *queue);
 static void diagnostics(MXS_ROUTER *instance, DCB *dcb);
+static void collect_metrics(PROMETHEUS_OUTPUT *out, void *data);
 static void clientReply(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session, GWBUF *queue,
                         DCB *backend_dcb);
 static void errorReply(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session, GWBUF *message,
@@ -193,6 +195,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
 {
     spinlock_init(&instlock);
     instances = NULL;
+    prometheus_add_collector(collect_metrics, NULL);
 
     static modulecmd_arg_type_t args_convert[] =
     {
@@ -349,7 +352,9 @@ static bool conversion_task_ctl(AVRO_INSTANCE *inst, bool start)
         /** Remove old task and create a new one */
         hktask_remove(tasknm);
 
-        if (!start || hktask_add(tasknm, converter_func, inst, inst->task_delay))
+        /** The conversion only touches the instance, so it can run in parallel
+         * with the other housekeeper tasks without delaying them */
+        if (!start || hktask_add_concurrent(tasknm, converter_func, inst, inst->task_delay, 1))
         {
             rval = true;
         }
@@ -899,6 +904,39 @@ spin_reporter(void *dcb, char *desc, int value)
     dcb_printf((DCB *) dcb, "\t\t%-35s  %d\n", desc, value);
 }
 
+/**
+ * Add the statistics of all avrorouter instances to Prometheus output
+ *
+ * The statistics are updated by the conversion task and the client sessions,
+ * they are read without locking.
+ *
+ * @param out   The output
+ * @param data  Not used
+ */
+static void
+collect_metrics(PROMETHEUS_OUTPUT *out, void *data)
+{
+    spinlock_acquire(&instlock);
+
+    for (AVRO_INSTANCE *inst = instances; inst; inst = inst->next)
+    {
+        char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+        prometheus_label(labels, "service", inst->service->name);
+
+        prometheus_sample(out, "maxscale_avro_binlog_events_total", PROMETHEUS_COUNTER,
+                          "Number of binlog events converted", labels, inst->stats.n_binlogs);
+        prometheus_sample(out, "maxscale_avro_rotates_total", PROMETHEUS_COUNTER,
+                          "Number of binlog rotate events", labels, inst->stats.n_rotates);
+        prometheus_sample(out, "maxscale_avro_binlog_position", PROMETHEUS_GAUGE,
+                          "Position in the binlog file being converted", labels,
+                          inst->current_pos);
+        prometheus_sample(out, "maxscale_avro_clients", PROMETHEUS_GAUGE,
+                          "Current number of client sessions", labels, inst->stats.n_clients);
+    }
+
+    spinlock_release(&instlock);
+}
+
 /**
  * Display router diagnostics
  *
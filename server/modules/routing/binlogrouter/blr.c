@@ -77,6 +77,7 @@
 #include <maxscale/dcb.h>
 #include <maxscale/spinlock.h>
 #include <maxscale/housekeeper.h>
+#include <maxscale/prometheus.h>
 #include <time.h>
 
 #include <maxscale/log_manager.h>
@@ -115,6 +116,7 @@ int blr_read_events_all_events(ROUTER_INSTANCE *router, int fix, int debug);
 void blr_master_close(ROUTER_INSTANCE *);
 void blr_free_ssl_data(ROUTER_INSTANCE *inst);
 static void destroyInstance(MXS_ROUTER *instance);
+static void collect_metrics(PROMETHEUS_OUTPUT *out, void *data);
 bool blr_extract_key(const char *linebuf, int nline, ROUTER_INSTANCE *router);
 bool blr_get_encryption_key(ROUTER_INSTANCE *router);
 int blr_parse_key_file(ROUTER_INSTANCE *router);
@@ -151,6 +153,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
     MXS_NOTICE("Initialise binlog router module.");
     spinlock_init(&instlock);
     instances = NULL;
+    prometheus_add_collector(collect_metrics, NULL);
 
     static MXS_ROUTER_OBJECT MyObject =
     {
@@ -199,6 +202,7 @@ MXS_MODULE* MXS_CREATE_MODULE()
             {"shortburst", MXS_MODULE_PARAM_COUNT, DEF_SHORT_BURST},
             {"longburst", MXS_MODULE_PARAM_COUNT, DEF_LONG_BURST},
             {"burstsize", MXS_MODULE_PARAM_SIZE, DEF_BURST_SIZE},
+            {"event_cache_size", MXS_MODULE_PARAM_SIZE, DEF_EVENT_CACHE_SIZE},
             {"heartbeat", MXS_MODULE_PARAM_COUNT, BLR_HEARTBEAT_DEFAULT_INTERVAL},
             {"send_slave_heartbeat", MXS_MODULE_PARAM_BOOL, "false"},
             {"binlogdir", MXS_MODULE_PARAM_PATH, NULL, MXS_MODULE_OPT_PATH_W_OK},
@@ -322,6 +326,7 @@ createInstance(SERVICE *service, char **options)
     inst->short_burst = config_get_integer(params, "shortburst");
     inst->long_burst = config_get_integer(params, "longburst");
     inst->burst_size = config_get_size(params, "burstsize");
+    inst->cache_size = config_get_size(params, "event_cache_size");
     inst->binlogdir = config_copy_string(params, "binlogdir");
     inst->heartbeat = config_get_integer(params, "heartbeat");
     inst->ssl_cert_verification_depth = config_get_integer(params, "ssl_cert_verification_depth");
@@ -1248,6 +1253,54 @@ spin_reporter(void *dcb, char *desc, int value)
 }
 #endif
 
+/**
+ * Add the statistics of all binlog router instances to Prometheus output
+ *
+ * The statistics are updated by the thread handling the master connection
+ * and the slave sessions, they are read without locking.
+ *
+ * @param out   The output
+ * @param data  Not used
+ */
+static void
+collect_metrics(PROMETHEUS_OUTPUT *out, void *data)
+{
+    spinlock_acquire(&instlock);
+
+    for (ROUTER_INSTANCE *inst = instances; inst; inst = inst->next)
+    {
+        char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+        prometheus_label(labels, "service", inst->service->name);
+
+        prometheus_sample(out, "maxscale_binlog_events_total", PROMETHEUS_COUNTER,
+                          "Number of binlog events received from the master", labels,
+                          inst->stats.n_binlogs);
+        prometheus_sample(out, "maxscale_binlog_event_errors_total", PROMETHEUS_COUNTER,
+                          "Number of binlog events that could not be handled", labels,
+                          inst->stats.n_binlog_errors);
+        prometheus_sample(out, "maxscale_binlog_rotates_total", PROMETHEUS_COUNTER,
+                          "Number of binlog rotate events", labels, inst->stats.n_rotates);
+        prometheus_sample(out, "maxscale_binlog_bad_crc_total", PROMETHEUS_COUNTER,
+                          "Number of binlog events with a bad CRC", labels, inst->stats.n_badcrc);
+        prometheus_sample(out, "maxscale_binlog_master_reconnects_total", PROMETHEUS_COUNTER,
+                          "Number of times the master connection was started", labels,
+                          inst->stats.n_masterstarts);
+        prometheus_sample(out, "maxscale_binlog_cache_hits_total", PROMETHEUS_COUNTER,
+                          "Number of binlog records read from the cache", labels,
+                          inst->stats.n_cachehits);
+        prometheus_sample(out, "maxscale_binlog_cache_misses_total", PROMETHEUS_COUNTER,
+                          "Number of binlog records read from a file", labels,
+                          inst->stats.n_cachemisses);
+        prometheus_sample(out, "maxscale_binlog_slaves", PROMETHEUS_GAUGE,
+                          "Number of registered slaves", labels, inst->stats.n_registered);
+        prometheus_sample(out, "maxscale_binlog_master_connected", PROMETHEUS_GAUGE,
+                          "Whether binlog events are being received from the master", labels,
+                          inst->master_state == BLRM_BINLOGDUMP ? 1 : 0);
+    }
+
+    spinlock_release(&instlock);
+}
+
 /**
  * Display router diagnostics
  *
@@ -1401,6 +1454,17 @@ diagnostics(MXS_ROUTER *router, DCB *dcb)
                router_inst->stats.n_reads);
     dcb_printf(dcb, "\tNumber of residual data packets:             %u\n",
                router_inst->stats.n_residuals);
+    if (router_inst->cache)
+    {
+        spinlock_acquire(&router_inst->cache->lock);
+        dcb_printf(dcb, "\tEvents in the event cache:                   %d (%lu bytes)\n",
+                   router_inst->cache->cnt, router_inst->cache->bytes);
+        spinlock_release(&router_inst->cache->lock);
+        dcb_printf(dcb, "\tEvents read from the event cache:            %lu\n",
+                   router_inst->stats.n_cachehits);
+        dcb_printf(dcb, "\tEvents read from binlog files:               %lu\n",
+                   router_inst->stats.n_cachemisses);
+    }
     dcb_printf(dcb, "\tAverage events per packet:                   %.1f\n",
                router_inst->stats.n_reads != 0 ?
                ((double)router_inst->stats.n_binlogs / router_inst->stats.n_reads) : 0);
@@ -1619,6 +1683,10 @@ diagnostics(MXS_ROUTER *router, DCB *dcb)
                        session->stats.n_dcb);
             dcb_printf(dcb, "\t\tNo. of failed reads                      %u\n",
                        session->stats.n_failed_read);
+            dcb_printf(dcb, "\t\tNo. of events read from the cache        %lu\n",
+                       session->stats.n_cache_reads);
+            dcb_printf(dcb, "\t\tNo. of events read from binlog files     %lu\n",
+                       session->stats.n_file_reads);
 
 #ifdef DETAILED_DIAG
             dcb_printf(dcb, "\t\tNo. of nested distribute events          %u\n",
@@ -50,7 +50,7 @@
 #include <stdint.h>
 #include <openssl/aes.h>
 #include <pthread.h>
-#include <zlib.h>
+#include <maxscale/crc32.h>
 
 #include <maxscale/dcb.h>
 #include <maxscale/buffer.h>
@@ -197,6 +197,7 @@ enum blr_aes_mode
 #define DEF_SHORT_BURST         "15"
 #define DEF_LONG_BURST          "500"
 #define DEF_BURST_SIZE          "1024000" /* 1 Mb */
+#define DEF_EVENT_CACHE_SIZE    "8388608" /* 8 MiB */
 
 /**
  * master reconnect backoff constants
@@ -323,25 +324,30 @@ typedef struct rep_header
 } REP_HEADER;
 
 /**
- * The binlog record structure. This contains the actual packet read from the binlog
- * file.
+ * The binlog record structure. This contains an event that was written to a
+ * binlog file.
  */
 typedef struct
 {
+    char            *binlogname;    /*< binlog file, shared by the entries of the file */
     unsigned long   position;       /*< binlog record position for this cache entry */
-    GWBUF           *pkt;           /*< The packet received from the master */
+    GWBUF           *pkt;           /*< The event received from the master */
     REP_HEADER      hdr;            /*< The packet header */
 } BLCACHE_RECORD;
 
 /**
- * The binlog cache. A cache exists for each file that hold cached bin log records.
- * Caches will be used for all files being read by more than 1 slave.
+ * The binlog cache. A ring of the latest events written to the binlog files,
+ * ordered by binlog file and position. The slaves that are up to date read
+ * the events from the cache and share the buffers.
  */
 typedef struct
 {
-    BLCACHE_RECORD  **records;      /*< The actual binlog records */
-    int             current;        /*< The next record that will be inserted */
+    BLCACHE_RECORD  *records;       /*< The actual binlog records */
+    int             size;           /*< The number of slots in records */
+    int             first;          /*< The oldest record */
     int             cnt;            /*< The number of records in the cache */
+    unsigned long   bytes;          /*< The size of the events in the cache */
+    unsigned long   max_bytes;      /*< The maximum size of the events */
     SPINLOCK        lock;           /*< The spinlock for the cache */
 } BLCACHE;
 
@@ -374,6 +380,8 @@ typedef struct
     int             n_failed_read;
     int             n_overrun;
     int             n_caughtup;
+    uint64_t        n_cache_reads;  /*< Number of events read from the event cache */
+    uint64_t        n_file_reads;   /*< Number of events read from binlog files */
     int             n_actions[3];
     uint64_t        lastsample;
     int             minno;
@@ -567,6 +575,8 @@ typedef struct router_instance
     unsigned int      short_burst;  /*< Short burst for slave catchup */
     unsigned int      long_burst;   /*< Long burst for slave catchup */
     unsigned long     burst_size;   /*< Maximum size of burst to send */
+    unsigned long     cache_size;   /*< Maximum size of the cached events */
+    BLCACHE           *cache;       /*< The latest events */
     unsigned long     heartbeat;    /*< Configured heartbeat value */
     ROUTER_STATS      stats;        /*< Statistics for this router */
     int               active_logs;
@@ -754,6 +764,10 @@ extern int blr_slave_request(ROUTER_INSTANCE *, ROUTER_SLAVE *, GWBUF *);
 extern void blr_slave_rotate(ROUTER_INSTANCE *, ROUTER_SLAVE *, uint8_t *);
 extern int blr_slave_catchup(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, bool large);
 extern void blr_init_cache(ROUTER_INSTANCE *);
+extern void blr_cache_add(ROUTER_INSTANCE *, const char *, unsigned long, REP_HEADER *, uint8_t *,
+                          uint32_t);
+extern GWBUF *blr_cache_get(ROUTER_INSTANCE *, const char *, unsigned long, REP_HEADER *);
+extern void blr_cache_binlog_changed(ROUTER_INSTANCE *, const char *);
 
 extern int  blr_file_init(ROUTER_INSTANCE *);
 extern int  blr_write_binlog_record(ROUTER_INSTANCE *, REP_HEADER *, uint32_t pos, uint8_t *);
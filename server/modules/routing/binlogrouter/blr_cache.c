@@ -46,16 +46,293 @@
 #include <maxscale/spinlock.h>
 
 #include <maxscale/log_manager.h>
+#include <maxscale/alloc.h>
 
 
+/** Number of records the cache starts with, it grows as needed */
+#define BLR_CACHE_INITIAL_RECORDS 1024
+
+static int blr_cache_cmp(const char *binlog1, unsigned long pos1,
+                         const char *binlog2, unsigned long pos2);
+static BLCACHE_RECORD *blr_cache_record(BLCACHE *cache, int i);
+static void blr_cache_evict(BLCACHE *cache);
+static void blr_cache_empty(BLCACHE *cache);
+static bool blr_cache_grow(BLCACHE *cache);
+
 /**
- * Initialise the cache for this instanceof the binlog router. As a side
- * effect also determine the binlog file to read and the position to read
- * from.
+ * Initialise the cache for this instance of the binlog router. The cache holds
+ * the latest events written to the binlog files, up to router->cache_size
+ * bytes. A size of zero disables the cache.
  *
  * @param   router      The router instance
  */
 void
 blr_init_cache(ROUTER_INSTANCE *router)
 {
+    if (router->cache_size == 0)
+    {
+        return;
+    }
+
+    BLCACHE *cache = MXS_CALLOC(1, sizeof(BLCACHE));
+    BLCACHE_RECORD *records = MXS_CALLOC(BLR_CACHE_INITIAL_RECORDS, sizeof(BLCACHE_RECORD));
+
+    if (cache && records)
+    {
+        cache->records = records;
+        cache->size = BLR_CACHE_INITIAL_RECORDS;
+        cache->max_bytes = router->cache_size;
+        spinlock_init(&cache->lock);
+        router->cache = cache;
+    }
+    else
+    {
+        MXS_ERROR("%s: Failed to allocate the binlog event cache, slaves will "
+                  "read all events from the binlog files.", router->service->name);
+        MXS_FREE(cache);
+        MXS_FREE(records);
+    }
+}
+
+/**
+ * Add an event that was written to a binlog file to the cache. The oldest
+ * events are removed to make room for it. Events larger than the cache are
+ * not added and are read from the file.
+ *
+ * @param   router      The router instance
+ * @param   binlog      The binlog file the event was written to
+ * @param   pos         The position of the event in the file
+ * @param   hdr         The header of the event
+ * @param   buf         The event
+ * @param   size        The size of the event
+ */
+void
+blr_cache_add(ROUTER_INSTANCE *router, const char *binlog, unsigned long pos,
+              REP_HEADER *hdr, uint8_t *buf, uint32_t size)
+{
+    BLCACHE *cache = router->cache;
+    GWBUF *pkt;
+
+    if (cache == NULL || size != hdr->event_size || size > cache->max_bytes ||
+        (pkt = gwbuf_alloc_and_load(hdr->event_size, buf)) == NULL)
+    {
+        return;
+    }
+
+    spinlock_acquire(&cache->lock);
+
+    char *name = NULL;
+
+    if (cache->cnt > 0)
+    {
+        BLCACHE_RECORD *last = blr_cache_record(cache, cache->cnt - 1);
+
+        if (blr_cache_cmp(binlog, pos, last->binlogname, last->position) <= 0)
+        {
+            /** The binlog files have been rewritten */
+            blr_cache_empty(cache);
+        }
+        else if (strcmp(binlog, last->binlogname) == 0)
+        {
+            name = last->binlogname;
+        }
+    }
+
+    while (cache->cnt > 0 && cache->bytes + hdr->event_size > cache->max_bytes)
+    {
+        blr_cache_evict(cache);
+    }
+
+    if (cache->cnt == cache->size && !blr_cache_grow(cache))
+    {
+        blr_cache_evict(cache);
+    }
+
+    if (cache->cnt == 0 || name == NULL)
+    {
+        /** The evicted records may have shared the name */
+        name = MXS_STRDUP(binlog);
+    }
+
+    if (name)
+    {
+        BLCACHE_RECORD *record = blr_cache_record(cache, cache->cnt);
+        record->binlogname = name;
+        record->position = pos;
+        record->pkt = pkt;
+        record->hdr = *hdr;
+        cache->bytes += hdr->event_size;
+        cache->cnt++;
+        pkt = NULL;
+    }
+
+    spinlock_release(&cache->lock);
+
+    gwbuf_free(pkt);
+}
+
+/**
+ * Get an event from the cache. Events in the current binlog file are only
+ * returned up to the last committed transaction, as blr_read_binlog() does.
+ *
+ * @param   router      The router instance
+ * @param   binlog      The binlog file to read
+ * @param   pos         The position of the event
+ * @param   hdr         The header to populate
+ * @return              The event, shared with the cache, or NULL if the event
+ *                      is not in the cache
+ */
+GWBUF *
+blr_cache_get(ROUTER_INSTANCE *router, const char *binlog, unsigned long pos, REP_HEADER *hdr)
+{
+    BLCACHE *cache = router->cache;
+    GWBUF *rval = NULL;
+
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    spinlock_acquire(&router->binlog_lock);
+    bool unsafe = strcmp(router->binlog_name, binlog) == 0 && pos >= router->binlog_position;
+    spinlock_release(&router->binlog_lock);
+
+    if (unsafe)
+    {
+        return NULL;
+    }
+
+    spinlock_acquire(&cache->lock);
+
+    int low = 0;
+    int high = cache->cnt - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        BLCACHE_RECORD *record = blr_cache_record(cache, mid);
+        int cmp = blr_cache_cmp(binlog, pos, record->binlogname, record->position);
+
+        if (cmp == 0)
+        {
+            rval = gwbuf_clone(record->pkt);
+            *hdr = record->hdr;
+            hdr->ok = SLAVE_POS_READ_OK;
+            break;
+        }
+        else if (cmp < 0)
+        {
+            high = mid - 1;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    spinlock_release(&cache->lock);
+
+    return rval;
+}
+
+/**
+ * Called when the router starts writing to a binlog file. If the file does
+ * not come after the files in the cache, the binlog files are being rewritten
+ * and the cached events are discarded.
+ *
+ * @param   router      The router instance
+ * @param   binlog      The binlog file the router writes to
+ */
+void
+blr_cache_binlog_changed(ROUTER_INSTANCE *router, const char *binlog)
+{
+    BLCACHE *cache = router->cache;
+
+    if (cache)
+    {
+        spinlock_acquire(&cache->lock);
+
+        if (cache->cnt > 0 &&
+            strcmp(binlog, blr_cache_record(cache, cache->cnt - 1)->binlogname) <= 0)
+        {
+            blr_cache_empty(cache);
+        }
+
+        spinlock_release(&cache->lock);
+    }
+}
+
+/**
+ * Compare the positions of two events. The binlog files are ordered by name.
+ */
+static int
+blr_cache_cmp(const char *binlog1, unsigned long pos1, const char *binlog2, unsigned long pos2)
+{
+    int rval = strcmp(binlog1, binlog2);
+
+    if (rval == 0)
+    {
+        rval = pos1 < pos2 ? -1 : (pos1 > pos2 ? 1 : 0);
+    }
+
+    return rval;
+}
+
+/** Get the record at an offset from the oldest one */
+static BLCACHE_RECORD *
+blr_cache_record(BLCACHE *cache, int i)
+{
+    return &cache->records[(cache->first + i) % cache->size];
+}
+
+/** Remove the oldest record, the cache lock must be held */
+static void
+blr_cache_evict(BLCACHE *cache)
+{
+    BLCACHE_RECORD *record = blr_cache_record(cache, 0);
+
+    if (cache->cnt == 1 || blr_cache_record(cache, 1)->binlogname != record->binlogname)
+    {
+        MXS_FREE(record->binlogname);
+    }
+
+    cache->bytes -= record->hdr.event_size;
+    gwbuf_free(record->pkt);
+    memset(record, 0, sizeof(*record));
+    cache->first = (cache->first + 1) % cache->size;
+    cache->cnt--;
+}
+
+/** Remove all records, the cache lock must be held */
+static void
+blr_cache_empty(BLCACHE *cache)
+{
+    while (cache->cnt > 0)
+    {
+        blr_cache_evict(cache);
+    }
+}
+
+/** Double the number of records the cache can hold, the cache lock must be held */
+static bool
+blr_cache_grow(BLCACHE *cache)
+{
+    BLCACHE_RECORD *records = MXS_CALLOC(cache->size * 2, sizeof(BLCACHE_RECORD));
+
+    if (records == NULL)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < cache->cnt; i++)
+    {
+        records[i] = *blr_cache_record(cache, i);
+    }
+
+    MXS_FREE(cache->records);
+    cache->records = records;
+    cache->first = 0;
+    cache->size *= 2;
+
+    return true;
 }
@@ -426,6 +426,7 @@ blr_file_create(ROUTER_INSTANCE *router, char *file)
             char new_binlog[strlen(file) + 1];
             strcpy(new_binlog, file);
             strcpy(router->binlog_name, new_binlog);
+            blr_cache_binlog_changed(router, new_binlog);
 
             router->binlog_fd = fd;
             router->current_pos = BINLOG_MAGIC_SIZE;     /* Initial position after the magic number */
@@ -484,6 +485,7 @@ blr_file_append(ROUTER_INSTANCE *router, char *file)
     close(router->binlog_fd);
     spinlock_acquire(&router->binlog_lock);
     memmove(router->binlog_name, file, BINLOG_FNAMELEN);
+    blr_cache_binlog_changed(router, router->binlog_name);
     router->current_pos = lseek(fd, 0L, SEEK_END);
     if (router->current_pos < 4)
     {
@@ -553,6 +555,9 @@ blr_write_binlog_record(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint32_t size,
         n = hole_size;
     }
 
+    /* The position of the event in the file */
+    uint64_t event_pos = router->last_written;
+
     if (router->encryption.enabled && router->encryption_ctx != NULL)
     {
         GWBUF *encrypted;
@@ -607,6 +612,9 @@ blr_write_binlog_record(ROUTER_INSTANCE *router, REP_HEADER *hdr, uint32_t size,
     router->last_event_pos = hdr->next_pos - hdr->event_size;
     spinlock_release(&router->binlog_lock);
 
+    /* Keep the event in memory for the slaves that are up to date */
+    blr_cache_add(router, router->binlog_name, event_pos, hdr, buf, size);
+
     /* Check whether adding the Start Encryption event into current binlog */
     if (router->encryption.enabled && write_start_encryption_event)
     {
@@ -2559,8 +2567,7 @@ blr_create_ignorable_event(uint32_t event_size,
          * and then the checksum of the real event: 4 byte less than event_size
          */
         uint32_t chksum;
-        chksum = crc32(0L, NULL, 0);
-        chksum = crc32(chksum, new_event, event_size - BINLOG_EVENT_CRC_SIZE);
+        chksum = mxs_crc32(0, new_event, event_size - BINLOG_EVENT_CRC_SIZE);
 
         // checksum is stored after current event data using 4 bytes
         encode_value(new_event + event_size - BINLOG_EVENT_CRC_SIZE, chksum, 32);
@@ -2758,8 +2765,7 @@ blr_create_start_encryption_event(ROUTER_INSTANCE *router, uint32_t event_pos, b
          * and then the checksum of the event.
          */
         uint32_t chksum;
-        chksum = crc32(0L, NULL, 0);
-        chksum = crc32(chksum, new_event, event_size - BINLOG_EVENT_CRC_SIZE);
+        chksum = mxs_crc32(0, new_event, event_size - BINLOG_EVENT_CRC_SIZE);
 
         // checksum is stored at the end of current event data: 4 less bytes than event size
         encode_value(new_event + event_size - BINLOG_EVENT_CRC_SIZE, chksum, 32);
@@ -1017,7 +1017,7 @@ static bool verify_checksum(ROUTER_INSTANCE *router, size_t len, uint8_t *ptr)
     uint32_t offset = MYSQL_HEADER_LEN + 1;
     uint32_t size = len - (offset + MYSQL_CHECKSUM_LEN);
 
-    uint32_t checksum = crc32(0L, ptr + offset, size);
+    uint32_t checksum = mxs_crc32(0, ptr + offset, size);
     uint32_t pktsum = EXTRACT32(ptr + offset + size);
 
     if (pktsum != checksum)
@@ -85,7 +85,6 @@
 #include <sys/stat.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/version.h>
-#include <zlib.h>
 #include <maxscale/alloc.h>
 
 static char* get_next_token(char *str, const char* delim, char **saveptr);
@@ -108,6 +107,8 @@ int blr_slave_catchup(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, bool large);
 uint8_t *blr_build_header(GWBUF *pkt, REP_HEADER *hdr);
 int blr_slave_callback(DCB *dcb, DCB_REASON reason, void *data);
 static int blr_slave_fake_rotate(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, BLFILE** filep);
+static GWBUF *blr_slave_read_event(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, BLFILE *file,
+                                   REP_HEADER *hdr, char *errmsg);
 static uint32_t blr_slave_send_fde(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, GWBUF *fde);
 static int blr_slave_send_maxscale_version(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave);
 static int blr_slave_send_server_id(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave);
@@ -2138,8 +2139,7 @@ blr_slave_binlog_dump(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, GWBUF *queue
          * include the length, sequence number and ok byte that makes up the first
          * 5 bytes of the message. We also do not include the 4 byte checksum itself.
          */
-        chksum = crc32(0L, NULL, 0);
-        chksum = crc32(chksum, GWBUF_DATA(resp) + 5, hdr.event_size - 4);
+        chksum = mxs_crc32(0, GWBUF_DATA(resp) + 5, hdr.event_size - 4);
         encode_value(ptr, chksum, 32);
     }
 
@@ -2386,7 +2386,7 @@ blr_slave_catchup(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, bool large)
     int events_before = slave->stats.n_events;
 
     while (burst-- && burst_size > 0 &&
-           (record = blr_read_binlog(router, file, slave->binlog_pos, &hdr, read_errmsg, slave->encryption_ctx)) != NULL)
+           (record = blr_slave_read_event(router, slave, file, &hdr, read_errmsg)) != NULL)
     {
         char binlog_name[BINLOG_FNAMELEN + 1];
         uint32_t binlog_pos;
@@ -2755,6 +2755,42 @@ blr_slave_catchup(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, bool large)
     return rval;
 }
 
+/**
+ * Read the next event for a slave. The event is taken from the cache of the
+ * latest events if it is there, otherwise it is read from the binlog file.
+ *
+ * @param router    The binlog router
+ * @param slave     The slave
+ * @param file      The binlog file the slave is reading
+ * @param hdr       Binlog header to populate
+ * @param errmsg    Allocated BINLOG_ERROR_MSG_LEN bytes message error buffer
+ * @return          The event or NULL if there is no event to send
+ */
+static GWBUF *
+blr_slave_read_event(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, BLFILE *file,
+                     REP_HEADER *hdr, char *errmsg)
+{
+    GWBUF *record = blr_cache_get(router, slave->binlogfile, slave->binlog_pos, hdr);
+
+    if (record)
+    {
+        slave->stats.n_cache_reads++;
+        atomic_add_uint64(&router->stats.n_cachehits, 1);
+    }
+    else if ((record = blr_read_binlog(router, file, slave->binlog_pos, hdr, errmsg,
+                                       slave->encryption_ctx)) != NULL)
+    {
+        slave->stats.n_file_reads++;
+
+        if (router->cache)
+        {
+            atomic_add_uint64(&router->stats.n_cachemisses, 1);
+        }
+    }
+
+    return record;
+}
+
 /**
  * The DCB callback used by the slave to obtain DCB_REASON_LOW_WATER callbacks
  * when the server sends all the the queue data for a DCB. This is the mechanism
@@ -2915,8 +2951,7 @@ blr_slave_fake_rotate(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, BLFILE** fil
          * include the length, sequence number and ok byte that makes up the first
          * 5 bytes of the message. We also do not include the 4 byte checksum itself.
          */
-        chksum = crc32(0L, NULL, 0);
-        chksum = crc32(chksum, GWBUF_DATA(resp) + 5, hdr.event_size - 4);
+        chksum = mxs_crc32(0, GWBUF_DATA(resp) + 5, hdr.event_size - 4);
         encode_value(ptr, chksum, 32);
     }
 
@@ -3019,8 +3054,7 @@ blr_slave_send_fde(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave, GWBUF *fde)
      * and write it into the header
      */
     ptr = GWBUF_DATA(fde) + event_size - BINLOG_EVENT_CRC_SIZE;
-    chksum = crc32(0L, NULL, 0);
-    chksum = crc32(chksum, GWBUF_DATA(fde), event_size - BINLOG_EVENT_CRC_SIZE);
+    chksum = mxs_crc32(0, GWBUF_DATA(fde), event_size - BINLOG_EVENT_CRC_SIZE);
     encode_value(ptr, chksum, 32);
 
     return slave->dcb->func.write(slave->dcb, head);
@@ -5697,8 +5731,7 @@ blr_slave_send_heartbeat(ROUTER_INSTANCE *router, ROUTER_SLAVE *slave)
     /* Add the CRC32 */
     if (!slave->nocrc)
     {
-        chksum = crc32(0L, NULL, 0);
-        chksum = crc32(chksum, GWBUF_DATA(resp) + 5, hdr.event_size - 4);
+        chksum = mxs_crc32(0, GWBUF_DATA(resp) + 5, hdr.event_size - 4);
         encode_value(ptr, chksum, 32);
     }
 
@@ -700,6 +700,119 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    tests++;
+
+    /********************************************
+     *
+     * Second test suite is about the event cache
+     *
+     ********************************************/
+
+    printf("--------- Event cache tests ---------\n");
+
+    uint8_t event[100];
+    REP_HEADER hdr;
+    GWBUF *record;
+
+    memset(event, 0, sizeof(event));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.event_size = sizeof(event);
+    strcpy(inst->binlog_name, "file.000001");
+    inst->binlog_position = 1000;
+    inst->cache_size = 3 * sizeof(event);
+    blr_init_cache(inst);
+
+    for (int pos = 4; pos < 304; pos += sizeof(event))
+    {
+        event[0] = pos;
+        hdr.next_pos = pos + sizeof(event);
+        blr_cache_add(inst, inst->binlog_name, pos, &hdr, event, sizeof(event));
+    }
+
+    /**
+     * Test 24: read a cached event
+     *
+     * Expected the event at the position
+     */
+    memset(&hdr, 0, sizeof(hdr));
+    record = blr_cache_get(inst, "file.000001", 104, &hdr);
+
+    if (record && GWBUF_LENGTH(record) == sizeof(event) && GWBUF_DATA(record)[0] == 104 &&
+        hdr.event_size == sizeof(event) && hdr.next_pos == 204)
+    {
+        printf("Test %d PASSED, event read from the cache\n", tests);
+    }
+    else
+    {
+        printf("Test %d: reading an event from the cache FAILED\n", tests);
+        return 1;
+    }
+
+    gwbuf_free(record);
+    tests++;
+
+    /**
+     * Test 25: adding an event to a full cache removes the oldest one
+     *
+     * Expected the first event to be missing and the new one to be found
+     */
+    event[0] = 48;
+    hdr.next_pos = 404;
+    blr_cache_add(inst, inst->binlog_name, 304, &hdr, event, sizeof(event));
+
+    if (blr_cache_get(inst, "file.000001", 4, &hdr) == NULL &&
+        (record = blr_cache_get(inst, "file.000001", 304, &hdr)) != NULL &&
+        GWBUF_DATA(record)[0] == 48 && inst->cache->cnt == 3)
+    {
+        printf("Test %d PASSED, oldest event removed from the cache\n", tests);
+    }
+    else
+    {
+        printf("Test %d: adding an event to a full cache FAILED\n", tests);
+        return 1;
+    }
+
+    gwbuf_free(record);
+    tests++;
+
+    /**
+     * Test 26: events of an uncommitted transaction are not returned
+     *
+     * Expected NULL
+     */
+    inst->binlog_position = 304;
+
+    if (blr_cache_get(inst, "file.000001", 304, &hdr) == NULL &&
+        blr_cache_get(inst, "file.000002", 304, &hdr) == NULL)
+    {
+        printf("Test %d PASSED, unsafe event not read from the cache\n", tests);
+    }
+    else
+    {
+        printf("Test %d: reading an unsafe event from the cache FAILED\n", tests);
+        return 1;
+    }
+
+    tests++;
+
+    /**
+     * Test 27: writing to an earlier binlog file empties the cache
+     *
+     * Expected an empty cache
+     */
+    blr_cache_binlog_changed(inst, "file.000001");
+
+    if (inst->cache->cnt == 0 && inst->cache->bytes == 0 &&
+        blr_cache_get(inst, "file.000001", 204, &hdr) == NULL)
+    {
+        printf("Test %d PASSED, cache emptied when the binlog files are rewritten\n", tests);
+    }
+    else
+    {
+        printf("Test %d: emptying the cache FAILED\n", tests);
+        return 1;
+    }
+
     mxs_log_flush_sync();
     mxs_log_finish();
 
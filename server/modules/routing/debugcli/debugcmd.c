@@ -29,6 +29,7 @@
 #include <maxscale/cdefs.h>
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,7 +46,11 @@
 #include <maxscale/housekeeper.h>
 #include <maxscale/log_manager.h>
 #include <maxscale/maxscale.h>
+#include <maxscale/latency.h>
+#include <maxscale/metrics.h>
 #include <maxscale/modulecmd.h>
+#include <maxscale/query_digest.h>
+#include <maxscale/resolver.h>
 #include <maxscale/router.h>
 #include <maxscale/server.h>
 #include <maxscale/service.h>
@@ -96,6 +101,9 @@ struct subcommand
 
 static void telnetdShowUsers(DCB *);
 static void show_log_throttling(DCB *);
+static void show_latency(DCB *);
+static void show_metrics(DCB *);
+static void show_spinlocks(DCB *);
 
 static void showVersion(DCB *dcb)
 {
@@ -138,6 +146,14 @@ struct subcommand showoptions[] =
         "Example : show authenticators my-service",
         {ARG_TYPE_SERVICE}
     },
+    {
+        "digests", 0, 0, dShowQueryDigests,
+        "Show server-wide statement statistics",
+        "Usage: show digests\n"
+        "\n"
+        "The statistics are collected by the digestfilter",
+        {0}
+    },
     {
         "epoll", 0, 0, dprintPollStats,
         "Show the polling system statistics",
@@ -173,12 +189,30 @@ struct subcommand showoptions[] =
         "Usage: show filters",
         {0}
     },
+    {
+        "latency", 0, 0, show_latency,
+        "Show the latency of the stages of statement processing",
+        "Usage: show latency\n"
+        "\n"
+        "Shows the latency of each stage for all services and the backend\n"
+        "and reply latency for all servers",
+        {0}
+    },
     {
         "log_throttling", 0, 0, show_log_throttling,
         "Show the current log throttling setting (count, window (ms), suppression (ms))",
         "Usage: show log_throttling",
         {0}
     },
+    {
+        "metrics", 0, 0, show_metrics,
+        "Show the values of all registered metrics",
+        "Usage: show metrics\n"
+        "\n"
+        "Shows the name, type, value and labels of each metric. For histograms,\n"
+        "the value is the number of observations",
+        {0}
+    },
     {
         "modules", 0, 0, dprintAllModules,
         "Show all currently loaded modules",
@@ -213,6 +247,12 @@ struct subcommand showoptions[] =
         "Example: show persistent db-server-1",
         {ARG_TYPE_SERVER}
     },
+    {
+        "resolver", 0, 0, dprintResolverStats,
+        "Show the host name resolver cache",
+        "Usage: show resolver",
+        {0}
+    },
     {
         "server", 1, 1, dprintServer,
         "Show server details",
@@ -270,6 +310,14 @@ struct subcommand showoptions[] =
         "Usage: show sessions",
         {0}
     },
+    {
+        "spinlocks", 0, 0, show_spinlocks,
+        "Show the results of spinlock profiling",
+        "Usage: show spinlocks\n"
+        "\n"
+        "Profiling is started with `enable spinlock-profiling`",
+        {0}
+    },
     {
         "tasks", 0, 0, hkshow_tasks,
         "Show all active housekeeper tasks in MaxScale",
@@ -717,6 +765,10 @@ static void enable_syslog();
 static void disable_syslog();
 static void enable_maxlog();
 static void disable_maxlog();
+static void enable_spinlock_profiling();
+static void disable_spinlock_profiling();
+static void enable_latency_tracing(DCB *dcb, int percent);
+static void disable_latency_tracing();
 static void enable_account(DCB *, char *user);
 static void disable_account(DCB *, char *user);
 
@@ -783,6 +835,30 @@ struct subcommand enableoptions[] =
         "Usage: enable maxlog",
         {0}
     },
+    {
+        "spinlock-profiling",
+        0, 0,
+        enable_spinlock_profiling,
+        "Start profiling the contention of spinlocks",
+        "Usage: enable spinlock-profiling\n"
+        "\n"
+        "The results of earlier profiling are discarded. The results\n"
+        "are shown with `show spinlocks`",
+        {0}
+    },
+    {
+        "latency-tracing",
+        1, 1,
+        enable_latency_tracing,
+        "Log the latency of each statement of a sample of new sessions",
+        "Usage: enable latency-tracing PERCENT\n"
+        "\n"
+        "Parameters:\n"
+        "PERCENT Percentage of new sessions to trace\n"
+        "\n"
+        "Example: enable latency-tracing 5",
+        {ARG_TYPE_NUMERIC}
+    },
     {
         "account",
         1, 1,
@@ -866,6 +942,22 @@ struct subcommand disableoptions[] =
         "Usage: disable maxlog",
         {0}
     },
+    {
+        "spinlock-profiling",
+        0, 0,
+        disable_spinlock_profiling,
+        "Stop profiling the contention of spinlocks",
+        "Usage: disable spinlock-profiling",
+        {0}
+    },
+    {
+        "latency-tracing",
+        0, 0,
+        disable_latency_tracing,
+        "Stop tracing the latency of new sessions",
+        "Usage: disable latency-tracing",
+        {0}
+    },
     {
         "account",
         1, 1,
@@ -1075,6 +1167,17 @@ flushlogs(DCB *pdcb)
     mxs_log_rotate();
 }
 
+/**
+ * User command to discard the collected statement statistics
+ *
+ * @param pdcb          The stream to write output to
+ */
+static void
+flushdigests(DCB *pdcb)
+{
+    query_digest_reset();
+}
+
 
 /**
  * The subcommands of the flush command
@@ -1097,6 +1200,14 @@ struct subcommand flushoptions[] =
         "Usage: flush logs",
         {0}
     },
+    {
+        "digests",
+        0, 0,
+        flushdigests,
+        "Discard the server-wide statement statistics",
+        "Usage: flush digests",
+        {0}
+    },
     {
         EMPTY_OPTION
     }
@@ -2198,6 +2309,91 @@ show_log_throttling(DCB *dcb)
     dcb_printf(dcb, "%lu %lu %lu\n", t.count, t.window_ms, t.suppress_ms);
 }
 
+/**
+ * Print the latency of the stages of statement processing
+ *
+ * @param dcb The DCB to print the latency to.
+ */
+static void
+show_latency(DCB *dcb)
+{
+    int sampling = latency_get_trace_sampling();
+
+    if (sampling)
+    {
+        dcb_printf(dcb, "Tracing %d%% of new sessions.\n\n", sampling);
+    }
+    else
+    {
+        dcb_printf(dcb, "Tracing is disabled.\n\n");
+    }
+
+    dprintServiceLatency(dcb);
+    dcb_printf(dcb, "\n");
+    dprintServerLatency(dcb);
+}
+
+static bool show_metric(const MXS_METRIC *metric, void *data)
+{
+    DCB *dcb = (DCB*)data;
+    const char *labels = mxs_metric_labels(metric);
+
+    dcb_printf(dcb, "%-50s %-10s %" PRId64 "\n", mxs_metric_name(metric),
+               mxs_metric_type_to_string(mxs_metric_type(metric)), mxs_metric_get(metric));
+
+    if (*labels)
+    {
+        dcb_printf(dcb, "    {%s}\n", labels);
+    }
+
+    return true;
+}
+
+/**
+ * Print the values of all metrics
+ *
+ * @param dcb   The DCB to print to
+ */
+static void
+show_metrics(DCB *dcb)
+{
+    dcb_printf(dcb, "%-50s %-10s %s\n", "Metric", "Type", "Value");
+    mxs_metric_foreach(show_metric, dcb);
+}
+
+static void spinlock_reporter(void *hdl, const void *lock, const char *caller,
+                              uint64_t acquired, uint64_t contended)
+{
+    DCB *dcb = (DCB*)hdl;
+    double pct = acquired ? (100.0 * contended) / acquired : 100.0;
+
+    dcb_printf(dcb, "%-18p | %-40s | %12lu | %12lu | %6.2f\n",
+               lock, caller, acquired, contended, pct > 100.0 ? 100.0 : pct);
+}
+
+/**
+ * Show the results of spinlock profiling, most contended locks first
+ *
+ * @param dcb  The DCB for output
+ */
+static void
+show_spinlocks(DCB *dcb)
+{
+    dcb_printf(dcb, "Spinlock profiling is %s.\n",
+               spinlock_profile_enabled() ? "enabled" : "disabled");
+    dcb_printf(dcb, "%-18s | %-40s | %12s | %12s | %6s\n",
+               "Lock", "Acquired in", "Acquisitions", "Contended", "%");
+    dcb_printf(dcb, "-------------------+------------------------------------------+"
+               "--------------+--------------+-------\n");
+
+    uint64_t dropped = spinlock_profile_report(spinlock_reporter, dcb);
+
+    if (dropped)
+    {
+        dcb_printf(dcb, "%lu samples were dropped due to too many locks.\n", dropped);
+    }
+}
+
 /**
  * Command to shutdown a running monitor
  *
@@ -2449,6 +2645,51 @@ disable_maxlog()
     mxs_log_set_maxlog_enabled(false);
 }
 
+/**
+ * Enable spinlock profiling.
+ */
+static void
+enable_spinlock_profiling()
+{
+    spinlock_profile_enable(true);
+}
+
+/**
+ * Disable spinlock profiling.
+ */
+static void
+disable_spinlock_profiling()
+{
+    spinlock_profile_enable(false);
+}
+
+/**
+ * Enable latency tracing of a sample of new sessions
+ *
+ * @param dcb     The DCB for messages
+ * @param percent Percentage of sessions to trace
+ */
+static void
+enable_latency_tracing(DCB *dcb, int percent)
+{
+    if (percent < 1 || percent > 100)
+    {
+        dcb_printf(dcb, "The percentage must be between 1 and 100.\n");
+        return;
+    }
+
+    latency_set_trace_sampling(percent);
+}
+
+/**
+ * Disable latency tracing of new sessions
+ */
+static void
+disable_latency_tracing()
+{
+    latency_set_trace_sampling(0);
+}
+
 /**
  * Enable a Linux account
  *
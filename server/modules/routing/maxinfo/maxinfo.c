@@ -39,6 +39,7 @@
 #include <maxscale/modinfo.h>
 #include <maxscale/modutil.h>
 #include <maxscale/monitor.h>
+#include <maxscale/prometheus.h>
 #include <maxscale/atomic.h>
 #include <maxscale/spinlock.h>
 #include <maxscale/dcb.h>
@@ -712,6 +713,17 @@ handle_url(INFO_INSTANCE *instance, INFO_SESSION *session, GWBUF *queue)
     RESULTSET *set;
 
     uri = (char *)GWBUF_DATA(queue);
+
+    if (strcmp(uri, "/metrics") == 0)
+    {
+        GWBUF *metrics = prometheus_collect();
+
+        if (metrics)
+        {
+            session->dcb->func.write(session->dcb, metrics);
+        }
+    }
+
     for (i = 0; supported_uri[i].uri; i++)
     {
         if (strcmp(uri, supported_uri[i].uri) == 0)
@@ -39,6 +39,7 @@
 #include <maxscale/maxscale.h>
 #include <maxscale/modinfo.h>
 #include <maxscale/modutil.h>
+#include <maxscale/query_digest.h>
 #include <maxscale/resultset.h>
 #include <maxscale/router.h>
 #include <maxscale/service.h>
@@ -267,6 +268,66 @@ exec_show_eventTimes(DCB *dcb, MAXINFO_TREE *tree)
     resultset_free(set);
 }
 
+/**
+ * Fetch the server-wide statement statistics
+ *
+ * @param dcb   DCB to which to stream result set
+ * @param tree  Potential like clause (currently unused)
+ */
+static void
+exec_show_digests(DCB *dcb, MAXINFO_TREE *tree)
+{
+    RESULTSET *set;
+
+    if ((set = queryDigestGetList()) == NULL)
+    {
+        return;
+    }
+
+    resultset_stream_mysql(set, dcb);
+    resultset_free(set);
+}
+
+/**
+ * Fetch the per-stage latency of the services
+ *
+ * @param dcb   DCB to which to stream result set
+ * @param tree  Potential like clause (currently unused)
+ */
+static void
+exec_show_serviceLatency(DCB *dcb, MAXINFO_TREE *tree)
+{
+    RESULTSET *set;
+
+    if ((set = serviceGetLatencyList()) == NULL)
+    {
+        return;
+    }
+
+    resultset_stream_mysql(set, dcb);
+    resultset_free(set);
+}
+
+/**
+ * Fetch the backend and reply latency of the servers
+ *
+ * @param dcb   DCB to which to stream result set
+ * @param tree  Potential like clause (currently unused)
+ */
+static void
+exec_show_serverLatency(DCB *dcb, MAXINFO_TREE *tree)
+{
+    RESULTSET *set;
+
+    if ((set = serverGetLatencyList()) == NULL)
+    {
+        return;
+    }
+
+    resultset_stream_mysql(set, dcb);
+    resultset_free(set);
+}
+
 /**
  * The table of show commands that are supported
  */
@@ -286,6 +347,9 @@ static struct
     { "modules", exec_show_modules },
     { "monitors", exec_show_monitors },
     { "eventTimes", exec_show_eventTimes },
+    { "digests", exec_show_digests },
+    { "serviceLatency", exec_show_serviceLatency },
+    { "serverLatency", exec_show_serverLatency },
     { NULL, NULL }
 };
 
@@ -31,6 +31,7 @@
 
 #include <maxscale/cdefs.h>
 #include <maxscale/dcb.h>
+#include <maxscale/metrics.h>
 #include <maxscale/service.h>
 
 MXS_BEGIN_DECLS
@@ -60,8 +61,8 @@ typedef struct router_client_session
  */
 typedef struct
 {
-    int n_sessions; /*< Number sessions created     */
-    int n_queries; /*< Number of queries forwarded */
+    MXS_METRIC *n_sessions; /*< Number sessions created     */
+    MXS_METRIC *n_queries; /*< Number of queries forwarded */
 } ROUTER_STATS;
 
 /**
@@ -72,6 +72,7 @@
 
 #include "readconnection.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -86,6 +87,7 @@
 #include <maxscale/log_manager.h>
 #include <maxscale/protocol/mysql.h>
 #include <maxscale/modutil.h>
+#include <maxscale/prometheus.h>
 
 /* The router entry points */
 static MXS_ROUTER *createInstance(SERVICE *service, char **options);
@@ -104,6 +106,22 @@ static void rses_end_locked_router_action(ROUTER_CLIENT_SES* rses);
 static SERVER_REF *get_root_master(SERVER_REF *servers);
 static int handle_state_switch(DCB* dcb, DCB_REASON reason, void * routersession);
 
+/**
+ * The metrics of the router instances
+ */
+static const MXS_METRIC_DEF readconn_metrics[] =
+{
+    {
+        "maxscale_readconnroute_sessions_total", MXS_METRIC_COUNTER,
+        "Number of router sessions created"
+    },
+    {
+        "maxscale_readconnroute_queries_total", MXS_METRIC_COUNTER,
+        "Number of queries forwarded"
+    },
+    MXS_END_MODULE_METRICS
+};
+
 /**
  * The module entry point routine. It is this routine that
  * must populate the structure that is referred to as the
@@ -144,7 +162,8 @@ MXS_MODULE* MXS_CREATE_MODULE()
         NULL, /* Thread finish. */
         {
             {MXS_END_MODULE_PARAMS}
-        }
+        },
+        readconn_metrics
     };
 
     return &info;
@@ -154,6 +173,8 @@ static inline void free_readconn_instance(ROUTER_INSTANCE *router)
 {
     if (router)
     {
+        mxs_metric_free(router->stats.n_sessions);
+        mxs_metric_free(router->stats.n_queries);
         MXS_FREE(router);
     }
 }
@@ -182,6 +203,18 @@ createInstance(SERVICE *service, char **options)
     inst->service = service;
     spinlock_init(&inst->lock);
 
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+    prometheus_label(labels, "service", service->name);
+
+    if ((inst->stats.n_sessions = mxs_metric_create("maxscale_readconnroute_sessions_total",
+                                                    labels)) == NULL ||
+        (inst->stats.n_queries = mxs_metric_create("maxscale_readconnroute_queries_total",
+                                                   labels)) == NULL)
+    {
+        free_readconn_instance(inst);
+        return NULL;
+    }
+
     /*
      * Process the options
      */
@@ -432,7 +465,7 @@ newSession(MXS_ROUTER *instance, MXS_SESSION *session)
                      DCB_REASON_NOT_RESPONDING,
                      &handle_state_switch,
                      client_rses);
-    inst->stats.n_sessions++;
+    mxs_metric_inc(inst->stats.n_sessions);
 
     CHK_CLIENT_RSES(client_rses);
 
@@ -585,7 +618,7 @@ routeQuery(MXS_ROUTER *instance, MXS_ROUTER_SESSION *router_session, GWBUF *queu
     mysql_server_cmd_t mysql_command = proto->current_command;
     bool rses_is_closed;
 
-    inst->stats.n_queries++;
+    mxs_metric_inc(inst->stats.n_queries);
 
     /** Dirty read for quick check if router is closed. */
     if (router_cli_ses->rses_closed)
@@ -660,12 +693,12 @@ diagnostics(MXS_ROUTER *router, DCB *dcb)
     ROUTER_INSTANCE *router_inst = (ROUTER_INSTANCE *) router;
     char *weightby;
 
-    dcb_printf(dcb, "\tNumber of router sessions:   	%d\n",
-               router_inst->stats.n_sessions);
+    dcb_printf(dcb, "\tNumber of router sessions:   	%" PRId64 "\n",
+               mxs_metric_get(router_inst->stats.n_sessions));
     dcb_printf(dcb, "\tCurrent no. of router sessions:	%d\n",
                router_inst->service->stats.n_current);
-    dcb_printf(dcb, "\tNumber of queries forwarded:   	%d\n",
-               router_inst->stats.n_queries);
+    dcb_printf(dcb, "\tNumber of queries forwarded:   	%" PRId64 "\n",
+               mxs_metric_get(router_inst->stats.n_queries));
     if ((weightby = serviceGetWeightingParameter(router_inst->service))
         != NULL)
     {
@@ -29,7 +29,9 @@
 #include <maxscale/spinlock.h>
 #include <maxscale/modinfo.h>
 #include <maxscale/modutil.h>
+#include <maxscale/prometheus.h>
 #include <maxscale/alloc.h>
+#include <maxscale/latency.h>
 
 /**
  * @file readwritesplit.c   The entry points for the read/write query splitting
@@ -94,6 +96,7 @@ static uint64_t getCapabilities(MXS_ROUTER* instance);
  * not part of the API.
  */
 
+static bool create_rwsplit_metrics(ROUTER_INSTANCE *router);
 static void free_rwsplit_instance(ROUTER_INSTANCE *router);
 static bool rwsplit_process_router_options(ROUTER_INSTANCE *router,
                                            char **options);
@@ -109,6 +112,26 @@ static bool create_backends(ROUTER_CLIENT_SES *rses, backend_ref_t** dest, int*
 /**
  * Enum values for router parameters
  */
+/**
+ * The metrics of the router instances
+ */
+static const MXS_METRIC_DEF rwsplit_metrics[] =
+{
+    {
+        "maxscale_rwsplit_sessions_total", MXS_METRIC_COUNTER,
+        "Number of router sessions created"
+    },
+    {
+        "maxscale_rwsplit_queries_total", MXS_METRIC_COUNTER,
+        "Number of queries forwarded"
+    },
+    {
+        "maxscale_rwsplit_routed_total", MXS_METRIC_COUNTER,
+        "Number of statements routed to each type of target"
+    },
+    MXS_END_MODULE_METRICS
+};
+
 static const MXS_ENUM_VALUE use_sql_variables_in_values[] =
 {
     {"all",    TYPE_ALL},
@@ -122,6 +145,7 @@ static const MXS_ENUM_VALUE slave_selection_criteria_values[] =
     {"LEAST_ROUTER_CONNECTIONS", LEAST_ROUTER_CONNECTIONS},
     {"LEAST_BEHIND_MASTER",      LEAST_BEHIND_MASTER},
     {"LEAST_CURRENT_OPERATIONS", LEAST_CURRENT_OPERATIONS},
+    {"ADAPTIVE_ROUTING",         ADAPTIVE_ROUTING},
     {NULL}
 };
 
@@ -197,8 +221,10 @@ MXS_MODULE *MXS_CREATE_MODULE()
             {"strict_multi_stmt",  MXS_MODULE_PARAM_BOOL, "true"},
             {"strict_sp_calls",  MXS_MODULE_PARAM_BOOL, "false"},
             {"master_accept_reads", MXS_MODULE_PARAM_BOOL, "false"},
+            {"lazy_connect", MXS_MODULE_PARAM_BOOL, "false"},
             {MXS_END_MODULE_PARAMS}
-        }
+        },
+        rwsplit_metrics
     };
 
     MXS_NOTICE("Initializing statement-based read/write split router module.");
@@ -280,8 +306,10 @@ static MXS_ROUTER *createInstance(SERVICE *service, char **options)
     router->rwsplit_config.disable_sescmd_history = config_get_bool(params, "disable_sescmd_history");
     router->rwsplit_config.max_sescmd_history = config_get_integer(params, "max_sescmd_history");
     router->rwsplit_config.master_accept_reads = config_get_bool(params, "master_accept_reads");
+    router->rwsplit_config.lazy_connect = config_get_bool(params, "lazy_connect");
 
-    if (!handle_max_slaves(router, config_get_string(params, "max_slave_connections")) ||
+    if (!create_rwsplit_metrics(router) ||
+        !handle_max_slaves(router, config_get_string(params, "max_slave_connections")) ||
         (options && !rwsplit_process_router_options(router, options)))
     {
         free_rwsplit_instance(router);
@@ -295,6 +323,14 @@ static MXS_ROUTER *createInstance(SERVICE *service, char **options)
         router->rwsplit_config.max_sescmd_history = 0;
     }
 
+    if (router->rwsplit_config.lazy_connect &&
+        router->rwsplit_config.disable_sescmd_history)
+    {
+        MXS_WARNING("Service '%s' has 'lazy_connect' enabled but the session command "
+                    "history is disabled. Slaves are connected only before the first "
+                    "session command of a session.", service->name);
+    }
+
     return (MXS_ROUTER *)router;
 }
 
@@ -361,11 +397,23 @@ static MXS_ROUTER_SESSION *newSession(MXS_ROUTER *router_inst, MXS_SESSION *sess
     client_rses->rses_backend_ref = backend_ref;
     client_rses->rses_nbackends = router_nservers; /*< # of backend servers */
 
+    /**
+     * With lazy_connect, only the master is connected now and the slaves when
+     * reads are routed to them. If there is no master, one slave is connected
+     * so that the session has a server for session commands.
+     */
+    int initial_nslaves = client_rses->rses_config.lazy_connect ? 0 : max_nslaves;
     backend_ref_t *master_ref = NULL; /*< pointer to selected master */
+
     if (!select_connect_backend_servers(&master_ref, backend_ref, router_nservers,
-                                        max_nslaves, max_slave_rlag,
+                                        initial_nslaves, max_slave_rlag,
                                         client_rses->rses_config.slave_selection_criteria,
-                                        session, router, false))
+                                        session, router, false) ||
+        (master_ref == NULL && initial_nslaves == 0 && max_nslaves > 0 &&
+         !select_connect_backend_servers(&master_ref, backend_ref, router_nservers,
+                                         1, max_slave_rlag,
+                                         client_rses->rses_config.slave_selection_criteria,
+                                         session, router, true)))
     {
         /**
          * Master and at least <min_nslaves> slaves must be found if the router is
@@ -388,7 +436,7 @@ static MXS_ROUTER_SESSION *newSession(MXS_ROUTER *router_inst, MXS_SESSION *sess
         client_rses->rses_config.max_slave_connections = n_conn;
     }
 
-    router->stats.n_sessions += 1;
+    mxs_metric_inc(router->stats.n_sessions);
 
     return (void *)client_rses;
 }
@@ -616,27 +664,34 @@ static void diagnostics(MXS_ROUTER *instance, DCB *dcb)
                router->rwsplit_config.max_sescmd_history);
     dcb_printf(dcb, "\tmaster_accept_reads:       %s\n",
                router->rwsplit_config.master_accept_reads ? "true" : "false");
+    dcb_printf(dcb, "\tlazy_connect:              %s\n",
+               router->rwsplit_config.lazy_connect ? "true" : "false");
     dcb_printf(dcb, "\n");
 
-    if (router->stats.n_queries > 0)
+    int64_t n_queries = mxs_metric_get(router->stats.n_queries);
+    int64_t n_master = mxs_metric_get(router->stats.n_master);
+    int64_t n_slave = mxs_metric_get(router->stats.n_slave);
+    int64_t n_all = mxs_metric_get(router->stats.n_all);
+
+    if (n_queries > 0)
     {
-        master_pct = ((double)router->stats.n_master / (double)router->stats.n_queries) * 100.0;
-        slave_pct = ((double)router->stats.n_slave / (double)router->stats.n_queries) * 100.0;
-        all_pct = ((double)router->stats.n_all / (double)router->stats.n_queries) * 100.0;
+        master_pct = ((double)n_master / (double)n_queries) * 100.0;
+        slave_pct = ((double)n_slave / (double)n_queries) * 100.0;
+        all_pct = ((double)n_all / (double)n_queries) * 100.0;
     }
 
-    dcb_printf(dcb, "\tNumber of router sessions:           	%" PRIu64 "\n",
-               router->stats.n_sessions);
+    dcb_printf(dcb, "\tNumber of router sessions:           	%" PRId64 "\n",
+               mxs_metric_get(router->stats.n_sessions));
     dcb_printf(dcb, "\tCurrent no. of router sessions:      	%d\n",
                router->service->stats.n_current);
-    dcb_printf(dcb, "\tNumber of queries forwarded:          	%" PRIu64 "\n",
-               router->stats.n_queries);
-    dcb_printf(dcb, "\tNumber of queries forwarded to master:	%" PRIu64 " (%.2f%%)\n",
-               router->stats.n_master, master_pct);
-    dcb_printf(dcb, "\tNumber of queries forwarded to slave: 	%" PRIu64 " (%.2f%%)\n",
-               router->stats.n_slave, slave_pct);
-    dcb_printf(dcb, "\tNumber of queries forwarded to all:   	%" PRIu64 " (%.2f%%)\n",
-               router->stats.n_all, all_pct);
+    dcb_printf(dcb, "\tNumber of queries forwarded:          	%" PRId64 "\n",
+               n_queries);
+    dcb_printf(dcb, "\tNumber of queries forwarded to master:	%" PRId64 " (%.2f%%)\n",
+               n_master, master_pct);
+    dcb_printf(dcb, "\tNumber of queries forwarded to slave: 	%" PRId64 " (%.2f%%)\n",
+               n_slave, slave_pct);
+    dcb_printf(dcb, "\tNumber of queries forwarded to all:   	%" PRId64 " (%.2f%%)\n",
+               n_all, all_pct);
 
     if ((weightby = serviceGetWeightingParameter(router->service)) != NULL)
     {
@@ -722,7 +777,8 @@ static void clientReply(MXS_ROUTER *instance,
             bool rconn = false;
             writebuf = sescmd_cursor_process_replies(writebuf, bref, &rconn);
 
-            if (rconn && !router_inst->rwsplit_config.disable_sescmd_history)
+            if (rconn && !router_inst->rwsplit_config.disable_sescmd_history &&
+                !router_cli_ses->rses_config.lazy_connect)
             {
                 select_connect_backend_servers(
                     &router_cli_ses->rses_master_ref, router_cli_ses->rses_backend_ref,
@@ -750,6 +806,9 @@ static void clientReply(MXS_ROUTER *instance,
      */
     else if (BREF_IS_QUERY_ACTIVE(bref))
     {
+        /** The response times are shared by all sessions, see ADAPTIVE_ROUTING */
+        server_add_response_time(bref->ref->server,
+                                 (latency_now() - bref->query_started) / 1000);
         bref_clear_state(bref, BREF_QUERY_ACTIVE);
         /** Set response status as replied */
         bref_clear_state(bref, BREF_WAITING_RESULT);
@@ -787,7 +846,7 @@ static void clientReply(MXS_ROUTER *instance,
                                               gwbuf_clone(bref->bref_pending_cmd))) == 1)
         {
             ROUTER_INSTANCE* inst = (ROUTER_INSTANCE *)instance;
-            atomic_add_uint64(&inst->stats.n_queries, 1);
+            mxs_metric_inc(inst->stats.n_queries);
             /**
              * Add one query response waiter to backend reference
              */
@@ -928,6 +987,11 @@ void bref_set_state(backend_ref_t *bref, bref_state_t state)
         }
     }
 
+    if ((state & BREF_QUERY_ACTIVE) && (bref->bref_state & BREF_QUERY_ACTIVE) == 0)
+    {
+        bref->query_started = latency_now();
+    }
+
     bref->bref_state |= state;
 }
 
@@ -1159,14 +1223,15 @@ static bool rwsplit_process_router_options(ROUTER_INSTANCE *router,
                 c = GET_SELECT_CRITERIA(value);
                 ss_dassert(c == LEAST_GLOBAL_CONNECTIONS ||
                            c == LEAST_ROUTER_CONNECTIONS || c == LEAST_BEHIND_MASTER ||
-                           c == LEAST_CURRENT_OPERATIONS || c == UNDEFINED_CRITERIA);
+                           c == LEAST_CURRENT_OPERATIONS || c == ADAPTIVE_ROUTING ||
+                           c == UNDEFINED_CRITERIA);
 
                 if (c == UNDEFINED_CRITERIA)
                 {
                     MXS_ERROR("Unknown slave selection criteria \"%s\". "
                               "Allowed values are LEAST_GLOBAL_CONNECTIONS, "
-                              "LEAST_ROUTER_CONNECTIONS, LEAST_BEHIND_MASTER,"
-                              "and LEAST_CURRENT_OPERATIONS.",
+                              "LEAST_ROUTER_CONNECTIONS, LEAST_BEHIND_MASTER, "
+                              "LEAST_CURRENT_OPERATIONS and ADAPTIVE_ROUTING.",
                               STRCRITERIA(router->rwsplit_config.slave_selection_criteria));
                     success = false;
                 }
@@ -1583,8 +1648,9 @@ static bool handle_error_new_connection(ROUTER_INSTANCE *inst,
      * Try to get replacement slave or at least the minimum
      * number of slave connections for router session.
      */
-    if (inst->rwsplit_config.disable_sescmd_history)
+    if (inst->rwsplit_config.disable_sescmd_history || myrses->rses_config.lazy_connect)
     {
+        /** With lazy_connect, a replacement is connected when a read needs one */
         succp = have_enough_servers(myrses, 1, myrses->rses_nbackends, inst) ? true : false;
     }
     else
@@ -1669,10 +1735,59 @@ static bool have_enough_servers(ROUTER_CLIENT_SES *rses, const int min_nsrv,
  * @param   router  Router instance
  *
  */
+/**
+ * @brief Create a metric of a router instance
+ *
+ * @param router The router instance
+ * @param name   Name of the metric
+ * @param target Value of the label @c target, NULL for none
+ *
+ * @return The instrument or NULL on error
+ */
+static MXS_METRIC* create_rwsplit_metric(ROUTER_INSTANCE *router, const char *name,
+                                         const char *target)
+{
+    char labels[PROMETHEUS_LABELS_MAXLEN] = "";
+    prometheus_label(labels, "service", router->service->name);
+
+    if (target)
+    {
+        prometheus_label(labels, "target", target);
+    }
+
+    return mxs_metric_create(name, labels);
+}
+
+/**
+ * @brief Create the metrics of a router instance
+ *
+ * @param router The router instance
+ *
+ * @return True if all metrics were created
+ */
+static bool create_rwsplit_metrics(ROUTER_INSTANCE *router)
+{
+    ROUTER_STATS *stats = &router->stats;
+
+    stats->n_sessions = create_rwsplit_metric(router, "maxscale_rwsplit_sessions_total", NULL);
+    stats->n_queries = create_rwsplit_metric(router, "maxscale_rwsplit_queries_total", NULL);
+    stats->n_master = create_rwsplit_metric(router, "maxscale_rwsplit_routed_total", "master");
+    stats->n_slave = create_rwsplit_metric(router, "maxscale_rwsplit_routed_total", "slave");
+    stats->n_all = create_rwsplit_metric(router, "maxscale_rwsplit_routed_total", "all");
+
+    return stats->n_sessions && stats->n_queries && stats->n_master &&
+           stats->n_slave && stats->n_all;
+}
+
 static void free_rwsplit_instance(ROUTER_INSTANCE *router)
 {
     if (router)
     {
+        mxs_metric_free(router->stats.n_sessions);
+        mxs_metric_free(router->stats.n_queries);
+        mxs_metric_free(router->stats.n_master);
+        mxs_metric_free(router->stats.n_slave);
+        mxs_metric_free(router->stats.n_all);
         MXS_FREE(router);
     }
 }
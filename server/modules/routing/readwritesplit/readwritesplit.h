@@ -33,6 +33,7 @@
 
 #include <maxscale/dcb.h>
 #include <maxscale/hashtable.h>
+#include <maxscale/metrics.h>
 #include <maxscale/router.h>
 #include <maxscale/service.h>
 
@@ -106,8 +107,9 @@ typedef enum select_criteria
     LEAST_ROUTER_CONNECTIONS,   /*< connections established by this router */
     LEAST_BEHIND_MASTER,
     LEAST_CURRENT_OPERATIONS,
-    DEFAULT_CRITERIA   = LEAST_CURRENT_OPERATIONS,
-    LAST_CRITERIA               /*< not used except for an index */
+    ADAPTIVE_ROUTING,           /*< fastest expected response, chosen for each query */
+    LAST_CRITERIA,              /*< not used except for an index */
+    DEFAULT_CRITERIA   = LEAST_CURRENT_OPERATIONS
 } select_criteria_t;
 
 static inline const char* select_criteria_to_str(select_criteria_t type)
@@ -126,6 +128,9 @@ static inline const char* select_criteria_to_str(select_criteria_t type)
     case LEAST_CURRENT_OPERATIONS:
         return "LEAST_CURRENT_OPERATIONS";
 
+    case ADAPTIVE_ROUTING:
+        return "ADAPTIVE_ROUTING";
+
     default:
         return "UNDEFINED_CRITERIA";
     }
@@ -173,7 +178,9 @@ static inline const char* failure_mode_to_str(enum failure_mode type)
         strncmp(s,"LEAST_ROUTER_CONNECTIONS", strlen("LEAST_ROUTER_CONNECTIONS")) == 0 ?        \
         LEAST_ROUTER_CONNECTIONS : (                                                            \
         strncmp(s,"LEAST_CURRENT_OPERATIONS", strlen("LEAST_CURRENT_OPERATIONS")) == 0 ?        \
-        LEAST_CURRENT_OPERATIONS : UNDEFINED_CRITERIA))))
+        LEAST_CURRENT_OPERATIONS : (                                                            \
+        strncmp(s,"ADAPTIVE_ROUTING", strlen("ADAPTIVE_ROUTING")) == 0 ?                        \
+        ADAPTIVE_ROUTING : UNDEFINED_CRITERIA)))))
 
 /**
  * Session variable command
@@ -191,6 +198,9 @@ typedef struct mysql_sescmd_st
                                    *  LOCAL_INFILE. Slave servers are compared to this
                                    *  when they return session command replies.*/
     int      position; /*< Position of this command */
+    char*              my_sescmd_key;        /*< The session state the command sets or
+                                              *  NULL if it can't be superseded */
+    bool               my_sescmd_constant;   /*< The state doesn't depend on its old value */
 #if defined(SS_DEBUG)
     skygw_chk_t        my_sescmd_chk_tail;
 #endif
@@ -252,6 +262,7 @@ typedef struct backend_ref_st
     GWBUF*          bref_pending_cmd; /**< For stmt which can't be routed due active sescmd execution */
     unsigned char   reply_cmd;  /**< The reply the backend server sent to a session command.
                                  * Used to detect slaves that fail to execute session command. */
+    uint64_t        query_started; /**< When the active query was sent, see latency_now() */
 #if defined(SS_DEBUG)
     skygw_chk_t     bref_chk_tail;
 #endif
@@ -276,6 +287,7 @@ typedef struct rwsplit_config_st
     enum failure_mode master_failure_mode; /**< Master server failure handling mode.
                                                * @see enum failure_mode */
     bool              retry_failed_reads; /**< Retry failed reads on other servers */
+    bool              lazy_connect; /**< Connect to slaves when reads are routed to them */
 } rwsplit_config_t;
 
 #if defined(PREP_STMT_CACHING)
@@ -332,15 +344,16 @@ struct router_client_session
 } ;
 
 /**
- * The statistics for this router instance
+ * The statistics for this router instance, updated without locking by the
+ * worker threads
  */
 typedef struct
 {
-    uint64_t n_sessions; /*< Number sessions created */
-    uint64_t n_queries;  /*< Number of queries forwarded */
-    uint64_t n_master;   /*< Number of stmts sent to master */
-    uint64_t n_slave;    /*< Number of stmts sent to slave */
-    uint64_t n_all;      /*< Number of stmts sent to all */
+    MXS_METRIC *n_sessions; /*< Number sessions created */
+    MXS_METRIC *n_queries;  /*< Number of queries forwarded */
+    MXS_METRIC *n_master;   /*< Number of stmts sent to master */
+    MXS_METRIC *n_slave;    /*< Number of stmts sent to slave */
+    MXS_METRIC *n_all;      /*< Number of stmts sent to all */
 } ROUTER_STATS;
 
 /**
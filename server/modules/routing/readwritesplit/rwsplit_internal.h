@@ -51,6 +51,7 @@ void live_session_reply(GWBUF **querybuf, ROUTER_CLIENT_SES *rses);
 void print_error_packet(ROUTER_CLIENT_SES *rses, GWBUF *buf, DCB *dcb);
 void check_session_command_reply(GWBUF *writebuf, sescmd_cursor_t *scur, backend_ref_t *bref);
 bool execute_sescmd_in_backend(backend_ref_t *backend_ref);
+char *get_sescmd_state_key(GWBUF *buf, unsigned char packet_type, bool *constant);
 bool handle_target_is_all(route_target_t route_target,
                           ROUTER_INSTANCE *inst, ROUTER_CLIENT_SES *rses,
                           GWBUF *querybuf, int packet_type, qc_query_type_t qtype);
@@ -121,6 +122,7 @@ GWBUF *sescmd_cursor_clone_querybuf(sescmd_cursor_t *scur);
 GWBUF *sescmd_cursor_process_replies(GWBUF *replybuf,
                                      backend_ref_t *bref,
                                      bool *reconnect);
+int compact_sescmd_history(ROUTER_CLIENT_SES *rses);
 
 /*
  * The following are implemented in rwsplit_select_backends.c
@@ -133,6 +135,9 @@ bool select_connect_backend_servers(backend_ref_t **p_master_ref,
                                     MXS_SESSION *session,
                                     ROUTER_INSTANCE *router,
                                     bool active_session);
+void connect_lazy_slave(ROUTER_CLIENT_SES *rses);
+int64_t adaptive_weight(const backend_ref_t *bref);
+backend_ref_t* adaptive_candidate(backend_ref_t *cand, backend_ref_t *new, int64_t *total_weight);
 
 /*
  * The following are implemented in rwsplit_tmp_table_multi.c
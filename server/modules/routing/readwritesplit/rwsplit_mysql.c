@@ -18,6 +18,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <ctype.h>
 
 #include <maxscale/router.h>
 #include "rwsplit_internal.h"
@@ -53,6 +54,12 @@
  * @endverbatim
  */
 
+static const char* skip_space(const char *ptr, const char *end);
+static int word_length(const char *ptr, const char *end);
+static bool word_is(const char *ptr, int len, const char *word);
+static bool reads_session_state(const char *ptr, int len);
+static bool single_assignment(const char *ptr, const char *end, bool *constant);
+
 /*
  * The following functions are called from elsewhere in the router and
  * are defined in rwsplit_internal.h.  They are not intended to be called
@@ -283,7 +290,7 @@ handle_target_is_all(route_target_t route_target,
 
     if (result)
     {
-        atomic_add_uint64(&inst->stats.n_all, 1);
+        mxs_metric_inc(inst->stats.n_all);
     }
     return result;
 }
@@ -499,6 +506,133 @@ return_succp:
     return succp;
 }
 
+/**
+ * @brief Find the session state that a session command sets
+ *
+ * Commands that set the same state supersede each other: only the effect of
+ * the last successful one remains. The recognized commands are USE and
+ * COM_INIT_DB, SET NAMES and SET CHARACTER SET as well as a single assignment
+ * to a session or a user variable. Statements with more than one assignment or
+ * statement, comments or a payload that does not fit into the first buffer
+ * are not recognized.
+ *
+ * @param buf         The session command
+ * @param packet_type The packet type of the command
+ * @param constant    Set to true if the new state does not depend on the old
+ *                    one, e.g. SET @a = 1 but not SET @a = @a + 1
+ *
+ * @return The key of the state or NULL if the command was not recognized. The
+ *         caller must free the key.
+ */
+char *get_sescmd_state_key(GWBUF *buf, unsigned char packet_type, bool *constant)
+{
+    *constant = false;
+
+    if (packet_type == MYSQL_COM_INIT_DB)
+    {
+        *constant = true;
+        return MXS_STRDUP("db");
+    }
+
+    char *sql;
+    int len;
+
+    if (packet_type != MYSQL_COM_QUERY || !modutil_extract_SQL(buf, &sql, &len) ||
+        len > (int)GWBUF_LENGTH(buf) - 5)
+    {
+        return NULL;
+    }
+
+    const char *ptr = skip_space(sql, sql + len);
+    const char *end = sql + len;
+    int wlen = word_length(ptr, end);
+
+    if (word_is(ptr, wlen, "USE"))
+    {
+        ptr = skip_space(ptr + wlen, end);
+        return single_assignment(ptr, end, constant) ? MXS_STRDUP("db") : NULL;
+    }
+
+    if (!word_is(ptr, wlen, "SET"))
+    {
+        return NULL;
+    }
+
+    ptr = skip_space(ptr + wlen, end);
+    wlen = word_length(ptr, end);
+
+    if (word_is(ptr, wlen, "NAMES") || word_is(ptr, wlen, "CHARSET") ||
+        word_is(ptr, wlen, "CHARACTER"))
+    {
+        /** Both set character_set_client, _connection and _results */
+        return single_assignment(ptr + wlen, end, constant) ? MXS_STRDUP("names") : NULL;
+    }
+
+    if (word_is(ptr, wlen, "SESSION") || word_is(ptr, wlen, "LOCAL"))
+    {
+        ptr = skip_space(ptr + wlen, end);
+    }
+
+    const char *prefix = "var:";
+
+    if (end - ptr > 2 && ptr[0] == '@' && ptr[1] == '@')
+    {
+        ptr += 2;
+        wlen = word_length(ptr, end);
+
+        if (ptr + wlen < end && ptr[wlen] == '.')
+        {
+            if (!word_is(ptr, wlen, "SESSION") && !word_is(ptr, wlen, "LOCAL"))
+            {
+                return NULL;
+            }
+            ptr += wlen + 1;
+        }
+    }
+    else if (ptr < end && *ptr == '@')
+    {
+        prefix = "@";
+        ptr++;
+    }
+
+    wlen = word_length(ptr, end);
+
+    if (wlen == 0 || word_is(ptr, wlen, "GLOBAL") || word_is(ptr, wlen, "TRANSACTION") ||
+        word_is(ptr, wlen, "PASSWORD"))
+    {
+        return NULL;
+    }
+
+    const char *name = ptr;
+    ptr = skip_space(ptr + wlen, end);
+
+    if (ptr < end && *ptr == ':')
+    {
+        ptr++;
+    }
+
+    if (ptr == end || *ptr != '=' || !single_assignment(ptr + 1, end, constant))
+    {
+        return NULL;
+    }
+
+    char *key = MXS_MALLOC(strlen(prefix) + wlen + 1);
+
+    if (key)
+    {
+        strcpy(key, prefix);
+        char *dest = key + strlen(prefix);
+
+        for (int i = 0; i < wlen; i++)
+        {
+            *dest++ = tolower(name[i]);
+        }
+        *dest = '\0';
+    }
+
+    return key;
+}
+
 /*
  * End of functions called from other router modules; start of functions that
  * are internal to this module
@@ -572,3 +706,124 @@ bool send_readonly_error(DCB *dcb)
 
     return succp;
 }
+
+static const char* skip_space(const char *ptr, const char *end)
+{
+    while (ptr < end && isspace(*ptr))
+    {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+/** Length of the identifier or keyword that starts at @c ptr */
+static int word_length(const char *ptr, const char *end)
+{
+    const char *start = ptr;
+
+    while (ptr < end && (isalnum(*ptr) || *ptr == '_' || *ptr == '$'))
+    {
+        ptr++;
+    }
+
+    return ptr - start;
+}
+
+static bool word_is(const char *ptr, int len, const char *word)
+{
+    return len == (int)strlen(word) && strncasecmp(ptr, word, len) == 0;
+}
+
+/** Check whether a keyword evaluates to session state without parentheses */
+static bool reads_session_state(const char *ptr, int len)
+{
+    static const char *keywords[] =
+    {
+        "CURRENT_USER", "CURRENT_ROLE", "CURRENT_DATE", "CURRENT_TIME",
+        "CURRENT_TIMESTAMP", "LOCALTIME", "LOCALTIMESTAMP", "UTC_DATE",
+        "UTC_TIME", "UTC_TIMESTAMP", "DEFAULT"
+    };
+
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+    {
+        if (word_is(ptr, len, keywords[i]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Check that the rest of a statement is the value of a single assignment
+ *
+ * @param ptr      Start of the value
+ * @param end      End of the statement
+ * @param constant Set to false if the value refers to variables, functions or
+ *                 keywords that read session state
+ *
+ * @return False if the rest contains more assignments, more statements or
+ *         comments
+ */
+static bool single_assignment(const char *ptr, const char *end, bool *constant)
+{
+    char quote = '\0';
+    int depth = 0;
+    *constant = true;
+
+    for (; ptr < end; ptr++)
+    {
+        if (quote)
+        {
+            if (*ptr == '\\' && quote != '`')
+            {
+                ptr++;
+            }
+            else if (*ptr == quote)
+            {
+                quote = '\0';
+            }
+        }
+        else if (*ptr == '\'' || *ptr == '"' || *ptr == '`')
+        {
+            quote = *ptr;
+        }
+        else if (*ptr == ';')
+        {
+            return skip_space(ptr + 1, end) == end;
+        }
+        else if ((*ptr == ',' && depth == 0) || *ptr == '#' ||
+                 (ptr + 1 < end && ((ptr[0] == '/' && ptr[1] == '*') ||
+                                    (ptr[0] == '-' && ptr[1] == '-'))))
+        {
+            return false;
+        }
+        else if (*ptr == '(')
+        {
+            depth++;
+            *constant = false;
+        }
+        else if (*ptr == '@')
+        {
+            *constant = false;
+        }
+        else if (*ptr == ')')
+        {
+            depth--;
+        }
+        else if (isalpha(*ptr) || *ptr == '_')
+        {
+            int wlen = word_length(ptr, end);
+
+            if (reads_session_state(ptr, wlen))
+            {
+                *constant = false;
+            }
+            ptr += wlen - 1;
+        }
+    }
+
+    return quote == '\0';
+}
@@ -238,6 +238,13 @@ bool route_session_write(ROUTER_CLIENT_SES *router_cli_ses,
         goto return_succp;
     }
 
+    if (!router_cli_ses->rses_config.disable_sescmd_history)
+    {
+        /** The history limit applies to the commands that still matter */
+        atomic_add(&router_cli_ses->rses_nsescmd,
+                   -compact_sescmd_history(router_cli_ses));
+    }
+
     if (router_cli_ses->rses_config.max_sescmd_history > 0 &&
         router_cli_ses->rses_nsescmd >=
         router_cli_ses->rses_config.max_sescmd_history)
@@ -527,6 +534,9 @@ bool rwsplit_get_dcb(DCB **p_dcb, ROUTER_CLIENT_SES *rses, backend_type_t btype,
     if (btype == BE_SLAVE)
     {
         backend_ref_t *candidate_bref = NULL;
+        /** With ADAPTIVE_ROUTING, the candidate is a weighted random choice */
+        bool adaptive = rses->rses_config.slave_selection_criteria == ADAPTIVE_ROUTING;
+        int64_t total_weight = 0;
 
         for (i = 0; i < rses->rses_nbackends; i++)
         {
@@ -558,6 +568,7 @@ bool rwsplit_get_dcb(DCB **p_dcb, ROUTER_CLIENT_SES *rses, backend_type_t btype,
                     /** found master */
                     candidate_bref = &backend_ref[i];
                     candidate.status = candidate_bref->ref->server->status;
+                    total_weight = adaptive ? adaptive_weight(candidate_bref) : 0;
                     succp = true;
                 }
                 /**
@@ -572,6 +583,7 @@ bool rwsplit_get_dcb(DCB **p_dcb, ROUTER_CLIENT_SES *rses, backend_type_t btype,
                     /** found slave */
                     candidate_bref = &backend_ref[i];
                     candidate.status = candidate_bref->ref->server->status;
+                    total_weight = adaptive ? adaptive_weight(candidate_bref) : 0;
                     succp = true;
                 }
             }
@@ -588,6 +600,7 @@ bool rwsplit_get_dcb(DCB **p_dcb, ROUTER_CLIENT_SES *rses, backend_type_t btype,
                 /** found slave */
                 candidate_bref = &backend_ref[i];
                 candidate.status = candidate_bref->ref->server->status;
+                total_weight = adaptive ? adaptive_weight(candidate_bref) : 0;
                 succp = true;
             }
             /**
@@ -602,8 +615,16 @@ bool rwsplit_get_dcb(DCB **p_dcb, ROUTER_CLIENT_SES *rses, backend_type_t btype,
                     (b->server->rlag != MAX_RLAG_NOT_AVAILABLE &&
                      b->server->rlag <= max_rlag))
                 {
-                    candidate_bref = check_candidate_bref(candidate_bref, &backend_ref[i],
-                                                          rses->rses_config.slave_selection_criteria);
+                    if (adaptive)
+                    {
+                        candidate_bref = adaptive_candidate(candidate_bref, &backend_ref[i],
+                                                            &total_weight);
+                    }
+                    else
+                    {
+                        candidate_bref = check_candidate_bref(candidate_bref, &backend_ref[i],
+                                                              rses->rses_config.slave_selection_criteria);
+                    }
                     candidate.status = candidate_bref->ref->server->status;
                 }
                 else
@@ -1067,12 +1088,17 @@ bool handle_slave_is_target(ROUTER_INSTANCE *inst, ROUTER_CLIENT_SES *rses,
 {
     int rlag_max = rses_get_max_replication_lag(rses);
 
+    if (rses->rses_config.lazy_connect)
+    {
+        connect_lazy_slave(rses);
+    }
+
     /**
      * Search suitable backend server, get DCB in target_dcb
      */
     if (rwsplit_get_dcb(target_dcb, rses, BE_SLAVE, NULL, rlag_max))
     {
-        atomic_add_uint64(&inst->stats.n_slave, 1);
+        mxs_metric_inc(inst->stats.n_slave);
         return true;
     }
     else
@@ -1164,14 +1190,14 @@ bool handle_master_is_target(ROUTER_INSTANCE *inst, ROUTER_CLIENT_SES *rses,
 
     if (succp && master_dcb == curr_master_dcb)
     {
-        atomic_add_uint64(&inst->stats.n_master, 1);
+        mxs_metric_inc(inst->stats.n_master);
         *target_dcb = master_dcb;
     }
     else
     {
         if (succp && master_dcb == curr_master_dcb)
         {
-            atomic_add_uint64(&inst->stats.n_master, 1);
+            mxs_metric_inc(inst->stats.n_master);
             *target_dcb = master_dcb;
         }
         else
@@ -1260,7 +1286,7 @@ handle_got_target(ROUTER_INSTANCE *inst, ROUTER_CLIENT_SES *rses,
 
         backend_ref_t *bref;
 
-        atomic_add_uint64(&inst->stats.n_queries, 1);
+        mxs_metric_inc(inst->stats.n_queries);
         /**
          * Add one query response waiter to backend reference
          */
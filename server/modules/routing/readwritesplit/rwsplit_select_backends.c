@@ -13,12 +13,14 @@
 
 #include "readwritesplit.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <strings.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <maxscale/random_jkiss.h>
 #include <maxscale/router.h>
 #include "rwsplit_internal.h"
 /**
@@ -35,6 +37,9 @@
  * @endverbatim
  */
 
+/** The weight of a server that is expected to respond in one microsecond */
+#define ADAPTIVE_WEIGHT_SCALE 1000000000
+
 static bool connect_server(backend_ref_t *bref, MXS_SESSION *session, bool execute_history);
 
 static void log_server_connections(select_criteria_t select_criteria,
@@ -50,6 +55,8 @@ static int bref_cmp_behind_master(const void *bref1, const void *bref2);
 
 static int bref_cmp_current_load(const void *bref1, const void *bref2);
 
+static int bref_cmp_response_time(const void *bref1, const void *bref2);
+
 /**
  * The order of functions _must_ match with the order the select criteria are
  * listed in select_criteria_t definition in readwritesplit.h
@@ -60,7 +67,8 @@ int (*criteria_cmpfun[LAST_CRITERIA])(const void *, const void *) =
     bref_cmp_global_conn,
     bref_cmp_router_conn,
     bref_cmp_behind_master,
-    bref_cmp_current_load
+    bref_cmp_current_load,
+    bref_cmp_response_time
 };
 
 /**
@@ -313,6 +321,73 @@ bool select_connect_backend_servers(backend_ref_t **p_master_ref,
     return succp;
 }
 
+/**
+ * @brief Connect a slave when a read would be routed to it
+ *
+ * With lazy_connect, the slaves are not connected when the session is created.
+ * When a read is routed, the best slave that is not connected is compared to
+ * the best connected one with the slave selection criteria and connected if it
+ * is better. The session command history is executed on the new connection
+ * before the read.
+ *
+ * A slave is not connected if the session command history has been disabled
+ * and session commands have been executed, as the slave could not be brought
+ * to the same state.
+ *
+ * @param rses Router session
+ */
+void connect_lazy_slave(ROUTER_CLIENT_SES *rses)
+{
+    if (rses->rses_config.disable_sescmd_history && rses->rses_nsescmd > 0)
+    {
+        return;
+    }
+
+    backend_ref_t *backend_ref = rses->rses_backend_ref;
+    int n = rses->rses_nbackends;
+    SERVER_REF *master_backend = get_root_master(backend_ref, n);
+    SERVER *master_host = master_backend ? master_backend->server : NULL;
+    int (*p)(const void *, const void *) = criteria_cmpfun[rses->rses_config.slave_selection_criteria];
+    backend_ref_t *connected = NULL;
+    int slaves_connected = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (BREF_IS_IN_USE(&backend_ref[i]) && bref_valid_for_slave(&backend_ref[i], master_host))
+        {
+            slaves_connected += 1;
+
+            if (connected == NULL || p(connected, &backend_ref[i]) > 0)
+            {
+                connected = &backend_ref[i];
+            }
+        }
+    }
+
+    if (slaves_connected >= rses_get_max_slavecount(rses, n))
+    {
+        return;
+    }
+
+    backend_ref_t *bref = get_slave_candidate(backend_ref, n, master_host, p);
+
+    if (bref && (connected == NULL || p(connected, bref) > 0))
+    {
+        if (connect_server(bref, rses->client_dcb->session, true))
+        {
+            MXS_INFO("Connected lazily to %s in \t[%s]:%d",
+                     STRSRVSTATUS(bref->ref->server),
+                     bref->ref->server->name,
+                     bref->ref->server->port);
+        }
+        else
+        {
+            /** Failed to connect, mark server as failed */
+            bref_set_state(bref, BREF_FATAL_FAILURE);
+        }
+    }
+}
+
 /** Compare number of connections from this router in backend servers */
 static int bref_cmp_router_conn(const void *bref1, const void *bref2)
 {
@@ -407,6 +482,86 @@ static int bref_cmp_current_load(const void *bref1, const void *bref2)
            ((1000 + 1000 * b2->server->stats.n_current_ops) / b2->weight);
 }
 
+/**
+ * @brief The expected time it takes a server to respond
+ *
+ * The moving average of the response times is multiplied by the number of
+ * operations that are already waiting for the server. A server that has not
+ * responded yet is expected to be fast so that it is tried.
+ *
+ * @param ref Server reference
+ * @return The expected response time in microseconds, scaled by the weight
+ */
+static int64_t expected_response_time(const SERVER_REF *ref)
+{
+    int64_t rtime = (ref->server->stats.response_time + 1) *
+                    (ref->server->stats.n_current_ops + 1);
+
+    return ref->weight ? rtime * 1000 / ref->weight : rtime;
+}
+
+/** Compare the expected response times of backend servers */
+static int bref_cmp_response_time(const void *bref1, const void *bref2)
+{
+    SERVER_REF *b1 = ((backend_ref_t *)bref1)->ref;
+    SERVER_REF *b2 = ((backend_ref_t *)bref2)->ref;
+
+    if (b1->weight == 0 && b2->weight != 0)
+    {
+        return 1;
+    }
+    else if (b2->weight == 0 && b1->weight != 0)
+    {
+        return -1;
+    }
+
+    int64_t t1 = expected_response_time(b1);
+    int64_t t2 = expected_response_time(b2);
+
+    return t1 < t2 ? -1 : (t1 > t2 ? 1 : 0);
+}
+
+/**
+ * @brief The share of queries a backend should get with ADAPTIVE_ROUTING
+ *
+ * @param bref Backend reference
+ * @return The inverse of the expected response time, zero for servers with
+ *         zero weight
+ */
+int64_t adaptive_weight(const backend_ref_t *bref)
+{
+    return bref->ref->weight ? ADAPTIVE_WEIGHT_SCALE / expected_response_time(bref->ref) + 1 : 0;
+}
+
+/**
+ * @brief Choose between the current candidate and a challenger with ADAPTIVE_ROUTING
+ *
+ * Each backend that is offered in turn is chosen with a probability that
+ * is its share of the total weight of all backends offered so far. The
+ * backend that remains is then a weighted random choice of all of them, so
+ * faster servers get more queries but every server keeps getting some and its
+ * response time stays up to date.
+ *
+ * @param cand         The current candidate, NULL if there is none
+ * @param new          The challenger
+ * @param total_weight Total weight of the backends offered so far, updated
+ * @return The backend that remains the candidate
+ */
+backend_ref_t* adaptive_candidate(backend_ref_t *cand, backend_ref_t *new, int64_t *total_weight)
+{
+    int64_t weight = adaptive_weight(new);
+    *total_weight += weight;
+
+    if (cand == NULL)
+    {
+        return new;
+    }
+
+    uint64_t r = ((uint64_t)random_jkiss() << 32) | random_jkiss();
+
+    return (int64_t)(r % (*total_weight ? *total_weight : 1)) < weight ? new : cand;
+}
+
 /**
  * @brief Connect a server
  *
@@ -476,7 +631,8 @@ static void log_server_connections(select_criteria_t select_criteria,
     if (select_criteria == LEAST_GLOBAL_CONNECTIONS ||
         select_criteria == LEAST_ROUTER_CONNECTIONS ||
         select_criteria == LEAST_BEHIND_MASTER ||
-        select_criteria == LEAST_CURRENT_OPERATIONS)
+        select_criteria == LEAST_CURRENT_OPERATIONS ||
+        select_criteria == ADAPTIVE_ROUTING)
     {
         MXS_INFO("Servers and %s connection counts:",
                  select_criteria == LEAST_GLOBAL_CONNECTIONS ? "all MaxScale"
@@ -511,6 +667,14 @@ static void log_server_connections(select_criteria_t select_criteria,
                 MXS_INFO("replication lag : %d in \t[%s]:%d %s",
                          b->server->rlag, b->server->name,
                          b->server->port, STRSRVSTATUS(b->server));
+                break;
+
+            case ADAPTIVE_ROUTING:
+                MXS_INFO("response time : %" PRId64 "us, current operations : %d in \t[%s]:%d %s",
+                         b->server->stats.response_time, b->server->stats.n_current_ops,
+                         b->server->name, b->server->port, STRSRVSTATUS(b->server));
+                break;
+
             default:
                 break;
             }
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <maxscale/alloc.h>
 #include <maxscale/router.h>
 #include "rwsplit_internal.h"
 
@@ -39,6 +40,8 @@ static bool sescmd_cursor_history_empty(sescmd_cursor_t *scur);
 static void sescmd_cursor_reset(sescmd_cursor_t *scur);
 static bool sescmd_cursor_next(sescmd_cursor_t *scur);
 static rses_property_t *mysql_sescmd_get_property(mysql_sescmd_t *scmd);
+static bool sescmd_is_superseded(rses_property_t *prop);
+static bool sescmd_is_in_use(ROUTER_CLIENT_SES *rses, rses_property_t *prop);
 
 /*
  * The following functions, all to do with the handling of session commands,
@@ -92,6 +95,8 @@ mysql_sescmd_t *mysql_sescmd_init(rses_property_t *rses_prop,
     sescmd->my_sescmd_buf = sescmd_buf;
     sescmd->my_sescmd_packet_type = packet_type;
     sescmd->position = atomic_add(&rses->pos_generator, 1);
+    sescmd->my_sescmd_key = get_sescmd_state_key(sescmd_buf, packet_type,
+                                                 &sescmd->my_sescmd_constant);
 
     return sescmd;
 }
@@ -105,6 +110,7 @@ void mysql_sescmd_done(mysql_sescmd_t *sescmd)
     }
     CHK_RSES_PROP(sescmd->my_sescmd_prop);
     gwbuf_free(sescmd->my_sescmd_buf);
+    MXS_FREE(sescmd->my_sescmd_key);
     memset(sescmd, 0, sizeof(mysql_sescmd_t));
 }
 
@@ -365,6 +371,64 @@ static bool sescmd_cursor_history_empty(sescmd_cursor_t *scur)
     return succp;
 }
 
+/**
+ * @brief Remove superseded session commands from the history
+ *
+ * A command is superseded when a later command that succeeded sets the same
+ * session state to a value that does not depend on the old one and none of
+ * the commands in between could have used the old state, or when a later
+ * COM_CHANGE_USER succeeded. Unrecognized commands, values that refer to
+ * variables or functions and changes to the default database, character set
+ * or SQL mode are assumed to use the state set before them. A superseded command is removed once it
+ * has been replied to the client and no backend in use is executing it.
+ * Backends that have not yet executed it skip it. This keeps the history,
+ * and the time it takes to replay it, proportional to the amount of distinct
+ * session state instead of the age of the session.
+ *
+ * Router session must be locked
+ *
+ * @param rses Router client session
+ *
+ * @return Number of removed commands
+ */
+int compact_sescmd_history(ROUTER_CLIENT_SES *rses)
+{
+    rses_property_t **prev = &rses->rses_properties[RSES_PROP_TYPE_SESCMD];
+    int removed = 0;
+
+    while (*prev)
+    {
+        rses_property_t *prop = *prev;
+        CHK_RSES_PROP(prop);
+
+        if (prop->rses_prop_data.sescmd.my_sescmd_is_replied &&
+            sescmd_is_superseded(prop) && !sescmd_is_in_use(rses, prop))
+        {
+            *prev = prop->rses_prop_next;
+
+            /** Idle cursors that point past the command now point past its predecessor */
+            for (int i = 0; i < rses->rses_nbackends; i++)
+            {
+                sescmd_cursor_t *scur = &rses->rses_backend_ref[i].bref_sescmd_cur;
+
+                if (scur->scmd_cur_ptr_property == &prop->rses_prop_next)
+                {
+                    scur->scmd_cur_ptr_property = prev;
+                }
+            }
+
+            rses_property_done(prop);
+            removed++;
+        }
+        else
+        {
+            prev = &prop->rses_prop_next;
+        }
+    }
+
+    return removed;
+}
+
 /*
  * End of functions called from other modules of the read write split router;
  * start of functions that are internal to this module.
@@ -465,3 +529,79 @@ static rses_property_t *mysql_sescmd_get_property(mysql_sescmd_t *scmd)
     CHK_MYSQL_SESCMD(scmd);
     return scmd->my_sescmd_prop;
 }
+
+/**
+ * Check whether other statements are parsed or resolved according to the state
+ * that a command sets: the default database resolves unqualified names and the
+ * character set and SQL mode change how literals are interpreted.
+ */
+static bool sescmd_key_is_barrier(const char *key)
+{
+    return strcmp(key, "db") == 0 || strcmp(key, "names") == 0 ||
+           strcmp(key, "var:sql_mode") == 0 ||
+           strncmp(key, "var:character_set_", strlen("var:character_set_")) == 0 ||
+           strncmp(key, "var:collation_", strlen("var:collation_")) == 0;
+}
+
+/**
+ * Check whether a command in between may have used the state the earlier one set
+ *
+ * @param scmd  The earlier command
+ * @param later A command executed after it
+ *
+ * @return True if removing @c scmd could change the result of @c later
+ */
+static bool sescmd_depends_on(mysql_sescmd_t *scmd, mysql_sescmd_t *later)
+{
+    return scmd->my_sescmd_key == NULL || sescmd_key_is_barrier(scmd->my_sescmd_key) ||
+           later->my_sescmd_key == NULL || !later->my_sescmd_constant ||
+           sescmd_key_is_barrier(later->my_sescmd_key);
+}
+
+static bool sescmd_is_superseded(rses_property_t *prop)
+{
+    mysql_sescmd_t *scmd = &prop->rses_prop_data.sescmd;
+    bool depended_on = false;
+
+    for (rses_property_t *next = prop->rses_prop_next; next; next = next->rses_prop_next)
+    {
+        mysql_sescmd_t *later = &next->rses_prop_data.sescmd;
+        bool succeeded = later->my_sescmd_is_replied && later->reply_cmd == MYSQL_REPLY_OK;
+
+        if (succeeded && later->my_sescmd_packet_type == MYSQL_COM_CHANGE_USER)
+        {
+            /** Resets all session state regardless of what was executed before it */
+            return true;
+        }
+
+        if (!depended_on && succeeded && scmd->my_sescmd_key && later->my_sescmd_key &&
+            later->my_sescmd_constant && strcmp(scmd->my_sescmd_key, later->my_sescmd_key) == 0)
+        {
+            return true;
+        }
+
+        if (sescmd_depends_on(scmd, later))
+        {
+            /** Only a COM_CHANGE_USER can make the command redundant anymore */
+            depended_on = true;
+        }
+    }
+
+    return false;
+}
+
+/** Check whether a backend in use is about to execute or is executing a command */
+static bool sescmd_is_in_use(ROUTER_CLIENT_SES *rses, rses_property_t *prop)
+{
+    for (int i = 0; i < rses->rses_nbackends; i++)
+    {
+        backend_ref_t *bref = &rses->rses_backend_ref[i];
+
+        if (BREF_IS_IN_USE(bref) && *bref->bref_sescmd_cur.scmd_cur_ptr_property == prop)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2016 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2019-07-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file testsescmd.c Session state keys and compaction of the session command history
+ */
+
+// To ensure that ss_info_assert asserts also when builing in non-debug mode.
+#if !defined(SS_DEBUG)
+#define SS_DEBUG
+#endif
+#if defined(NDEBUG)
+#undef NDEBUG
+#endif
+
+#include "../readwritesplit.h"
+#include "../rwsplit_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <maxscale/alloc.h>
+#include <maxscale/debug.h>
+#include <maxscale/modutil.h>
+
+/** Maximum number of statements in one compaction test */
+#define MAX_STMTS 8
+
+typedef struct
+{
+    const char *sql;
+    const char *key;  /*< Expected key, NULL if the statement is not recognized */
+    bool constant;    /*< Expected constness of the value */
+} KEY_TEST;
+
+static KEY_TEST key_tests[] =
+{
+    {"USE db1", "db", true},
+    {"use `db1`;", "db", true},
+    {"SET NAMES utf8", "names", true},
+    {"SET CHARACTER SET latin1", "names", true},
+    {"SET autocommit=1", "var:autocommit", true},
+    {"SET SESSION sql_mode='ANSI_QUOTES'", "var:sql_mode", true},
+    {"SET @@session.SQL_MODE = 'ANSI'", "var:sql_mode", true},
+    {"SET @@sql_mode=''", "var:sql_mode", true},
+    {"SET @a=1", "@a", true},
+    {"SET @a := 'x,y'", "@a", true},
+    {"SET @b=@a", "@b", false},
+    {"SET @t=DATABASE()", "@t", false},
+    {"SET @u=CURRENT_USER", "@u", false},
+    {"SET sql_mode=CONCAT(@@sql_mode, ',ANSI')", "var:sql_mode", false},
+    {"SET @a=1, @b=2", NULL, false},
+    {"SET @a=1; SET @b=2", NULL, false},
+    {"SET @a=1 /* comment */", NULL, false},
+    {"SET @a=1 -- comment", NULL, false},
+    {"SET GLOBAL max_connections=10", NULL, false},
+    {"SET @@global.max_connections=10", NULL, false},
+    {"SET TRANSACTION READ ONLY", NULL, false},
+    {"SELECT 1", NULL, false},
+    {"CREATE TEMPORARY TABLE t1 (id INT)", NULL, false},
+    {NULL}
+};
+
+typedef struct
+{
+    const char *name;
+    const char *stmts[MAX_STMTS];  /*< The executed session commands */
+    const char *failed;            /*< Statement that returns an error, if any */
+    const char *kept[MAX_STMTS];   /*< The commands left after compaction */
+} COMPACT_TEST;
+
+static COMPACT_TEST compact_tests[] =
+{
+    {
+        "Same variable",
+        {"SET @a=1", "SET @a=2"}, NULL,
+        {"SET @a=2"}
+    },
+    {
+        "Independent command in between",
+        {"SET @a=1", "SET @c=5", "SET @a=2"}, NULL,
+        {"SET @c=5", "SET @a=2"}
+    },
+    {
+        "Value read in between",
+        {"SET @a=1", "SET @b=@a", "SET @a=2"}, NULL,
+        {"SET @a=1", "SET @b=@a", "SET @a=2"}
+    },
+    {
+        "Default database read in between",
+        {"USE db1", "SET @t=DATABASE()", "USE db2"}, NULL,
+        {"USE db1", "SET @t=DATABASE()", "USE db2"}
+    },
+    {
+        "Literal parsed with the old character set",
+        {"SET NAMES latin1", "SET @a='x'", "SET NAMES utf8"}, NULL,
+        {"SET NAMES latin1", "SET @a='x'", "SET NAMES utf8"}
+    },
+    {
+        "Literal parsed with the old SQL mode",
+        {"SET sql_mode='ANSI_QUOTES'", "SET @a=\"x\"", "SET sql_mode=''"}, NULL,
+        {"SET sql_mode='ANSI_QUOTES'", "SET @a=\"x\"", "SET sql_mode=''"}
+    },
+    {
+        "Character set changed in between",
+        {"SET @a=1", "SET NAMES latin1", "SET @a=2"}, NULL,
+        {"SET @a=1", "SET NAMES latin1", "SET @a=2"}
+    },
+    {
+        "Unrecognized command in between",
+        {"SET @a=1", "CREATE TEMPORARY TABLE t1 AS SELECT @a", "SET @a=2"}, NULL,
+        {"SET @a=1", "CREATE TEMPORARY TABLE t1 AS SELECT @a", "SET @a=2"}
+    },
+    {
+        "Consecutive database changes",
+        {"USE db1", "USE db2", "SET @a=1"}, NULL,
+        {"USE db2", "SET @a=1"}
+    },
+    {
+        "Failed replacement",
+        {"SET @a=1", "SET @a=2"}, "SET @a=2",
+        {"SET @a=1", "SET @a=2"}
+    },
+    {
+        "Value that depends on the old one",
+        {"SET @a=1", "SET @a=@a+1"}, NULL,
+        {"SET @a=1", "SET @a=@a+1"}
+    },
+    {NULL}
+};
+
+static void init_rses(ROUTER_CLIENT_SES *rses)
+{
+    memset(rses, 0, sizeof(*rses));
+    rses->rses_chk_top = CHK_NUM_ROUTER_SES;
+    rses->rses_chk_tail = CHK_NUM_ROUTER_SES;
+}
+
+static void free_rses(ROUTER_CLIENT_SES *rses)
+{
+    rses_property_t *prop = rses->rses_properties[RSES_PROP_TYPE_SESCMD];
+
+    while (prop)
+    {
+        rses_property_t *next = prop->rses_prop_next;
+        rses_property_done(prop);
+        prop = next;
+    }
+}
+
+/**
+ * Add a replied session command to the history
+ *
+ * @param rses   Router session
+ * @param sql    The statement
+ * @param result Reply of the command
+ */
+static void add_sescmd(ROUTER_CLIENT_SES *rses, const char *sql, unsigned char result)
+{
+    rses_property_t *prop = rses_property_init(RSES_PROP_TYPE_SESCMD);
+    ss_info_dassert(prop, "Property should be allocated");
+
+    mysql_sescmd_t *scmd = mysql_sescmd_init(prop, modutil_create_query(sql),
+                                             MYSQL_COM_QUERY, rses);
+    scmd->my_sescmd_is_replied = true;
+    scmd->reply_cmd = result;
+    int rc = rses_property_add(rses, prop);
+    ss_info_dassert(rc == 0, "Property should be added");
+}
+
+static int test_keys()
+{
+    ss_dfprintf(stderr, "testsescmd : Session state keys of statements");
+
+    for (KEY_TEST *t = key_tests; t->sql; t++)
+    {
+        GWBUF *buf = modutil_create_query(t->sql);
+        bool constant = false;
+        char *key = get_sescmd_state_key(buf, MYSQL_COM_QUERY, &constant);
+
+        if (t->key)
+        {
+            ss_info_dassert(key && strcmp(key, t->key) == 0, t->sql);
+            ss_info_dassert(constant == t->constant, t->sql);
+        }
+        else
+        {
+            ss_info_dassert(key == NULL, t->sql);
+        }
+
+        MXS_FREE(key);
+        gwbuf_free(buf);
+    }
+
+    /** COM_INIT_DB sets the default database */
+    const char db[] = "\x01test";
+    GWBUF *buf = gwbuf_alloc(MYSQL_HEADER_LEN + sizeof(db) - 1);
+    uint8_t *data = GWBUF_DATA(buf);
+    gw_mysql_set_byte3(data, sizeof(db) - 1);
+    data[3] = 0;
+    memcpy(data + MYSQL_HEADER_LEN, db, sizeof(db) - 1);
+
+    bool constant = false;
+    char *key = get_sescmd_state_key(buf, MYSQL_COM_INIT_DB, &constant);
+    ss_info_dassert(key && strcmp(key, "db") == 0 && constant, "COM_INIT_DB sets the database");
+    MXS_FREE(key);
+
+    key = get_sescmd_state_key(buf, MYSQL_COM_STMT_PREPARE, &constant);
+    ss_info_dassert(key == NULL, "Other commands should not have a key");
+    gwbuf_free(buf);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+static int test_compaction()
+{
+    ss_dfprintf(stderr, "testsescmd : Compaction of the session command history");
+
+    for (COMPACT_TEST *t = compact_tests; t->name; t++)
+    {
+        ROUTER_CLIENT_SES rses;
+        init_rses(&rses);
+        int n_stmts = 0;
+        int n_kept = 0;
+
+        for (const char **sql = t->stmts; sql < t->stmts + MAX_STMTS && *sql; sql++, n_stmts++)
+        {
+            bool failed = t->failed && strcmp(*sql, t->failed) == 0;
+            add_sescmd(&rses, *sql, failed ? MYSQL_REPLY_ERR : MYSQL_REPLY_OK);
+        }
+
+        for (const char **sql = t->kept; sql < t->kept + MAX_STMTS && *sql; sql++)
+        {
+            n_kept++;
+        }
+
+        ss_info_dassert(compact_sescmd_history(&rses) == n_stmts - n_kept, t->name);
+
+        rses_property_t *prop = rses.rses_properties[RSES_PROP_TYPE_SESCMD];
+
+        for (int i = 0; i < n_kept; i++)
+        {
+            ss_info_dassert(prop, t->name);
+            char *sql = modutil_get_SQL(prop->rses_prop_data.sescmd.my_sescmd_buf);
+            ss_info_dassert(sql && strcmp(sql, t->kept[i]) == 0, t->name);
+            MXS_FREE(sql);
+            prop = prop->rses_prop_next;
+        }
+
+        ss_info_dassert(prop == NULL, t->name);
+        free_rses(&rses);
+    }
+
+    /** A successful COM_CHANGE_USER replaces everything before it */
+    ROUTER_CLIENT_SES rses;
+    init_rses(&rses);
+    add_sescmd(&rses, "SET @a=1", MYSQL_REPLY_OK);
+    add_sescmd(&rses, "CREATE TEMPORARY TABLE t1 AS SELECT @a", MYSQL_REPLY_OK);
+    add_sescmd(&rses, "SET NAMES latin1", MYSQL_REPLY_OK);
+    add_sescmd(&rses, "SET @b=@a", MYSQL_REPLY_OK);
+
+    rses_property_t *last = rses.rses_properties[RSES_PROP_TYPE_SESCMD];
+
+    while (last->rses_prop_next)
+    {
+        last = last->rses_prop_next;
+    }
+
+    last->rses_prop_data.sescmd.my_sescmd_packet_type = MYSQL_COM_CHANGE_USER;
+    ss_info_dassert(compact_sescmd_history(&rses) == 3, "COM_CHANGE_USER replaces all commands");
+    ss_info_dassert(rses.rses_properties[RSES_PROP_TYPE_SESCMD] == last &&
+                    last->rses_prop_next == NULL, "Only COM_CHANGE_USER should remain");
+    free_rses(&rses);
+
+    ss_dfprintf(stderr, "\t..done\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+
+    result += test_keys();
+    result += test_compaction();
+
+    return result;
+}
@@ -30,7 +30,10 @@
 #include <maxscale/modutil.h>
 #include <maxscale/protocol/mysql.h>
 #include <maxscale/alloc.h>
+#include <maxscale/housekeeper.h>
+#include <maxscale/paths.h>
 #include <maxscale/poll.h>
+#include <maxscale/utils.h>
 #include <pcre.h>
 
 #define DEFAULT_REFRESH_INTERVAL "300"
@@ -57,6 +60,8 @@
  */
 
 static MXS_ROUTER* createInstance(SERVICE *service, char **options);
+static void load_shard_maps(ROUTER_INSTANCE *router);
+static void store_shard_maps(void *data);
 static MXS_ROUTER_SESSION* newSession(MXS_ROUTER *instance, MXS_SESSION *session);
 static void closeSession(MXS_ROUTER *instance, MXS_ROUTER_SESSION *session);
 static void freeSession(MXS_ROUTER *instance, MXS_ROUTER_SESSION *session);
@@ -854,6 +859,14 @@ static MXS_ROUTER* createInstance(SERVICE *service, char **options)
         MXS_FREE(router);
         router = NULL;
     }
+    else
+    {
+        load_shard_maps(router);
+
+        char task_name[strlen(service->name) + sizeof(" shard maps")];
+        sprintf(task_name, "%s shard maps", service->name);
+        hktask_add_concurrent(task_name, store_shard_maps, router, SHARD_MAP_STORE_FREQ, 1);
+    }
 
     return (MXS_ROUTER *)router;
 }
@@ -4274,6 +4287,7 @@ void replace_shard_map(shard_map_t **target, shard_map_t **source)
  */
 void synchronize_shard_map(ROUTER_CLIENT_SES *client)
 {
+    bool changed = true;
     spinlock_acquire(&client->router->lock);
 
     client->router->stats.shmap_cache_miss++;
@@ -4300,6 +4314,7 @@ void synchronize_shard_map(ROUTER_CLIENT_SES *client)
              */
             hashtable_free(client->shardmap->hash);
             MXS_FREE(client->shardmap);
+            changed = false;
         }
         spinlock_release(&map->lock);
         client->shardmap = map;
@@ -4312,5 +4327,215 @@ void synchronize_shard_map(ROUTER_CLIENT_SES *client)
         ss_dassert(hashtable_fetch(client->router->shard_maps,
                                    client->rses_client_dcb->user) == client->shardmap);
     }
+
+    if (changed)
+    {
+        /** The maps are persisted by a housekeeper task, not by the worker */
+        client->router->shard_maps_changed = true;
+    }
+
     spinlock_release(&client->router->lock);
 }
+
+/** Name of the file where the shard maps are persisted */
+static const char SHARD_MAP_FILE[] = "shard_maps";
+
+/**
+ * Check that a name can be stored in the shard map file
+ * @param name Name to check
+ * @return True if the name contains no separators
+ */
+static bool shard_map_name_ok(const char *name)
+{
+    return strpbrk(name, "\t\n") == NULL;
+}
+
+/**
+ * Persist the shard maps of all users if they have changed
+ *
+ * This is a housekeeper task, so the changes made by the sessions are collected
+ * and written at most once every SHARD_MAP_STORE_FREQ seconds, without blocking
+ * the worker threads. Only one run of the task executes at a time. The maps are written to a file in the data directory of
+ * the service with one line per mapped database. The file is written in full to
+ * a temporary file which is then renamed over the previous one.
+ * @param data Router instance
+ */
+static void store_shard_maps(void *data)
+{
+    ROUTER_INSTANCE *router = (ROUTER_INSTANCE*)data;
+    spinlock_acquire(&router->lock);
+    bool changed = router->shard_maps_changed;
+    router->shard_maps_changed = false;
+    spinlock_release(&router->lock);
+
+    if (!changed)
+    {
+        return;
+    }
+
+    char *content = NULL;
+    size_t size = 0;
+    FILE *mem = open_memstream(&content, &size);
+
+    if (mem == NULL)
+    {
+        return;
+    }
+
+    spinlock_acquire(&router->lock);
+    HASHITERATOR *users = hashtable_iterator(router->shard_maps);
+
+    if (users)
+    {
+        char *user;
+
+        while ((user = hashtable_next(users)))
+        {
+            shard_map_t *map = hashtable_fetch(router->shard_maps, user);
+
+            if (map == NULL || !shard_map_name_ok(user))
+            {
+                continue;
+            }
+
+            spinlock_acquire(&map->lock);
+            HASHITERATOR *dbs = hashtable_iterator(map->hash);
+
+            if (dbs)
+            {
+                char *db;
+
+                while ((db = hashtable_next(dbs)))
+                {
+                    char *server = hashtable_fetch(map->hash, db);
+
+                    if (server && shard_map_name_ok(db) && shard_map_name_ok(server))
+                    {
+                        fprintf(mem, "%s\t%s\t%s\n", user, db, server);
+                    }
+                }
+
+                hashtable_iterator_free(dbs);
+            }
+
+            spinlock_release(&map->lock);
+        }
+
+        hashtable_iterator_free(users);
+    }
+
+    spinlock_release(&router->lock);
+    fclose(mem);
+
+    char path[PATH_MAX];
+    char tmp[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s/", get_datadir(), router->service->name);
+
+    if (mxs_mkdir_all(path, S_IRWXU))
+    {
+        snprintf(tmp, sizeof(tmp), "%s/%s/%s.tmp", get_datadir(), router->service->name,
+                 SHARD_MAP_FILE);
+        snprintf(path, sizeof(path), "%s/%s/%s", get_datadir(), router->service->name,
+                 SHARD_MAP_FILE);
+
+        FILE *file = fopen(tmp, "w");
+        bool ok = file && fwrite(content, 1, size, file) == size;
+
+        if (file && fclose(file) != 0)
+        {
+            ok = false;
+        }
+
+        if (!ok || rename(tmp, path) != 0)
+        {
+            char err[MXS_STRERROR_BUFLEN];
+            MXS_ERROR("[%s] Failed to store the shard maps at '%s': %d, %s",
+                      router->service->name, path, errno, strerror_r(errno, err, sizeof(err)));
+            unlink(tmp);
+        }
+    }
+
+    free(content);
+}
+
+/**
+ * Load the shard maps persisted by the previous run
+ *
+ * The loaded maps are used as if they had been just created and are refreshed
+ * once they are older than refresh_interval seconds. A map that refers to a
+ * server that is no longer used by the service is marked stale.
+ * @param router Router instance
+ */
+static void load_shard_maps(ROUTER_INSTANCE *router)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s/%s", get_datadir(), router->service->name, SHARD_MAP_FILE);
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    time_t now = time(NULL);
+    int loaded = 0;
+
+    while (getline(&line, &size, file) != -1)
+    {
+        char *saveptr;
+        char *user = strtok_r(line, "\t\n", &saveptr);
+        char *db = strtok_r(NULL, "\t\n", &saveptr);
+        char *server = strtok_r(NULL, "\t\n", &saveptr);
+
+        if (user == NULL || db == NULL || server == NULL)
+        {
+            continue;
+        }
+
+        shard_map_t *map = hashtable_fetch(router->shard_maps, user);
+
+        if (map == NULL)
+        {
+            if ((map = shard_map_alloc()) == NULL)
+            {
+                break;
+            }
+
+            map->state = SHMAP_READY;
+            map->last_updated = now;
+            hashtable_add(router->shard_maps, user, map);
+            loaded++;
+        }
+
+        bool found = false;
+
+        for (SERVER_REF *ref = router->service->dbref; ref; ref = ref->next)
+        {
+            if (SERVER_REF_IS_ACTIVE(ref) && strcmp(ref->server->unique_name, server) == 0)
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if (found)
+        {
+            hashtable_add(map->hash, db, server);
+        }
+        else
+        {
+            map->state = SHMAP_STALE;
+        }
+    }
+
+    free(line);
+    fclose(file);
+
+    if (loaded > 0)
+    {
+        MXS_NOTICE("[%s] Loaded the shard maps of %d users stored by the previous run.",
+                   router->service->name, loaded);
+    }
+}
@@ -94,6 +94,9 @@ typedef enum bref_state
 #define BREF_IS_CLOSED(s)           ((s)->bref_state & BREF_CLOSED)
 #define BREF_IS_MAPPED(s)           ((s)->bref_mapped)
 
+/** How often the changed shard maps are persisted, in seconds */
+#define SHARD_MAP_STORE_FREQ 5
+
 #define SCHEMA_ERR_DUPLICATEDB 5000
 #define SCHEMA_ERRSTR_DUPLICATEDB "DUPDB"
 #define SCHEMA_ERR_DBNOTFOUND 1049
@@ -374,6 +377,8 @@ typedef struct router_instance
                                            * if they are found on more than one server. */
     pcre2_match_data*       ignore_match_data;
     SERVER*                 preferred_server; /**< Server to prefer in conflict situations */
+    bool                    shard_maps_changed; /*< The shard maps have changed since
+                                                 * they were last persisted */
 
 } ROUTER_INSTANCE;
 